@@ -0,0 +1,526 @@
+/**
+ * @file BandwidthShaper.cpp
+ * @brief Implementation of the shared transfer rate limiter
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "BandwidthShaper.h"
+
+#include <Autolock.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+
+using namespace OneDrive;
+
+const bigtime_t BandwidthShaper::kBurstTime = 100000LL; // 100ms
+
+// How often the schedule is checked against the clock
+static const bigtime_t kScheduleCheckInterval = 1000000LL;
+
+// Longest uninterrupted wait, so limit changes reach waiting transfers
+static const bigtime_t kSleepSlice = 250000LL;
+
+static const uint8 kAllDays = 0x7f;
+
+static const char* kDayNames[7] = {
+    "sun", "mon", "tue", "wed", "thu", "fri", "sat"
+};
+
+/**
+ * @brief Parse a weekday name, -1 if unknown
+ */
+static int32
+ParseDay(const BString& name)
+{
+    if (name.Length() < 3) {
+        return -1;
+    }
+    for (int32 day = 0; day < 7; day++) {
+        if (strncasecmp(name.String(), kDayNames[day], 3) == 0) {
+            return day;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse "Mon-Fri", "Sat,Sun" and combinations into a day mask
+ */
+static bool
+ParseDays(const BString& token, uint8& days)
+{
+    days = 0;
+    int32 start = 0;
+    while (start <= token.Length()) {
+        int32 end = token.FindFirst(',', start);
+        if (end < 0) {
+            end = token.Length();
+        }
+        BString part;
+        token.CopyInto(part, start, end - start);
+
+        int32 dash = part.FindFirst('-');
+        BString firstName(part);
+        BString lastName(part);
+        if (dash >= 0) {
+            part.CopyInto(firstName, 0, dash);
+            part.CopyInto(lastName, dash + 1, part.Length() - dash - 1);
+        }
+        int32 first = ParseDay(firstName);
+        int32 last = ParseDay(lastName);
+        if (first < 0 || last < 0) {
+            return false;
+        }
+
+        // Ranges may wrap, e.g. "Fri-Mon"
+        for (int32 day = first; ; day = (day + 1) % 7) {
+            days |= 1 << day;
+            if (day == last) {
+                break;
+            }
+        }
+        start = end + 1;
+    }
+    return days != 0;
+}
+
+/**
+ * @brief Parse "HH:MM" into minutes after midnight; "24:00" is allowed
+ */
+static bool
+ParseTime(const char* text, int32 length, int32& minutes)
+{
+    int32 hours = 0;
+    int32 mins = 0;
+    int32 i = 0;
+    int32 digits = 0;
+    while (i < length && isdigit(text[i]) && digits < 2) {
+        hours = hours * 10 + (text[i++] - '0');
+        digits++;
+    }
+    if (digits == 0 || i >= length || text[i++] != ':') {
+        return false;
+    }
+    digits = 0;
+    while (i < length && isdigit(text[i]) && digits < 2) {
+        mins = mins * 10 + (text[i++] - '0');
+        digits++;
+    }
+    if (digits != 2 || i != length || mins > 59 || hours > 24
+        || (hours == 24 && mins != 0)) {
+        return false;
+    }
+    minutes = hours * 60 + mins;
+    return true;
+}
+
+/**
+ * @brief Parse "HH:MM-HH:MM"
+ */
+static bool
+ParseTimeRange(const BString& token, int32& start, int32& end)
+{
+    int32 dash = token.FindFirst('-');
+    return dash > 0
+        && ParseTime(token.String(), dash, start)
+        && ParseTime(token.String() + dash + 1, token.Length() - dash - 1,
+            end);
+}
+
+/**
+ * @brief Parse "unlimited", "0", "1500", "512K", "2M" or "1.5G"
+ */
+static bool
+ParseRate(const char* text, off_t& rate)
+{
+    if (strcasecmp(text, "unlimited") == 0) {
+        rate = 0;
+        return true;
+    }
+
+    char* end;
+    double value = strtod(text, &end);
+    if (end == text || value < 0) {
+        return false;
+    }
+    switch (tolower(*end)) {
+        case '\0':
+            break;
+        case 'k':
+            value *= 1024;
+            end++;
+            break;
+        case 'm':
+            value *= 1024 * 1024;
+            end++;
+            break;
+        case 'g':
+            value *= 1024.0 * 1024 * 1024;
+            end++;
+            break;
+        default:
+            return false;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+    rate = (off_t)value;
+    return true;
+}
+
+/**
+ * @brief Parse one schedule entry
+ */
+static bool
+ParseRule(const BString& entry, BandwidthRule& rule)
+{
+    rule.days = kAllDays;
+    rule.start = -1;
+    rule.end = -1;
+    for (int32 i = 0; i < kBandwidthDirectionCount; i++) {
+        rule.limits[i] = -1;
+    }
+
+    bool haveLimit = false;
+    int32 start = 0;
+    while (start < entry.Length()) {
+        while (start < entry.Length() && isspace(entry.ByteAt(start))) {
+            start++;
+        }
+        int32 end = start;
+        while (end < entry.Length() && !isspace(entry.ByteAt(end))) {
+            end++;
+        }
+        if (end == start) {
+            break;
+        }
+        BString token;
+        entry.CopyInto(token, start, end - start);
+        start = end;
+
+        if (token.FindFirst(':') >= 0) {
+            if (rule.start >= 0
+                || !ParseTimeRange(token, rule.start, rule.end)) {
+                return false;
+            }
+        } else if (token.IStartsWith("up=")) {
+            if (!ParseRate(token.String() + 3, rule.limits[kBandwidthUpload])) {
+                return false;
+            }
+            haveLimit = true;
+        } else if (token.IStartsWith("down=")) {
+            if (!ParseRate(token.String() + 5,
+                    rule.limits[kBandwidthDownload])) {
+                return false;
+            }
+            haveLimit = true;
+        } else if (isalpha(token.ByteAt(0))
+            && token.ICompare("unlimited") != 0) {
+            // Days come first
+            if (rule.start >= 0 || haveLimit || !ParseDays(token, rule.days)) {
+                return false;
+            }
+        } else {
+            off_t rate;
+            if (!ParseRate(token.String(), rate)) {
+                return false;
+            }
+            rule.limits[kBandwidthUpload] = rate;
+            rule.limits[kBandwidthDownload] = rate;
+            haveLimit = true;
+        }
+    }
+    return rule.start >= 0 && haveLimit;
+}
+
+/**
+ * @brief Constructor
+ */
+BandwidthShaper::BandwidthShaper()
+    : fLock("BandwidthShaper Lock"),
+      fNextScheduleCheck(0)
+{
+    for (int32 i = 0; i < kBandwidthDirectionCount; i++) {
+        Bucket& bucket = fBuckets[i];
+        bucket.defaultLimit = 0;
+        bucket.limit = 0;
+        bucket.next = 0;
+        bucket.generation = 0;
+        bucket.bytes = 0;
+        bucket.throttled = 0;
+    }
+}
+
+/**
+ * @brief Destructor
+ */
+BandwidthShaper::~BandwidthShaper()
+{
+}
+
+/**
+ * @brief Set the limit used outside the schedule
+ */
+void
+BandwidthShaper::SetLimit(BandwidthDirection direction, off_t bytesPerSecond)
+{
+    if (direction < 0 || direction >= kBandwidthDirectionCount) {
+        return;
+    }
+
+    BAutolock lock(fLock);
+    fBuckets[direction].defaultLimit = bytesPerSecond > 0 ? bytesPerSecond : 0;
+    _UpdateLimits(system_time(), true);
+}
+
+/**
+ * @brief Set the time-of-day schedule
+ */
+status_t
+BandwidthShaper::SetSchedule(const char* schedule)
+{
+    std::vector<BandwidthRule> rules;
+    status_t status = ParseSchedule(schedule, rules);
+    if (status != B_OK) {
+        return status;
+    }
+
+    BAutolock lock(fLock);
+    fSchedule.swap(rules);
+    _UpdateLimits(system_time(), true);
+    return B_OK;
+}
+
+/**
+ * @brief Get the limit in effect now
+ */
+off_t
+BandwidthShaper::CurrentLimit(BandwidthDirection direction)
+{
+    if (direction < 0 || direction >= kBandwidthDirectionCount) {
+        return 0;
+    }
+
+    BAutolock lock(fLock);
+    _UpdateLimits(system_time(), false);
+    return fBuckets[direction].limit;
+}
+
+/**
+ * @brief Get the limit for a time of the week
+ */
+off_t
+BandwidthShaper::LimitAt(BandwidthDirection direction, int32 weekday,
+    int32 minute) const
+{
+    if (direction < 0 || direction >= kBandwidthDirectionCount) {
+        return 0;
+    }
+
+    BAutolock lock(fLock);
+
+    int32 yesterday = (weekday + 6) % 7;
+    for (size_t i = 0; i < fSchedule.size(); i++) {
+        const BandwidthRule& rule = fSchedule[i];
+        bool matches;
+        if (rule.start < rule.end) {
+            matches = (rule.days & (1 << weekday)) != 0
+                && minute >= rule.start && minute < rule.end;
+        } else if (rule.start == rule.end) {
+            matches = (rule.days & (1 << weekday)) != 0;
+        } else {
+            // Past midnight the range belongs to the day it started on
+            matches = ((rule.days & (1 << weekday)) != 0 && minute >= rule.start)
+                || ((rule.days & (1 << yesterday)) != 0 && minute < rule.end);
+        }
+
+        if (matches && rule.limits[direction] >= 0) {
+            return rule.limits[direction];
+        }
+        if (matches) {
+            break;
+        }
+    }
+    return fBuckets[direction].defaultLimit;
+}
+
+/**
+ * @brief Wait until a chunk may be transferred
+ */
+void
+BandwidthShaper::Throttle(BandwidthDirection direction, size_t bytes)
+{
+    if (direction < 0 || direction >= kBandwidthDirectionCount || bytes == 0) {
+        return;
+    }
+
+    BAutolock lock(fLock);
+    Bucket& bucket = fBuckets[direction];
+
+    while (true) {
+        bigtime_t start = system_time();
+        _UpdateLimits(start, false);
+        bigtime_t wait = _Reserve(bucket, bytes, start);
+        if (wait == 0) {
+            return;
+        }
+
+        int32 generation = bucket.generation;
+        bool retimed = false;
+        lock.Unlock();
+
+        bigtime_t until = start + wait;
+        while (!retimed) {
+            bigtime_t remaining = until - system_time();
+            if (remaining <= 0) {
+                break;
+            }
+            snooze(remaining < kSleepSlice ? remaining : kSleepSlice);
+
+            lock.Lock();
+            _UpdateLimits(system_time(), false);
+            retimed = bucket.generation != generation;
+            lock.Unlock();
+        }
+
+        lock.Lock();
+        bucket.throttled += system_time() - start;
+        if (!retimed) {
+            return;
+        }
+
+        // The slot was timed at the old rate; ask again at the new one
+        bucket.bytes -= bytes;
+    }
+}
+
+/**
+ * @brief Reserve a slot for a chunk without waiting
+ */
+bigtime_t
+BandwidthShaper::Reserve(BandwidthDirection direction, size_t bytes,
+    bigtime_t now)
+{
+    if (direction < 0 || direction >= kBandwidthDirectionCount) {
+        return 0;
+    }
+
+    BAutolock lock(fLock);
+    _UpdateLimits(now, false);
+    return _Reserve(fBuckets[direction], bytes, now);
+}
+
+/**
+ * @brief Get statistics of a direction
+ */
+BandwidthStats
+BandwidthShaper::Stats(BandwidthDirection direction) const
+{
+    BandwidthStats stats = { 0, 0, 0 };
+    if (direction < 0 || direction >= kBandwidthDirectionCount) {
+        return stats;
+    }
+
+    BAutolock lock(fLock);
+    const Bucket& bucket = fBuckets[direction];
+    stats.limit = bucket.limit;
+    stats.bytes = bucket.bytes;
+    stats.throttled = bucket.throttled;
+    return stats;
+}
+
+/**
+ * @brief Parse a schedule
+ */
+status_t
+BandwidthShaper::ParseSchedule(const char* schedule,
+    std::vector<BandwidthRule>& rules)
+{
+    rules.clear();
+    if (schedule == NULL) {
+        return B_OK;
+    }
+
+    BString text(schedule);
+    int32 start = 0;
+    while (start <= text.Length()) {
+        int32 end = text.FindFirst(';', start);
+        if (end < 0) {
+            end = text.Length();
+        }
+        BString entry;
+        text.CopyInto(entry, start, end - start);
+        entry.Trim();
+        start = end + 1;
+
+        if (entry.IsEmpty()) {
+            continue;
+        }
+
+        BandwidthRule rule;
+        if (!ParseRule(entry, rule)) {
+            rules.clear();
+            return B_BAD_VALUE;
+        }
+        rules.push_back(rule);
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Re-evaluate the schedule if due, fLock held
+ */
+void
+BandwidthShaper::_UpdateLimits(bigtime_t now, bool force)
+{
+    if (!force && now < fNextScheduleCheck) {
+        return;
+    }
+    fNextScheduleCheck = now + kScheduleCheckInterval;
+
+    int32 weekday = 0;
+    int32 minute = 0;
+    if (!fSchedule.empty()) {
+        time_t clock = time(NULL);
+        struct tm local;
+        localtime_r(&clock, &local);
+        weekday = local.tm_wday;
+        minute = local.tm_hour * 60 + local.tm_min;
+    }
+
+    for (int32 i = 0; i < kBandwidthDirectionCount; i++) {
+        Bucket& bucket = fBuckets[i];
+        off_t limit = fSchedule.empty() ? bucket.defaultLimit
+            : LimitAt((BandwidthDirection)i, weekday, minute);
+        if (limit != bucket.limit) {
+            // Debt or credit of the old rate does not carry over
+            bucket.limit = limit;
+            bucket.next = now;
+            bucket.generation++;
+        }
+    }
+}
+
+/**
+ * @brief Reserve a slot, fLock held
+ */
+bigtime_t
+BandwidthShaper::_Reserve(Bucket& bucket, size_t bytes, bigtime_t now)
+{
+    bucket.bytes += bytes;
+    if (bucket.limit <= 0) {
+        return 0;
+    }
+
+    if (bucket.next < now - kBurstTime) {
+        bucket.next = now - kBurstTime;
+    }
+    bigtime_t wait = bucket.next - now;
+    bucket.next += (bigtime_t)((double)bytes * 1000000.0 / bucket.limit);
+    return wait > 0 ? wait : 0;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file BandwidthShaper.h
+ * @brief Shared upload and download rate limits for file transfers
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Every transfer asks the shaper for permission before it moves a chunk.
+ * Uploads and downloads draw from separate token buckets, so a limited
+ * upload never slows a download, and the limits can follow a weekly
+ * schedule such as "unlimited at night, 2 MB/s during office hours".
+ */
+
+#ifndef BANDWIDTH_SHAPER_H
+#define BANDWIDTH_SHAPER_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <vector>
+
+namespace OneDrive {
+
+/**
+ * @brief Transfer directions with their own limit
+ */
+enum BandwidthDirection {
+    kBandwidthUpload = 0,
+    kBandwidthDownload,
+    kBandwidthDirectionCount
+};
+
+/**
+ * @brief One entry of a bandwidth schedule
+ */
+struct BandwidthRule {
+    uint8 days;                 ///< Bit per weekday, bit 0 = Sunday
+    int32 start;                ///< Minutes after midnight, inclusive
+    int32 end;                  ///< Minutes after midnight, exclusive
+    off_t limits[kBandwidthDirectionCount]; ///< Bytes/sec, 0 = unlimited,
+                                            ///< -1 = default limit
+};
+
+/**
+ * @brief Statistics of one direction
+ */
+struct BandwidthStats {
+    off_t limit;                ///< Limit in effect (bytes/sec, 0 = none)
+    off_t bytes;                ///< Bytes granted
+    bigtime_t throttled;        ///< Time transfers spent waiting
+};
+
+/**
+ * @brief Token-bucket rate limiter shared by all transfers
+ *
+ * Each direction is a token bucket kept as the time its next byte may
+ * leave: a chunk reserves bytes / rate of that time line and waits until
+ * its slot begins. An idle bucket saves up to kBurstTime of credit, so
+ * short transfers are not delayed.
+ *
+ * Slots are handed out in request order and a transfer asks for its next
+ * chunk only after sending the previous one, so concurrent transfers take
+ * turns chunk by chunk and share the rate evenly.
+ *
+ * Outside the schedule the default limits apply. The schedule is checked
+ * against the local time at most once per second; when a limit changes,
+ * waiting transfers are re-timed at the new rate at once.
+ *
+ * @see OneDriveAPI
+ * @since 1.0.0
+ */
+class BandwidthShaper {
+public:
+    /**
+     * @brief Constructor, without limits
+     */
+    BandwidthShaper();
+
+    /**
+     * @brief Destructor
+     */
+    ~BandwidthShaper();
+
+    /**
+     * @brief Set the limit used outside the schedule
+     *
+     * @param direction Direction
+     * @param bytesPerSecond Limit, 0 for none
+     */
+    void SetLimit(BandwidthDirection direction, off_t bytesPerSecond);
+
+    /**
+     * @brief Set the time-of-day schedule
+     *
+     * Entries are separated by ';', each "[days] HH:MM-HH:MM limit".
+     * Days are names or ranges such as "Mon-Fri" or "Sat,Sun", every day
+     * when left out. A limit is "unlimited" or a rate like "512K" or
+     * "2M" (bytes/sec), for both directions or as "up=2M down=8M". A
+     * range may wrap past midnight. The first matching entry wins.
+     *
+     * Example: "Mon-Fri 09:00-18:00 2M; 22:00-07:00 unlimited"
+     *
+     * @param schedule Schedule, empty for none
+     * @return B_OK, or B_BAD_VALUE keeping the previous schedule
+     */
+    status_t SetSchedule(const char* schedule);
+
+    /**
+     * @brief Get the limit in effect now
+     *
+     * @param direction Direction
+     * @return Bytes/sec, 0 for none
+     */
+    off_t CurrentLimit(BandwidthDirection direction);
+
+    /**
+     * @brief Get the limit for a time of the week
+     *
+     * @param direction Direction
+     * @param weekday Day, 0 = Sunday
+     * @param minute Minutes after midnight
+     * @return Bytes/sec, 0 for none
+     */
+    off_t LimitAt(BandwidthDirection direction, int32 weekday,
+        int32 minute) const;
+
+    /**
+     * @brief Wait until a chunk may be transferred
+     *
+     * Called by transfer loops before every chunk; returns at once
+     * without a limit.
+     *
+     * @param direction Direction
+     * @param bytes Chunk size
+     */
+    void Throttle(BandwidthDirection direction, size_t bytes);
+
+    /**
+     * @brief Reserve a slot for a chunk without waiting
+     *
+     * @param direction Direction
+     * @param bytes Chunk size
+     * @param now Current system time
+     * @return Time to wait before sending, 0 if none
+     */
+    bigtime_t Reserve(BandwidthDirection direction, size_t bytes,
+        bigtime_t now);
+
+    /**
+     * @brief Get statistics of a direction
+     *
+     * @param direction Direction
+     * @return Snapshot of the counters
+     */
+    BandwidthStats Stats(BandwidthDirection direction) const;
+
+    /**
+     * @brief Parse a schedule
+     *
+     * @param schedule Schedule text, see SetSchedule()
+     * @param rules Receives the rules
+     * @return B_OK, or B_BAD_VALUE on a syntax error
+     */
+    static status_t ParseSchedule(const char* schedule,
+        std::vector<BandwidthRule>& rules);
+
+    static const bigtime_t kBurstTime;  ///< Credit an idle bucket keeps
+
+private:
+    /**
+     * @brief Token bucket of one direction
+     */
+    struct Bucket {
+        off_t defaultLimit;     ///< Limit outside the schedule
+        off_t limit;            ///< Limit in effect
+        bigtime_t next;         ///< When the next byte may leave
+        int32 generation;       ///< Bumped when the limit changes
+        off_t bytes;
+        bigtime_t throttled;
+    };
+
+    /**
+     * @brief Re-evaluate the schedule if due, fLock held
+     */
+    void _UpdateLimits(bigtime_t now, bool force);
+
+    /**
+     * @brief Reserve a slot, fLock held
+     */
+    bigtime_t _Reserve(Bucket& bucket, size_t bytes, bigtime_t now);
+
+private:
+    mutable BLocker fLock;
+    Bucket fBuckets[kBandwidthDirectionCount];
+    std::vector<BandwidthRule> fSchedule;
+    bigtime_t fNextScheduleCheck;
+};
+
+} // namespace OneDrive
+
+#endif // BANDWIDTH_SHAPER_H
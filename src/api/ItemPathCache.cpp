@@ -0,0 +1,388 @@
+/**
+ * @file ItemPathCache.cpp
+ * @brief Implementation of the path to item ID resolution cache
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "ItemPathCache.h"
+
+#include <Autolock.h>
+#include <OS.h>
+
+#include <vector>
+
+using namespace OneDrive;
+
+const int32 ItemPathCache::kDefaultCapacity = 4096;
+const bigtime_t ItemPathCache::kDefaultNegativeTTL = 60000000LL; // 60 seconds
+
+/**
+ * @brief Strip a trailing separator so equivalent paths share a key
+ */
+static BString
+NormalizePath(const BString& path)
+{
+    BString normalized(path);
+    while (normalized.Length() > 1
+        && normalized.ByteAt(normalized.Length() - 1) == '/') {
+        normalized.Truncate(normalized.Length() - 1);
+    }
+    return normalized;
+}
+
+/**
+ * @brief Constructor
+ */
+ItemPathCache::ItemPathCache(int32 capacity)
+    : fLock("ItemPathCache Lock"),
+      fCapacity(capacity > 0 ? capacity : kDefaultCapacity),
+      fNegativeTTL(kDefaultNegativeTTL),
+      fHits(0),
+      fNegativeHits(0),
+      fMisses(0),
+      fEvictions(0),
+      fInvalidations(0)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+ItemPathCache::~ItemPathCache()
+{
+}
+
+/**
+ * @brief Look up a path
+ */
+PathCacheResult
+ItemPathCache::Lookup(const BString& path, BString& itemId, BString* eTag)
+{
+    BAutolock lock(fLock);
+
+    PathIndex::iterator it = fIndex.find(NormalizePath(path));
+    if (it == fIndex.end()) {
+        fMisses++;
+        return kPathCacheMiss;
+    }
+
+    EntryList::iterator entry = it->second;
+    if (entry->notFound
+        && system_time() - entry->insertTime > fNegativeTTL) {
+        _Remove(it);
+        fMisses++;
+        return kPathCacheMiss;
+    }
+
+    // Move to front: most recently used
+    fEntries.splice(fEntries.begin(), fEntries, entry);
+
+    if (entry->notFound) {
+        fNegativeHits++;
+        return kPathCacheNotFound;
+    }
+
+    itemId = entry->itemId;
+    if (eTag != NULL) {
+        *eTag = entry->eTag;
+    }
+
+    fHits++;
+    return kPathCacheHit;
+}
+
+/**
+ * @brief Find the cached path of an item
+ */
+bool
+ItemPathCache::PathForItem(const BString& itemId, BString& path) const
+{
+    BAutolock lock(fLock);
+
+    std::map<BString, BString>::const_iterator it = fIdIndex.find(itemId);
+    if (it == fIdIndex.end()) {
+        return false;
+    }
+
+    path = it->second;
+    return true;
+}
+
+/**
+ * @brief Store a successful resolution
+ */
+void
+ItemPathCache::Insert(const BString& path, const BString& itemId,
+    const BString& eTag)
+{
+    if (itemId.IsEmpty()) {
+        return;
+    }
+
+    PathCacheEntry entry;
+    entry.path = NormalizePath(path);
+    entry.itemId = itemId;
+    entry.eTag = eTag;
+    entry.notFound = false;
+    entry.insertTime = system_time();
+
+    BAutolock lock(fLock);
+    _Store(entry);
+}
+
+/**
+ * @brief Store a "not found" resolution
+ */
+void
+ItemPathCache::InsertNotFound(const BString& path)
+{
+    PathCacheEntry entry;
+    entry.path = NormalizePath(path);
+    entry.notFound = true;
+    entry.insertTime = system_time();
+
+    BAutolock lock(fLock);
+    _Store(entry);
+}
+
+/**
+ * @brief Drop a single path
+ */
+void
+ItemPathCache::InvalidatePath(const BString& path)
+{
+    BAutolock lock(fLock);
+
+    PathIndex::iterator it = fIndex.find(NormalizePath(path));
+    if (it != fIndex.end()) {
+        _Remove(it);
+        fInvalidations++;
+    }
+}
+
+/**
+ * @brief Drop a path and everything below it
+ */
+void
+ItemPathCache::InvalidateSubtree(const BString& path)
+{
+    BAutolock lock(fLock);
+    fInvalidations += _RemoveSubtree(NormalizePath(path));
+}
+
+/**
+ * @brief Drop the entry for an item (and its subtree) by ID
+ */
+void
+ItemPathCache::InvalidateItem(const BString& itemId)
+{
+    BAutolock lock(fLock);
+
+    std::map<BString, BString>::iterator it = fIdIndex.find(itemId);
+    if (it == fIdIndex.end()) {
+        return;
+    }
+
+    BString path = it->second;
+    fInvalidations += _RemoveSubtree(path);
+}
+
+/**
+ * @brief Re-key a moved path and its subtree
+ */
+void
+ItemPathCache::Move(const BString& oldPath, const BString& newPath)
+{
+    BString from = NormalizePath(oldPath);
+    BString to = NormalizePath(newPath);
+    if (from == to) {
+        return;
+    }
+
+    BAutolock lock(fLock);
+
+    // Collect the moved subtree's positive entries
+    std::vector<PathCacheEntry> moved;
+    BString prefix(from);
+    if (prefix != "/") {
+        prefix << "/";
+    }
+
+    PathIndex::iterator it = fIndex.find(from);
+    if (it != fIndex.end() && !it->second->notFound) {
+        moved.push_back(*it->second);
+    }
+    for (it = fIndex.lower_bound(prefix);
+        it != fIndex.end() && it->first.StartsWith(prefix); ++it) {
+        if (!it->second->notFound) {
+            moved.push_back(*it->second);
+        }
+    }
+
+    int32 removed = _RemoveSubtree(from) + _RemoveSubtree(to);
+    fInvalidations += removed - (int32)moved.size();
+
+    for (size_t i = 0; i < moved.size(); i++) {
+        PathCacheEntry entry = moved[i];
+        BString suffix;
+        entry.path.CopyInto(suffix, from.Length(),
+            entry.path.Length() - from.Length());
+        entry.path = to;
+        entry.path << suffix;
+        _Store(entry);
+    }
+
+    // The old location no longer exists remotely
+    PathCacheEntry gone;
+    gone.path = from;
+    gone.notFound = true;
+    gone.insertTime = system_time();
+    _Store(gone);
+}
+
+/**
+ * @brief Drop all entries
+ */
+void
+ItemPathCache::Clear()
+{
+    BAutolock lock(fLock);
+
+    fInvalidations += fIndex.size();
+    fEntries.clear();
+    fIndex.clear();
+    fIdIndex.clear();
+}
+
+/**
+ * @brief Get cache statistics
+ */
+PathCacheStats
+ItemPathCache::GetStats() const
+{
+    BAutolock lock(fLock);
+
+    PathCacheStats stats;
+    stats.hits = fHits;
+    stats.negativeHits = fNegativeHits;
+    stats.misses = fMisses;
+    stats.evictions = fEvictions;
+    stats.invalidations = fInvalidations;
+    stats.entries = fIndex.size();
+    stats.capacity = fCapacity;
+    return stats;
+}
+
+/**
+ * @brief Add cache statistics to a message
+ */
+status_t
+ItemPathCache::GetStats(BMessage& message) const
+{
+    PathCacheStats stats = GetStats();
+
+    int64 lookups = stats.hits + stats.negativeHits + stats.misses;
+    float hitRate = lookups > 0
+        ? (float)(stats.hits + stats.negativeHits) / lookups : 0.0f;
+
+    message.AddInt64("path_cache_hits", stats.hits);
+    message.AddInt64("path_cache_negative_hits", stats.negativeHits);
+    message.AddInt64("path_cache_misses", stats.misses);
+    message.AddInt64("path_cache_evictions", stats.evictions);
+    message.AddInt64("path_cache_invalidations", stats.invalidations);
+    message.AddInt32("path_cache_entries", stats.entries);
+    message.AddInt32("path_cache_capacity", stats.capacity);
+    message.AddFloat("path_cache_hit_rate", hitRate);
+
+    return B_OK;
+}
+
+/**
+ * @brief Store an entry, replacing any previous one for the path
+ */
+void
+ItemPathCache::_Store(const PathCacheEntry& entry)
+{
+    PathIndex::iterator it = fIndex.find(entry.path);
+    if (it != fIndex.end()) {
+        _Remove(it);
+    }
+
+    fEntries.push_front(entry);
+    fIndex[entry.path] = fEntries.begin();
+    if (!entry.notFound) {
+        fIdIndex[entry.itemId] = entry.path;
+    }
+
+    _EvictIfNeeded();
+}
+
+/**
+ * @brief Remove an entry by path index position
+ */
+ItemPathCache::PathIndex::iterator
+ItemPathCache::_Remove(PathIndex::iterator it)
+{
+    EntryList::iterator entry = it->second;
+    if (!entry->notFound) {
+        std::map<BString, BString>::iterator idIt
+            = fIdIndex.find(entry->itemId);
+        if (idIt != fIdIndex.end() && idIt->second == entry->path) {
+            fIdIndex.erase(idIt);
+        }
+    }
+
+    fEntries.erase(entry);
+
+    PathIndex::iterator next = it;
+    ++next;
+    fIndex.erase(it);
+    return next;
+}
+
+/**
+ * @brief Evict least recently used entries above capacity
+ */
+void
+ItemPathCache::_EvictIfNeeded()
+{
+    while ((int32)fIndex.size() > fCapacity && !fEntries.empty()) {
+        PathIndex::iterator it = fIndex.find(fEntries.back().path);
+        if (it == fIndex.end()) {
+            fEntries.pop_back();
+            continue;
+        }
+        _Remove(it);
+        fEvictions++;
+    }
+}
+
+/**
+ * @brief Remove a path and every entry below it
+ */
+int32
+ItemPathCache::_RemoveSubtree(const BString& path)
+{
+    int32 removed = 0;
+
+    PathIndex::iterator it = fIndex.find(path);
+    if (it != fIndex.end()) {
+        _Remove(it);
+        removed++;
+    }
+
+    BString prefix(path);
+    if (prefix != "/") {
+        prefix << "/";
+    }
+
+    it = fIndex.lower_bound(prefix);
+    while (it != fIndex.end() && it->first.StartsWith(prefix)) {
+        it = _Remove(it);
+        removed++;
+    }
+
+    return removed;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file ItemPathCache.h
+ * @brief LRU cache of OneDrive path to item ID resolutions
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Resolving a path to an item ID costs a Graph round trip. The cache keeps
+ * recent resolutions, including negative "not found" results, and is
+ * invalidated precisely when remote changes or moves are observed.
+ */
+
+#ifndef ITEM_PATH_CACHE_H
+#define ITEM_PATH_CACHE_H
+
+#include <Locker.h>
+#include <Message.h>
+#include <String.h>
+
+#include <list>
+#include <map>
+
+namespace OneDrive {
+
+/**
+ * @brief Result of a cache lookup
+ */
+enum PathCacheResult {
+    kPathCacheMiss = 0,         ///< Path not cached, ask the server
+    kPathCacheHit,              ///< Path cached with its item ID
+    kPathCacheNotFound          ///< Path cached as not existing remotely
+};
+
+/**
+ * @brief Cached path resolution
+ */
+struct PathCacheEntry {
+    BString path;               ///< OneDrive path (cache key)
+    BString itemId;             ///< Item ID (empty for negative entries)
+    BString eTag;               ///< Item ETag when known
+    bool notFound;              ///< Negative entry flag
+    bigtime_t insertTime;       ///< When the entry was stored
+};
+
+/**
+ * @brief Path cache statistics
+ */
+struct PathCacheStats {
+    int64 hits;                 ///< Positive hits
+    int64 negativeHits;         ///< Hits on "not found" entries
+    int64 misses;               ///< Lookups that went to the server
+    int64 evictions;            ///< Entries dropped by LRU capacity
+    int64 invalidations;        ///< Entries dropped by change notifications
+    int32 entries;              ///< Current number of entries
+    int32 capacity;             ///< Maximum number of entries
+};
+
+/**
+ * @brief Thread-safe LRU cache mapping OneDrive paths to item IDs
+ *
+ * Entries are kept in a path-ordered map so a folder's whole subtree can
+ * be found with a single range scan, and in a recency list for LRU
+ * eviction. A reverse index from item ID to path lets delta results,
+ * which identify items by ID, invalidate the right entries.
+ *
+ * Negative entries expire after a short time as a safety net; positive
+ * entries stay valid until evicted or invalidated.
+ *
+ * @see OneDriveAPI
+ * @since 1.0.0
+ */
+class ItemPathCache {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param capacity Maximum number of cached paths
+     */
+    ItemPathCache(int32 capacity = kDefaultCapacity);
+
+    /**
+     * @brief Destructor
+     */
+    ~ItemPathCache();
+
+    /**
+     * @brief Look up a path
+     *
+     * @param path OneDrive path
+     * @param itemId Receives the item ID on a positive hit
+     * @param eTag Optional, receives the cached ETag on a positive hit
+     * @return Lookup result
+     */
+    PathCacheResult Lookup(const BString& path, BString& itemId,
+        BString* eTag = NULL);
+
+    /**
+     * @brief Find the cached path of an item
+     *
+     * @param itemId Item ID
+     * @param path Receives the cached path
+     * @return true if the item is cached
+     */
+    bool PathForItem(const BString& itemId, BString& path) const;
+
+    /**
+     * @brief Store a successful resolution
+     *
+     * @param path OneDrive path
+     * @param itemId Item ID
+     * @param eTag Item ETag (may be empty)
+     */
+    void Insert(const BString& path, const BString& itemId,
+        const BString& eTag = "");
+
+    /**
+     * @brief Store a "not found" resolution
+     *
+     * @param path OneDrive path that does not exist remotely
+     */
+    void InsertNotFound(const BString& path);
+
+    /**
+     * @brief Drop a single path
+     *
+     * @param path OneDrive path
+     */
+    void InvalidatePath(const BString& path);
+
+    /**
+     * @brief Drop a path and everything below it
+     *
+     * @param path OneDrive folder path
+     */
+    void InvalidateSubtree(const BString& path);
+
+    /**
+     * @brief Drop the entry for an item (and its subtree) by ID
+     *
+     * Used for delta results, which identify items by ID: a renamed or
+     * moved folder changes the paths of all its descendants.
+     *
+     * @param itemId Item ID
+     */
+    void InvalidateItem(const BString& itemId);
+
+    /**
+     * @brief Re-key a moved path and its subtree
+     *
+     * Item IDs are stable across moves, so entries are moved rather than
+     * dropped. Entries previously cached at the destination are removed.
+     *
+     * @param oldPath Previous OneDrive path
+     * @param newPath New OneDrive path
+     */
+    void Move(const BString& oldPath, const BString& newPath);
+
+    /**
+     * @brief Drop all entries
+     */
+    void Clear();
+
+    /**
+     * @brief Get cache statistics
+     *
+     * @return Snapshot of the counters
+     */
+    PathCacheStats GetStats() const;
+
+    /**
+     * @brief Add cache statistics to a message
+     *
+     * @param stats Message to fill
+     * @return B_OK on success
+     */
+    status_t GetStats(BMessage& stats) const;
+
+    /**
+     * @brief Set how long negative entries stay valid
+     *
+     * @param ttl Lifetime in microseconds
+     */
+    void SetNegativeTTL(bigtime_t ttl) { fNegativeTTL = ttl; }
+
+    static const int32 kDefaultCapacity;        ///< Default entry limit
+    static const bigtime_t kDefaultNegativeTTL; ///< Default negative lifetime
+
+private:
+    typedef std::list<PathCacheEntry> EntryList;
+    typedef std::map<BString, EntryList::iterator> PathIndex;
+
+    /**
+     * @brief Store an entry, replacing any previous one for the path
+     *
+     * @param entry Entry to store
+     */
+    void _Store(const PathCacheEntry& entry);
+
+    /**
+     * @brief Remove an entry by path index position
+     *
+     * @param it Index position to remove
+     * @return Index position following the removed one
+     */
+    PathIndex::iterator _Remove(PathIndex::iterator it);
+
+    /**
+     * @brief Evict least recently used entries above capacity
+     */
+    void _EvictIfNeeded();
+
+    /**
+     * @brief Remove a path and every entry below it
+     *
+     * @param path Folder path
+     * @return Number of entries removed
+     */
+    int32 _RemoveSubtree(const BString& path);
+
+private:
+    mutable BLocker fLock;                  ///< Thread safety lock
+    EntryList fEntries;                     ///< Entries, most recent first
+    PathIndex fIndex;                       ///< Path -> entry
+    std::map<BString, BString> fIdIndex;    ///< Item ID -> path
+    int32 fCapacity;                        ///< Maximum entries
+    bigtime_t fNegativeTTL;                 ///< Negative entry lifetime
+
+    int64 fHits;                            ///< Positive hits
+    int64 fNegativeHits;                    ///< Negative hits
+    int64 fMisses;                          ///< Misses
+    int64 fEvictions;                       ///< LRU evictions
+    int64 fInvalidations;                   ///< Invalidated entries
+};
+
+} // namespace OneDrive
+
+#endif // ITEM_PATH_CACHE_H
@@ -0,0 +1,994 @@
+/**
+ * @file NotificationChannel.cpp
+ * @brief Implementation of the drive change notification channel
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "NotificationChannel.h"
+#include "OneDriveAPI.h"
+
+#include <Autolock.h>
+#include <Message.h>
+#include <NetworkAddress.h>
+#include <SecureSocket.h>
+#include <Socket.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+using namespace OneDrive;
+
+static const bigtime_t kConnectTimeout = 30000000LL;        // 30 seconds
+static const bigtime_t kDefaultPingInterval = 25000000LL;   // 25 seconds
+static const bigtime_t kDefaultPingTimeout = 60000000LL;    // 60 seconds
+static const bigtime_t kInitialBackoff = 1000000LL;         // 1 second
+static const bigtime_t kMaxBackoff = 60000000LL;            // 60 seconds
+static const bigtime_t kStopCheckInterval = 500000LL;       // 0.5 seconds
+static const char* kEnginePath = "/socket.io/";
+static const char kRecordSeparator = '\x1e';
+
+/**
+ * @brief Find a quoted string value in a flat JSON object
+ */
+static bool
+ExtractJsonString(const BString& json, const char* key, BString& value)
+{
+    BString searchKey = "\"";
+    searchKey << key << "\"";
+
+    int32 keyStart = json.FindFirst(searchKey.String());
+    if (keyStart < 0) {
+        return false;
+    }
+
+    int32 colon = json.FindFirst(":", keyStart + searchKey.Length());
+    int32 valueStart = colon < 0 ? -1 : json.FindFirst("\"", colon);
+    if (valueStart < 0) {
+        return false;
+    }
+
+    int32 valueEnd = json.FindFirst("\"", valueStart + 1);
+    if (valueEnd < 0) {
+        return false;
+    }
+
+    json.CopyInto(value, valueStart + 1, valueEnd - valueStart - 1);
+    return true;
+}
+
+/**
+ * @brief Find a numeric value in a flat JSON object
+ */
+static bool
+ExtractJsonNumber(const BString& json, const char* key, int64& value)
+{
+    BString searchKey = "\"";
+    searchKey << key << "\"";
+
+    int32 keyStart = json.FindFirst(searchKey.String());
+    if (keyStart < 0) {
+        return false;
+    }
+
+    int32 pos = json.FindFirst(":", keyStart + searchKey.Length());
+    if (pos < 0) {
+        return false;
+    }
+    pos++;
+    while (pos < json.Length() && json.ByteAt(pos) == ' ') {
+        pos++;
+    }
+
+    char* end = NULL;
+    value = strtoll(json.String() + pos, &end, 10);
+    return end != json.String() + pos;
+}
+
+
+/**
+ * @brief Minimal HTTP/1.1 client connection
+ *
+ * Sends one request at a time on a keep-alive socket and reads responses
+ * delimited by Content-Length, chunked encoding or connection close.
+ */
+class NotificationChannel::Connection {
+public:
+    Connection()
+        : fKeepAlive(false)
+    {
+    }
+
+    ~Connection()
+    {
+        Close();
+    }
+
+    status_t Connect(const BString& host, uint16 port, bool secure,
+        bigtime_t timeout)
+    {
+        Close();
+
+        BNetworkAddress address(host.String(), port);
+        status_t status = address.InitCheck();
+        if (status != B_OK) {
+            return status;
+        }
+
+        if (secure) {
+            fSocket.reset(new BSecureSocket());
+        } else {
+            fSocket.reset(new BSocket());
+        }
+
+        status = fSocket->Connect(address, kConnectTimeout);
+        if (status != B_OK) {
+            fSocket.reset();
+            return status;
+        }
+
+        fSocket->SetTimeout(timeout);
+        fHost = host;
+        fKeepAlive = true;
+        return B_OK;
+    }
+
+    void Close()
+    {
+        if (fSocket.get() != NULL) {
+            fSocket->Disconnect();
+            fSocket.reset();
+        }
+        fBuffer.Truncate(0);
+        fKeepAlive = false;
+    }
+
+    bool IsOpen() const
+    {
+        return fSocket.get() != NULL && fKeepAlive;
+    }
+
+    status_t SendRequest(const char* method, const BString& target,
+        const BString* body)
+    {
+        if (fSocket.get() == NULL) {
+            return B_NOT_INITIALIZED;
+        }
+
+        BString request;
+        request << method << " " << target << " HTTP/1.1\r\n";
+        request << "Host: " << fHost << "\r\n";
+        request << "Accept: */*\r\n";
+        request << "Connection: keep-alive\r\n";
+        if (body != NULL) {
+            request << "Content-Type: text/plain;charset=UTF-8\r\n";
+            request << "Content-Length: " << body->Length() << "\r\n";
+        }
+        request << "\r\n";
+        if (body != NULL) {
+            request << *body;
+        }
+
+        const char* data = request.String();
+        int32 remaining = request.Length();
+        while (remaining > 0) {
+            ssize_t written = fSocket->Write(data, remaining);
+            if (written <= 0) {
+                return written < 0 ? (status_t)written : B_IO_ERROR;
+            }
+            data += written;
+            remaining -= written;
+        }
+        return B_OK;
+    }
+
+    status_t WaitForReadable(bigtime_t timeout)
+    {
+        if (fSocket.get() == NULL) {
+            return B_NOT_INITIALIZED;
+        }
+        if (fBuffer.Length() > 0) {
+            return B_OK;
+        }
+        return fSocket->WaitForReadable(timeout);
+    }
+
+    status_t ReadResponse(int32& statusCode, BString& body)
+    {
+        body.Truncate(0);
+
+        BString line;
+        status_t status = _ReadLine(line);
+        if (status != B_OK) {
+            return status;
+        }
+
+        // "HTTP/1.1 200 OK"
+        int32 space = line.FindFirst(" ");
+        if (!line.StartsWith("HTTP/") || space < 0) {
+            return B_BAD_DATA;
+        }
+        statusCode = atoi(line.String() + space + 1);
+        fKeepAlive = !line.StartsWith("HTTP/1.0");
+
+        int64 contentLength = -1;
+        bool chunked = false;
+        while (true) {
+            status = _ReadLine(line);
+            if (status != B_OK) {
+                return status;
+            }
+            if (line.IsEmpty()) {
+                break;
+            }
+
+            int32 colon = line.FindFirst(":");
+            if (colon < 0) {
+                continue;
+            }
+            BString name;
+            line.CopyInto(name, 0, colon);
+            name.ToLower();
+            int32 valueStart = colon + 1;
+            while (valueStart < line.Length()
+                && line.ByteAt(valueStart) == ' ') {
+                valueStart++;
+            }
+            BString value;
+            line.CopyInto(value, valueStart, line.Length() - valueStart);
+            value.ToLower();
+
+            if (name == "content-length") {
+                contentLength = strtoll(value.String(), NULL, 10);
+            } else if (name == "transfer-encoding") {
+                chunked = value.FindFirst("chunked") >= 0;
+            } else if (name == "connection") {
+                if (value.FindFirst("close") >= 0) {
+                    fKeepAlive = false;
+                } else if (value.FindFirst("keep-alive") >= 0) {
+                    fKeepAlive = true;
+                }
+            }
+        }
+
+        if (chunked) {
+            while (true) {
+                status = _ReadLine(line);
+                if (status != B_OK) {
+                    return status;
+                }
+                int32 size = strtol(line.String(), NULL, 16);
+                if (size <= 0) {
+                    // Skip trailers up to the final empty line
+                    do {
+                        status = _ReadLine(line);
+                    } while (status == B_OK && !line.IsEmpty());
+                    return status;
+                }
+                BString chunk;
+                status = _ReadBytes(size, chunk);
+                if (status == B_OK) {
+                    status = _ReadLine(line);
+                }
+                if (status != B_OK) {
+                    return status;
+                }
+                body << chunk;
+            }
+        }
+
+        if (contentLength >= 0) {
+            return _ReadBytes(contentLength, body);
+        }
+
+        // Body delimited by connection close
+        fKeepAlive = false;
+        while (_Fill() == B_OK) {
+        }
+        body = fBuffer;
+        fBuffer.Truncate(0);
+        return B_OK;
+    }
+
+private:
+    status_t _ReadLine(BString& line)
+    {
+        int32 end;
+        while ((end = fBuffer.FindFirst("\r\n")) < 0) {
+            status_t status = _Fill();
+            if (status != B_OK) {
+                return status;
+            }
+        }
+        fBuffer.CopyInto(line, 0, end);
+        fBuffer.Remove(0, end + 2);
+        return B_OK;
+    }
+
+    status_t _ReadBytes(int64 count, BString& data)
+    {
+        while (fBuffer.Length() < count) {
+            status_t status = _Fill();
+            if (status != B_OK) {
+                return status;
+            }
+        }
+        fBuffer.CopyInto(data, 0, count);
+        fBuffer.Remove(0, count);
+        return B_OK;
+    }
+
+    status_t _Fill()
+    {
+        char buffer[4096];
+        ssize_t bytesRead = fSocket->Read(buffer, sizeof(buffer));
+        if (bytesRead < 0) {
+            return bytesRead;
+        }
+        if (bytesRead == 0) {
+            fKeepAlive = false;
+            return B_IO_ERROR;
+        }
+        fBuffer.Append(buffer, bytesRead);
+        return B_OK;
+    }
+
+private:
+    std::unique_ptr<BSocket> fSocket;
+    BString fBuffer;
+    BString fHost;
+    bool fKeepAlive;
+};
+
+
+/**
+ * @brief Constructor
+ */
+NotificationChannel::NotificationChannel(::OneDriveAPI* api,
+    const BMessenger& target)
+    : fAPI(api),
+      fTarget(target),
+      fLock("NotificationChannel Lock"),
+      fThread(-1),
+      fQuitSemaphore(-1),
+      fQuitting(false),
+      fPoll(new Connection()),
+      fSend(new Connection()),
+      fPort(0),
+      fSecure(false),
+      fPingInterval(kDefaultPingInterval),
+      fPingTimeout(kDefaultPingTimeout),
+      fLastPing(0),
+      fAwaitingPong(false),
+      fRequestSequence(0)
+{
+    fStats.connected = false;
+    fStats.notifications = 0;
+    fStats.connects = 0;
+    fStats.failures = 0;
+}
+
+/**
+ * @brief Destructor
+ */
+NotificationChannel::~NotificationChannel()
+{
+    Stop();
+}
+
+/**
+ * @brief Start the channel thread
+ */
+status_t
+NotificationChannel::Start(const BString& notificationUrl)
+{
+    if (fThread >= 0) {
+        return B_OK;
+    }
+    if (notificationUrl.IsEmpty() && fAPI == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    fFixedUrl = notificationUrl;
+    fQuitting = false;
+
+    fQuitSemaphore = create_sem(0, "notification channel quit");
+    if (fQuitSemaphore < 0) {
+        return fQuitSemaphore;
+    }
+
+    fThread = spawn_thread(_ChannelThread, "notification channel",
+        B_NORMAL_PRIORITY, this);
+    if (fThread < 0) {
+        status_t status = fThread;
+        delete_sem(fQuitSemaphore);
+        fQuitSemaphore = -1;
+        fThread = -1;
+        return status;
+    }
+
+    resume_thread(fThread);
+    return B_OK;
+}
+
+/**
+ * @brief Stop the channel thread and close the connection
+ */
+void
+NotificationChannel::Stop()
+{
+    if (fThread < 0) {
+        return;
+    }
+
+    // The thread notices fQuitting within kStopCheckInterval while
+    // polling, and immediately while backing off.
+    fQuitting = true;
+    release_sem(fQuitSemaphore);
+
+    status_t exitValue;
+    wait_for_thread(fThread, &exitValue);
+    fThread = -1;
+
+    delete_sem(fQuitSemaphore);
+    fQuitSemaphore = -1;
+}
+
+/**
+ * @brief Check whether the channel is connected
+ */
+bool
+NotificationChannel::IsConnected() const
+{
+    BAutolock lock(fLock);
+    return fStats.connected;
+}
+
+/**
+ * @brief Get channel statistics
+ */
+NotificationChannelStats
+NotificationChannel::GetStats() const
+{
+    BAutolock lock(fLock);
+    return fStats;
+}
+
+/**
+ * @brief Split a URL into its components
+ */
+bool
+NotificationChannel::ParseUrl(const BString& url, bool& secure,
+    BString& host, uint16& port, BString& path, BString& query)
+{
+    int32 hostStart;
+    if (url.StartsWith("https://")) {
+        secure = true;
+        hostStart = 8;
+        port = 443;
+    } else if (url.StartsWith("http://")) {
+        secure = false;
+        hostStart = 7;
+        port = 80;
+    } else {
+        return false;
+    }
+
+    BString rest;
+    url.CopyInto(rest, hostStart, url.Length() - hostStart);
+    int32 fragment = rest.FindFirst("#");
+    if (fragment >= 0) {
+        rest.Truncate(fragment);
+    }
+
+    int32 pathStart = rest.FindFirst("/");
+    int32 queryStart = rest.FindFirst("?");
+    if (queryStart >= 0 && (pathStart < 0 || queryStart < pathStart)) {
+        pathStart = -1;
+    }
+    int32 hostEnd = pathStart >= 0 ? pathStart
+        : (queryStart >= 0 ? queryStart : rest.Length());
+
+    BString authority;
+    rest.CopyInto(authority, 0, hostEnd);
+    int32 colon = authority.FindLast(":");
+    if (colon >= 0) {
+        char* end = NULL;
+        long value = strtol(authority.String() + colon + 1, &end, 10);
+        if (*end != '\0' || value <= 0 || value > 65535) {
+            return false;
+        }
+        port = (uint16)value;
+        authority.Truncate(colon);
+    }
+    if (authority.IsEmpty()) {
+        return false;
+    }
+    host = authority;
+
+    path.Truncate(0);
+    query.Truncate(0);
+    if (queryStart >= 0) {
+        rest.CopyInto(query, queryStart + 1, rest.Length() - queryStart - 1);
+        rest.Truncate(queryStart);
+    }
+    if (pathStart >= 0) {
+        rest.CopyInto(path, pathStart, rest.Length() - pathStart);
+    }
+    if (path.IsEmpty()) {
+        path = "/";
+    }
+
+    return true;
+}
+
+/**
+ * @brief Split an Engine.IO polling payload into packets
+ */
+int32
+NotificationChannel::DecodePayload(const BString& payload,
+    BStringList& packets)
+{
+    int32 count = 0;
+
+    // EIO 3 payloads start with "<digits>:"
+    int32 digits = 0;
+    while (digits < payload.Length() && payload.ByteAt(digits) >= '0'
+        && payload.ByteAt(digits) <= '9') {
+        digits++;
+    }
+    bool lengthPrefixed = digits > 0 && digits < payload.Length()
+        && payload.ByteAt(digits) == ':';
+
+    if (!lengthPrefixed) {
+        // EIO 4: packets separated by a record separator
+        int32 start = 0;
+        while (start <= payload.Length()) {
+            int32 end = payload.FindFirst(kRecordSeparator, start);
+            if (end < 0) {
+                end = payload.Length();
+            }
+            if (end > start) {
+                BString packet;
+                payload.CopyInto(packet, start, end - start);
+                packets.Add(packet);
+                count++;
+            }
+            start = end + 1;
+        }
+        return count;
+    }
+
+    // EIO 3: "<length>:<packet>" repeated, the length counting UTF-16
+    // code units rather than bytes
+    int32 pos = 0;
+    while (pos < payload.Length()) {
+        int32 colon = payload.FindFirst(":", pos);
+        if (colon <= pos) {
+            break;
+        }
+
+        int32 length = atoi(payload.String() + pos);
+        int32 start = colon + 1;
+        int32 end = start;
+        while (length > 0 && end < payload.Length()) {
+            uint8 byte = (uint8)payload.ByteAt(end);
+            int32 bytes = 1;
+            if (byte >= 0xf0) {
+                bytes = 4;
+                length--;   // encoded as a surrogate pair
+            } else if (byte >= 0xe0) {
+                bytes = 3;
+            } else if (byte >= 0xc0) {
+                bytes = 2;
+            }
+            end += bytes;
+            length--;
+        }
+        if (length != 0 || end > payload.Length()) {
+            break;
+        }
+
+        BString packet;
+        payload.CopyInto(packet, start, end - start);
+        packets.Add(packet);
+        count++;
+        pos = end;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Parse an Engine.IO open packet
+ */
+bool
+NotificationChannel::ParseHandshake(const BString& packet, BString& sid,
+    bigtime_t& pingInterval, bigtime_t& pingTimeout)
+{
+    if (packet.Length() < 2 || packet.ByteAt(0) != '0') {
+        return false;
+    }
+
+    if (!ExtractJsonString(packet, "sid", sid) || sid.IsEmpty()) {
+        return false;
+    }
+
+    int64 value;
+    pingInterval = ExtractJsonNumber(packet, "pingInterval", value)
+        && value > 0 ? value * 1000 : kDefaultPingInterval;
+    pingTimeout = ExtractJsonNumber(packet, "pingTimeout", value)
+        && value > 0 ? value * 1000 : kDefaultPingTimeout;
+    return true;
+}
+
+/**
+ * @brief Check whether a packet is a socket.io event
+ */
+bool
+NotificationChannel::IsEventPacket(const BString& packet)
+{
+    // Engine.IO message (4) carrying a socket.io event (2)
+    return packet.StartsWith("42");
+}
+
+/**
+ * @brief Channel thread entry point
+ */
+int32
+NotificationChannel::_ChannelThread(void* data)
+{
+    static_cast<NotificationChannel*>(data)->_Run();
+    return 0;
+}
+
+/**
+ * @brief Connect, receive and reconnect until stopped
+ */
+void
+NotificationChannel::_Run()
+{
+    bigtime_t backoff = kInitialBackoff;
+
+    while (!fQuitting) {
+        status_t status = _Open();
+        if (status == B_OK) {
+            backoff = kInitialBackoff;
+            _SetConnected(true);
+            status = _Receive();
+            _SetConnected(false);
+        } else {
+            BAutolock lock(fLock);
+            fStats.failures++;
+        }
+        _Close();
+
+        if (fQuitting) {
+            break;
+        }
+
+        syslog(LOG_INFO, "OneDrive API: Notification channel down (%s), "
+            "reconnecting in %d s", strerror(status), (int)(backoff / 1000000));
+
+        if (!_Wait(backoff)) {
+            break;
+        }
+        backoff = backoff * 2 > kMaxBackoff ? kMaxBackoff : backoff * 2;
+    }
+}
+
+/**
+ * @brief Resolve the URL, connect and perform the handshake
+ */
+status_t
+NotificationChannel::_Open()
+{
+    BString url(fFixedUrl);
+    if (url.IsEmpty()) {
+        // Subscriptions expire, so every session gets a fresh URL
+        OneDriveError error = fAPI->GetNotificationUrl(url);
+        if (error != ONEDRIVE_OK) {
+            return B_ERROR;
+        }
+    }
+
+    BString path;
+    if (!ParseUrl(url, fSecure, fHost, fPort, path, fQuery)) {
+        syslog(LOG_ERR, "OneDrive API: Invalid notification URL");
+        return B_BAD_VALUE;
+    }
+    fNamespace = path;
+    fSid.Truncate(0);
+
+    // Until the handshake tells the real values, allow a generous wait
+    status_t status = fPoll->Connect(fHost, fPort, fSecure,
+        kDefaultPingInterval + kDefaultPingTimeout);
+    if (status != B_OK) {
+        return status;
+    }
+
+    BString payload;
+    int32 statusCode = 0;
+    status = fPoll->SendRequest("GET", _Target(), NULL);
+    if (status == B_OK) {
+        status = fPoll->ReadResponse(statusCode, payload);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+    if (statusCode != 200) {
+        return B_ERROR;
+    }
+
+    BStringList packets;
+    DecodePayload(payload, packets);
+    if (packets.CountStrings() == 0
+        || !ParseHandshake(packets.StringAt(0), fSid, fPingInterval,
+            fPingTimeout)) {
+        return B_BAD_DATA;
+    }
+
+    if (fNamespace != "/") {
+        BString connect("40");
+        connect << fNamespace << ",";
+        status = _SendPacket(connect);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    fLastPing = system_time();
+    fAwaitingPong = false;
+
+    BAutolock lock(fLock);
+    fStats.connects++;
+    return B_OK;
+}
+
+/**
+ * @brief Long-poll for packets until the session ends
+ */
+status_t
+NotificationChannel::_Receive()
+{
+    while (!fQuitting) {
+        if (!fPoll->IsOpen()) {
+            status_t status = fPoll->Connect(fHost, fPort, fSecure,
+                fPingInterval + fPingTimeout);
+            if (status != B_OK) {
+                return status;
+            }
+        }
+
+        status_t status = fPoll->SendRequest("GET", _Target(), NULL);
+        if (status == B_OK) {
+            status = _AwaitResponse();
+        }
+
+        BString payload;
+        int32 statusCode = 0;
+        if (status == B_OK) {
+            status = fPoll->ReadResponse(statusCode, payload);
+        }
+        if (status != B_OK) {
+            return status;
+        }
+        if (statusCode != 200) {
+            // Unknown or expired session
+            return B_ERROR;
+        }
+
+        status = _HandlePayload(payload);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    return B_CANCELED;
+}
+
+/**
+ * @brief Wait for the pending poll to answer, pinging meanwhile
+ */
+status_t
+NotificationChannel::_AwaitResponse()
+{
+    while (!fQuitting) {
+        bigtime_t now = system_time();
+        if (fAwaitingPong && now - fLastPing > fPingTimeout) {
+            return B_TIMED_OUT;
+        }
+        if (!fAwaitingPong && now - fLastPing >= fPingInterval) {
+            // EIO 3 clients keep the session alive; the pong arrives on
+            // the pending poll
+            status_t status = _SendPacket("2");
+            if (status != B_OK) {
+                return status;
+            }
+            fLastPing = now;
+            fAwaitingPong = true;
+        }
+
+        bigtime_t wait = fAwaitingPong ? fLastPing + fPingTimeout - now
+            : fLastPing + fPingInterval - now;
+        if (wait > kStopCheckInterval) {
+            wait = kStopCheckInterval;
+        }
+        if (wait < 0) {
+            wait = 0;
+        }
+
+        status_t status = fPoll->WaitForReadable(wait);
+        if (status == B_OK) {
+            return B_OK;
+        }
+        if (status != B_TIMED_OUT && status != B_WOULD_BLOCK) {
+            return status;
+        }
+    }
+
+    return B_CANCELED;
+}
+
+/**
+ * @brief Handle the packets of one poll response
+ */
+status_t
+NotificationChannel::_HandlePayload(const BString& payload)
+{
+    BStringList packets;
+    DecodePayload(payload, packets);
+
+    bool changed = false;
+    for (int32 i = 0; i < packets.CountStrings(); i++) {
+        BString packet = packets.StringAt(i);
+        if (packet.IsEmpty()) {
+            continue;
+        }
+
+        switch (packet.ByteAt(0)) {
+            case '1':
+                // Server closed the session
+                return B_ERROR;
+
+            case '2':
+                // EIO 4 servers ping and expect a pong
+                _SendPacket(BString("3") << (packet.String() + 1));
+                break;
+
+            case '3':
+                fAwaitingPong = false;
+                break;
+
+            case '4':
+                if (IsEventPacket(packet)) {
+                    changed = true;
+                } else if (packet.StartsWith("41")
+                    || packet.StartsWith("44")) {
+                    // Namespace disconnect or error
+                    return B_ERROR;
+                }
+                break;
+
+            default:
+                // Noop, upgrade and unexpected packets
+                break;
+        }
+    }
+
+    if (changed) {
+        // One message per response: the owner fetches all changes at once
+        {
+            BAutolock lock(fLock);
+            fStats.notifications++;
+        }
+        fTarget.SendMessage(kMsgRemoteChangeNotified);
+    }
+
+    return B_OK;
+}
+
+/**
+ * @brief Send one packet on the side connection
+ */
+status_t
+NotificationChannel::_SendPacket(const BString& packet)
+{
+    // EIO 3 string payload framing, single packet
+    BString body;
+    body << packet.CountChars() << ":" << packet;
+
+    status_t status = B_ERROR;
+    for (int32 attempt = 0; attempt < 2; attempt++) {
+        bool reused = fSend->IsOpen();
+        if (!reused) {
+            status = fSend->Connect(fHost, fPort, fSecure, fPingTimeout);
+            if (status != B_OK) {
+                return status;
+            }
+        }
+
+        int32 statusCode = 0;
+        BString response;
+        status = fSend->SendRequest("POST", _Target(), &body);
+        if (status == B_OK) {
+            status = fSend->ReadResponse(statusCode, response);
+        }
+        if (status == B_OK) {
+            return statusCode == 200 ? B_OK : B_ERROR;
+        }
+
+        // A reused keep-alive connection may have been closed by the
+        // server in the meantime; retry once on a fresh one
+        fSend->Close();
+        if (!reused) {
+            break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Build the Engine.IO request target for the session
+ */
+BString
+NotificationChannel::_Target()
+{
+    BString target(kEnginePath);
+    target << "?EIO=3&transport=polling&b64=1&t=" << ++fRequestSequence;
+    if (!fSid.IsEmpty()) {
+        target << "&sid=" << fSid;
+    }
+    if (!fQuery.IsEmpty()) {
+        target << "&" << fQuery;
+    }
+    return target;
+}
+
+/**
+ * @brief Close both connections and forget the session
+ */
+void
+NotificationChannel::_Close()
+{
+    fPoll->Close();
+    fSend->Close();
+    fSid.Truncate(0);
+    fAwaitingPong = false;
+}
+
+/**
+ * @brief Record and report a connection state change
+ */
+void
+NotificationChannel::_SetConnected(bool connected)
+{
+    {
+        BAutolock lock(fLock);
+        if (fStats.connected == connected) {
+            return;
+        }
+        fStats.connected = connected;
+    }
+
+    syslog(LOG_INFO, "OneDrive API: Notification channel %s",
+        connected ? "connected" : "disconnected");
+
+    BMessage message(kMsgNotificationChannelState);
+    message.AddBool("connected", connected);
+    fTarget.SendMessage(&message);
+}
+
+/**
+ * @brief Wait, returning early when stopped
+ */
+bool
+NotificationChannel::_Wait(bigtime_t timeout)
+{
+    status_t status = acquire_sem_etc(fQuitSemaphore, 1, B_RELATIVE_TIMEOUT,
+        timeout);
+    return status == B_TIMED_OUT && !fQuitting;
+}
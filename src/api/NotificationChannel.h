@@ -0,0 +1,266 @@
+/**
+ * @file NotificationChannel.h
+ * @brief Long-lived push channel for remote drive change notifications
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Microsoft Graph offers a socket.io notification endpoint per drive
+ * (`root/subscriptions/socketIo`). The NotificationChannel keeps a single
+ * connection to it open and tells its target when the drive changed, so a
+ * delta fetch is only made when there is something to fetch.
+ */
+
+#ifndef NOTIFICATION_CHANNEL_H
+#define NOTIFICATION_CHANNEL_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <StringList.h>
+
+#include <memory>
+
+class BSocket;
+class OneDriveAPI;
+
+namespace OneDrive {
+
+/**
+ * @brief Messages sent by the notification channel to its target
+ */
+enum {
+    kMsgRemoteChangeNotified = 'rcnt',      ///< The drive changed remotely
+    kMsgNotificationChannelState = 'ncst'   ///< Channel up/down ("connected")
+};
+
+/**
+ * @brief Notification channel statistics
+ */
+struct NotificationChannelStats {
+    bool connected;             ///< Channel currently connected
+    int32 notifications;        ///< Change notifications received
+    int32 connects;             ///< Successful connections
+    int32 failures;             ///< Failed connection attempts
+};
+
+/**
+ * @brief socket.io client for Graph drive change notifications
+ *
+ * The channel runs the Engine.IO protocol over HTTP long-polling on its
+ * own thread: one keep-alive connection (TLS for https URLs) holds the
+ * pending poll, a second one carries pings. It needs no WebSocket support
+ * and works against any socket.io server, including a local stand-in
+ * (a plain http:// URL) for testing.
+ *
+ * Every socket.io event received is reported as kMsgRemoteChangeNotified;
+ * the payload is not needed since the delta API tells what changed.
+ * Connection changes are reported as kMsgNotificationChannelState so the
+ * owner can fall back to polling while the channel is down. The channel
+ * reconnects by itself with exponential backoff, fetching a fresh
+ * notification URL through the API for each attempt.
+ *
+ * @see OneDriveAPI::GetNotificationUrl
+ * @since 1.0.0
+ */
+class NotificationChannel {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param api API used to fetch notification URLs (may be NULL when a
+     *        fixed URL is passed to Start())
+     * @param target Messenger receiving channel messages
+     */
+    NotificationChannel(::OneDriveAPI* api, const BMessenger& target);
+
+    /**
+     * @brief Destructor
+     */
+    ~NotificationChannel();
+
+    /**
+     * @brief Start the channel thread
+     *
+     * @param notificationUrl Fixed socket.io URL; if empty, a URL is
+     *        requested from the API before each connection
+     * @return B_OK on success
+     */
+    status_t Start(const BString& notificationUrl = "");
+
+    /**
+     * @brief Stop the channel thread and close the connection
+     */
+    void Stop();
+
+    /**
+     * @brief Check whether the channel is connected
+     *
+     * @return true if notifications are being received
+     */
+    bool IsConnected() const;
+
+    /**
+     * @brief Get channel statistics
+     *
+     * @return Snapshot of the counters
+     */
+    NotificationChannelStats GetStats() const;
+
+    /**
+     * @brief Split a URL into its components
+     *
+     * @param url URL to parse
+     * @param secure Receives whether the scheme is https
+     * @param host Receives the host name
+     * @param port Receives the port (scheme default if absent)
+     * @param path Receives the path, without query
+     * @param query Receives the query, without '?'
+     * @return true if the URL is usable
+     */
+    static bool ParseUrl(const BString& url, bool& secure, BString& host,
+        uint16& port, BString& path, BString& query);
+
+    /**
+     * @brief Split an Engine.IO polling payload into packets
+     *
+     * Understands both length-prefixed (EIO 3) and record-separated
+     * (EIO 4) framing.
+     *
+     * @param payload Response body
+     * @param packets Receives the packets
+     * @return Number of packets decoded
+     */
+    static int32 DecodePayload(const BString& payload, BStringList& packets);
+
+    /**
+     * @brief Parse an Engine.IO open packet
+     *
+     * @param packet Packet starting with '0'
+     * @param sid Receives the session ID
+     * @param pingInterval Receives the ping interval
+     * @param pingTimeout Receives the ping timeout
+     * @return true if the packet is a valid open packet
+     */
+    static bool ParseHandshake(const BString& packet, BString& sid,
+        bigtime_t& pingInterval, bigtime_t& pingTimeout);
+
+    /**
+     * @brief Check whether a packet is a socket.io event
+     *
+     * @param packet Engine.IO packet
+     * @return true for event packets
+     */
+    static bool IsEventPacket(const BString& packet);
+
+private:
+    class Connection;
+
+    /**
+     * @brief Channel thread entry point
+     *
+     * @param data Pointer to the channel
+     * @return Thread exit code
+     */
+    static int32 _ChannelThread(void* data);
+
+    /**
+     * @brief Connect, receive and reconnect until stopped
+     */
+    void _Run();
+
+    /**
+     * @brief Resolve the URL, connect and perform the handshake
+     *
+     * @return B_OK on success
+     */
+    status_t _Open();
+
+    /**
+     * @brief Long-poll for packets until the session ends
+     *
+     * @return Error that ended the session
+     */
+    status_t _Receive();
+
+    /**
+     * @brief Wait for the pending poll to answer, pinging meanwhile
+     *
+     * @return B_OK when the response can be read
+     */
+    status_t _AwaitResponse();
+
+    /**
+     * @brief Handle the packets of one poll response
+     *
+     * @param payload Response body
+     * @return B_OK to keep polling, an error to reconnect
+     */
+    status_t _HandlePayload(const BString& payload);
+
+    /**
+     * @brief Send one packet on the side connection
+     *
+     * @param packet Engine.IO packet
+     * @return B_OK on success
+     */
+    status_t _SendPacket(const BString& packet);
+
+    /**
+     * @brief Build the Engine.IO request target for the session
+     *
+     * @return Path and query
+     */
+    BString _Target();
+
+    /**
+     * @brief Close both connections and forget the session
+     */
+    void _Close();
+
+    /**
+     * @brief Record and report a connection state change
+     *
+     * @param connected New state
+     */
+    void _SetConnected(bool connected);
+
+    /**
+     * @brief Wait, returning early when stopped
+     *
+     * @param timeout Time to wait
+     * @return false if the channel is stopping
+     */
+    bool _Wait(bigtime_t timeout);
+
+private:
+    ::OneDriveAPI* fAPI;                ///< URL source (may be NULL)
+    BMessenger fTarget;                 ///< Message target
+    BString fFixedUrl;                  ///< URL given to Start()
+    mutable BLocker fLock;              ///< Protects counters
+
+    thread_id fThread;                  ///< Channel thread
+    sem_id fQuitSemaphore;              ///< Released by Stop()
+    volatile bool fQuitting;            ///< Stop requested
+
+    std::unique_ptr<Connection> fPoll;  ///< Long-poll connection
+    std::unique_ptr<Connection> fSend;  ///< Connection for sent packets
+    BString fHost;                      ///< Server host
+    uint16 fPort;                       ///< Server port
+    bool fSecure;                       ///< Use TLS
+    BString fQuery;                     ///< Query from the notification URL
+    BString fNamespace;                 ///< socket.io namespace
+    BString fSid;                       ///< Engine.IO session ID
+    bigtime_t fPingInterval;            ///< Client ping interval
+    bigtime_t fPingTimeout;             ///< Server reply allowance
+    bigtime_t fLastPing;                ///< When we last pinged
+    bool fAwaitingPong;                 ///< Ping sent, no reply yet
+    int32 fRequestSequence;             ///< Cache-busting counter
+
+    NotificationChannelStats fStats;    ///< Counters
+};
+
+} // namespace OneDrive
+
+#endif // NOTIFICATION_CHANNEL_H
@@ -8,7 +8,9 @@
 
 #include "OneDriveAPI.h"
 #include "AuthManager.h"
+#include "BandwidthShaper.h"
 #include "ConnectionPool.h"
+#include "ItemPathCache.h"
 #include "../shared/OneDriveConstants.h"
 #include "../shared/ErrorLogger.h"
 
@@ -36,6 +38,10 @@ const char* GraphEndpoints::kUserProfile = "/me";
 const int32 OneDriveAPI::kDefaultTimeout = 30; // 30 seconds
 const int32 OneDriveAPI::kMaxRetries = 3;
 const int32 OneDriveAPI::kLargeFileThreshold = 4 * 1024 * 1024; // 4MB
+const int32 OneDriveAPI::kTransferChunkSize = 64 * 1024; // 64KB
+const int32 OneDriveAPI::kUploadSessionChunkSize = 10 * 320 * 1024; // Multiple of 320KB
+const bigtime_t OneDriveAPI::kCopyPollInterval = 250000; // 250ms
+const bigtime_t OneDriveAPI::kCopyTimeout = 600000000LL; // 10 minutes
 const int32 OneDriveAPI::kRateLimitWindow = 60; // 60 seconds
 const int32 OneDriveAPI::kMaxRequestsPerWindow = 1000; // Microsoft Graph limit
 
@@ -44,7 +50,8 @@ OneDriveItem::OneDriveItem()
     : type(ITEM_TYPE_UNKNOWN),
       size(0),
       createdTime(0),
-      modifiedTime(0)
+      modifiedTime(0),
+      deleted(false)
 {
 }
 
@@ -54,7 +61,9 @@ OneDriveAPI::OneDriveAPI(AuthenticationManager& authManager)
       fTimeout(kDefaultTimeout),
       fRetryCount(kMaxRetries),
       fDevelopmentMode(true),
+      fBandwidthShaper(nullptr),
       fUrlContext(nullptr),
+      fShuttingDown(false),
       fLastRequestTime(0),
       fRequestCount(0)
 {
@@ -64,6 +73,8 @@ OneDriveAPI::OneDriveAPI(AuthenticationManager& authManager)
     // TODO: Initialize BUrlContext when HTTP API is integrated
     fUrlContext = nullptr;
     
+    fPathCache = std::make_unique<OneDrive::ItemPathCache>();
+    
     // Initialize connection pool
     fConnectionPool = std::make_unique<OneDrive::ConnectionPool>(*this, fUrlContext);
     if (fConnectionPool->Initialize() != B_OK) {
@@ -73,6 +84,20 @@ OneDriveAPI::OneDriveAPI(AuthenticationManager& authManager)
 
 OneDriveAPI::~OneDriveAPI()
 {
+    // Copy monitors use this object until they are gone; they poll
+    // without holding the lock and give up at their next poll
+    fShuttingDown = true;
+    std::set<thread_id> monitors;
+    {
+        BAutolock lock(fLock);
+        monitors.swap(fCopyMonitors);
+    }
+    for (std::set<thread_id>::iterator it = monitors.begin();
+            it != monitors.end(); ++it) {
+        status_t exitValue;
+        wait_for_thread(*it, &exitValue);
+    }
+    
     BAutolock lock(fLock);
     syslog(LOG_INFO, "OneDrive API: Shutting down API client");
     
@@ -93,12 +118,6 @@ OneDriveAPI::ListFolder(const BString& folderPath, BList& items)
     syslog(LOG_INFO, "OneDrive API: Listing folder: %s", 
            folderPath.IsEmpty() ? "root" : folderPath.String());
     
-    // Clear existing items
-    for (int32 i = 0; i < items.CountItems(); i++) {
-        delete static_cast<OneDriveItem*>(items.ItemAt(i));
-    }
-    items.MakeEmpty();
-    
     // Construct endpoint
     BString endpoint;
     if (folderPath.IsEmpty()) {
@@ -109,24 +128,50 @@ OneDriveAPI::ListFolder(const BString& folderPath, BList& items)
         endpoint << ":/" << folderPath << ":/children";
     }
     
-    // Make request
-    BMallocIO responseData;
-    OneDriveError error = _MakeRequest(HTTP_GET, endpoint, NULL, responseData);
+    OneDriveError error = _ListChildren(endpoint, items);
     if (error != ONEDRIVE_OK) {
         return error;
     }
     
-    // Parse response
-    BString jsonResponse;
-    responseData.Seek(0, SEEK_SET);
-    char buffer[1024];
-    ssize_t bytesRead;
-    while ((bytesRead = responseData.Read(buffer, sizeof(buffer))) > 0) {
-        jsonResponse.Append(buffer, bytesRead);
+    // A listing resolves every child's path for free
+    BString parentPath(folderPath);
+    if (!parentPath.StartsWith("/")) {
+        parentPath.Prepend("/");
+    }
+    if (!parentPath.EndsWith("/")) {
+        parentPath << "/";
+    }
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* item = static_cast<OneDriveItem*>(items.ItemAt(i));
+        BString childPath(parentPath);
+        childPath << item->name;
+        fPathCache->Insert(childPath, item->id, item->eTag);
     }
     
-    // Parse JSON and extract items
-    return _ParseFolderContents(jsonResponse, items);
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::ListFolderById(const BString& folderId, BList& items)
+{
+    // No lock across the request: crawlers list folders concurrently
+    syslog(LOG_INFO, "OneDrive API: Listing folder by ID: %s", folderId.String());
+    
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << folderId << "/children";
+    
+    return _ListChildren(endpoint, items);
+}
+
+int32
+OneDriveAPI::GetMaxConcurrentRequests() const
+{
+    if (!fConnectionPool) {
+        return 1;
+    }
+    
+    int32 maxConnections = fConnectionPool->GetMaxConnections();
+    return maxConnections > 0 ? maxConnections : 1;
 }
 
 OneDriveError
@@ -135,8 +180,7 @@ OneDriveAPI::DownloadFile(const BString& itemId,
                          void (*progressCallback)(float progress, void* userData),
                          void* userData)
 {
-    BAutolock lock(fLock);
-    
+    // No lock across the request: the pipeline downloads concurrently
     syslog(LOG_INFO, "OneDrive API: Downloading file %s to %s", 
            itemId.String(), localPath.String());
     
@@ -150,18 +194,26 @@ OneDriveAPI::DownloadFile(const BString& itemId,
         return error;
     }
     
-    // TODO: Implement actual file download with progress callback
-    // For now, create placeholder file for development
+    if (fDevelopmentMode) {
+        // Placeholder content for development
+        BString placeholder = "OneDrive file downloaded: ";
+        placeholder << itemId;
+        responseData.SetSize(0);
+        responseData.Seek(0, SEEK_SET);
+        responseData.Write(placeholder.String(), placeholder.Length());
+    }
+    
     BFile file(localPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
     if (file.InitCheck() != B_OK) {
+        BAutolock errorLock(fLock);
         fLastError = "Failed to create local file";
         return ONEDRIVE_NETWORK_ERROR;
     }
     
-    // Write placeholder content
-    BString placeholder = "OneDrive file downloaded: ";
-    placeholder << itemId;
-    file.Write(placeholder.String(), placeholder.Length());
+    error = _WriteDownloadData(responseData, file, progressCallback, userData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
     
     if (progressCallback) {
         progressCallback(1.0f, userData);
@@ -175,16 +227,16 @@ OneDriveError
 OneDriveAPI::UploadFile(const BString& localPath,
                        const BString& remotePath,
                        void (*progressCallback)(float progress, void* userData),
-                       void* userData)
+                       void* userData,
+                       OneDriveItem* uploaded)
 {
-    BAutolock lock(fLock);
-    
     syslog(LOG_INFO, "OneDrive API: Uploading file %s to %s", 
            localPath.String(), remotePath.String());
     
     // Check if file exists
     BFile file(localPath.String(), B_READ_ONLY);
     if (file.InitCheck() != B_OK) {
+        BAutolock lock(fLock);
         fLastError = "Local file not found";
         return ONEDRIVE_FILE_NOT_FOUND;
     }
@@ -195,15 +247,23 @@ OneDriveAPI::UploadFile(const BString& localPath,
     
     // Use upload session for large files
     if (fileSize > kLargeFileThreshold) {
-        return _UploadLargeFile(localPath, remotePath, progressCallback, userData);
+        BString address = GraphEndpoints::kDriveRoot;
+        address << ":/" << remotePath << ":";
+        OneDriveError error = _UploadLargeFile(file, fileSize, address,
+                                               progressCallback, userData, uploaded);
+        if (error == ONEDRIVE_OK && uploaded != NULL) {
+            BAutolock lock(fLock);
+            fPathCache->Insert(_LocalPathToOneDrivePath(remotePath), uploaded->id,
+                               uploaded->eTag);
+        }
+        return error;
     }
     
-    // Small file upload - read file content
+    // Small file upload - read file content, unlocked while throttled
     BMallocIO fileData;
-    char buffer[8192];
-    ssize_t bytesRead;
-    while ((bytesRead = file.Read(buffer, sizeof(buffer))) > 0) {
-        fileData.Write(buffer, bytesRead);
+    OneDriveError error = _ReadUploadData(file, fileData);
+    if (error != ONEDRIVE_OK) {
+        return error;
     }
     
     // Construct endpoint
@@ -216,7 +276,7 @@ OneDriveAPI::UploadFile(const BString& localPath,
     // TODO: Set proper binary data for upload
     
     BMallocIO responseData;
-    OneDriveError error = _MakeRequest(HTTP_PUT, endpoint, &requestBody, responseData);
+    error = _MakeRequest(HTTP_PUT, endpoint, &requestBody, responseData);
     
     if (progressCallback) {
         progressCallback(error == ONEDRIVE_OK ? 1.0f : 0.0f, userData);
@@ -226,11 +286,25 @@ OneDriveAPI::UploadFile(const BString& localPath,
         syslog(LOG_INFO, "OneDrive API: Upload completed (development mode)");
     }
     
-    return error;
+    if (error != ONEDRIVE_OK || uploaded == NULL) {
+        return error;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    if (_ParseOneDriveItem(jsonResponse, *uploaded) != B_OK) {
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    BAutolock lock(fLock);
+    fPathCache->Insert(_LocalPathToOneDrivePath(remotePath), uploaded->id,
+                       uploaded->eTag);
+    return ONEDRIVE_OK;
 }
 
 OneDriveError
-OneDriveAPI::CreateFolder(const BString& folderPath, const BString& folderName)
+OneDriveAPI::CreateFolder(const BString& folderPath, const BString& folderName,
+                         OneDriveItem* created)
 {
     BAutolock lock(fLock);
     
@@ -255,7 +329,270 @@ OneDriveAPI::CreateFolder(const BString& folderPath, const BString& folderName)
     requestBody << "}";
     
     BMallocIO responseData;
-    return _MakeRequest(HTTP_POST, endpoint, &requestBody, responseData);
+    OneDriveError error = _MakeRequest(HTTP_POST, endpoint, &requestBody, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    // The folder now exists: drop any cached "not found" result
+    BString newPath(folderPath);
+    if (!newPath.EndsWith("/")) {
+        newPath << "/";
+    }
+    newPath << folderName;
+    fPathCache->InvalidatePath(_LocalPathToOneDrivePath(newPath));
+    
+    if (created == NULL) {
+        return ONEDRIVE_OK;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    return _ParseOneDriveItem(jsonResponse, *created) == B_OK ? ONEDRIVE_OK : ONEDRIVE_API_ERROR;
+}
+
+OneDriveError
+OneDriveAPI::CreateFolderInParent(const BString& parentId, const BString& folderName,
+                                 OneDriveItem* created)
+{
+    BAutolock lock(fLock);
+    
+    syslog(LOG_INFO, "OneDrive API: Creating folder %s in parent %s", 
+           folderName.String(), parentId.String());
+    
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << parentId << "/children";
+    
+    BString requestBody = "{";
+    requestBody << "\"name\": \"" << folderName << "\",";
+    requestBody << "\"folder\": {},";
+    requestBody << "\"@microsoft.graph.conflictBehavior\": \"rename\"";
+    requestBody << "}";
+    
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_POST, endpoint, &requestBody, responseData);
+    if (error != ONEDRIVE_OK || created == NULL) {
+        return error;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    return _ParseOneDriveItem(jsonResponse, *created) == B_OK ? ONEDRIVE_OK : ONEDRIVE_API_ERROR;
+}
+
+OneDriveError
+OneDriveAPI::UploadFileToParent(const BString& localPath,
+                               const BString& parentId,
+                               const BString& fileName,
+                               OneDriveItem* uploaded)
+{
+    syslog(LOG_INFO, "OneDrive API: Uploading file %s into parent %s", 
+           localPath.String(), parentId.String());
+    
+    BFile file(localPath.String(), B_READ_ONLY);
+    if (file.InitCheck() != B_OK) {
+        BAutolock lock(fLock);
+        fLastError = "Local file not found";
+        return ONEDRIVE_FILE_NOT_FOUND;
+    }
+    
+    off_t fileSize;
+    file.GetSize(&fileSize);
+    
+    if (fileSize > kLargeFileThreshold) {
+        // The session is created relative to the parent, like small uploads
+        BString address = GraphEndpoints::kDriveItems;
+        address << "/" << parentId << ":/" << fileName << ":";
+        return _UploadLargeFile(file, fileSize, address, NULL, NULL, uploaded);
+    }
+    
+    BMallocIO fileData;
+    OneDriveError error = _ReadUploadData(file, fileData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    // Address the new file relative to its parent: no path resolution needed
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << parentId << ":/" << fileName << ":/content";
+    
+    BString requestBody;
+    // TODO: Set proper binary data for upload
+    
+    BMallocIO responseData;
+    error = _MakeRequest(HTTP_PUT, endpoint, &requestBody, responseData);
+    if (error != ONEDRIVE_OK || uploaded == NULL) {
+        return error;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    return _ParseOneDriveItem(jsonResponse, *uploaded) == B_OK ? ONEDRIVE_OK : ONEDRIVE_API_ERROR;
+}
+
+OneDriveError
+OneDriveAPI::MoveItem(const BString& itemId, const BString& newParentId,
+                     const BString& newParentPath, const BString& newName)
+{
+    BAutolock lock(fLock);
+    
+    syslog(LOG_INFO, "OneDrive API: Moving item %s to %s/%s", 
+           itemId.String(), newParentPath.String(), newName.String());
+    
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << itemId;
+    
+    // By ID like copies; a path reference needs the colon even for root
+    BString parentReference;
+    if (!newParentId.IsEmpty()) {
+        parentReference << "{\"id\": \"" << newParentId << "\"}";
+    } else {
+        parentReference << "{\"path\": \"/drive/root:";
+        if (!newParentPath.IsEmpty() && newParentPath != "/") {
+            if (!newParentPath.StartsWith("/")) {
+                parentReference << "/";
+            }
+            parentReference << newParentPath;
+        }
+        parentReference << "\"}";
+    }
+    
+    BString requestBody = "{";
+    requestBody << "\"parentReference\": " << parentReference << ",";
+    requestBody << "\"name\": \"" << newName << "\"";
+    requestBody << "}";
+    
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_PATCH, endpoint, &requestBody, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    BString newPath(newParentPath);
+    if (!newPath.StartsWith("/")) {
+        newPath.Prepend("/");
+    }
+    if (!newPath.EndsWith("/")) {
+        newPath << "/";
+    }
+    newPath << newName;
+    
+    BString oldPath;
+    if (fPathCache->PathForItem(itemId, oldPath)) {
+        fPathCache->Move(oldPath, newPath);
+    } else {
+        fPathCache->InvalidateSubtree(newPath);
+    }
+    
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::CopyItem(const BString& itemId, const BString& parentId,
+                     const BString& name, OneDriveItem* copied)
+{
+    BString monitorUrl;
+    OneDriveError error = _RequestCopy(itemId, parentId, name, monitorUrl);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    // The copy may take a while; other requests go on meanwhile
+    BString resourceId;
+    error = _WaitForMonitor(monitorUrl, resourceId);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    if (copied != NULL) {
+        copied->id = resourceId;
+        copied->name = name;
+        copied->parentId = parentId;
+    }
+    return ONEDRIVE_OK;
+}
+
+/**
+ * @brief A copy whose monitor is polled in the background
+ */
+struct CopyJob {
+    OneDriveAPI* api;
+    BString monitorUrl;
+    BString parentId;
+    BString name;
+    CopyCompletionCallback completion;
+    void (*progressCallback)(float, void*);
+    void* userData;
+};
+
+OneDriveError
+OneDriveAPI::StartCopy(const BString& itemId, const BString& parentId,
+                      const BString& name, CopyCompletionCallback completion,
+                      void* userData,
+                      void (*progressCallback)(float progress, void* userData))
+{
+    if (completion == NULL) {
+        return ONEDRIVE_INVALID_REQUEST;
+    }
+    
+    CopyJob* job = new CopyJob;
+    job->api = this;
+    job->parentId = parentId;
+    job->name = name;
+    job->completion = completion;
+    job->progressCallback = progressCallback;
+    job->userData = userData;
+    
+    OneDriveError error = _RequestCopy(itemId, parentId, name, job->monitorUrl);
+    if (error != ONEDRIVE_OK) {
+        delete job;
+        return error;
+    }
+    
+    // Known before it runs, so the destructor can wait for it
+    thread_id thread = spawn_thread(_CopyMonitorThread, "OneDrive copy monitor",
+                                    B_LOW_PRIORITY, job);
+    BAutolock lock(fLock);
+    if (thread >= 0) {
+        fCopyMonitors.insert(thread);
+    }
+    if (thread < 0 || resume_thread(thread) != B_OK) {
+        // The server copies anyway; only the outcome goes unobserved
+        if (thread >= 0) {
+            fCopyMonitors.erase(thread);
+            kill_thread(thread);
+        }
+        delete job;
+        fLastError = "Could not start the copy monitor";
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    return ONEDRIVE_OK;
+}
+
+int32
+OneDriveAPI::_CopyMonitorThread(void* data)
+{
+    CopyJob* job = static_cast<CopyJob*>(data);
+    OneDriveAPI* api = job->api;
+    
+    BString resourceId;
+    OneDriveError error = api->_WaitForMonitor(job->monitorUrl, resourceId,
+                                               job->progressCallback,
+                                               job->userData);
+    
+    OneDriveItem copied;
+    if (error == ONEDRIVE_OK) {
+        copied.id = resourceId;
+        copied.name = job->name;
+        copied.parentId = job->parentId;
+    }
+    job->completion(error, copied, job->userData);
+    delete job;
+    
+    BAutolock lock(api->fLock);
+    api->fCopyMonitors.erase(find_thread(NULL));
+    return 0;
 }
 
 OneDriveError
@@ -269,7 +606,16 @@ OneDriveAPI::DeleteItem(const BString& itemId)
     endpoint << "/" << itemId;
     
     BMallocIO responseData;
-    return _MakeRequest(HTTP_DELETE, endpoint, NULL, responseData);
+    OneDriveError error = _MakeRequest(HTTP_DELETE, endpoint, NULL, responseData);
+    if (error == ONEDRIVE_OK) {
+        BString oldPath;
+        if (fPathCache->PathForItem(itemId, oldPath)) {
+            fPathCache->InvalidateSubtree(oldPath);
+            fPathCache->InsertNotFound(oldPath);
+        }
+    }
+    
+    return error;
 }
 
 OneDriveError
@@ -424,6 +770,13 @@ OneDriveAPI::SetConnectionPoolParams(int32 minConnections, int32 probeInterval)
     }
 }
 
+void
+OneDriveAPI::SetBandwidthShaper(OneDrive::BandwidthShaper* shaper)
+{
+    BAutolock lock(fLock);
+    fBandwidthShaper = shaper;
+}
+
 // Private implementation methods
 
 OneDriveError
@@ -431,15 +784,18 @@ OneDriveAPI::_MakeRequest(HttpMethod method,
                          const BString& endpoint,
                          const BString* requestBody,
                          BMallocIO& responseData,
-                         const BMessage* customHeaders)
+                         const BMessage* customHeaders,
+                         BMessage* responseHeaders)
 {
     // Check authentication
     if (!fAuthManager.IsAuthenticated()) {
+        BAutolock lock(fLock);
         fLastError = "Not authenticated";
         return ONEDRIVE_AUTH_ERROR;
     }
     
-    // Rate limiting check
+    // Rate limiting check; the request itself may run unlocked
+    BAutolock lock(fLock);
     time_t currentTime = time(NULL);
     if (currentTime - fLastRequestTime < kRateLimitWindow) {
         fRequestCount++;
@@ -452,9 +808,11 @@ OneDriveAPI::_MakeRequest(HttpMethod method,
         fLastRequestTime = currentTime;
         fRequestCount = 1;
     }
+    lock.Unlock();
     
     // Implement actual HTTP request using Haiku's BHttpSession
-    return _MakeHttpRequest(method, endpoint, requestBody, responseData, customHeaders);
+    return _MakeHttpRequest(method, endpoint, requestBody, responseData, customHeaders,
+                            responseHeaders);
 }
 
 OneDriveError
@@ -462,7 +820,8 @@ OneDriveAPI::_MakeHttpRequest(HttpMethod method,
                              const BString& endpoint, 
                              const BString* requestBody,
                              BMallocIO& responseData,
-                             const BMessage* customHeaders)
+                             const BMessage* customHeaders,
+                             BMessage* responseHeaders)
 {
     // In development mode, use mock responses
     if (fDevelopmentMode) {
@@ -475,9 +834,19 @@ OneDriveAPI::_MakeHttpRequest(HttpMethod method,
         
         if (result == ONEDRIVE_OK) {
             responseData.Write(mockResponse.String(), mockResponse.Length());
+            BAutolock lock(fLock);
             fLastError = "";
         }
         
+        // Copies are accepted with the URL of a monitor to poll
+        if (result == ONEDRIVE_OK && responseHeaders != NULL
+            && method == HTTP_POST && endpoint.FindFirst("/copy?") >= 0) {
+            static int32 sMockCopySequence = 0;
+            BString monitorUrl = "https://api.onedrive.com/v1.0/monitor/mock_copy_";
+            monitorUrl << atomic_add(&sMockCopySequence, 1);
+            responseHeaders->AddString("Location", monitorUrl);
+        }
+        
         return result;
     }
     
@@ -485,6 +854,7 @@ OneDriveAPI::_MakeHttpRequest(HttpMethod method,
     // TODO: Implement when HTTP API is integrated
     
     // For now, return network error in production mode
+    BAutolock lock(fLock);
     fLastError = "HTTP client not yet implemented";
     return ONEDRIVE_NETWORK_ERROR;
 }
@@ -494,17 +864,90 @@ OneDriveAPI::_GenerateMockResponse(const BString& endpoint, HttpMethod method, B
 {
     syslog(LOG_DEBUG, "OneDrive API: Generating mock response for %s", endpoint.String());
     
-    if (endpoint.FindFirst("/children") >= 0) {
-        // Folder listing response
+    static int32 sMockItemSequence = 0;
+    
+    if (method == HTTP_POST && endpoint.EndsWith("/children")) {
+        // Created folder response
+        response = "{\"id\": \"mock_folder_";
+        response << atomic_add(&sMockItemSequence, 1) << "\", ";
+        response << "\"name\": \"New Folder\", ";
+        response << "\"folder\": {\"childCount\": 0}, ";
+        response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
+        response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        
+    } else if (method == HTTP_PUT && endpoint.EndsWith(":/content")) {
+        // Uploaded file response
+        response = "{\"id\": \"mock_file_";
+        response << atomic_add(&sMockItemSequence, 1) << "\", ";
+        response << "\"name\": \"uploaded_file\", ";
+        response << "\"file\": {\"mimeType\": \"application/octet-stream\"}, ";
+        response << "\"size\": 0, ";
+        response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
+        response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        
+    } else if (method == HTTP_POST && endpoint.EndsWith("/createUploadSession")) {
+        // Upload session: ranges go to the returned URL
+        response = "{\"uploadUrl\": \"https://api.onedrive.com/v1.0/upload/mock_session_";
+        response << atomic_add(&sMockItemSequence, 1) << "\", ";
+        response << "\"expirationDateTime\": \"2024-01-02T12:00:00Z\"}";
+        
+    } else if (method == HTTP_PUT && endpoint.FindFirst("/upload/") >= 0) {
+        // Upload range accepted; mock sessions complete with any range
+        response = "{\"id\": \"mock_file_";
+        response << atomic_add(&sMockItemSequence, 1) << "\", ";
+        response << "\"name\": \"uploaded_file\", ";
+        response << "\"file\": {\"mimeType\": \"application/octet-stream\"}, ";
+        response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
+        response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        
+    } else if (method == HTTP_POST && endpoint.FindFirst("/copy?") >= 0) {
+        // Copy accepted: no body, the monitor URL is in the headers
+        response = "";
+        
+    } else if (endpoint.FindFirst("/monitor/") >= 0) {
+        // Copy monitor: mock copies finish at once
+        response = "{\"operation\": \"itemCopy\", ";
+        response << "\"percentageComplete\": 100.0, ";
+        response << "\"resourceId\": \"mock_file_" << atomic_add(&sMockItemSequence, 1) << "\", ";
+        response << "\"status\": \"completed\"}";
+        
+    } else if (endpoint.FindFirst("/delta") >= 0) {
+        // Delta response: full enumeration first, then no changes
+        static int32 sMockDeltaSequence = 0;
+        response = "{\"value\": [";
+        if (endpoint.FindFirst("token=") < 0) {
+            response << "{\"id\": \"mock_folder_1\", \"name\": \"My Folder\", ";
+            response << "\"folder\": {\"childCount\": 0}, ";
+            response << "\"parentReference\": {\"id\": \"mock_root\", \"path\": \"/drive/root:\"}, ";
+            response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        }
+        response << "], \"@odata.deltaLink\": \"";
+        response << GraphEndpoints::kBaseURL << GraphEndpoints::kDriveRoot;
+        response << "/delta?token=mock_delta_" << atomic_add(&sMockDeltaSequence, 1);
+        response << "\"}";
+        
+    } else if (endpoint.EndsWith("/subscriptions/socketIo")) {
+        // Notification subscription: a local stand-in socket.io server
+        response = "{\"id\": \"mock_subscription\", ";
+        response << "\"notificationUrl\": \"http://127.0.0.1:8765/notifications?token=mock\", ";
+        response << "\"expirationDateTime\": \"2024-01-02T12:00:00Z\"}";
+        
+    } else if (endpoint.FindFirst("/children") >= 0) {
+        // Folder listing response; only the root has a subfolder, so a
+        // crawl of the mock drive terminates
+        bool isRoot = endpoint.FindFirst("/items/") < 0
+            || endpoint.FindFirst("/items/root/") >= 0;
         response = "{\"value\": [";
         response << "{\"id\": \"mock_file_1\", \"name\": \"Document.txt\", ";
         response << "\"file\": {\"mimeType\": \"text/plain\"}, \"size\": 2048, ";
         response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
-        response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"},";
-        response << "{\"id\": \"mock_folder_1\", \"name\": \"My Folder\", ";
-        response << "\"folder\": {\"childCount\": 3}, ";
-        response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
         response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        if (isRoot) {
+            response << ",{\"id\": \"mock_folder_1\", \"name\": \"My Folder\", ";
+            response << "\"folder\": {\"childCount\": 3}, ";
+            response << "\"createdDateTime\": \"2024-01-01T12:00:00Z\", ";
+            response << "\"lastModifiedDateTime\": \"2024-01-01T12:00:00Z\"}";
+        }
         response << "]}";
         
     } else if (endpoint == GraphEndpoints::kUserProfile) {
@@ -539,21 +982,156 @@ OneDriveAPI::_GenerateMockResponse(const BString& endpoint, HttpMethod method, B
     return ONEDRIVE_OK;
 }
 
-status_t
-OneDriveAPI::_AddAuthHeaders(BMessage& headers)
+status_t
+OneDriveAPI::_AddAuthHeaders(BMessage& headers)
+{
+    BString accessToken;
+    status_t result = fAuthManager.GetAccessToken(accessToken);
+    if (result != B_OK) {
+        return result;
+    }
+    
+    BString authHeader = "Bearer ";
+    authHeader << accessToken;
+    headers.AddString("Authorization", authHeader);
+    headers.AddString("Content-Type", "application/json");
+    
+    return B_OK;
+}
+
+OneDriveError
+OneDriveAPI::GetDelta(const BString& deltaToken, BList& items,
+                     BString& newDeltaToken)
+{
+    BString token(deltaToken);
+    while (true) {
+        BString jsonResponse;
+        BString nextToken;
+        OneDriveError error = FetchDeltaPage(token, jsonResponse, nextToken,
+                                             newDeltaToken);
+        if (error != ONEDRIVE_OK) {
+            return error;
+        }
+        
+        error = ParseDeltaPage(jsonResponse, items);
+        if (error != ONEDRIVE_OK) {
+            fLastError = "Invalid delta response format";
+            return error;
+        }
+        
+        if (nextToken.IsEmpty()) {
+            break;
+        }
+        token = nextToken;
+    }
+    
+    // Changed items invalidate exactly their own cached paths
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* item = static_cast<OneDriveItem*>(items.ItemAt(i));
+        NotifyRemoteItemChanged(item->id, item->deleted ? BString() : item->path);
+    }
+    
+    syslog(LOG_DEBUG, "OneDrive API: Delta returned %d changes",
+           (int)items.CountItems());
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::FetchDeltaPage(const BString& pageToken, BString& jsonPage,
+                           BString& nextToken, BString& deltaToken)
+{
+    BAutolock lock(fLock);
+    
+    BString endpoint = GraphEndpoints::kDriveRoot;
+    endpoint << "/delta";
+    if (!pageToken.IsEmpty()) {
+        endpoint << "?token=" << pageToken;
+    }
+    
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_GET, endpoint, NULL, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    _ResponseToString(responseData, jsonPage);
+    
+    BString nextLink;
+    BString deltaLink;
+    _ExtractJsonString(jsonPage, "@odata.nextLink", nextLink);
+    _ExtractJsonString(jsonPage, "@odata.deltaLink", deltaLink);
+    
+    nextToken.SetTo("");
+    if (_ExtractDeltaToken(deltaLink, deltaToken)) {
+        return ONEDRIVE_OK;
+    }
+    
+    if (!_ExtractDeltaToken(nextLink, nextToken)) {
+        fLastError = "Delta response without continuation link";
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::GetNotificationUrl(BString& notificationUrl)
+{
+    BAutolock lock(fLock);
+    
+    BString endpoint = GraphEndpoints::kDriveRoot;
+    endpoint << "/subscriptions/socketIo";
+    
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_GET, endpoint, NULL, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    
+    if (!_ExtractJsonString(jsonResponse, "notificationUrl", notificationUrl)
+        || notificationUrl.IsEmpty()) {
+        fLastError = "Subscription response without notification URL";
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::_ListChildren(const BString& endpoint, BList& items)
 {
-    BString accessToken;
-    status_t result = fAuthManager.GetAccessToken(accessToken);
-    if (result != B_OK) {
-        return result;
+    // Clear existing items
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        delete static_cast<OneDriveItem*>(items.ItemAt(i));
     }
+    items.MakeEmpty();
     
-    BString authHeader = "Bearer ";
-    authHeader << accessToken;
-    headers.AddString("Authorization", authHeader);
-    headers.AddString("Content-Type", "application/json");
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_GET, endpoint, NULL, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
     
-    return B_OK;
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    
+    // Parse JSON and extract items
+    return _ParseFolderContents(jsonResponse, items);
+}
+
+void
+OneDriveAPI::_ResponseToString(BMallocIO& responseData, BString& output)
+{
+    output.SetTo("");
+    responseData.Seek(0, SEEK_SET);
+    char buffer[1024];
+    ssize_t bytesRead;
+    while ((bytesRead = responseData.Read(buffer, sizeof(buffer))) > 0) {
+        output.Append(buffer, bytesRead);
+    }
 }
 
 OneDriveError
@@ -567,6 +1145,7 @@ OneDriveAPI::_ParseFolderContents(const BString& jsonData, BList& items)
     // Look for "value" array in response
     int32 valueStart = jsonData.FindFirst("\"value\":");
     if (valueStart < 0) {
+        BAutolock lock(fLock);
         fLastError = "Invalid folder response format";
         return ONEDRIVE_API_ERROR;
     }
@@ -665,6 +1244,11 @@ OneDriveAPI::_ParseOneDriveItem(const BString& jsonItem, OneDriveItem& item)
         item.type = ITEM_TYPE_UNKNOWN;
     }
     
+    _ExtractJsonString(jsonItem, "eTag", item.eTag);
+    if (item.type == ITEM_TYPE_FILE) {
+        _ExtractJsonString(jsonItem, "quickXorHash", item.quickXorHash);
+    }
+    
     // Set timestamps (simplified - use current time for development)
     item.createdTime = time(NULL);
     item.modifiedTime = time(NULL);
@@ -750,26 +1334,315 @@ OneDriveAPI::_ParseJsonResponse(const BString& jsonData, BMessage& parsedMessage
 }
 
 OneDriveError
-OneDriveAPI::_UploadLargeFile(const BString& localPath,
-                             const BString& remotePath,
+OneDriveAPI::_UploadLargeFile(BFile& file, off_t fileSize,
+                             const BString& itemAddress,
                              void (*progressCallback)(float, void*),
-                             void* userData)
+                             void* userData,
+                             OneDriveItem* uploaded)
 {
-    // TODO: Implement upload session for large files
-    syslog(LOG_INFO, "OneDrive API: Large file upload (not implemented)");
+    syslog(LOG_INFO, "OneDrive API: Creating upload session for %s",
+           itemAddress.String());
     
-    if (progressCallback) {
-        progressCallback(1.0f, userData);
+    BString endpoint(itemAddress);
+    endpoint << "/createUploadSession";
+    
+    BString requestBody = "{\"item\": {";
+    requestBody << "\"@microsoft.graph.conflictBehavior\": \"replace\"";
+    requestBody << "}}";
+    
+    BMallocIO responseData;
+    OneDriveError error = _MakeRequest(HTTP_POST, endpoint, &requestBody, responseData);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    BString jsonResponse;
+    _ResponseToString(responseData, jsonResponse);
+    BString uploadUrl;
+    if (!_ExtractJsonString(jsonResponse, "uploadUrl", uploadUrl)) {
+        BAutolock lock(fLock);
+        fLastError = "Upload session created without an upload URL";
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    // Send the file range by range; each range is read throttled
+    off_t offset = 0;
+    while (offset < fileSize) {
+        off_t rangeSize = min_c((off_t)kUploadSessionChunkSize, fileSize - offset);
+        
+        BString range;
+        char* buffer = range.LockBuffer(rangeSize);
+        if (buffer == NULL) {
+            BAutolock lock(fLock);
+            fLastError = "Out of memory for upload range";
+            return ONEDRIVE_API_ERROR;
+        }
+        
+        off_t bytesRead = 0;
+        while (bytesRead < rangeSize) {
+            ssize_t chunk = file.ReadAt(offset + bytesRead, buffer + bytesRead,
+                min_c((off_t)kTransferChunkSize, rangeSize - bytesRead));
+            if (chunk <= 0) {
+                break;
+            }
+            if (fBandwidthShaper != nullptr) {
+                fBandwidthShaper->Throttle(OneDrive::kBandwidthUpload, chunk);
+            }
+            bytesRead += chunk;
+        }
+        range.UnlockBuffer(bytesRead);
+        
+        if (bytesRead != rangeSize) {
+            BAutolock lock(fLock);
+            fLastError = "Failed to read local file";
+            return ONEDRIVE_FILE_NOT_FOUND;
+        }
+        
+        BString contentRange;
+        contentRange.SetToFormat("bytes %lld-%lld/%lld", (long long)offset,
+            (long long)(offset + rangeSize - 1), (long long)fileSize);
+        BMessage headers;
+        headers.AddString("Content-Range", contentRange);
+        
+        // The upload URL is absolute and carries its own authorization
+        responseData.SetSize(0);
+        responseData.Seek(0, SEEK_SET);
+        error = _MakeRequest(HTTP_PUT, uploadUrl, &range, responseData, &headers);
+        if (error != ONEDRIVE_OK) {
+            return error;
+        }
+        
+        offset += rangeSize;
+        if (progressCallback) {
+            progressCallback((float)offset / fileSize, userData);
+        }
     }
     
-    return ONEDRIVE_OK; // Placeholder for development
+    if (uploaded == NULL) {
+        return ONEDRIVE_OK;
+    }
+    
+    // The response to the last range is the uploaded item
+    _ResponseToString(responseData, jsonResponse);
+    return _ParseOneDriveItem(jsonResponse, *uploaded) == B_OK ? ONEDRIVE_OK : ONEDRIVE_API_ERROR;
 }
 
 OneDriveError
-OneDriveAPI::SyncAttributes(const BString& itemId, const BMessage& attributes)
+OneDriveAPI::_ReadUploadData(BFile& file, BMallocIO& data)
+{
+    std::unique_ptr<char[]> buffer(new char[kTransferChunkSize]);
+    ssize_t bytesRead;
+    while ((bytesRead = file.Read(buffer.get(), kTransferChunkSize)) > 0) {
+        if (fBandwidthShaper != nullptr) {
+            fBandwidthShaper->Throttle(OneDrive::kBandwidthUpload, bytesRead);
+        }
+        data.Write(buffer.get(), bytesRead);
+    }
+    
+    if (bytesRead < 0) {
+        BAutolock lock(fLock);
+        fLastError = "Failed to read local file";
+        return ONEDRIVE_FILE_NOT_FOUND;
+    }
+    data.Seek(0, SEEK_SET);
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::_WriteDownloadData(BMallocIO& data, BFile& file,
+                               void (*progressCallback)(float, void*),
+                               void* userData)
+{
+    const char* content = static_cast<const char*>(data.Buffer());
+    size_t size = data.BufferLength();
+    
+    for (size_t offset = 0; offset < size; offset += kTransferChunkSize) {
+        size_t chunk = size - offset < (size_t)kTransferChunkSize
+            ? size - offset : (size_t)kTransferChunkSize;
+        if (fBandwidthShaper != nullptr) {
+            fBandwidthShaper->Throttle(OneDrive::kBandwidthDownload, chunk);
+        }
+        
+        if (file.Write(content + offset, chunk) != (ssize_t)chunk) {
+            BAutolock lock(fLock);
+            fLastError = "Failed to write local file";
+            return ONEDRIVE_NETWORK_ERROR;
+        }
+        
+        if (progressCallback) {
+            progressCallback((float)(offset + chunk) / size, userData);
+        }
+    }
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::_RequestCopy(const BString& itemId, const BString& parentId,
+                         const BString& name, BString& monitorUrl)
 {
     BAutolock lock(fLock);
     
+    syslog(LOG_INFO, "OneDrive API: Copying item %s to %s in parent %s",
+           itemId.String(), name.String(), parentId.String());
+    
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << itemId << "/copy?@microsoft.graph.conflictBehavior=replace";
+    
+    BString requestBody = "{";
+    requestBody << "\"parentReference\": {\"id\": \"" << parentId << "\"},";
+    requestBody << "\"name\": \"" << name << "\"";
+    requestBody << "}";
+    
+    BMallocIO responseData;
+    BMessage responseHeaders;
+    OneDriveError error = _MakeRequest(HTTP_POST, endpoint, &requestBody,
+                                       responseData, NULL, &responseHeaders);
+    if (error != ONEDRIVE_OK) {
+        return error;
+    }
+    
+    if (responseHeaders.FindString("Location", &monitorUrl) != B_OK) {
+        fLastError = "Copy accepted without a monitor";
+        return ONEDRIVE_API_ERROR;
+    }
+    return ONEDRIVE_OK;
+}
+
+OneDriveError
+OneDriveAPI::_WaitForMonitor(const BString& monitorUrl, BString& resourceId,
+                            void (*progressCallback)(float, void*),
+                            void* userData)
+{
+    // TODO: The monitor URL is absolute and pre-authenticated; the HTTP
+    // client must send it as is, without the Authorization header
+    bigtime_t interval = kCopyPollInterval;
+    bigtime_t deadline = system_time() + kCopyTimeout;
+    
+    while (true) {
+        BMallocIO responseData;
+        OneDriveError error = _MakeRequest(HTTP_GET, monitorUrl, NULL, responseData);
+        if (error != ONEDRIVE_OK) {
+            return error;
+        }
+        
+        BString jsonResponse;
+        _ResponseToString(responseData, jsonResponse);
+        
+        BString status;
+        _ExtractJsonString(jsonResponse, "status", status);
+        
+        BString percentage;
+        if (progressCallback != NULL
+            && _ExtractJsonValue(jsonResponse, "percentageComplete", percentage)) {
+            progressCallback(atof(percentage.String()) / 100.0f, userData);
+        }
+        
+        if (status == "completed") {
+            if (!_ExtractJsonString(jsonResponse, "resourceId", resourceId)) {
+                BAutolock lock(fLock);
+                fLastError = "Copy completed without a resource ID";
+                return ONEDRIVE_API_ERROR;
+            }
+            return ONEDRIVE_OK;
+        }
+        if (status == "failed" || status.IsEmpty()) {
+            BAutolock lock(fLock);
+            fLastError = "Copy failed";
+            BString code;
+            if (_ExtractJsonString(jsonResponse, "code", code)) {
+                fLastError << ": " << code;
+            }
+            return ONEDRIVE_API_ERROR;
+        }
+        
+        // "notStarted", "inProgress" or "waiting"
+        if (fShuttingDown) {
+            BAutolock lock(fLock);
+            fLastError = "Copy no longer monitored: shutting down";
+            return ONEDRIVE_NETWORK_ERROR;
+        }
+        if (system_time() + interval > deadline) {
+            BAutolock lock(fLock);
+            fLastError = "Copy did not finish in time";
+            return ONEDRIVE_NETWORK_ERROR;
+        }
+        snooze(interval);
+        interval = min_c(interval * 2, kCopyPollInterval * 8);
+    }
+}
+
+OneDriveError
+OneDriveAPI::UpdateItemMetadata(const BString& itemId, const BMessage& metadata)
+{
+    // Nothing shared is touched before _MakeRequest(), which locks only
+    // for its bookkeeping: attribute workers overlap their PATCHes
+    
+    // Everything but the content goes in one PATCH of the item
+    BString fields;
+    
+    BString description;
+    if (metadata.FindString("description", &description) == B_OK) {
+        description.CharacterEscape("\"\\", '\\');
+        fields << "\"description\":\"" << description << "\"";
+    }
+    
+    int64 created;
+    int64 modified;
+    bool hasCreated = metadata.FindInt64("created", &created) == B_OK;
+    bool hasModified = metadata.FindInt64("modified", &modified) == B_OK;
+    if (hasCreated || hasModified) {
+        if (!fields.IsEmpty()) {
+            fields << ",";
+        }
+        fields << "\"fileSystemInfo\":{";
+        if (hasCreated) {
+            fields << "\"createdDateTime\":\""
+                << _FormatDateTime((time_t)created) << "\"";
+        }
+        if (hasModified) {
+            if (hasCreated) {
+                fields << ",";
+            }
+            fields << "\"lastModifiedDateTime\":\""
+                << _FormatDateTime((time_t)modified) << "\"";
+        }
+        fields << "}";
+    }
+    
+    BMessage attributes;
+    if (metadata.FindMessage("attributes", &attributes) == B_OK) {
+        BString attributesJson;
+        OneDriveError result = _SerializeAttributesToJson(attributes,
+            attributesJson);
+        if (result != ONEDRIVE_OK) {
+            return result;
+        }
+        if (!fields.IsEmpty()) {
+            fields << ",";
+        }
+        fields << "\"customProperties\":" << attributesJson;
+    }
+    
+    if (fields.IsEmpty()) {
+        return ONEDRIVE_OK;
+    }
+    
+    syslog(LOG_INFO, "OneDrive API: Updating metadata of item %s",
+           itemId.String());
+    
+    BString endpoint = GraphEndpoints::kDriveItems;
+    endpoint << "/" << itemId;
+    
+    BString requestBody = "{";
+    requestBody << fields << "}";
+    
+    BMallocIO responseData;
+    return _MakeRequest(HTTP_PATCH, endpoint, &requestBody, responseData);
+}
+
+OneDriveError
+OneDriveAPI::SyncAttributes(const BString& itemId, const BMessage& attributes)
+{
     if (!fAuthManager.IsAuthenticated()) {
         syslog(LOG_WARNING, "OneDrive API: Authentication required for attribute sync");
         return ONEDRIVE_AUTH_ERROR;
@@ -810,6 +1683,30 @@ OneDriveAPI::GetItemIdByPath(const BString& filePath, BString& itemId)
     return _GetItemIdByPath(filePath, itemId);
 }
 
+void
+OneDriveAPI::NotifyRemoteItemChanged(const BString& itemId, const BString& newPath)
+{
+    fPathCache->InvalidateItem(itemId);
+    
+    if (!newPath.IsEmpty()) {
+        fPathCache->InvalidatePath(_LocalPathToOneDrivePath(newPath));
+    }
+}
+
+void
+OneDriveAPI::NotifyItemMoved(const BString& oldPath, const BString& newPath)
+{
+    fPathCache->Move(_LocalPathToOneDrivePath(oldPath),
+                     _LocalPathToOneDrivePath(newPath));
+}
+
+status_t
+OneDriveAPI::GetPathCacheStats(BMessage& stats)
+{
+    stats.MakeEmpty();
+    return fPathCache->GetStats(stats);
+}
+
 OneDriveError
 OneDriveAPI::_SerializeAttributesToJson(const BMessage& attributes, BString& jsonOutput)
 {
@@ -896,9 +1793,32 @@ OneDriveAPI::_UpdateItemMetadata(const BString& itemId, const BString& metadataJ
     return ONEDRIVE_OK;
 }
 
+BString
+OneDriveAPI::_FormatDateTime(time_t time)
+{
+    struct tm utc;
+    gmtime_r(&time, &utc);
+    
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return BString(buffer);
+}
+
 OneDriveError
 OneDriveAPI::_GetItemIdByPath(const BString& filePath, BString& itemId)
 {
+    // Most lookups are answered without a round trip
+    BString cacheKey = _LocalPathToOneDrivePath(filePath);
+    switch (fPathCache->Lookup(cacheKey, itemId)) {
+        case OneDrive::kPathCacheHit:
+            return ONEDRIVE_OK;
+        case OneDrive::kPathCacheNotFound:
+            fLastError = "Item not found (cached)";
+            return ONEDRIVE_FILE_NOT_FOUND;
+        case OneDrive::kPathCacheMiss:
+            break;
+    }
+    
     // In development mode, generate a mock item ID
     if (fDevelopmentMode) {
         itemId = "DEV_ITEM_";
@@ -909,6 +1829,7 @@ OneDriveAPI::_GetItemIdByPath(const BString& filePath, BString& itemId)
         }
         itemId << hash;
         syslog(LOG_DEBUG, "OneDrive API: [DEV] Generated item ID %s for path %s", itemId.String(), filePath.String());
+        fPathCache->Insert(cacheKey, itemId);
         return ONEDRIVE_OK;
     }
     
@@ -923,6 +1844,9 @@ OneDriveAPI::_GetItemIdByPath(const BString& filePath, BString& itemId)
     OneDriveError result = _MakeHttpRequest(HTTP_GET, url, nullptr, responseData);
     
     if (result != ONEDRIVE_OK) {
+        if (result == ONEDRIVE_FILE_NOT_FOUND) {
+            fPathCache->InsertNotFound(cacheKey);
+        }
         syslog(LOG_ERR, "OneDrive API: Failed to get item by path: %s", filePath.String());
         return result;
     }
@@ -945,6 +1869,9 @@ OneDriveAPI::_GetItemIdByPath(const BString& filePath, BString& itemId)
             int32 idEnd = response.FindFirst("\"", idStart);
             if (idEnd > idStart) {
                 response.CopyInto(itemId, idStart, idEnd - idStart);
+                BString eTag;
+                _ExtractJsonString(response, "eTag", eTag);
+                fPathCache->Insert(cacheKey, itemId, eTag);
                 return ONEDRIVE_OK;
             }
         }
@@ -1224,6 +2151,129 @@ OneDriveAPI::_ParseSingleAttribute(const BString& attrJson, BMessage& attributes
     }
 }
 
+OneDriveError
+OneDriveAPI::ParseDeltaPage(const BString& jsonData, BList& items)
+{
+    // No fLastError here: this runs concurrently with requests
+    int32 valueStart = jsonData.FindFirst("\"value\":");
+    if (valueStart < 0) {
+        return ONEDRIVE_API_ERROR;
+    }
+    
+    int32 arrayStart = jsonData.FindFirst("[", valueStart);
+    if (arrayStart < 0) {
+        return ONEDRIVE_OK;
+    }
+    
+    int32 pos = arrayStart + 1;
+    while (pos < jsonData.Length()) {
+        // Skip separators up to the next item or the end of the array
+        while (pos < jsonData.Length() && jsonData[pos] != '{'
+            && jsonData[pos] != ']') {
+            pos++;
+        }
+        if (pos >= jsonData.Length() || jsonData[pos] == ']') {
+            break;
+        }
+        
+        int32 objEnd = _FindObjectEnd(jsonData, pos);
+        if (objEnd < 0) {
+            return ONEDRIVE_API_ERROR;
+        }
+        
+        BString itemJson;
+        jsonData.CopyInto(itemJson, pos, objEnd - pos + 1);
+        pos = objEnd + 1;
+        
+        // Split off the parent reference so its "id" is not taken for ours
+        BString parentPath;
+        OneDriveItem* item = new OneDriveItem();
+        int32 parentStart = itemJson.FindFirst("\"parentReference\":");
+        if (parentStart >= 0) {
+            int32 braceStart = itemJson.FindFirst("{", parentStart);
+            int32 braceEnd = braceStart >= 0 ? _FindObjectEnd(itemJson, braceStart) : -1;
+            if (braceEnd > braceStart) {
+                BString parentJson;
+                itemJson.CopyInto(parentJson, braceStart, braceEnd - braceStart + 1);
+                _ExtractJsonString(parentJson, "id", item->parentId);
+                _ExtractJsonString(parentJson, "path", parentPath);
+                itemJson.Remove(parentStart, braceEnd - parentStart + 1);
+            }
+        }
+        
+        if (_ParseOneDriveItem(itemJson, *item) != B_OK) {
+            delete item;
+            continue;
+        }
+        
+        item->deleted = itemJson.FindFirst("\"deleted\":") >= 0;
+        
+        // "/drive/root:/Folder" -> "/Folder/name"; the root itself has no parent
+        if (parentStart >= 0) {
+            int32 rootEnd = parentPath.FindFirst(":");
+            if (rootEnd >= 0) {
+                parentPath.Remove(0, rootEnd + 1);
+            }
+            if (!parentPath.EndsWith("/")) {
+                parentPath << "/";
+            }
+            item->path = parentPath;
+            item->path << item->name;
+        }
+        
+        items.AddItem(item);
+    }
+    
+    return ONEDRIVE_OK;
+}
+
+int32
+OneDriveAPI::_FindObjectEnd(const BString& json, int32 start)
+{
+    int32 depth = 0;
+    bool inString = false;
+    
+    for (int32 i = start; i < json.Length(); i++) {
+        char c = json[i];
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}') {
+            if (--depth == 0) {
+                return i;
+            }
+        }
+    }
+    
+    return -1;
+}
+
+bool
+OneDriveAPI::_ExtractDeltaToken(const BString& link, BString& token)
+{
+    int32 tokenStart = link.FindFirst("token=");
+    if (tokenStart < 0) {
+        return false;
+    }
+    
+    tokenStart += 6;
+    int32 tokenEnd = link.FindFirst("&", tokenStart);
+    if (tokenEnd < 0) {
+        tokenEnd = link.Length();
+    }
+    
+    token.SetTo("");
+    link.CopyInto(token, tokenStart, tokenEnd - tokenStart);
+    return !token.IsEmpty();
+}
+
 bool
 OneDriveAPI::_ExtractJsonString(const BString& json, const char* key, BString& value)
 {
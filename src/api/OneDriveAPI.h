@@ -19,13 +19,18 @@
 #include <Locker.h>
 #include <List.h>
 #include <DataIO.h>
+#include <OS.h>
 
 #include <memory>
+#include <set>
 
 // Forward declarations
 class AuthenticationManager;
+class BFile;
 namespace OneDrive {
+    class BandwidthShaper;
     class ConnectionPool;
+    class ItemPathCache;
 }
 
 /**
@@ -71,7 +76,8 @@ enum OneDriveError {
     ONEDRIVE_FILE_NOT_FOUND,
     ONEDRIVE_INVALID_REQUEST,
     ONEDRIVE_RATE_LIMITED,
-    ONEDRIVE_SERVER_ERROR
+    ONEDRIVE_SERVER_ERROR,
+    ONEDRIVE_RESYNC_REQUIRED
 };
 
 /**
@@ -86,12 +92,28 @@ struct OneDriveItem {
     time_t createdTime;            ///< Creation timestamp
     time_t modifiedTime;           ///< Last modification timestamp
     BString eTag;                  ///< Entity tag for change detection
+    BString quickXorHash;          ///< Base64 content hash (files)
     BString downloadUrl;           ///< Direct download URL (temporary)
     BMessage attributes;           ///< Custom BFS attributes (Haiku-specific)
+    BString parentId;              ///< Parent folder ID (delta results)
+    bool deleted;                  ///< Removed remotely (delta results)
     
     OneDriveItem();
 };
 
+/**
+ * @brief Called once when an asynchronous copy finishes
+ * 
+ * Runs on the copy's monitor thread.
+ * 
+ * @param error ONEDRIVE_OK, or why the copy failed
+ * @param copied ID, name and parent ID of the copy on success
+ * @param userData As given to OneDriveAPI::StartCopy()
+ */
+typedef void (*CopyCompletionCallback)(OneDriveError error,
+                                       const OneDriveItem& copied,
+                                       void* userData);
+
 /**
  * @brief Microsoft Graph API client for OneDrive integration
  * 
@@ -149,6 +171,88 @@ public:
      */
     OneDriveError ListFolder(const BString& folderPath, BList& items);
     
+    /**
+     * @brief List items in OneDrive folder addressed by ID
+     * 
+     * Uses `items/{id}/children`, so the listing keeps working when an
+     * ancestor folder has been renamed and needs no server path resolution.
+     * 
+     * @param folderId OneDrive ID of the folder
+     * @param items List to store retrieved items
+     * @return OneDriveError code
+     */
+    OneDriveError ListFolderById(const BString& folderId, BList& items);
+    
+    /**
+     * @brief Get how many requests may run concurrently
+     * 
+     * Callers issuing independent requests from several threads, like
+     * ListFolderById() during a crawl, should not exceed this budget.
+     * 
+     * @return Connection budget of the pool (at least 1)
+     */
+    int32 GetMaxConcurrentRequests() const;
+    
+    /**
+     * @brief Get changes to the drive since a delta token
+     * 
+     * Follows all result pages. With an empty token the whole drive is
+     * enumerated; with a current token the result is usually empty.
+     * Returned items carry their full path and a deleted flag.
+     * 
+     * @param deltaToken Token from a previous call (empty for initial sync)
+     * @param items List to store changed OneDriveItem objects
+     * @param newDeltaToken Receives the token for the next call
+     * @return OneDriveError code
+     */
+    OneDriveError GetDelta(const BString& deltaToken, BList& items,
+                          BString& newDeltaToken);
+    
+    /**
+     * @brief Fetch one raw page of drive changes
+     * 
+     * Only the page links are extracted, so the next page can be requested
+     * right away while this one is parsed elsewhere.
+     * 
+     * @param pageToken Token of the page (empty for the first page of an
+     *        initial sync)
+     * @param jsonPage Receives the response body
+     * @param nextToken Receives the token of the next page, empty on the
+     *        last page
+     * @param deltaToken Receives the token for the next delta call, set on
+     *        the last page only
+     * @return OneDriveError code; ONEDRIVE_RESYNC_REQUIRED if the token
+     *         expired (HTTP 410) and the drive must be enumerated again.
+     *         The token "latest" returns the current token without items.
+     */
+    OneDriveError FetchDeltaPage(const BString& pageToken, BString& jsonPage,
+                                BString& nextToken, BString& deltaToken);
+    
+    /**
+     * @brief Parse a page fetched with FetchDeltaPage()
+     * 
+     * Takes no lock and changes no API state, so pages can be parsed on
+     * another thread while further requests are made.
+     * 
+     * @param jsonPage Response body
+     * @param items BList to append changed OneDriveItem objects to
+     * @return OneDriveError code
+     */
+    OneDriveError ParseDeltaPage(const BString& jsonPage, BList& items);
+    
+    /**
+     * @brief Get a socket.io URL for drive change notifications
+     * 
+     * Each call creates a new subscription; the URL is only valid for a
+     * limited time and should be fetched again before reconnecting.
+     * In development mode a local stand-in server URL is returned.
+     * 
+     * @param notificationUrl Receives the notification URL
+     * @return OneDriveError code
+     * @see OneDrive::NotificationChannel
+     */
+    OneDriveError GetNotificationUrl(BString& notificationUrl);
+    
     /**
      * @brief Download file from OneDrive
      * 
@@ -175,21 +279,111 @@ public:
      * @param remotePath Remote path in OneDrive (including filename)
      * @param progressCallback Optional progress callback function
      * @param userData User data for progress callback
+     * @param uploaded Optional item to receive the uploaded file (including its ID)
      * @return OneDriveError code
      */
     OneDriveError UploadFile(const BString& localPath,
                             const BString& remotePath,
                             void (*progressCallback)(float progress, void* userData) = NULL,
-                            void* userData = NULL);
+                            void* userData = NULL,
+                            OneDriveItem* uploaded = NULL);
     
     /**
      * @brief Create folder in OneDrive
      * 
      * @param folderPath Path where to create the folder
      * @param folderName Name of the new folder
+     * @param created Optional item to receive the new folder (including its ID)
+     * @return OneDriveError code
+     */
+    OneDriveError CreateFolder(const BString& folderPath, const BString& folderName,
+                              OneDriveItem* created = NULL);
+    
+    /**
+     * @brief Create folder inside a parent addressed by ID
+     * 
+     * Avoids server-side path resolution when the parent's ID is already
+     * known, e.g. when a whole new folder tree is created parent-first.
+     * 
+     * @param parentId OneDrive ID of the parent folder
+     * @param folderName Name of the new folder
+     * @param created Optional item to receive the new folder (including its ID)
+     * @return OneDriveError code
+     */
+    OneDriveError CreateFolderInParent(const BString& parentId,
+                                      const BString& folderName,
+                                      OneDriveItem* created = NULL);
+    
+    /**
+     * @brief Upload file into a parent folder addressed by ID
+     * 
+     * @param localPath Local file path to upload
+     * @param parentId OneDrive ID of the destination folder
+     * @param fileName Name of the file in OneDrive
+     * @param uploaded Optional item to receive the uploaded file
      * @return OneDriveError code
      */
-    OneDriveError CreateFolder(const BString& folderPath, const BString& folderName);
+    OneDriveError UploadFileToParent(const BString& localPath,
+                                    const BString& parentId,
+                                    const BString& fileName,
+                                    OneDriveItem* uploaded = NULL);
+    
+    /**
+     * @brief Move or rename an item
+     * 
+     * Moving a folder moves its whole subtree in a single request. The
+     * destination is addressed by ID when given, otherwise by path.
+     * 
+     * @param itemId OneDrive item ID to move
+     * @param newParentId Destination folder ID, empty to address it by path
+     * @param newParentPath Destination folder path (empty string for root)
+     * @param newName New item name
+     * @return OneDriveError code
+     */
+    OneDriveError MoveItem(const BString& itemId, const BString& newParentId,
+                          const BString& newParentPath, const BString& newName);
+    
+    /**
+     * @brief Copy an item server-side
+     * 
+     * The drive copies the content itself; nothing is transferred. Graph
+     * runs copies asynchronously, so this polls the copy's monitor until
+     * it finishes, without holding the API lock. An existing item of the
+     * same name is replaced.
+     * 
+     * @param itemId OneDrive item ID to copy
+     * @param parentId OneDrive ID of the destination folder
+     * @param name Name of the copy
+     * @param copied Optional item to receive ID, name and parent ID of
+     *        the copy
+     * @return OneDriveError code, ONEDRIVE_NETWORK_ERROR if the copy did
+     *         not finish within kCopyTimeout
+     */
+    OneDriveError CopyItem(const BString& itemId, const BString& parentId,
+                          const BString& name, OneDriveItem* copied = NULL);
+    
+    /**
+     * @brief Start a server-side copy and return at once
+     * 
+     * As CopyItem(), but the monitor is polled on a thread of its own,
+     * which reports the outcome to the completion callback. A folder is
+     * copied with everything inside it.
+     * 
+     * @param itemId OneDrive item ID to copy
+     * @param parentId OneDrive ID of the destination folder
+     * @param name Name of the copy
+     * @param completion Called once with the outcome if the copy started
+     * @param userData Passed to both callbacks
+     * @param progressCallback Optional, called with the share done so far
+     *        as the monitor reports it
+     * @return ONEDRIVE_OK if the copy started, otherwise the error that
+     *         kept it from starting; the completion is then not called
+     */
+    OneDriveError StartCopy(const BString& itemId, const BString& parentId,
+                           const BString& name,
+                           CopyCompletionCallback completion, void* userData,
+                           void (*progressCallback)(float progress,
+                                                    void* userData) = NULL);
     
     /**
      * @brief Delete item from OneDrive
@@ -215,7 +409,13 @@ public:
     /**
      * @brief Update item metadata
      * 
-     * Updates OneDrive item metadata including custom BFS attributes.
+     * Updates OneDrive item metadata including custom BFS attributes,
+     * with a single PATCH and no content transfer. Recognized fields:
+     * "description" (string), "created" and "modified" (int64 time_t,
+     * sent as fileSystemInfo) and "attributes" (message of BFS
+     * attributes, sent as custom properties). Absent fields are left as
+     * they are; the attributes sent replace all stored before, so they
+     * must be the complete set.
      * 
      * @param itemId OneDrive item ID
      * @param metadata BMessage containing metadata to update
@@ -245,6 +445,37 @@ public:
      */
     OneDriveError GetItemIdByPath(const BString& filePath, BString& itemId);
     
+    /**
+     * @brief Notify the path cache that a remote item changed
+     * 
+     * Called for each delta result. Drops the cached path of the item and,
+     * for folders, of its whole subtree.
+     * 
+     * @param itemId OneDrive item ID reported by the delta
+     * @param newPath Current path of the item, if known (clears a cached
+     *        "not found" result at the new location)
+     */
+    void NotifyRemoteItemChanged(const BString& itemId,
+                                const BString& newPath = "");
+    
+    /**
+     * @brief Notify the path cache that an item was moved
+     * 
+     * Cached IDs below the old path are re-keyed to the new path.
+     * 
+     * @param oldPath Previous path
+     * @param newPath New path
+     */
+    void NotifyItemMoved(const BString& oldPath, const BString& newPath);
+    
+    /**
+     * @brief Get path resolution cache statistics
+     * 
+     * @param stats BMessage to store hit/miss counters and hit rate
+     * @return B_OK on success
+     */
+    status_t GetPathCacheStats(BMessage& stats);
+    
     // User and Drive Information
     
     /**
@@ -308,6 +539,17 @@ public:
      * @param probeInterval How often to re-probe limits (seconds)
      */
     void SetConnectionPoolParams(int32 minConnections, int32 probeInterval);
+    
+    /**
+     * @brief Set the rate limiter for file transfers
+     * 
+     * Uploads and downloads ask the shaper before every chunk, outside
+     * the API lock so a throttled transfer does not hold up other
+     * requests.
+     * 
+     * @param shaper Shared shaper, not owned; NULL for no limit
+     */
+    void SetBandwidthShaper(OneDrive::BandwidthShaper* shaper);
 
 private:
     /// @name HTTP Client Implementation
@@ -321,13 +563,15 @@ private:
      * @param requestBody Request body data (NULL for GET)
      * @param responseData Response data storage
      * @param customHeaders Custom HTTP headers
+     * @param responseHeaders Optional message to receive response headers
      * @return OneDriveError code
      */
     OneDriveError _MakeRequest(HttpMethod method,
                               const BString& endpoint,
                               const BString* requestBody,
                               BMallocIO& responseData,
-                              const BMessage* customHeaders = NULL);
+                              const BMessage* customHeaders = NULL,
+                              BMessage* responseHeaders = NULL);
     
     /**
      * @brief Make actual HTTP request using networking APIs
@@ -337,13 +581,15 @@ private:
      * @param requestBody Request body data (NULL for GET)
      * @param responseData Response data storage
      * @param customHeaders Custom HTTP headers
+     * @param responseHeaders Optional message to receive response headers
      * @return OneDriveError code
      */
     OneDriveError _MakeHttpRequest(HttpMethod method,
                                   const BString& endpoint,
                                   const BString* requestBody,
                                   BMallocIO& responseData,
-                                  const BMessage* customHeaders = NULL);
+                                  const BMessage* customHeaders = NULL,
+                                  BMessage* responseHeaders = NULL);
     
     /**
      * @brief Generate mock API response for development
@@ -395,16 +641,83 @@ private:
     /**
      * @brief Upload file using upload session for large files
      * 
-     * @param localPath Local file path
-     * @param remotePath Remote path in OneDrive
+     * Creates the session at the item's address, then sends the file in
+     * ranges of kUploadSessionChunkSize; the last range returns the item.
+     * 
+     * @param file Open file to upload
+     * @param fileSize Size of the file
+     * @param itemAddress Item address ending in ':', by path or parent ID
      * @param progressCallback Progress callback
      * @param userData User data for callback
+     * @param uploaded Receives the uploaded item, may be NULL
      * @return OneDriveError code
      */
-    OneDriveError _UploadLargeFile(const BString& localPath,
-                                  const BString& remotePath,
+    OneDriveError _UploadLargeFile(BFile& file, off_t fileSize,
+                                  const BString& itemAddress,
                                   void (*progressCallback)(float, void*),
-                                  void* userData);
+                                  void* userData,
+                                  OneDriveItem* uploaded);
+    
+    /**
+     * @brief Read a file to upload chunk by chunk, throttled
+     * 
+     * @param file Open file
+     * @param data Receives the content
+     * @return ONEDRIVE_OK, or ONEDRIVE_FILE_NOT_FOUND on a read error
+     */
+    OneDriveError _ReadUploadData(BFile& file, BMallocIO& data);
+    
+    /**
+     * @brief Write downloaded content chunk by chunk, throttled
+     * 
+     * @param data Downloaded content
+     * @param file Open file to write to
+     * @param progressCallback Progress callback
+     * @param userData User data for callback
+     * @return ONEDRIVE_OK, or ONEDRIVE_NETWORK_ERROR on a write error
+     */
+    OneDriveError _WriteDownloadData(BMallocIO& data, BFile& file,
+                                    void (*progressCallback)(float, void*),
+                                    void* userData);
+    
+    /**
+     * @brief Poll an asynchronous operation's monitor until it finishes
+     * 
+     * Called without fLock held. The interval starts at kCopyPollInterval
+     * and doubles up to eight times that.
+     * 
+     * @param monitorUrl Monitor URL from the Location header
+     * @param resourceId Receives the ID of the resulting item
+     * @param progressCallback Optional, called with each reported share
+     *        done
+     * @param userData Passed to the progress callback
+     * @return ONEDRIVE_OK, ONEDRIVE_API_ERROR if the operation failed, or
+     *         ONEDRIVE_NETWORK_ERROR after kCopyTimeout or on shutdown
+     */
+    OneDriveError _WaitForMonitor(const BString& monitorUrl,
+                                 BString& resourceId,
+                                 void (*progressCallback)(float, void*) = NULL,
+                                 void* userData = NULL);
+    
+    /**
+     * @brief Ask the server to copy an item
+     * 
+     * @param itemId OneDrive item ID to copy
+     * @param parentId OneDrive ID of the destination folder
+     * @param name Name of the copy
+     * @param monitorUrl Receives the URL of the copy's monitor
+     * @return OneDriveError code
+     */
+    OneDriveError _RequestCopy(const BString& itemId, const BString& parentId,
+                              const BString& name, BString& monitorUrl);
+    
+    /**
+     * @brief Thread polling the monitor of a copy started by StartCopy()
+     * 
+     * @param data Heap-allocated copy job, deleted by the thread
+     * @return Always 0
+     */
+    static int32 _CopyMonitorThread(void* data);
     
     /// @}
     
@@ -438,6 +751,23 @@ private:
      */
     status_t _JsonToAttributes(const BString& jsonMetadata, BMessage& attributes);
     
+    /**
+     * @brief Fetch and parse a children listing
+     * 
+     * @param endpoint Children endpoint (path- or ID-addressed)
+     * @param items List to populate with OneDriveItem objects
+     * @return OneDriveError code
+     */
+    OneDriveError _ListChildren(const BString& endpoint, BList& items);
+    
+    /**
+     * @brief Read a complete response body into a string
+     * 
+     * @param responseData Response data storage
+     * @param output String to store the response body
+     */
+    void _ResponseToString(BMallocIO& responseData, BString& output);
+    
     /**
      * @brief Parse folder contents from JSON response
      * 
@@ -447,6 +777,24 @@ private:
      */
     OneDriveError _ParseFolderContents(const BString& jsonData, BList& items);
     
+    /**
+     * @brief Find the brace closing a JSON object
+     * 
+     * @param json JSON text
+     * @param start Offset of the opening brace
+     * @return Offset of the matching closing brace, or -1
+     */
+    static int32 _FindObjectEnd(const BString& json, int32 start);
+    
+    /**
+     * @brief Extract the token query parameter of a delta link
+     * 
+     * @param link nextLink or deltaLink URL
+     * @param token Receives the token
+     * @return true if the link carries a token
+     */
+    static bool _ExtractDeltaToken(const BString& link, BString& token);
+    
     /**
      * @brief Convert HTTP method enum to string
      * 
@@ -473,6 +821,14 @@ private:
      */
     OneDriveError _UpdateItemMetadata(const BString& itemId, const BString& metadataJson);
     
+    /**
+     * @brief Format a time as Graph's ISO 8601 UTC date-time
+     * 
+     * @param time Seconds since the epoch
+     * @return Date-time such as "2024-01-01T12:00:00Z"
+     */
+    static BString _FormatDateTime(time_t time);
+    
     /**
      * @brief Get OneDrive item ID by file path
      * 
@@ -605,8 +961,14 @@ private:
     
     // Connection pool
     std::unique_ptr<OneDrive::ConnectionPool> fConnectionPool; ///< Adaptive connection pool
+    std::unique_ptr<OneDrive::ItemPathCache> fPathCache; ///< Path -> item ID cache
+    OneDrive::BandwidthShaper* fBandwidthShaper; ///< Transfer rate limiter (not owned)
     void*                   fUrlContext;       ///< URL context for sessions (BUrlContext*)
     
+    // Asynchronous copies
+    std::set<thread_id>     fCopyMonitors;     ///< Monitor threads running
+    volatile bool           fShuttingDown;     ///< Monitors give up when set
+    
     // Rate limiting
     time_t                  fLastRequestTime;  ///< Time of last API request
     int32                   fRequestCount;     ///< Requests made in current period
@@ -619,6 +981,10 @@ private:
     static const int32 kDefaultTimeout;       ///< Default request timeout
     static const int32 kMaxRetries;           ///< Maximum retry attempts
     static const int32 kLargeFileThreshold;   ///< Threshold for upload sessions
+    static const int32 kTransferChunkSize;    ///< Bytes moved per throttled chunk
+    static const int32 kUploadSessionChunkSize; ///< Bytes per upload session range
+    static const bigtime_t kCopyPollInterval; ///< First copy monitor poll delay
+    static const bigtime_t kCopyTimeout;      ///< Longest wait for a copy
     static const int32 kRateLimitWindow;      ///< Rate limit time window
     static const int32 kMaxRequestsPerWindow; ///< Max requests per time window
     
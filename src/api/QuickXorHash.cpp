@@ -0,0 +1,126 @@
+/**
+ * @file QuickXorHash.cpp
+ * @brief Implementation of the QuickXorHash content fingerprint
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "QuickXorHash.h"
+
+#include <string.h>
+
+using namespace OneDrive;
+
+const size_t QuickXorHash::kDigestSize;
+const int32 QuickXorHash::kWidth;
+const int32 QuickXorHash::kShift;
+const int32 QuickXorHash::kCells;
+
+/**
+ * @brief Constructor
+ */
+QuickXorHash::QuickXorHash()
+{
+    Reset();
+}
+
+/**
+ * @brief Start over
+ */
+void
+QuickXorHash::Reset()
+{
+    memset(fCells, 0, sizeof(fCells));
+    fLength = 0;
+    fShift = 0;
+}
+
+/**
+ * @brief Add input
+ *
+ * Bytes kWidth apart land on the same bit offset, so each of the first
+ * kWidth offsets XORs its whole column of input together and shifts it in
+ * once.
+ */
+void
+QuickXorHash::Update(const void* data, size_t length)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+
+    int32 cell = fShift / 64;
+    int32 offset = fShift % 64;
+    size_t columns = length < (size_t)kWidth ? length : (size_t)kWidth;
+
+    for (size_t i = 0; i < columns; i++) {
+        bool lastCell = cell == kCells - 1;
+        int32 cellBits = lastCell ? kWidth % 64 : 64;
+
+        uint8 column = 0;
+        for (size_t j = i; j < length; j += kWidth) {
+            column ^= bytes[j];
+        }
+
+        fCells[cell] ^= (uint64)column << offset;
+        if (offset > cellBits - 8) {
+            // The byte straddles two cells; the last wraps to the first
+            fCells[lastCell ? 0 : cell + 1]
+                ^= (uint64)column >> (cellBits - offset);
+        }
+
+        offset += kShift;
+        while (offset >= cellBits) {
+            offset -= cellBits;
+            cell = lastCell ? 0 : cell + 1;
+            lastCell = cell == kCells - 1;
+            cellBits = lastCell ? kWidth % 64 : 64;
+        }
+    }
+
+    fShift = (fShift + kShift * (length % kWidth)) % kWidth;
+    fLength += length;
+}
+
+/**
+ * @brief Get the digest of the input so far
+ */
+void
+QuickXorHash::Digest(uint8* digest) const
+{
+    for (size_t i = 0; i < kDigestSize; i++) {
+        digest[i] = (uint8)(fCells[i / 8] >> (8 * (i % 8)));
+    }
+    for (size_t i = 0; i < sizeof(fLength); i++) {
+        digest[kDigestSize - sizeof(fLength) + i]
+            ^= (uint8)(fLength >> (8 * i));
+    }
+}
+
+/**
+ * @brief Get the digest of the input so far as Graph shows it
+ */
+BString
+QuickXorHash::Base64() const
+{
+    static const char kAlphabet[]
+        = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    uint8 digest[kDigestSize];
+    Digest(digest);
+
+    BString encoded;
+    for (size_t i = 0; i < kDigestSize; i += 3) {
+        uint32 group = (uint32)digest[i] << 16;
+        if (i + 1 < kDigestSize) {
+            group |= (uint32)digest[i + 1] << 8;
+        }
+        if (i + 2 < kDigestSize) {
+            group |= digest[i + 2];
+        }
+        encoded << kAlphabet[(group >> 18) & 0x3f];
+        encoded << kAlphabet[(group >> 12) & 0x3f];
+        encoded << (i + 1 < kDigestSize ? kAlphabet[(group >> 6) & 0x3f] : '=');
+        encoded << (i + 2 < kDigestSize ? kAlphabet[group & 0x3f] : '=');
+    }
+    return encoded;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file QuickXorHash.h
+ * @brief OneDrive's QuickXorHash content fingerprint
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * OneDrive reports a QuickXorHash for every file on every drive type. A
+ * local file hashed the same way can be compared with remote items without
+ * downloading them.
+ */
+
+#ifndef QUICK_XOR_HASH_H
+#define QUICK_XOR_HASH_H
+
+#include <String.h>
+#include <SupportDefs.h>
+
+namespace OneDrive {
+
+/**
+ * @brief Incremental QuickXorHash
+ *
+ * Every input byte is XORed into a 160-bit register, each one 11 bits
+ * further along than the one before, wrapping around. The total length is
+ * XORed into the last 8 bytes at the end. The digest is the register in
+ * little-endian order; Graph shows it in Base64.
+ *
+ * @see OneDriveItem::quickXorHash
+ * @since 1.0.0
+ */
+class QuickXorHash {
+public:
+    /**
+     * @brief Constructor, ready for input
+     */
+    QuickXorHash();
+
+    /**
+     * @brief Start over
+     */
+    void Reset();
+
+    /**
+     * @brief Add input
+     *
+     * @param data Bytes to hash
+     * @param length Number of bytes
+     */
+    void Update(const void* data, size_t length);
+
+    /**
+     * @brief Get the digest of the input so far
+     *
+     * @param digest Receives kDigestSize bytes
+     */
+    void Digest(uint8* digest) const;
+
+    /**
+     * @brief Get the digest of the input so far as Graph shows it
+     *
+     * @return Base64 digest
+     */
+    BString Base64() const;
+
+    static const size_t kDigestSize = 20;   ///< Digest bytes (160 bits)
+
+private:
+    static const int32 kWidth = 160;        ///< Register bits
+    static const int32 kShift = 11;         ///< Offset between input bytes
+    static const int32 kCells = 3;          ///< 64-bit cells of the register
+
+    uint64 fCells[kCells];
+    uint64 fLength;                         ///< Bytes hashed
+    int32 fShift;                           ///< Offset of the next byte
+};
+
+} // namespace OneDrive
+
+#endif // QUICK_XOR_HASH_H
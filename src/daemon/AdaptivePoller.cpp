@@ -0,0 +1,82 @@
+/**
+ * @file AdaptivePoller.cpp
+ * @brief Implementation of the adaptive remote polling interval
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "AdaptivePoller.h"
+
+using namespace OneDrive;
+
+const bigtime_t AdaptivePoller::kDefaultMinInterval = 5000000LL;
+const bigtime_t AdaptivePoller::kDefaultMaxInterval = 300000000LL;
+const int32 AdaptivePoller::kFastPolls = 3;
+
+/**
+ * @brief Constructor
+ */
+AdaptivePoller::AdaptivePoller(bigtime_t minInterval, bigtime_t maxInterval)
+    : fMinInterval(minInterval),
+      fMaxInterval(maxInterval),
+      fInterval(minInterval),
+      fFastPollsLeft(0),
+      fPolls(0),
+      fHits(0)
+{
+    SetLimits(minInterval, maxInterval);
+}
+
+/**
+ * @brief Record the result of a poll
+ */
+bigtime_t
+AdaptivePoller::RecordPoll(int32 changeCount)
+{
+    fPolls++;
+
+    if (changeCount > 0) {
+        fHits++;
+        RecordActivity();
+        return fInterval;
+    }
+
+    if (fFastPollsLeft > 0) {
+        fFastPollsLeft--;
+        return fInterval;
+    }
+
+    fInterval *= 2;
+    if (fInterval > fMaxInterval) {
+        fInterval = fMaxInterval;
+    }
+
+    return fInterval;
+}
+
+/**
+ * @brief Switch to the fast cadence without a poll result
+ */
+void
+AdaptivePoller::RecordActivity()
+{
+    fInterval = fMinInterval;
+    fFastPollsLeft = kFastPolls;
+}
+
+/**
+ * @brief Change the interval limits
+ */
+void
+AdaptivePoller::SetLimits(bigtime_t minInterval, bigtime_t maxInterval)
+{
+    fMinInterval = minInterval > 0 ? minInterval : kDefaultMinInterval;
+    fMaxInterval = maxInterval > fMinInterval ? maxInterval : fMinInterval;
+
+    if (fInterval < fMinInterval) {
+        fInterval = fMinInterval;
+    } else if (fInterval > fMaxInterval) {
+        fInterval = fMaxInterval;
+    }
+}
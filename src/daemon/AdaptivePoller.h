@@ -0,0 +1,113 @@
+/**
+ * @file AdaptivePoller.h
+ * @brief Change-rate driven remote polling interval
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * The AdaptivePoller decides how long to wait before the next remote delta
+ * poll. Polls that find changes tighten the cadence to seconds; a run of
+ * empty polls backs it off towards the configured ceiling.
+ */
+
+#ifndef ADAPTIVE_POLLER_H
+#define ADAPTIVE_POLLER_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+
+namespace OneDrive {
+
+/**
+ * @brief Computes the remote poll interval from recent poll results
+ *
+ * After a poll that returned changes the interval drops to the minimum
+ * and stays there for a few more polls, since remote activity tends to
+ * come in bursts. Every further empty poll doubles the interval up to
+ * the maximum, so an idle account is polled rarely.
+ *
+ * The poller is not thread-safe; the owner serializes access.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class AdaptivePoller {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param minInterval Shortest interval, used after remote activity
+     * @param maxInterval Longest interval, used for idle accounts
+     */
+    AdaptivePoller(bigtime_t minInterval = kDefaultMinInterval,
+        bigtime_t maxInterval = kDefaultMaxInterval);
+
+    /**
+     * @brief Record the result of a poll
+     *
+     * @param changeCount Number of changes the poll returned
+     * @return Interval until the next poll
+     */
+    bigtime_t RecordPoll(int32 changeCount);
+
+    /**
+     * @brief Switch to the fast cadence without a poll result
+     *
+     * For activity seen through other channels, e.g. a change
+     * notification or a user-initiated sync.
+     */
+    void RecordActivity();
+
+    /**
+     * @brief Change the interval limits
+     *
+     * @param minInterval Shortest interval
+     * @param maxInterval Longest interval
+     */
+    void SetLimits(bigtime_t minInterval, bigtime_t maxInterval);
+
+    /**
+     * @brief Get interval until the next poll
+     *
+     * @return Interval in microseconds
+     */
+    bigtime_t CurrentInterval() const { return fInterval; }
+
+    /**
+     * @brief Get number of recorded polls
+     *
+     * @return Poll count
+     */
+    int32 PollCount() const { return fPolls; }
+
+    /**
+     * @brief Get number of polls that returned changes
+     *
+     * @return Poll hit count
+     */
+    int32 PollHits() const { return fHits; }
+
+    /**
+     * @brief Get fraction of polls that returned changes
+     *
+     * @return Ratio between 0 and 1
+     */
+    float HitRatio() const
+        { return fPolls > 0 ? (float)fHits / fPolls : 0.0f; }
+
+    static const bigtime_t kDefaultMinInterval; ///< 5 seconds
+    static const bigtime_t kDefaultMaxInterval; ///< 5 minutes
+    static const int32 kFastPolls;              ///< Fast polls after activity
+
+private:
+    bigtime_t fMinInterval;     ///< Shortest interval
+    bigtime_t fMaxInterval;     ///< Longest interval
+    bigtime_t fInterval;        ///< Current interval
+    int32 fFastPollsLeft;       ///< Empty polls before backing off
+    int32 fPolls;               ///< Recorded polls
+    int32 fHits;                ///< Polls with changes
+};
+
+} // namespace OneDrive
+
+#endif // ADAPTIVE_POLLER_H
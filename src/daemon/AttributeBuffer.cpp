@@ -0,0 +1,92 @@
+/**
+ * @file AttributeBuffer.cpp
+ * @brief Implementation of the attribute read buffer
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "AttributeBuffer.h"
+
+#include <stdlib.h>
+
+using namespace OneDrive;
+
+const size_t AttributeBuffer::kInlineSize;
+
+/**
+ * @brief Constructor
+ */
+AttributeBuffer::AttributeBuffer()
+    : fHeap(NULL),
+      fHeapSize(0),
+      fAllocations(0)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+AttributeBuffer::~AttributeBuffer()
+{
+    free(fHeap);
+}
+
+/**
+ * @brief Get memory for a value
+ */
+void*
+AttributeBuffer::Reserve(size_t size)
+{
+    if (size <= kInlineSize) {
+        return fInline;
+    }
+
+    if (size > fHeapSize) {
+        // Double at least, so a run of growing values allocates seldom
+        size_t heapSize = fHeapSize > kInlineSize ? fHeapSize * 2
+            : kInlineSize * 4;
+        while (heapSize < size) {
+            heapSize *= 2;
+        }
+
+        uint8* heap = static_cast<uint8*>(malloc(heapSize));
+        if (heap == NULL) {
+            return NULL;
+        }
+
+        free(fHeap);
+        fHeap = heap;
+        fHeapSize = heapSize;
+        fAllocations++;
+    }
+    return fHeap;
+}
+
+/**
+ * @brief Get the largest value that fits without allocating
+ */
+size_t
+AttributeBuffer::Capacity() const
+{
+    return fHeapSize > kInlineSize ? fHeapSize : kInlineSize;
+}
+
+/**
+ * @brief Count heap allocations since construction
+ */
+int32
+AttributeBuffer::CountAllocations() const
+{
+    return fAllocations;
+}
+
+/**
+ * @brief Get the buffer of the calling thread
+ */
+AttributeBuffer&
+AttributeBuffer::ForThread()
+{
+    static thread_local AttributeBuffer sBuffer;
+    return sBuffer;
+}
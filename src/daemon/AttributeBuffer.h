@@ -0,0 +1,169 @@
+/**
+ * @file AttributeBuffer.h
+ * @brief Reusable read buffer and zero-copy views of attribute values
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Reading the attributes of a file used to allocate, copy and free every
+ * value. Nearly all of them are a few bytes to a few hundred: a MIME type,
+ * a rating, a caption. An AttributeBuffer keeps such values in place and
+ * grows a heap block only for larger ones, which it then keeps for the
+ * next read; an AttributeView points at the value where it was read.
+ */
+
+#ifndef ATTRIBUTE_BUFFER_H
+#define ATTRIBUTE_BUFFER_H
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <fs_attr.h>
+
+#include <functional>
+
+namespace OneDrive {
+
+/**
+ * @brief An attribute value where it was read, without a copy
+ *
+ * The view is only valid during the call it is passed to; whoever needs
+ * the value longer copies it.
+ */
+struct AttributeView {
+    const char* name;               ///< Attribute name
+    type_code type;                 ///< Attribute type
+    const void* data;               ///< Attribute data
+    size_t size;                    ///< Bytes of data
+};
+
+/**
+ * @brief Called for every attribute of a file
+ */
+typedef std::function<void(const AttributeView& attribute)> AttributeVisitor;
+
+/**
+ * @brief The attributes of one file, read one after the other
+ *
+ * The calls are those of BNode, which AttributeManager reads through
+ * unless it was given an AttributeSource.
+ */
+class AttributeReader {
+public:
+    /**
+     * @brief Destructor
+     */
+    virtual ~AttributeReader() {}
+
+    /**
+     * @brief Check that the file could be opened
+     *
+     * @return B_OK, or the error opening it
+     */
+    virtual status_t InitCheck() const = 0;
+
+    /**
+     * @brief Get the name of the next attribute
+     *
+     * @param name Receives the name, B_ATTR_NAME_LENGTH bytes
+     * @return B_OK, or an error after the last attribute
+     */
+    virtual status_t GetNextAttrName(char* name) = 0;
+
+    /**
+     * @brief Get the type and size of an attribute
+     *
+     * @param name Attribute name
+     * @param info Receives type and size
+     * @return B_OK on success
+     */
+    virtual status_t GetAttrInfo(const char* name, attr_info* info) = 0;
+
+    /**
+     * @brief Read the value of an attribute
+     *
+     * @param name Attribute name
+     * @param type Attribute type
+     * @param offset Where in the value to start
+     * @param buffer Receives the value
+     * @param size Bytes to read
+     * @return Bytes read, or an error
+     */
+    virtual ssize_t ReadAttr(const char* name, type_code type, off_t offset,
+                             void* buffer, size_t size) = 0;
+};
+
+/**
+ * @brief Opens the attributes of a file; the caller deletes the reader
+ */
+typedef std::function<AttributeReader*(const BString& path)> AttributeSource;
+
+/**
+ * @brief A read buffer with inline storage for small values
+ *
+ * Reserve() hands out the inline storage for values of up to kInlineSize
+ * bytes, and otherwise a heap block that only ever grows. Each thread
+ * has one, from ForThread(), so reading needs neither a lock nor an
+ * allocation once the largest value has been seen.
+ *
+ * The memory from Reserve() is valid until the next call.
+ *
+ * @see AttributeManager
+ * @since 1.0.0
+ */
+class AttributeBuffer {
+public:
+    /**
+     * @brief Constructor
+     */
+    AttributeBuffer();
+
+    /**
+     * @brief Destructor
+     */
+    ~AttributeBuffer();
+
+    /**
+     * @brief Get memory for a value
+     *
+     * @param size Bytes needed
+     * @return The memory, or NULL if it could not be allocated
+     */
+    void* Reserve(size_t size);
+
+    /**
+     * @brief Get the largest value that fits without allocating
+     *
+     * @return Bytes
+     */
+    size_t Capacity() const;
+
+    /**
+     * @brief Count heap allocations since construction
+     *
+     * @return Number of allocations
+     */
+    int32 CountAllocations() const;
+
+    /**
+     * @brief Get the buffer of the calling thread
+     *
+     * @return The buffer, freed when the thread exits
+     */
+    static AttributeBuffer& ForThread();
+
+    static const size_t kInlineSize = 256;  ///< Bytes stored inline
+
+private:
+    AttributeBuffer(const AttributeBuffer& other);
+    AttributeBuffer& operator=(const AttributeBuffer& other);
+
+private:
+    uint8 fInline[kInlineSize];         ///< Storage for small values
+    uint8* fHeap;                       ///< Storage for larger ones
+    size_t fHeapSize;                   ///< Bytes at fHeap
+    int32 fAllocations;                 ///< Heap allocations made
+};
+
+} // namespace OneDrive
+
+#endif // ATTRIBUTE_BUFFER_H
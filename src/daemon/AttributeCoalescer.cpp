@@ -0,0 +1,258 @@
+/**
+ * @file AttributeCoalescer.cpp
+ * @brief Implementation of attribute change coalescing and diffing
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "AttributeCoalescer.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+using namespace OneDrive;
+
+const bigtime_t AttributeCoalescer::kDefaultQuietTime = 250000;
+const bigtime_t AttributeCoalescer::kDefaultMaxDelay = 2000000;
+
+/**
+ * @brief Constructor
+ */
+AttributeCoalescer::AttributeCoalescer(bigtime_t quietTime,
+    bigtime_t maxDelay)
+    : fLock("AttributeCoalescer Lock"),
+      fQuietTime(quietTime),
+      fMaxDelay(maxDelay),
+      fBusySince(0)
+{
+    memset(&fStats, 0, sizeof(fStats));
+}
+
+/**
+ * @brief Destructor
+ */
+AttributeCoalescer::~AttributeCoalescer()
+{
+}
+
+/**
+ * @brief Add a change notification
+ */
+void
+AttributeCoalescer::Add(const BString& path, const BString& attribute,
+    bigtime_t now)
+{
+    BAutolock lock(fLock);
+
+    fStats.changes++;
+
+    std::map<BString, Pending>::iterator found = fPending.find(path);
+    if (found == fPending.end()) {
+        Pending pending;
+        pending.first = now;
+        pending.changes = 0;
+        pending.due = fDue.end();
+        found = fPending.insert(std::make_pair(path, pending)).first;
+    }
+
+    Pending& pending = found->second;
+    if (!attribute.IsEmpty()) {
+        pending.names.insert(attribute);
+    }
+    pending.changes++;
+
+    // Each change pushes the end back, up to the maximum delay
+    bigtime_t due = now + fQuietTime;
+    if (due > pending.first + fMaxDelay) {
+        due = pending.first + fMaxDelay;
+    }
+    if (pending.due != fDue.end()) {
+        fDue.erase(pending.due);
+    }
+    pending.due = fDue.insert(std::make_pair(due, path));
+}
+
+/**
+ * @brief Take the file whose burst ended first, of those not taken
+ */
+bool
+AttributeCoalescer::TakeDue(bigtime_t now, AttributeBurst& burst)
+{
+    BAutolock lock(fLock);
+
+    // Taken files are skipped; there are no more of them than workers
+    DueIndex::iterator due = fDue.begin();
+    while (due != fDue.end() && due->first <= now
+        && fTaken.find(due->second) != fTaken.end()) {
+        due++;
+    }
+    if (due == fDue.end() || due->first > now) {
+        return false;
+    }
+
+    std::map<BString, Pending>::iterator found = fPending.find(due->second);
+    fDue.erase(due);
+
+    burst.path = found->first;
+    burst.names.assign(found->second.names.begin(),
+        found->second.names.end());
+    burst.changes = found->second.changes;
+    fPending.erase(found);
+
+    if (fTaken.empty()) {
+        fBusySince = now;
+    }
+    fTaken.insert(burst.path);
+
+    fStats.bursts++;
+    return true;
+}
+
+/**
+ * @brief Release a taken file
+ */
+void
+AttributeCoalescer::Done(const BString& path, bigtime_t now)
+{
+    BAutolock lock(fLock);
+
+    if (fTaken.erase(path) == 0) {
+        return;
+    }
+
+    fStats.completed++;
+    if (fTaken.empty()) {
+        fStats.busyTime += now - fBusySince;
+    }
+}
+
+/**
+ * @brief Get the time the next burst of a file not taken ends
+ */
+bigtime_t
+AttributeCoalescer::NextDue() const
+{
+    BAutolock lock(fLock);
+
+    for (DueIndex::const_iterator due = fDue.begin(); due != fDue.end();
+            due++) {
+        if (fTaken.find(due->second) == fTaken.end()) {
+            return due->first;
+        }
+    }
+    return B_INFINITE_TIMEOUT;
+}
+
+/**
+ * @brief Fingerprint an attribute value
+ */
+uint64
+AttributeCoalescer::Fingerprint(type_code type, const void* data, size_t size)
+{
+    const uint64 kPrime = 0x100000001b3ULL;
+    uint64 hash = 0xcbf29ce484222325ULL;
+
+    for (int32 i = 0; i < 4; i++) {
+        hash = (hash ^ ((type >> (8 * i)) & 0xff)) * kPrime;
+    }
+
+    const uint8* bytes = static_cast<const uint8*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * kPrime;
+    }
+    return hash;
+}
+
+/**
+ * @brief Compare a file's attributes with its last upload
+ */
+void
+AttributeCoalescer::Diff(const BString& path,
+    const AttributeFingerprints& current, std::vector<BString>& changed,
+    std::vector<BString>& removed) const
+{
+    BAutolock lock(fLock);
+
+    changed.clear();
+    removed.clear();
+
+    std::map<BString, AttributeFingerprints>::const_iterator found
+        = fUploaded.find(path);
+    if (found == fUploaded.end()) {
+        for (AttributeFingerprints::const_iterator it = current.begin();
+                it != current.end(); it++) {
+            changed.push_back(it->first);
+        }
+        return;
+    }
+
+    // Both sides are sorted by name: one merge pass
+    const AttributeFingerprints& uploaded = found->second;
+    AttributeFingerprints::const_iterator now = current.begin();
+    AttributeFingerprints::const_iterator then = uploaded.begin();
+    while (now != current.end() || then != uploaded.end()) {
+        if (then == uploaded.end()
+            || (now != current.end() && now->first < then->first)) {
+            changed.push_back(now->first);
+            now++;
+        } else if (now == current.end() || then->first < now->first) {
+            removed.push_back(then->first);
+            then++;
+        } else {
+            if (now->second != then->second) {
+                changed.push_back(now->first);
+            }
+            now++;
+            then++;
+        }
+    }
+}
+
+/**
+ * @brief Record the attributes of a file as uploaded
+ */
+void
+AttributeCoalescer::Commit(const BString& path,
+    const AttributeFingerprints& uploaded)
+{
+    BAutolock lock(fLock);
+    fUploaded[path] = uploaded;
+}
+
+/**
+ * @brief Forget a file's pending changes and uploaded state
+ */
+void
+AttributeCoalescer::Forget(const BString& path)
+{
+    BAutolock lock(fLock);
+
+    std::map<BString, Pending>::iterator found = fPending.find(path);
+    if (found != fPending.end()) {
+        fDue.erase(found->second.due);
+        fPending.erase(found);
+    }
+    fUploaded.erase(path);
+}
+
+/**
+ * @brief Get the coalescing counters
+ */
+AttributeCoalescerStats
+AttributeCoalescer::Stats(bigtime_t now) const
+{
+    BAutolock lock(fLock);
+
+    AttributeCoalescerStats stats = fStats;
+    stats.pending = fPending.size();
+    stats.active = fTaken.size();
+    if (!fTaken.empty()) {
+        stats.busyTime += now - fBusySince;
+    }
+    if (stats.busyTime > 0) {
+        stats.drainRate = stats.completed * 1000000.0f / stats.busyTime;
+    }
+    return stats;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file AttributeCoalescer.h
+ * @brief Per-file coalescing of attribute changes and diffs to the last upload
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Applications such as Tracker write several attributes of a file in a
+ * burst, each one a change notification of its own. The AttributeCoalescer
+ * holds a file back until its burst is over, so it is uploaded once, and
+ * remembers a fingerprint of every attribute uploaded, so a file whose
+ * attributes all match their last upload is not sent again.
+ */
+
+#ifndef ATTRIBUTE_COALESCER_H
+#define ATTRIBUTE_COALESCER_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace OneDrive {
+
+/**
+ * @brief Fingerprints of a file's attributes by attribute name
+ */
+typedef std::map<BString, uint64> AttributeFingerprints;
+
+/**
+ * @brief A file whose burst of attribute changes is over
+ */
+struct AttributeBurst {
+    BString path;                   ///< Local path of the file
+    std::vector<BString> names;     ///< Attributes reported changed
+    int32 changes;                  ///< Change notifications coalesced
+};
+
+/**
+ * @brief Coalescing counters
+ */
+struct AttributeCoalescerStats {
+    int32 changes;                  ///< Change notifications added
+    int32 bursts;                   ///< Bursts handed out
+    int32 completed;                ///< Bursts reported done
+    int32 pending;                  ///< Files waiting for their burst to end
+    int32 active;                   ///< Files taken and not done yet
+    bigtime_t busyTime;             ///< Time with at least one file taken
+    float drainRate;                ///< Files done per second of busy time
+};
+
+/**
+ * @brief Burst windows per file, and fingerprints of the last upload
+ *
+ * A file's burst ends once no change has arrived for the quiet time, or
+ * at the latest the maximum delay after its first change, so a file
+ * rewritten without pause is still uploaded. Changes arriving after its
+ * burst was taken start a new one.
+ *
+ * Several workers may take bursts. A file stays taken until Done() is
+ * called for it, and its next burst is not handed out before, so the
+ * uploads of one file never overlap or pass each other.
+ *
+ * Fingerprints are 64-bit FNV-1a hashes over type and data. Diff() compares
+ * the current attributes of a file with those of its last Commit(); a file
+ * never committed has all its attributes changed.
+ *
+ * @see AttributeManager
+ * @since 1.0.0
+ */
+class AttributeCoalescer {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param quietTime Time without changes that ends a burst
+     * @param maxDelay Longest time a file is held back
+     */
+    explicit AttributeCoalescer(bigtime_t quietTime = kDefaultQuietTime,
+                                bigtime_t maxDelay = kDefaultMaxDelay);
+
+    /**
+     * @brief Destructor
+     */
+    ~AttributeCoalescer();
+
+    /**
+     * @brief Add a change notification
+     *
+     * @param path Local path of the file
+     * @param attribute Name of the changed attribute
+     * @param now Current system time
+     */
+    void Add(const BString& path, const BString& attribute, bigtime_t now);
+
+    /**
+     * @brief Take the file whose burst ended first, of those not taken
+     *
+     * @param now Current system time
+     * @param burst Receives the file and its changes
+     * @return false if no burst has ended
+     */
+    bool TakeDue(bigtime_t now, AttributeBurst& burst);
+
+    /**
+     * @brief Release a taken file
+     *
+     * @param path Local path of the file
+     * @param now Current system time
+     */
+    void Done(const BString& path, bigtime_t now);
+
+    /**
+     * @brief Get the time the next burst of a file not taken ends
+     *
+     * @return System time, or B_INFINITE_TIMEOUT if there is none
+     */
+    bigtime_t NextDue() const;
+
+    /**
+     * @brief Fingerprint an attribute value
+     *
+     * @param type Attribute type
+     * @param data Attribute data
+     * @param size Bytes of data
+     * @return 64-bit fingerprint
+     */
+    static uint64 Fingerprint(type_code type, const void* data, size_t size);
+
+    /**
+     * @brief Compare a file's attributes with its last upload
+     *
+     * @param path Local path of the file
+     * @param current Fingerprints of the attributes it has now
+     * @param changed Receives attributes new or different since
+     * @param removed Receives attributes gone since
+     */
+    void Diff(const BString& path, const AttributeFingerprints& current,
+              std::vector<BString>& changed,
+              std::vector<BString>& removed) const;
+
+    /**
+     * @brief Record the attributes of a file as uploaded
+     *
+     * @param path Local path of the file
+     * @param uploaded Fingerprints of all its attributes
+     */
+    void Commit(const BString& path, const AttributeFingerprints& uploaded);
+
+    /**
+     * @brief Forget a file's pending changes and uploaded state
+     *
+     * @param path Local path of the file
+     */
+    void Forget(const BString& path);
+
+    /**
+     * @brief Get the coalescing counters
+     *
+     * @param now Current system time, to count ongoing busy time
+     * @return Counters since construction
+     */
+    AttributeCoalescerStats Stats(bigtime_t now) const;
+
+    static const bigtime_t kDefaultQuietTime;   ///< 250 ms
+    static const bigtime_t kDefaultMaxDelay;    ///< 2 s
+
+private:
+    typedef std::multimap<bigtime_t, BString> DueIndex;
+
+    /**
+     * @brief A file in a burst
+     */
+    struct Pending {
+        bigtime_t first;                ///< First change of the burst
+        std::set<BString> names;        ///< Attributes changed
+        int32 changes;                  ///< Notifications
+        DueIndex::iterator due;         ///< Entry in fDue
+    };
+
+private:
+    mutable BLocker fLock;              ///< Protects everything below
+    bigtime_t fQuietTime;               ///< Quiet time ending a burst
+    bigtime_t fMaxDelay;                ///< Longest hold of a file
+    std::map<BString, Pending> fPending; ///< Files in a burst by path
+    DueIndex fDue;                      ///< Files in a burst by end time
+    std::set<BString> fTaken;           ///< Files being worked on
+    bigtime_t fBusySince;               ///< When fTaken last became non-empty
+    std::map<BString, AttributeFingerprints> fUploaded; ///< Last uploads
+    AttributeCoalescerStats fStats;     ///< Counters
+};
+
+} // namespace OneDrive
+
+#endif // ATTRIBUTE_COALESCER_H
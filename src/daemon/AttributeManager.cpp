@@ -28,9 +28,62 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <memory>
+
 // Global node monitor handler
 static AttributeManager* sAttributeManager = nullptr;
 
+// Map an API error to a status code
+static status_t
+StatusForError(OneDriveError error)
+{
+    switch (error) {
+        case ONEDRIVE_OK:
+            return B_OK;
+        case ONEDRIVE_AUTH_ERROR:
+            return B_NOT_ALLOWED;
+        case ONEDRIVE_NETWORK_ERROR:
+            return B_DEVICE_NOT_FOUND;
+        case ONEDRIVE_FILE_NOT_FOUND:
+            return B_ENTRY_NOT_FOUND;
+        default:
+            return B_ERROR;
+    }
+}
+
+// Attributes of a file on disk
+class NodeAttributeReader : public OneDrive::AttributeReader {
+public:
+    explicit NodeAttributeReader(const BString& path)
+        : fNode(path.String())
+    {
+    }
+    
+    virtual status_t InitCheck() const
+    {
+        return fNode.InitCheck();
+    }
+    
+    virtual status_t GetNextAttrName(char* name)
+    {
+        return fNode.GetNextAttrName(name);
+    }
+    
+    virtual status_t GetAttrInfo(const char* name, attr_info* info)
+    {
+        return fNode.GetAttrInfo(name, info);
+    }
+    
+    virtual ssize_t ReadAttr(const char* name, type_code type, off_t offset,
+                             void* buffer, size_t size)
+    {
+        return fNode.ReadAttr(name, type, offset, buffer, size);
+    }
+    
+private:
+    BNode fNode;
+};
+
 //
 // BFSAttribute Implementation
 //
@@ -53,6 +106,16 @@ BFSAttribute::BFSAttribute(const BFSAttribute& other)
     CopyFrom(other);
 }
 
+BFSAttribute::BFSAttribute(BFSAttribute&& other)
+    : name(other.name)
+    , type(other.type)
+    , size(0)
+    , data(nullptr)
+    , modificationTime(other.modificationTime)
+{
+    MoveFrom(other);
+}
+
 BFSAttribute& BFSAttribute::operator=(const BFSAttribute& other)
 {
     if (this != &other) {
@@ -65,6 +128,17 @@ BFSAttribute& BFSAttribute::operator=(const BFSAttribute& other)
     return *this;
 }
 
+BFSAttribute& BFSAttribute::operator=(BFSAttribute&& other)
+{
+    if (this != &other) {
+        name = other.name;
+        type = other.type;
+        modificationTime = other.modificationTime;
+        MoveFrom(other);
+    }
+    return *this;
+}
+
 BFSAttribute::~BFSAttribute()
 {
     Clear();
@@ -74,20 +148,72 @@ void BFSAttribute::CopyFrom(const BFSAttribute& source)
 {
     Clear();
     if (source.data && source.size > 0) {
-        data = malloc(source.size);
-        if (data) {
-            memcpy(data, source.data, source.size);
-            size = source.size;
-        }
+        SetData(source.data, source.size);
     }
 }
 
-void BFSAttribute::Clear()
+void BFSAttribute::MoveFrom(BFSAttribute& source)
 {
+    Clear();
+    if (source.data == nullptr || source.size == 0) {
+        source.Clear();
+        return;
+    }
+    
+    if (source.data == source.inlineData) {
+        // Inline values are copied; at most kInlineSize bytes
+        memcpy(inlineData, source.inlineData, source.size);
+        data = inlineData;
+    } else {
+        data = source.data;
+    }
+    size = source.size;
+    
+    source.data = nullptr;
+    source.size = 0;
+}
+
+void* BFSAttribute::Allocate(size_t bytes)
+{
+    Clear();
+    if (bytes == 0) {
+        return nullptr;
+    }
+    
+    data = bytes <= sizeof(inlineData) ? inlineData : malloc(bytes);
     if (data) {
+        size = bytes;
+    }
+    return data;
+}
+
+status_t BFSAttribute::SetData(const void* source, size_t bytes)
+{
+    if (bytes == 0) {
+        Clear();
+        return B_OK;
+    }
+    
+    void* target = Allocate(bytes);
+    if (!target) {
+        return B_NO_MEMORY;
+    }
+    memcpy(target, source, bytes);
+    return B_OK;
+}
+
+OneDrive::AttributeView BFSAttribute::View() const
+{
+    OneDrive::AttributeView view = { name.String(), (type_code)type, data, size };
+    return view;
+}
+
+void BFSAttribute::Clear()
+{
+    if (data && data != inlineData) {
         free(data);
-        data = nullptr;
     }
+    data = nullptr;
     size = 0;
 }
 
@@ -101,6 +227,14 @@ AttributeChange::AttributeChange()
 {
 }
 
+AttributeChange::AttributeChange(const AttributeChange& other) = default;
+
+AttributeChange::AttributeChange(AttributeChange&& other) = default;
+
+AttributeChange& AttributeChange::operator=(const AttributeChange& other) = default;
+
+AttributeChange& AttributeChange::operator=(AttributeChange&& other) = default;
+
 AttributeChange::~AttributeChange()
 {
     // BFSAttribute destructors handle cleanup
@@ -114,7 +248,6 @@ AttributeManager::AttributeManager()
     : fAPIClient(nullptr)
     , fLock("AttributeManager")
     , fMonitoringActive(false)
-    , fProcessorThread(-1)
     , fProcessorSemaphore(-1)
     , fShuttingDown(false)
 {
@@ -144,22 +277,29 @@ status_t AttributeManager::Initialize(OneDriveAPI* apiClient)
         return fProcessorSemaphore;
     }
     
-    // Start change processing thread
-    fProcessorThread = spawn_thread(_ChangeProcessorThread, "AttributeProcessor", 
-                                   B_NORMAL_PRIORITY, this);
-    if (fProcessorThread < 0) {
-        delete_sem(fProcessorSemaphore);
-        fProcessorSemaphore = -1;
-        return fProcessorThread;
+    // Uploads wait on round trips: run as many as the API lets requests
+    // run at once, leaving the budget to transfers beyond kMaxWorkers
+    int32 workers = fAPIClient->GetMaxConcurrentRequests();
+    if (workers > kMaxWorkers) {
+        workers = kMaxWorkers;
     }
     
-    status_t result = resume_thread(fProcessorThread);
-    if (result != B_OK) {
-        kill_thread(fProcessorThread);
+    for (int32 i = 0; i < workers; i++) {
+        thread_id thread = spawn_thread(_WorkerThread, "AttributeWorker",
+                                        B_NORMAL_PRIORITY, this);
+        if (thread < 0 || resume_thread(thread) != B_OK) {
+            if (thread >= 0) {
+                kill_thread(thread);
+            }
+            break;
+        }
+        fWorkerThreads.push_back(thread);
+    }
+    
+    if (fWorkerThreads.empty()) {
         delete_sem(fProcessorSemaphore);
-        fProcessorThread = -1;
         fProcessorSemaphore = -1;
-        return result;
+        return B_NO_MORE_THREADS;
     }
     
     return B_OK;
@@ -167,25 +307,30 @@ status_t AttributeManager::Initialize(OneDriveAPI* apiClient)
 
 status_t AttributeManager::Shutdown()
 {
-    BAutolock autolock(fLock);
-    
-    fShuttingDown = true;
-    
-    // Stop all monitoring
-    StopAllMonitoring();
-    
-    // Signal processor thread to exit
-    if (fProcessorSemaphore >= 0) {
-        release_sem(fProcessorSemaphore);
+    std::vector<thread_id> workers;
+    {
+        BAutolock autolock(fLock);
+        
+        fShuttingDown = true;
+        
+        // Stop all monitoring
+        StopAllMonitoring();
+        
+        // Signal every worker to exit
+        workers.swap(fWorkerThreads);
+        if (fProcessorSemaphore >= 0 && !workers.empty()) {
+            release_sem_etc(fProcessorSemaphore, workers.size(), 0);
+        }
     }
     
-    // Wait for processor thread to exit
-    if (fProcessorThread >= 0) {
+    // Workers take the lock to collect changes: wait without it
+    for (size_t i = 0; i < workers.size(); i++) {
         status_t exitValue;
-        wait_for_thread(fProcessorThread, &exitValue);
-        fProcessorThread = -1;
+        wait_for_thread(workers[i], &exitValue);
     }
     
+    BAutolock autolock(fLock);
+    
     // Clean up semaphore
     if (fProcessorSemaphore >= 0) {
         delete_sem(fProcessorSemaphore);
@@ -200,70 +345,89 @@ status_t AttributeManager::Shutdown()
 
 status_t AttributeManager::ReadAttributes(const BString& filePath, BMessage& attributes)
 {
-    BNode node(filePath.String());
-    status_t result = node.InitCheck();
+    attributes.MakeEmpty();
+    
+    // Values go from the read buffer straight into the message
+    return VisitAttributes(filePath, [&attributes](const OneDrive::AttributeView& attribute) {
+        switch (attribute.type) {
+            case ATTR_TYPE_STRING:
+                attributes.AddString(attribute.name, (const char*)attribute.data);
+                break;
+            case ATTR_TYPE_INT32:
+                attributes.AddInt32(attribute.name, *(const int32*)attribute.data);
+                break;
+            case ATTR_TYPE_INT64:
+                attributes.AddInt64(attribute.name, *(const int64*)attribute.data);
+                break;
+            case ATTR_TYPE_FLOAT:
+                attributes.AddFloat(attribute.name, *(const float*)attribute.data);
+                break;
+            case ATTR_TYPE_DOUBLE:
+                attributes.AddDouble(attribute.name, *(const double*)attribute.data);
+                break;
+            case ATTR_TYPE_BOOL:
+                attributes.AddBool(attribute.name, *(const bool*)attribute.data);
+                break;
+            case ATTR_TYPE_RAW:
+            default:
+                attributes.AddData(attribute.name, attribute.type,
+                                 attribute.data, attribute.size);
+                break;
+        }
+    });
+}
+
+status_t AttributeManager::VisitAttributes(const BString& filePath, const OneDrive::AttributeVisitor& visitor)
+{
+    if (fAttributeSource) {
+        std::unique_ptr<OneDrive::AttributeReader> reader(fAttributeSource(filePath));
+        if (!reader) {
+            return B_ENTRY_NOT_FOUND;
+        }
+        return _VisitAttributes(*reader, visitor);
+    }
+    
+    NodeAttributeReader reader(filePath);
+    return _VisitAttributes(reader, visitor);
+}
+
+void AttributeManager::SetAttributeSource(const OneDrive::AttributeSource& source)
+{
+    fAttributeSource = source;
+}
+
+status_t AttributeManager::_VisitAttributes(OneDrive::AttributeReader& reader,
+                                            const OneDrive::AttributeVisitor& visitor)
+{
+    status_t result = reader.InitCheck();
     if (result != B_OK) {
         return result;
     }
     
-    attributes.MakeEmpty();
+    // One buffer per thread: after the largest value, reading allocates nothing
+    OneDrive::AttributeBuffer& buffer = OneDrive::AttributeBuffer::ForThread();
     
     // Iterate through all attributes
     char attributeName[B_ATTR_NAME_LENGTH];
-    while (node.GetNextAttrName(attributeName) == B_OK) {
-        BFSAttribute attribute;
-        attribute.name = attributeName;
-        
-        // Get attribute info
-        attr_info info;
-        result = node.GetAttrInfo(attributeName, &info);
-        if (result != B_OK) {
+    attr_info info;
+    while (reader.GetNextAttrName(attributeName) == B_OK) {
+        // Type and size are only known from the info
+        if (reader.GetAttrInfo(attributeName, &info) != B_OK || info.size <= 0) {
             continue;
         }
         
-        attribute.type = (BFSAttributeType)info.type;
-        attribute.size = info.size;
+        void* data = buffer.Reserve(info.size);
+        if (!data) {
+            return B_NO_MEMORY;
+        }
         
-        // Read attribute data
-        if (info.size > 0) {
-            attribute.data = malloc(info.size);
-            if (attribute.data) {
-                ssize_t bytesRead = node.ReadAttr(attributeName, info.type, 0, 
-                                                 attribute.data, info.size);
-                if (bytesRead != (ssize_t)info.size) {
-                    free(attribute.data);
-                    attribute.data = nullptr;
-                    continue;
-                }
-                
-                // Add to message based on type
-                switch (attribute.type) {
-                    case ATTR_TYPE_STRING:
-                        attributes.AddString(attributeName, (const char*)attribute.data);
-                        break;
-                    case ATTR_TYPE_INT32:
-                        attributes.AddInt32(attributeName, *(int32*)attribute.data);
-                        break;
-                    case ATTR_TYPE_INT64:
-                        attributes.AddInt64(attributeName, *(int64*)attribute.data);
-                        break;
-                    case ATTR_TYPE_FLOAT:
-                        attributes.AddFloat(attributeName, *(float*)attribute.data);
-                        break;
-                    case ATTR_TYPE_DOUBLE:
-                        attributes.AddDouble(attributeName, *(double*)attribute.data);
-                        break;
-                    case ATTR_TYPE_BOOL:
-                        attributes.AddBool(attributeName, *(bool*)attribute.data);
-                        break;
-                    case ATTR_TYPE_RAW:
-                    default:
-                        attributes.AddData(attributeName, attribute.type, 
-                                         attribute.data, attribute.size);
-                        break;
-                }
-            }
+        ssize_t bytesRead = reader.ReadAttr(attributeName, info.type, 0, data, info.size);
+        if (bytesRead != (ssize_t)info.size) {
+            continue;
         }
+        
+        OneDrive::AttributeView attribute = { attributeName, info.type, data, (size_t)info.size };
+        visitor(attribute);
     }
     
     return B_OK;
@@ -312,13 +476,11 @@ status_t AttributeManager::ReadAttribute(const BString& filePath, const BString&
     attribute.Clear();
     attribute.name = attributeName;
     attribute.type = (BFSAttributeType)info.type;
-    attribute.size = info.size;
     attribute.modificationTime = real_time_clock();
     
     // Read attribute data
     if (info.size > 0) {
-        attribute.data = malloc(info.size);
-        if (!attribute.data) {
+        if (!attribute.Allocate(info.size)) {
             return B_NO_MEMORY;
         }
         
@@ -431,6 +593,15 @@ status_t AttributeManager::StopAllMonitoring()
     return B_OK;
 }
 
+void AttributeManager::QueueAttributeChange(const BString& filePath, const BString& attributeName)
+{
+    AttributeChange* change = new AttributeChange();
+    change->filePath = filePath;
+    change->attributeName = attributeName;
+    change->changeType = ATTR_MODIFIED;
+    _QueueAttributeChange(change);
+}
+
 int32 AttributeManager::GetPendingChanges(BList& changes)
 {
     BAutolock autolock(fLock);
@@ -452,6 +623,23 @@ bool AttributeManager::HasPendingChanges() const
     return !fChangeQueue.empty();
 }
 
+AttributeSyncStats AttributeManager::GetSyncStats() const
+{
+    OneDrive::AttributeCoalescerStats coalescer = fCoalescer.Stats(system_time());
+    
+    BAutolock autolock(const_cast<BLocker&>(fLock));
+    
+    AttributeSyncStats stats;
+    stats.queuedChanges = fChangeQueue.size();
+    stats.pendingFiles = coalescer.pending;
+    stats.activeFiles = coalescer.active;
+    stats.backlog = stats.queuedChanges + coalescer.pending + coalescer.active;
+    stats.workers = fWorkerThreads.size();
+    stats.uploadedFiles = coalescer.completed;
+    stats.drainRate = coalescer.drainRate;
+    return stats;
+}
+
 void AttributeManager::ClearPendingChanges()
 {
     BAutolock autolock(fLock);
@@ -532,19 +720,54 @@ status_t AttributeManager::SynchronizeAttributes(const BString& filePath, bool f
     // For now, directly sync the BMessage to OneDrive
     // In the future, we might want to get the OneDrive item ID first
     OneDriveError apiResult = fAPIClient->SyncAttributes(filePath, localAttributes);
+    return StatusForError(apiResult);
+}
+
+status_t AttributeManager::UploadAttributeChanges(const BString& filePath, const BString& itemId)
+{
+    if (!fAPIClient) {
+        return B_NO_INIT;
+    }
     
-    switch (apiResult) {
-        case ONEDRIVE_OK:
-            return B_OK;
-        case ONEDRIVE_AUTH_ERROR:
-            return B_NOT_ALLOWED;
-        case ONEDRIVE_NETWORK_ERROR:
-            return B_DEVICE_NOT_FOUND;
-        case ONEDRIVE_FILE_NOT_FOUND:
-            return B_ENTRY_NOT_FOUND;
-        default:
-            return B_ERROR;
+    // Fingerprint every attribute where it was read; the fingerprints of
+    // the last upload tell whether anything needs sending at all
+    OneDrive::AttributeFingerprints current;
+    BMessage attributes;
+    status_t result = VisitAttributes(filePath,
+        [&current, &attributes](const OneDrive::AttributeView& attribute) {
+            current[attribute.name] = OneDrive::AttributeCoalescer::Fingerprint(
+                attribute.type, attribute.data, attribute.size);
+            attributes.AddData(attribute.name, attribute.type, attribute.data, attribute.size);
+        });
+    if (result != B_OK) {
+        return result;
+    }
+    
+    std::vector<BString> changed;
+    std::vector<BString> removed;
+    fCoalescer.Diff(filePath, current, changed, removed);
+    if (changed.empty() && removed.empty()) {
+        return B_OK;
+    }
+    
+    // The custom properties are replaced as a whole: send the full set,
+    // which also drops the removed attributes remotely
+    BMessage metadata;
+    metadata.AddMessage("attributes", &attributes);
+    
+    BString id(itemId);
+    if (id.IsEmpty()) {
+        OneDriveError lookup = fAPIClient->GetItemIdByPath(filePath, id);
+        if (lookup != ONEDRIVE_OK) {
+            return StatusForError(lookup);
+        }
+    }
+    
+    result = StatusForError(fAPIClient->UpdateItemMetadata(id, metadata));
+    if (result == B_OK) {
+        fCoalescer.Commit(filePath, current);
     }
+    return result;
 }
 
 status_t AttributeManager::DetectConflicts(const BString& filePath, bool& hasConflicts, BMessage& conflictDetails)
@@ -725,41 +948,66 @@ status_t AttributeManager::_NodeMonitorHandler(BMessage* message)
     return B_OK;
 }
 
-int32 AttributeManager::_ChangeProcessorThread(void* data)
+int32 AttributeManager::_WorkerThread(void* data)
 {
     AttributeManager* manager = (AttributeManager*)data;
     
     while (!manager->fShuttingDown) {
-        // Wait for changes to process
-        status_t result = acquire_sem(manager->fProcessorSemaphore);
-        if (result != B_OK || manager->fShuttingDown) {
+        // Wait for changes, or for the next burst to be over
+        bigtime_t due = manager->fCoalescer.NextDue();
+        status_t result;
+        if (due == B_INFINITE_TIMEOUT) {
+            result = acquire_sem(manager->fProcessorSemaphore);
+        } else {
+            result = acquire_sem_etc(manager->fProcessorSemaphore, 1,
+                                     B_ABSOLUTE_TIMEOUT, due);
+        }
+        if ((result != B_OK && result != B_TIMED_OUT) || manager->fShuttingDown) {
             break;
         }
         
-        // Process pending changes
+        // Collect new changes into their file's burst
         BList changes;
         int32 count = manager->GetPendingChanges(changes);
+        bigtime_t now = system_time();
         
         for (int32 i = 0; i < count; i++) {
             AttributeChange* change = (AttributeChange*)changes.ItemAt(i);
             if (change) {
-                manager->_ProcessAttributeChange(change);
+                manager->fCoalescer.Add(change->filePath, change->attributeName, now);
                 delete change;
             }
         }
+        
+        // One upload per file whose burst is over; files other workers
+        // have taken wait for them
+        OneDrive::AttributeBurst burst;
+        while (!manager->fShuttingDown
+               && manager->fCoalescer.TakeDue(system_time(), burst)) {
+            // More files are due than this worker takes: wake another
+            if (manager->fCoalescer.NextDue() <= system_time()) {
+                release_sem(manager->fProcessorSemaphore);
+            }
+            
+            manager->_ProcessAttributeBurst(burst);
+            manager->fCoalescer.Done(burst.path, system_time());
+        }
     }
     
     return 0;
 }
 
-void AttributeManager::_ProcessAttributeChange(AttributeChange* change)
+void AttributeManager::_ProcessAttributeBurst(const OneDrive::AttributeBurst& burst)
 {
-    if (!change || !fAPIClient) {
+    if (!fAPIClient) {
         return;
     }
     
-    // Synchronize the changed file's attributes with OneDrive
-    SynchronizeAttributes(change->filePath, true);
+    // Upload only what changed, once for the whole burst
+    status_t result = UploadAttributeChanges(burst.path);
+    if (result == B_ENTRY_NOT_FOUND) {
+        fCoalescer.Forget(burst.path);
+    }
 }
 
 BString AttributeManager::_AttributeTypeToString(BFSAttributeType type)
@@ -901,11 +1149,7 @@ status_t AttributeManager::_CompareAttributes(const BMessage& localAttributes, c
             // Set local value
             conflict->localValue.name = name;
             conflict->localValue.type = (BFSAttributeType)type;
-            conflict->localValue.size = localSize;
-            conflict->localValue.data = malloc(localSize);
-            if (conflict->localValue.data) {
-                memcpy(conflict->localValue.data, localData, localSize);
-            }
+            conflict->localValue.SetData(localData, localSize);
             conflict->localTimestamp = real_time_clock();
             
             conflicts.AddItem(conflict);
@@ -932,20 +1176,12 @@ status_t AttributeManager::_CompareAttributes(const BMessage& localAttributes, c
             // Set local value
             conflict->localValue.name = name;
             conflict->localValue.type = (BFSAttributeType)type;
-            conflict->localValue.size = localSize;
-            conflict->localValue.data = malloc(localSize);
-            if (conflict->localValue.data) {
-                memcpy(conflict->localValue.data, localData, localSize);
-            }
+            conflict->localValue.SetData(localData, localSize);
             
             // Set remote value
             conflict->remoteValue.name = name;
             conflict->remoteValue.type = (BFSAttributeType)remoteType;
-            conflict->remoteValue.size = remoteSize;
-            conflict->remoteValue.data = malloc(remoteSize);
-            if (conflict->remoteValue.data) {
-                memcpy(conflict->remoteValue.data, remoteData, remoteSize);
-            }
+            conflict->remoteValue.SetData(remoteData, remoteSize);
             
             conflicts.AddItem(conflict);
         }
@@ -969,11 +1205,7 @@ status_t AttributeManager::_CompareAttributes(const BMessage& localAttributes, c
             if (remoteAttributes.FindData(name, type, &remoteData, &remoteSize) == B_OK) {
                 conflict->remoteValue.name = name;
                 conflict->remoteValue.type = (BFSAttributeType)type;
-                conflict->remoteValue.size = remoteSize;
-                conflict->remoteValue.data = malloc(remoteSize);
-                if (conflict->remoteValue.data) {
-                    memcpy(conflict->remoteValue.data, remoteData, remoteSize);
-                }
+                conflict->remoteValue.SetData(remoteData, remoteSize);
             }
             conflict->remoteTimestamp = real_time_clock();
             
@@ -23,6 +23,10 @@
 #include <Entry.h>
 #include <fs_attr.h>
 #include <queue>
+#include <vector>
+
+#include "AttributeBuffer.h"
+#include "AttributeCoalescer.h"
 
 // Forward declarations
 class OneDriveAPI;
@@ -56,17 +60,25 @@ enum BFSAttributeType {
 
 /**
  * @brief Single BFS attribute information
+ * 
+ * Values of up to OneDrive::AttributeBuffer::kInlineSize bytes are kept
+ * in inlineData, larger ones on the heap; use Allocate() or SetData()
+ * rather than assigning data. Moving takes over a heap value instead of
+ * copying it.
  */
 struct BFSAttribute {
     BString name;                   ///< Attribute name
     BFSAttributeType type;          ///< Attribute data type
     size_t size;                    ///< Data size in bytes
-    void* data;                     ///< Attribute data (caller owns)
+    void* data;                     ///< Attribute data, inlineData or heap
     time_t modificationTime;        ///< When attribute was last modified
+    uint8 inlineData[OneDrive::AttributeBuffer::kInlineSize]; ///< Storage for small values
     
     BFSAttribute();
     BFSAttribute(const BFSAttribute& other);
+    BFSAttribute(BFSAttribute&& other);
     BFSAttribute& operator=(const BFSAttribute& other);
+    BFSAttribute& operator=(BFSAttribute&& other);
     ~BFSAttribute();
     
     /**
@@ -75,6 +87,33 @@ struct BFSAttribute {
      */
     void CopyFrom(const BFSAttribute& source);
     
+    /**
+     * @brief Take over attribute data, leaving the source empty
+     * @param source Source attribute to move from
+     */
+    void MoveFrom(BFSAttribute& source);
+    
+    /**
+     * @brief Replace the data with uninitialized memory
+     * @param bytes Size of the new data
+     * @return The memory, or NULL if empty or out of memory
+     */
+    void* Allocate(size_t bytes);
+    
+    /**
+     * @brief Replace the data with a copy
+     * @param source Data to copy
+     * @param bytes Size of the data
+     * @return B_OK on success, B_NO_MEMORY if it could not be allocated
+     */
+    status_t SetData(const void* source, size_t bytes);
+    
+    /**
+     * @brief View the value without copying it
+     * @return View valid as long as the attribute is unchanged
+     */
+    OneDrive::AttributeView View() const;
+    
     /**
      * @brief Free allocated data memory
      */
@@ -93,9 +132,26 @@ struct AttributeChange {
     BFSAttribute newValue;          ///< New value (for creations/modifications)
     
     AttributeChange();
+    AttributeChange(const AttributeChange& other);
+    AttributeChange(AttributeChange&& other);
+    AttributeChange& operator=(const AttributeChange& other);
+    AttributeChange& operator=(AttributeChange&& other);
     ~AttributeChange();
 };
 
+/**
+ * @brief Attribute sync backlog and throughput
+ */
+struct AttributeSyncStats {
+    int32 queuedChanges;            ///< Notifications not collected yet
+    int32 pendingFiles;             ///< Files waiting for their burst to end
+    int32 activeFiles;              ///< Files being uploaded
+    int32 backlog;                  ///< Files not uploaded yet, all stages
+    int32 workers;                  ///< Attribute workers
+    int32 uploadedFiles;            ///< Bursts processed
+    float drainRate;                ///< Files processed per busy second
+};
+
 /**
  * @brief Attribute conflict types for resolution
  */
@@ -140,6 +196,10 @@ struct AttributeConflict {
  * asynchronously to avoid blocking file operations. It supports all standard
  * BFS attribute types and provides transparent handling of binary data.
  * 
+ * Changes are processed by a pool of workers, as many as the API's
+ * concurrent request budget allows up to kMaxWorkers. A file is only ever
+ * uploaded by one worker at a time, so its uploads stay in order.
+ * 
  * @see BNode
  * @see OneDriveAPI
  * @see BNodeMonitor
@@ -206,6 +266,33 @@ public:
      */
     status_t ReadAttributes(const BString& filePath, BMessage& attributes);
     
+    /**
+     * @brief Visit all attributes of a file without copying them
+     * 
+     * Each value is read into the calling thread's AttributeBuffer and
+     * passed as a view, valid only during the call; small values need no
+     * allocation at all. Meant for hashing and diffing, where the value
+     * is looked at once.
+     * 
+     * @param filePath Path to the file to read attributes from
+     * @param visitor Called for every attribute
+     * @return B_OK on success, error code on failure
+     * @retval B_OK Attributes read successfully
+     * @retval B_ENTRY_NOT_FOUND File does not exist
+     * @retval B_NO_MEMORY A value too large to buffer
+     */
+    status_t VisitAttributes(const BString& filePath, const OneDrive::AttributeVisitor& visitor);
+    
+    /**
+     * @brief Read attributes from somewhere other than the file system
+     * 
+     * Set before the manager is used; tests read from memory this way.
+     * 
+     * @param source Opens the attributes of a file, or an empty function
+     *        to read through BNode again
+     */
+    void SetAttributeSource(const OneDrive::AttributeSource& source);
+    
     /**
      * @brief Write attributes to a file
      * 
@@ -303,6 +390,18 @@ public:
     
     // Change Queue Management
     
+    /**
+     * @brief Queue a change of one attribute of a file
+     * 
+     * Changes are coalesced per file: the file is uploaded once its burst
+     * of changes is over, with only the attributes that differ from its
+     * last upload.
+     * 
+     * @param filePath Path to the changed file
+     * @param attributeName Name of the changed attribute
+     */
+    void QueueAttributeChange(const BString& filePath, const BString& attributeName);
+    
     /**
      * @brief Get pending attribute changes
      * 
@@ -321,6 +420,13 @@ public:
      */
     bool HasPendingChanges() const;
     
+    /**
+     * @brief Get the backlog and drain rate of attribute sync
+     * 
+     * @return Current backlog and throughput
+     */
+    AttributeSyncStats GetSyncStats() const;
+    
     /**
      * @brief Clear all pending changes
      * 
@@ -375,6 +481,20 @@ public:
      */
     status_t SynchronizeAttributes(const BString& filePath, bool forceUpload = false);
     
+    /**
+     * @brief Upload the attributes of a file that changed since its last upload
+     * 
+     * Reads all attributes and fingerprints them. If any was added,
+     * changed or removed since the last upload, the complete set is sent
+     * in a single metadata PATCH, as it replaces the stored one. Nothing
+     * is sent if nothing differs.
+     * 
+     * @param filePath Path to the file
+     * @param itemId OneDrive item ID, looked up by path if empty
+     * @return B_OK on success, error code on failure
+     */
+    status_t UploadAttributeChanges(const BString& filePath, const BString& itemId = "");
+    
     // Conflict Resolution
     
     /**
@@ -403,6 +523,8 @@ public:
      */
     status_t ResolveConflicts(const BString& filePath, const BMessage& conflictDetails, const BString& strategy);
 
+    static const int32 kMaxWorkers = 4;         ///< Most attribute workers
+
 private:
     /// @name Core Components
     /// @{
@@ -415,9 +537,11 @@ private:
     BList                   fMonitoredPaths;    ///< List of monitored directory paths
     std::queue<AttributeChange*> fChangeQueue;  ///< Queue of pending attribute changes
     bool                    fMonitoringActive;  ///< Whether monitoring is currently active
-    thread_id               fProcessorThread;   ///< Change processing thread ID
+    std::vector<thread_id>  fWorkerThreads;     ///< Attribute sync workers
     sem_id                  fProcessorSemaphore; ///< Semaphore for thread synchronization
     bool                    fShuttingDown;      ///< Shutdown flag for threads
+    OneDrive::AttributeCoalescer fCoalescer;    ///< Burst windows and last uploads per file
+    OneDrive::AttributeSource fAttributeSource; ///< Attribute reads, BNode if empty
     /// @}
     
     /// @name Internal Methods
@@ -433,23 +557,32 @@ private:
     static status_t _NodeMonitorHandler(BMessage* message);
     
     /**
-     * @brief Change processing thread entry point
+     * @brief Attribute worker thread entry point
      * 
-     * Processes queued attribute changes in background thread.
+     * Collects queued changes into per-file bursts and uploads the files
+     * whose burst is over, one at a time.
      * 
      * @param data Pointer to AttributeManager instance
      * @return Thread exit code
      */
-    static int32 _ChangeProcessorThread(void* data);
+    static int32 _WorkerThread(void* data);
     
     /**
-     * @brief Process a single attribute change
+     * @brief Visit all attributes a reader has
      * 
-     * Handles a single queued attribute change, including OneDrive synchronization.
+     * @param reader Attributes of one file
+     * @param visitor Called for every attribute
+     * @return B_OK on success, error code on failure
+     */
+    status_t _VisitAttributes(OneDrive::AttributeReader& reader,
+                              const OneDrive::AttributeVisitor& visitor);
+    
+    /**
+     * @brief Process a file whose burst of attribute changes is over
      * 
-     * @param change Pointer to AttributeChange to process
+     * @param burst File and the changes coalesced for it
      */
-    void _ProcessAttributeChange(AttributeChange* change);
+    void _ProcessAttributeBurst(const OneDrive::AttributeBurst& burst);
     
     /**
      * @brief Convert BFS attribute type to string
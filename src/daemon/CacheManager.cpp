@@ -10,6 +10,7 @@
  */
 
 #include "CacheManager.h"
+#include "../api/QuickXorHash.h"
 #include "../shared/ErrorLogger.h"
 
 #include <algorithm>
@@ -97,6 +98,11 @@ status_t
 CacheManager::CacheFile(const BString& fileId, const BPath& sourcePath,
                        const BPath& originalPath, bool isPinned)
 {
+    // Read the content before locking: lookups need not wait for it
+    off_t size = 0;
+    BEntry(sourcePath.Path()).GetSize(&size);
+    BString checksum = _CalculateChecksum(sourcePath);
+    
     BAutolock lock(fLock);
     
     if (!fInitialized) {
@@ -112,12 +118,22 @@ CacheManager::CacheFile(const BString& fileId, const BPath& sourcePath,
     entry.fileId = fileId;
     entry.localPath = sourcePath;
     entry.originalPath = originalPath;
+    entry.size = size;
     entry.isPinned = isPinned;
     entry.cacheTime = time(NULL);
     entry.lastAccess = entry.cacheTime;
+    entry.lastModified = entry.cacheTime;
+    entry.checksum = checksum;
     entry.accessCount = 1;
     
+    auto it = fEntries.find(fileId);
+    if (it != fEntries.end()) {
+        _UnindexChecksum(it->second);
+    }
     fEntries[fileId] = entry;
+    if (!checksum.IsEmpty()) {
+        fChecksums.insert(std::make_pair(checksum, fileId));
+    }
     
     return B_OK;
 }
@@ -173,6 +189,7 @@ CacheManager::EvictFile(const BString& fileId)
     
     // TODO: Actually delete cached file
     
+    _UnindexChecksum(it->second);
     fEntries.erase(it);
     
     return B_OK;
@@ -399,6 +416,7 @@ CacheManager::ClearCache(bool keepPinned)
         auto it = fEntries.begin();
         while (it != fEntries.end()) {
             if (!it->second.isPinned) {
+                _UnindexChecksum(it->second);
                 it = fEntries.erase(it);
             } else {
                 ++it;
@@ -407,6 +425,7 @@ CacheManager::ClearCache(bool keepPinned)
     } else {
         // Clear everything
         fEntries.clear();
+        fChecksums.clear();
     }
     
     fCurrentCacheSize = 0;
@@ -462,15 +481,40 @@ CacheManager::UpdateCacheEntry(const BString& fileId, const BString& eTag,
     
     auto it = fEntries.find(fileId);
     if (it != fEntries.end()) {
+        _UnindexChecksum(it->second);
         it->second.eTag = eTag;
         it->second.checksum = checksum;
         it->second.lastModified = time(NULL);
+        if (!checksum.IsEmpty()) {
+            fChecksums.insert(std::make_pair(checksum, fileId));
+        }
         return B_OK;
     }
     
     return B_ENTRY_NOT_FOUND;
 }
 
+/**
+ * @brief Find a cached file by content
+ */
+bool
+CacheManager::FindByChecksum(const BString& checksum, off_t size,
+                             CacheEntry& entry)
+{
+    BAutolock lock(fLock);
+    
+    auto range = fChecksums.equal_range(checksum);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto found = fEntries.find(it->second);
+        if (found != fEntries.end() && found->second.size == size) {
+            entry = found->second;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 /**
  * @brief Prefetch files for performance
  */
@@ -650,6 +694,36 @@ CacheManager::_GenerateCachePath(const BString& fileId)
 BString
 CacheManager::_CalculateChecksum(const BPath& path)
 {
-    // TODO: Implement checksum calculation (SHA256)
-    return "";
+    BFile file(path.Path(), B_READ_ONLY);
+    if (file.InitCheck() != B_OK) {
+        return "";
+    }
+    
+    // QuickXorHash, so cached files can be matched with remote ones
+    QuickXorHash hash;
+    const size_t kBufferSize = 64 * 1024;
+    uint8* buffer = new uint8[kBufferSize];
+    
+    ssize_t bytesRead;
+    while ((bytesRead = file.Read(buffer, kBufferSize)) > 0) {
+        hash.Update(buffer, bytesRead);
+    }
+    
+    delete[] buffer;
+    return bytesRead < 0 ? BString() : hash.Base64();
+}
+
+/**
+ * @brief Drop an entry from the checksum index
+ */
+void
+CacheManager::_UnindexChecksum(const CacheEntry& entry)
+{
+    auto range = fChecksums.equal_range(entry.checksum);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == entry.fileId) {
+            fChecksums.erase(it);
+            return;
+        }
+    }
 }
\ No newline at end of file
@@ -281,6 +281,17 @@ public:
     status_t UpdateCacheEntry(const BString& fileId, const BString& eTag,
                              const BString& checksum);
     
+    /**
+     * @brief Find a cached file by content
+     * 
+     * @param checksum QuickXorHash of the content, as OneDrive reports it
+     * @param size Content size in bytes
+     * @param entry Output cache entry
+     * @return true if a cached file had this checksum and size
+     */
+    bool FindByChecksum(const BString& checksum, off_t size,
+                        CacheEntry& entry);
+    
     /**
      * @brief Prefetch files for performance
      * 
@@ -399,11 +410,19 @@ private:
      * @return Checksum string
      */
     BString _CalculateChecksum(const BPath& path);
+    
+    /**
+     * @brief Drop an entry from the checksum index
+     * 
+     * @param entry Entry being replaced or removed
+     */
+    void _UnindexChecksum(const CacheEntry& entry);
 
 private:
     BPath fCachePath;                       ///< Base cache directory
     sqlite3* fDatabase;                     ///< Metadata database
     std::map<BString, CacheEntry> fEntries; ///< Cache entries map
+    std::multimap<BString, BString> fChecksums; ///< Checksum to file IDs
     mutable BLocker fLock;                  ///< Thread safety lock
     
     off_t fMaxCacheSize;                    ///< Maximum cache size
@@ -0,0 +1,421 @@
+/**
+ * @file DeltaPipeline.cpp
+ * @brief Implementation of the pipelined delta enumeration
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "DeltaPipeline.h"
+#include "../api/OneDriveAPI.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+using namespace OneDrive;
+
+const int32 DeltaPipeline::kDefaultDepth = 4;
+
+/**
+ * @brief Constructor
+ */
+DeltaPipeline::Buffer::Buffer(int32 capacity, const char* name)
+    : fLock(name),
+      fFree(create_sem(capacity, name)),
+      fFilled(create_sem(0, name)),
+      fClosed(false)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+DeltaPipeline::Buffer::~Buffer()
+{
+    Drain();
+    delete_sem(fFree);
+    delete_sem(fFilled);
+}
+
+/**
+ * @brief Hand a page to the next stage, waiting for room
+ */
+bool
+DeltaPipeline::Buffer::Put(const Page& page, bigtime_t& stalled)
+{
+    bigtime_t start = system_time();
+    status_t status = fClosed ? B_CANCELED : acquire_sem(fFree);
+    stalled += system_time() - start;
+    if (status != B_OK || fClosed) {
+        return false;
+    }
+
+    {
+        BAutolock lock(fLock);
+        fPages.push_back(page);
+    }
+    release_sem(fFilled);
+    return true;
+}
+
+/**
+ * @brief Take a page from the previous stage, waiting for one
+ */
+bool
+DeltaPipeline::Buffer::Get(Page& page, bigtime_t& stalled)
+{
+    bigtime_t start = system_time();
+    status_t status = fClosed ? B_CANCELED : acquire_sem(fFilled);
+    stalled += system_time() - start;
+    if (status != B_OK || fClosed) {
+        return false;
+    }
+
+    {
+        BAutolock lock(fLock);
+        if (fPages.empty()) {
+            return false;
+        }
+        page = fPages.front();
+        fPages.pop_front();
+    }
+    release_sem(fFree);
+    return true;
+}
+
+/**
+ * @brief Wake and turn away both sides
+ */
+void
+DeltaPipeline::Buffer::Close()
+{
+    fClosed = true;
+    release_sem(fFree);
+    release_sem(fFilled);
+}
+
+/**
+ * @brief Drop pages that were never taken
+ */
+void
+DeltaPipeline::Buffer::Drain()
+{
+    BAutolock lock(fLock);
+    for (size_t i = 0; i < fPages.size(); i++) {
+        _FreeItems(fPages[i].items);
+    }
+    fPages.clear();
+}
+
+/**
+ * @brief Constructor
+ */
+DeltaPipeline::DeltaPipeline(const FetchFunction& fetch,
+    const ParseFunction& parse, const ApplyFunction& apply, int32 depth)
+    : fFetchFunction(fetch),
+      fParseFunction(parse),
+      fApplyFunction(apply),
+      fDepth(depth > 0 ? depth : kDefaultDepth),
+      fFetched(NULL),
+      fParsed(NULL),
+      fLock("DeltaPipeline Lock"),
+      fError(B_OK)
+{
+    memset(&fStats, 0, sizeof(fStats));
+}
+
+/**
+ * @brief Destructor
+ */
+DeltaPipeline::~DeltaPipeline()
+{
+}
+
+/**
+ * @brief Run the pipeline until the last page is applied
+ */
+status_t
+DeltaPipeline::Run(const BString& startToken, BString& deltaToken)
+{
+    {
+        BAutolock lock(fLock);
+        memset(&fStats, 0, sizeof(fStats));
+        fError = B_OK;
+        fStartToken = startToken;
+        fDeltaToken.SetTo("");
+        fFetched = new Buffer(fDepth, "delta fetched");
+        fParsed = new Buffer(fDepth, "delta parsed");
+    }
+
+    bigtime_t start = system_time();
+
+    thread_id fetchThread = spawn_thread(_FetchThread, "delta fetch",
+        B_NORMAL_PRIORITY, this);
+    thread_id parseThread = spawn_thread(_ParseThread, "delta parse",
+        B_NORMAL_PRIORITY, this);
+    if (fetchThread < 0 || parseThread < 0) {
+        _Fail(fetchThread < 0 ? fetchThread : parseThread);
+    }
+    if (fetchThread >= 0) {
+        resume_thread(fetchThread);
+    }
+    if (parseThread >= 0) {
+        resume_thread(parseThread);
+    }
+
+    // Apply stage: one batch per page, on the caller's thread
+    bool complete = false;
+    while (true) {
+        Page page;
+        bigtime_t stalled = 0;
+        bool received = fParsed->Get(page, stalled);
+        _Account(fStats.stalled, kDeltaStageApply, stalled);
+        if (!received) {
+            break;
+        }
+
+        bigtime_t applyStart = system_time();
+        status_t status = fApplyFunction(*page.items);
+        _Account(fStats.busy, kDeltaStageApply, system_time() - applyStart);
+
+        {
+            BAutolock lock(fLock);
+            fStats.pages++;
+            fStats.items += page.items->CountItems();
+        }
+        _FreeItems(page.items);
+
+        if (status != B_OK) {
+            _Fail(status);
+            break;
+        }
+        if (page.last) {
+            complete = true;
+            break;
+        }
+    }
+
+    status_t exitValue;
+    if (fetchThread >= 0) {
+        wait_for_thread(fetchThread, &exitValue);
+    }
+    if (parseThread >= 0) {
+        wait_for_thread(parseThread, &exitValue);
+    }
+
+    BAutolock lock(fLock);
+    delete fFetched;
+    delete fParsed;
+    fFetched = NULL;
+    fParsed = NULL;
+    fStats.elapsed = system_time() - start;
+
+    if (fError != B_OK) {
+        return fError;
+    }
+    if (!complete) {
+        return B_CANCELED;
+    }
+
+    deltaToken = fDeltaToken;
+    return B_OK;
+}
+
+/**
+ * @brief Abort a running pipeline
+ */
+void
+DeltaPipeline::Cancel()
+{
+    _Fail(B_CANCELED);
+}
+
+/**
+ * @brief Get timing of the last run
+ */
+DeltaPipelineStats
+DeltaPipeline::Stats() const
+{
+    BAutolock lock(fLock);
+    return fStats;
+}
+
+/**
+ * @brief Get the stage that limited a run
+ */
+DeltaStage
+DeltaPipeline::Bottleneck(const DeltaPipelineStats& stats)
+{
+    DeltaStage bottleneck = kDeltaStageFetch;
+    for (int32 stage = kDeltaStageParse; stage < kDeltaStageCount; stage++) {
+        if (stats.busy[stage] > stats.busy[bottleneck]) {
+            bottleneck = (DeltaStage)stage;
+        }
+    }
+    return bottleneck;
+}
+
+/**
+ * @brief Get a printable name for a stage
+ */
+const char*
+DeltaPipeline::StageName(DeltaStage stage)
+{
+    switch (stage) {
+        case kDeltaStageFetch:
+            return "fetch";
+        case kDeltaStageParse:
+            return "parse";
+        case kDeltaStageApply:
+            return "apply";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief Fetch stage thread entry point
+ */
+int32
+DeltaPipeline::_FetchThread(void* data)
+{
+    static_cast<DeltaPipeline*>(data)->_Fetch();
+    return 0;
+}
+
+/**
+ * @brief Parse stage thread entry point
+ */
+int32
+DeltaPipeline::_ParseThread(void* data)
+{
+    static_cast<DeltaPipeline*>(data)->_Parse();
+    return 0;
+}
+
+/**
+ * @brief Fetch pages until the last one or an error
+ */
+void
+DeltaPipeline::_Fetch()
+{
+    BString token = fStartToken;
+
+    while (true) {
+        Page page;
+        page.items = NULL;
+
+        BString nextToken;
+        BString deltaToken;
+        bigtime_t start = system_time();
+        status_t status = fFetchFunction(token, page.json, nextToken,
+            deltaToken);
+        _Account(fStats.busy, kDeltaStageFetch, system_time() - start);
+        if (status != B_OK) {
+            _Fail(status);
+            return;
+        }
+
+        page.last = nextToken.IsEmpty();
+        if (page.last) {
+            BAutolock lock(fLock);
+            fDeltaToken = deltaToken;
+        }
+
+        bigtime_t stalled = 0;
+        bool accepted = fFetched->Put(page, stalled);
+        _Account(fStats.stalled, kDeltaStageFetch, stalled);
+        if (!accepted || page.last) {
+            return;
+        }
+
+        token = nextToken;
+    }
+}
+
+/**
+ * @brief Parse pages until the last one or an error
+ */
+void
+DeltaPipeline::_Parse()
+{
+    while (true) {
+        Page page;
+        bigtime_t stalled = 0;
+        bool received = fFetched->Get(page, stalled);
+        _Account(fStats.stalled, kDeltaStageParse, stalled);
+        if (!received) {
+            return;
+        }
+
+        page.items = new BList();
+        bigtime_t start = system_time();
+        status_t status = fParseFunction(page.json, *page.items);
+        _Account(fStats.busy, kDeltaStageParse, system_time() - start);
+
+        // The raw page is no longer needed downstream
+        page.json.SetTo("");
+
+        if (status != B_OK) {
+            _FreeItems(page.items);
+            _Fail(status);
+            return;
+        }
+
+        stalled = 0;
+        bool accepted = fParsed->Put(page, stalled);
+        _Account(fStats.stalled, kDeltaStageParse, stalled);
+        if (!accepted) {
+            _FreeItems(page.items);
+            return;
+        }
+        if (page.last) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Record the first error and stop all stages
+ */
+void
+DeltaPipeline::_Fail(status_t error)
+{
+    BAutolock lock(fLock);
+
+    if (fError == B_OK) {
+        fError = error;
+    }
+    if (fFetched != NULL) {
+        fFetched->Close();
+    }
+    if (fParsed != NULL) {
+        fParsed->Close();
+    }
+}
+
+/**
+ * @brief Add time to a stage counter
+ */
+void
+DeltaPipeline::_Account(bigtime_t* counters, DeltaStage stage, bigtime_t time)
+{
+    BAutolock lock(fLock);
+    counters[stage] += time;
+}
+
+/**
+ * @brief Delete the items of a page
+ */
+void
+DeltaPipeline::_FreeItems(BList* items)
+{
+    if (items == NULL) {
+        return;
+    }
+    for (int32 i = 0; i < items->CountItems(); i++) {
+        delete static_cast<OneDriveItem*>(items->ItemAt(i));
+    }
+    delete items;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file DeltaPipeline.h
+ * @brief Pipelined fetch, parse and apply of delta pages
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * A large delta enumeration is hundreds of pages. Fetching, parsing and
+ * applying them one after the other leaves the network idle while pages
+ * are parsed and the CPU idle while they download. The DeltaPipeline runs
+ * the three steps as overlapping stages.
+ */
+
+#ifndef DELTA_PIPELINE_H
+#define DELTA_PIPELINE_H
+
+#include <List.h>
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <deque>
+#include <functional>
+
+namespace OneDrive {
+
+/**
+ * @brief Pipeline stages
+ */
+enum DeltaStage {
+    kDeltaStageFetch = 0,       ///< Network requests
+    kDeltaStageParse,           ///< JSON to items
+    kDeltaStageApply,           ///< Items to sync state
+    kDeltaStageCount
+};
+
+/**
+ * @brief Per-stage timing of a pipeline run
+ */
+struct DeltaPipelineStats {
+    int32 pages;                            ///< Pages processed
+    int32 items;                            ///< Items parsed
+    bigtime_t elapsed;                      ///< Wall time of the run
+    bigtime_t busy[kDeltaStageCount];       ///< Time spent working
+    bigtime_t stalled[kDeltaStageCount];    ///< Time spent waiting on others
+};
+
+/**
+ * @brief Three-stage pipeline over delta pages
+ *
+ * The fetch stage requests pages back to back: it only needs the next
+ * page token, which it gets without parsing the page. The parse stage
+ * turns raw pages into item lists on its own thread, and the apply stage
+ * runs on the caller's thread, once per page, so each page is applied as
+ * a single batch.
+ *
+ * Stages are connected by bounded buffers, so a slow stage holds back
+ * the others instead of letting pages pile up in memory. Busy and stall
+ * times per stage show which one limits a run: the bottleneck is busy
+ * while its neighbours stall.
+ *
+ * The final delta token is only returned once every page has been
+ * applied, so an interrupted run never skips changes.
+ *
+ * @see OneDriveAPI::FetchDeltaPage
+ * @see OneDriveAPI::ParseDeltaPage
+ * @since 1.0.0
+ */
+class DeltaPipeline {
+public:
+    /**
+     * @brief Fetch one page
+     *
+     * Arguments: page token, receives the raw page, receives the next page
+     * token (empty on the last page), receives the final delta token.
+     */
+    typedef std::function<status_t(const BString&, BString&, BString&,
+        BString&)> FetchFunction;
+
+    /**
+     * @brief Parse a raw page, appending OneDriveItem objects to the list
+     */
+    typedef std::function<status_t(const BString&, BList&)> ParseFunction;
+
+    /**
+     * @brief Apply the items of one page as a batch
+     *
+     * Items stay owned by the pipeline and are deleted afterwards.
+     */
+    typedef std::function<status_t(const BList&)> ApplyFunction;
+
+    /**
+     * @brief Constructor
+     *
+     * @param fetch Fetch stage
+     * @param parse Parse stage
+     * @param apply Apply stage
+     * @param depth Pages buffered between two stages
+     */
+    DeltaPipeline(const FetchFunction& fetch, const ParseFunction& parse,
+        const ApplyFunction& apply, int32 depth = kDefaultDepth);
+
+    /**
+     * @brief Destructor
+     */
+    ~DeltaPipeline();
+
+    /**
+     * @brief Run the pipeline until the last page is applied
+     *
+     * @param startToken Delta token to start from (empty for all items)
+     * @param deltaToken Receives the token for the next delta call
+     * @return B_OK on success, or the first stage error
+     */
+    status_t Run(const BString& startToken, BString& deltaToken);
+
+    /**
+     * @brief Abort a running pipeline
+     *
+     * Run() returns B_CANCELED once the stages have wound down.
+     */
+    void Cancel();
+
+    /**
+     * @brief Get timing of the last run
+     *
+     * @return Stage statistics
+     */
+    DeltaPipelineStats Stats() const;
+
+    /**
+     * @brief Get the stage that limited a run
+     *
+     * @param stats Statistics of a run
+     * @return Stage with the most busy time
+     */
+    static DeltaStage Bottleneck(const DeltaPipelineStats& stats);
+
+    /**
+     * @brief Get a printable name for a stage
+     *
+     * @param stage Stage
+     * @return Stage name
+     */
+    static const char* StageName(DeltaStage stage);
+
+    static const int32 kDefaultDepth;   ///< Default buffer depth
+
+private:
+    /**
+     * @brief Page travelling through the pipeline
+     */
+    struct Page {
+        BString json;           ///< Raw page, until parsed
+        BList* items;           ///< Parsed items
+        bool last;              ///< Last page of the run
+    };
+
+    /**
+     * @brief Bounded buffer between two stages
+     */
+    class Buffer {
+    public:
+        Buffer(int32 capacity, const char* name);
+        ~Buffer();
+
+        bool Put(const Page& page, bigtime_t& stalled);
+        bool Get(Page& page, bigtime_t& stalled);
+        void Close();
+        void Drain();
+
+    private:
+        BLocker fLock;
+        std::deque<Page> fPages;
+        sem_id fFree;
+        sem_id fFilled;
+        volatile bool fClosed;
+    };
+
+    /**
+     * @brief Fetch stage thread entry point
+     */
+    static int32 _FetchThread(void* data);
+
+    /**
+     * @brief Parse stage thread entry point
+     */
+    static int32 _ParseThread(void* data);
+
+    /**
+     * @brief Fetch pages until the last one or an error
+     */
+    void _Fetch();
+
+    /**
+     * @brief Parse pages until the last one or an error
+     */
+    void _Parse();
+
+    /**
+     * @brief Record the first error and stop all stages
+     *
+     * @param error Stage error
+     */
+    void _Fail(status_t error);
+
+    /**
+     * @brief Add time to a stage counter
+     */
+    void _Account(bigtime_t* counters, DeltaStage stage, bigtime_t time);
+
+    /**
+     * @brief Delete the items of a page
+     */
+    static void _FreeItems(BList* items);
+
+private:
+    FetchFunction fFetchFunction;
+    ParseFunction fParseFunction;
+    ApplyFunction fApplyFunction;
+    int32 fDepth;
+
+    Buffer* fFetched;                   ///< Fetch -> parse
+    Buffer* fParsed;                    ///< Parse -> apply
+    BString fStartToken;                ///< Token of the first page
+    BString fDeltaToken;                ///< Final token from the last page
+
+    mutable BLocker fLock;              ///< Protects error and stats
+    status_t fError;                    ///< First stage error
+    DeltaPipelineStats fStats;          ///< Timing of the current run
+};
+
+} // namespace OneDrive
+
+#endif // DELTA_PIPELINE_H
@@ -0,0 +1,220 @@
+/**
+ * @file DropJobTracker.cpp
+ * @brief Implementation of the drag-and-drop job progress tracker
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "DropJobTracker.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+using namespace OneDrive;
+
+const bigtime_t DropJobTracker::kDefaultReportInterval = 250000;
+
+/**
+ * @brief Constructor
+ */
+DropJobTracker::DropJobTracker(bigtime_t reportInterval)
+    : fLock("DropJobTracker Lock"),
+      fNextJob(1),
+      fReportInterval(reportInterval)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+DropJobTracker::~DropJobTracker()
+{
+}
+
+/**
+ * @brief Start a job, enumerating
+ */
+int32
+DropJobTracker::Begin()
+{
+    BAutolock lock(fLock);
+
+    Job job;
+    memset(&job.progress, 0, sizeof(job.progress));
+    job.progress.job = fNextJob++;
+    job.progress.enumerating = true;
+    job.lastReport = 0;
+    fJobs[job.progress.job] = job;
+
+    return job.progress.job;
+}
+
+/**
+ * @brief Add an item found by the job's enumeration
+ */
+bool
+DropJobTracker::AddItem(int32 job, const BString& path, off_t size)
+{
+    BAutolock lock(fLock);
+
+    std::map<int32, Job>::iterator found = fJobs.find(job);
+    if (found == fJobs.end()) {
+        return false;
+    }
+
+    std::map<BString, Item>::iterator existing = fItems.find(path);
+    if (existing != fItems.end()) {
+        // Queued again by this job: the other one stops waiting for it
+        std::map<int32, Job>::iterator owner
+            = fJobs.find(existing->second.job);
+        if (owner != fJobs.end()) {
+            owner->second.progress.totalItems--;
+            owner->second.progress.totalBytes -= existing->second.size;
+        }
+        fItems.erase(existing);
+        if (owner != fJobs.end() && owner != found) {
+            _FinishIfDone(owner);
+        }
+    }
+
+    Item item;
+    item.job = job;
+    item.size = size;
+    fItems[path] = item;
+
+    found->second.progress.totalItems++;
+    found->second.progress.totalBytes += size;
+    return true;
+}
+
+/**
+ * @brief Mark the job's enumeration as done
+ */
+bool
+DropJobTracker::EnumerationDone(int32 job, DropJobProgress& progress)
+{
+    BAutolock lock(fLock);
+
+    std::map<int32, Job>::iterator found = fJobs.find(job);
+    if (found == fJobs.end()) {
+        return false;
+    }
+
+    found->second.progress.enumerating = false;
+    progress = found->second.progress;
+    progress.finished = _FinishIfDone(found);
+    return true;
+}
+
+/**
+ * @brief Settle the item synced under a path
+ */
+bool
+DropJobTracker::ItemDone(const BString& path, bool succeeded, bigtime_t now,
+    DropJobProgress& progress)
+{
+    BAutolock lock(fLock);
+
+    std::map<BString, Item>::iterator item = fItems.find(path);
+    if (item == fItems.end()) {
+        return false;
+    }
+
+    std::map<int32, Job>::iterator job = fJobs.find(item->second.job);
+    if (job == fJobs.end()) {
+        fItems.erase(item);
+        return false;
+    }
+
+    DropJobProgress& counters = job->second.progress;
+    if (succeeded) {
+        counters.completedItems++;
+        counters.completedBytes += item->second.size;
+    } else {
+        counters.failedItems++;
+    }
+    fItems.erase(item);
+
+    progress = counters;
+    progress.finished = _FinishIfDone(job);
+    if (progress.finished) {
+        return true;
+    }
+
+    if (now - job->second.lastReport < fReportInterval) {
+        return false;
+    }
+    job->second.lastReport = now;
+    return true;
+}
+
+/**
+ * @brief Get the progress of a job
+ */
+bool
+DropJobTracker::GetProgress(int32 job, DropJobProgress& progress) const
+{
+    BAutolock lock(fLock);
+
+    std::map<int32, Job>::const_iterator found = fJobs.find(job);
+    if (found == fJobs.end()) {
+        return false;
+    }
+
+    progress = found->second.progress;
+    return true;
+}
+
+/**
+ * @brief Get the job waiting for the item synced under a path
+ */
+int32
+DropJobTracker::JobOf(const BString& path) const
+{
+    BAutolock lock(fLock);
+
+    std::map<BString, Item>::const_iterator found = fItems.find(path);
+    if (found == fItems.end()) {
+        return 0;
+    }
+    return found->second.job;
+}
+
+/**
+ * @brief Count unfinished jobs
+ */
+int32
+DropJobTracker::CountJobs() const
+{
+    BAutolock lock(fLock);
+    return fJobs.size();
+}
+
+/**
+ * @brief Count items not settled yet, over all jobs
+ */
+int32
+DropJobTracker::CountPendingItems() const
+{
+    BAutolock lock(fLock);
+    return fItems.size();
+}
+
+/**
+ * @brief Drop a job once nothing is left of it, fLock held
+ */
+bool
+DropJobTracker::_FinishIfDone(std::map<int32, Job>::iterator job)
+{
+    const DropJobProgress& progress = job->second.progress;
+    if (progress.enumerating
+        || progress.completedItems + progress.failedItems
+            < progress.totalItems) {
+        return false;
+    }
+
+    fJobs.erase(job);
+    return true;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file DropJobTracker.h
+ * @brief Aggregate progress of batched drag-and-drop jobs
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * A drop of thousands of files arrives as one job. Its folders are walked
+ * in the background and every file becomes a sync item of its own; the
+ * DropJobTracker adds those items up again, so the job can be reported as
+ * one thing.
+ */
+
+#ifndef DROP_JOB_TRACKER_H
+#define DROP_JOB_TRACKER_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <map>
+
+namespace OneDrive {
+
+/**
+ * @brief Progress of one drop job
+ */
+struct DropJobProgress {
+    int32 job;                  ///< Job ID
+    int32 totalItems;           ///< Items found so far
+    int32 completedItems;       ///< Items synced
+    int32 failedItems;          ///< Items given up on
+    off_t totalBytes;           ///< Bytes found so far
+    off_t completedBytes;       ///< Bytes of synced items
+    bool enumerating;           ///< Folders are still being walked
+    bool finished;              ///< Walk done and every item settled
+};
+
+/**
+ * @brief Per-job counters over items identified by local path
+ *
+ * Items are added while the job's folders are enumerated and settled as
+ * the sync engine completes or gives up on them. A job is finished once
+ * its enumeration is done and no item is left; finished jobs are dropped.
+ *
+ * Progress is meant to be sent to the client that started the job. To
+ * keep a large drop from flooding it with messages, ItemDone() asks for a
+ * report at most once per report interval, and always for the last item.
+ *
+ * A path belongs to one job at a time: adding it to another job moves it.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class DropJobTracker {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param reportInterval Least time between two progress reports
+     */
+    explicit DropJobTracker(
+        bigtime_t reportInterval = kDefaultReportInterval);
+
+    /**
+     * @brief Destructor
+     */
+    ~DropJobTracker();
+
+    /**
+     * @brief Start a job, enumerating
+     *
+     * @return New job ID
+     */
+    int32 Begin();
+
+    /**
+     * @brief Add an item found by the job's enumeration
+     *
+     * @param job Job ID
+     * @param path Local path the item is synced under
+     * @param size Bytes to transfer
+     * @return false if the job is unknown
+     */
+    bool AddItem(int32 job, const BString& path, off_t size);
+
+    /**
+     * @brief Mark the job's enumeration as done
+     *
+     * @param job Job ID
+     * @param progress Receives the job's progress
+     * @return false if the job is unknown
+     */
+    bool EnumerationDone(int32 job, DropJobProgress& progress);
+
+    /**
+     * @brief Settle the item synced under a path
+     *
+     * @param path Local path of a completed or abandoned item
+     * @param succeeded Whether the item was synced
+     * @param now Current time, for report throttling
+     * @param progress Receives the job's progress when a report is due
+     * @return true if a progress report is due
+     */
+    bool ItemDone(const BString& path, bool succeeded, bigtime_t now,
+                  DropJobProgress& progress);
+
+    /**
+     * @brief Get the progress of a job
+     *
+     * @param job Job ID
+     * @param progress Receives the progress
+     * @return false if the job is unknown or finished
+     */
+    bool GetProgress(int32 job, DropJobProgress& progress) const;
+
+    /**
+     * @brief Get the job waiting for the item synced under a path
+     *
+     * @param path Local path
+     * @return Job ID, 0 if no job waits for it
+     */
+    int32 JobOf(const BString& path) const;
+
+    /**
+     * @brief Count unfinished jobs
+     *
+     * @return Number of jobs
+     */
+    int32 CountJobs() const;
+
+    /**
+     * @brief Count items not settled yet, over all jobs
+     *
+     * @return Number of items
+     */
+    int32 CountPendingItems() const;
+
+    static const bigtime_t kDefaultReportInterval;  ///< 250 ms
+
+private:
+    /**
+     * @brief Job state
+     */
+    struct Job {
+        DropJobProgress progress;   ///< Counters
+        bigtime_t lastReport;       ///< When progress was last reported
+    };
+
+    /**
+     * @brief Item waiting to be settled
+     */
+    struct Item {
+        int32 job;                  ///< Owning job
+        off_t size;                 ///< Bytes, counted when synced
+    };
+
+    /**
+     * @brief Drop a job once nothing is left of it, fLock held
+     *
+     * @param job Job to check
+     * @return true if the job is finished
+     */
+    bool _FinishIfDone(std::map<int32, Job>::iterator job);
+
+private:
+    mutable BLocker fLock;              ///< Protects everything below
+    std::map<int32, Job> fJobs;         ///< Unfinished jobs by ID
+    std::map<BString, Item> fItems;     ///< Unsettled items by local path
+    int32 fNextJob;                     ///< Next job ID
+    bigtime_t fReportInterval;          ///< Least time between reports
+};
+
+} // namespace OneDrive
+
+#endif // DROP_JOB_TRACKER_H
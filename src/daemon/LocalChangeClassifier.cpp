@@ -0,0 +1,228 @@
+/**
+ * @file LocalChangeClassifier.cpp
+ * @brief Implementation of the local change classifier
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "LocalChangeClassifier.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+using namespace OneDrive;
+
+/**
+ * @brief Constructor
+ */
+LocalChangeClassifier::LocalChangeClassifier(const HashFunction& hash)
+    : fLock("LocalChangeClassifier Lock"),
+      fHash(hash)
+{
+    memset(&fStats, 0, sizeof(fStats));
+}
+
+/**
+ * @brief Destructor
+ */
+LocalChangeClassifier::~LocalChangeClassifier()
+{
+}
+
+/**
+ * @brief Record the state a file was synced in
+ */
+void
+LocalChangeClassifier::Remember(const node_ref& node,
+    const LocalFileState& state)
+{
+    BAutolock lock(fLock);
+    fFiles[_Key(node)] = state;
+}
+
+/**
+ * @brief Forget a file
+ */
+void
+LocalChangeClassifier::Forget(const node_ref& node)
+{
+    BAutolock lock(fLock);
+    fFiles.erase(_Key(node));
+}
+
+/**
+ * @brief Record where a file is now
+ */
+void
+LocalChangeClassifier::Locate(const node_ref& node, const BString& path)
+{
+    BAutolock lock(fLock);
+
+    std::map<NodeKey, LocalFileState>::iterator found
+        = fFiles.find(_Key(node));
+    if (found != fFiles.end()) {
+        found->second.path = path;
+        return;
+    }
+
+    LocalFileState& state = fFiles[_Key(node)];
+    state.path = path;
+    state.size = -1;
+    state.modified = 0;
+}
+
+/**
+ * @brief Move the files recorded at or below a path
+ */
+void
+LocalChangeClassifier::MoveTree(const BString& from, const BString& to)
+{
+    BString prefix(from);
+    prefix << "/";
+
+    BAutolock lock(fLock);
+
+    for (std::map<NodeKey, LocalFileState>::iterator it = fFiles.begin();
+            it != fFiles.end(); ++it) {
+        BString& path = it->second.path;
+        if (path == from) {
+            path = to;
+        } else if (path.StartsWith(prefix)) {
+            BString moved(to);
+            moved << (path.String() + from.Length());
+            path = moved;
+        }
+    }
+}
+
+/**
+ * @brief Get the local path of a file
+ */
+bool
+LocalChangeClassifier::PathFor(const node_ref& node, BString& path) const
+{
+    BAutolock lock(fLock);
+
+    std::map<NodeKey, LocalFileState>::const_iterator found
+        = fFiles.find(_Key(node));
+    if (found == fFiles.end()) {
+        return false;
+    }
+
+    path = found->second.path;
+    return true;
+}
+
+/**
+ * @brief Get the state a file was last synced in
+ */
+bool
+LocalChangeClassifier::StateOf(const node_ref& node,
+    LocalFileState& state) const
+{
+    BAutolock lock(fLock);
+
+    std::map<NodeKey, LocalFileState>::const_iterator found
+        = fFiles.find(_Key(node));
+    if (found == fFiles.end()) {
+        return false;
+    }
+
+    state = found->second;
+    return true;
+}
+
+/**
+ * @brief Classify a stat change
+ */
+LocalChangeKind
+LocalChangeClassifier::ClassifyStat(const node_ref& node, off_t size,
+    time_t modified, BString& hash)
+{
+    LocalFileState synced;
+    {
+        BAutolock lock(fLock);
+
+        std::map<NodeKey, LocalFileState>::iterator found
+            = fFiles.find(_Key(node));
+        if (found == fFiles.end() || found->second.size != size
+            || found->second.hash.IsEmpty()) {
+            fStats.content++;
+            return kLocalChangeContent;
+        }
+        if (found->second.modified == modified) {
+            // Permissions, owner or access time: the drive keeps none
+            fStats.unchanged++;
+            return kLocalChangeNone;
+        }
+        synced = found->second;
+    }
+
+    // Same size, new time: only the content can tell
+    hash = fHash(synced.path);
+
+    BAutolock lock(fLock);
+    fStats.hashed++;
+    if (hash.IsEmpty() || hash != synced.hash) {
+        fStats.content++;
+        return kLocalChangeContent;
+    }
+
+    std::map<NodeKey, LocalFileState>::iterator found
+        = fFiles.find(_Key(node));
+    if (found != fFiles.end()) {
+        found->second.modified = modified;
+    }
+    fStats.metadata++;
+    return kLocalChangeMetadata;
+}
+
+/**
+ * @brief Classify an attribute change
+ */
+LocalChangeKind
+LocalChangeClassifier::ClassifyAttributes(const node_ref& node)
+{
+    BAutolock lock(fLock);
+
+    std::map<NodeKey, LocalFileState>::const_iterator found
+        = fFiles.find(_Key(node));
+    if (found == fFiles.end() || found->second.size < 0) {
+        fStats.content++;
+        return kLocalChangeContent;
+    }
+
+    fStats.attributes++;
+    return kLocalChangeAttributes;
+}
+
+/**
+ * @brief Count known files
+ */
+int32
+LocalChangeClassifier::CountFiles() const
+{
+    BAutolock lock(fLock);
+    return fFiles.size();
+}
+
+/**
+ * @brief Get the classification counters
+ */
+LocalChangeStats
+LocalChangeClassifier::Stats() const
+{
+    BAutolock lock(fLock);
+    return fStats;
+}
+
+/**
+ * @brief Map key of a node
+ */
+LocalChangeClassifier::NodeKey
+LocalChangeClassifier::_Key(const node_ref& node)
+{
+    return NodeKey(node.device, node.node);
+}
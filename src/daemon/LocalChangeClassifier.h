@@ -0,0 +1,201 @@
+/**
+ * @file LocalChangeClassifier.h
+ * @brief Tells content changes of synced files from metadata changes
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Node monitoring reports a stat or attribute change of a file, not what
+ * changed. Setting a rating or touching a file must not send its content
+ * again; the LocalChangeClassifier compares the file with what was synced
+ * last and says which kind of update it needs.
+ */
+
+#ifndef LOCAL_CHANGE_CLASSIFIER_H
+#define LOCAL_CHANGE_CLASSIFIER_H
+
+#include <Locker.h>
+#include <Node.h>
+#include <String.h>
+
+#include <functional>
+#include <map>
+#include <utility>
+
+namespace OneDrive {
+
+/**
+ * @brief What a local change needs synced
+ */
+enum LocalChangeKind {
+    kLocalChangeNone = 0,       ///< Nothing the drive keeps changed
+    kLocalChangeContent,        ///< The content: upload
+    kLocalChangeMetadata,       ///< Timestamps only: PATCH fileSystemInfo
+    kLocalChangeAttributes      ///< BFS attributes only: PATCH properties
+};
+
+/**
+ * @brief A file as it was last synced
+ */
+struct LocalFileState {
+    BString path;               ///< Local path
+    off_t size;                 ///< Size in bytes, -1 if never synced
+    time_t modified;            ///< Modification time
+    BString hash;               ///< QuickXorHash, empty if unknown
+};
+
+/**
+ * @brief Counters of classified changes
+ */
+struct LocalChangeStats {
+    int32 content;              ///< Changes needing an upload
+    int32 metadata;             ///< Timestamp changes, content unchanged
+    int32 attributes;           ///< Attribute changes
+    int32 unchanged;            ///< Stat changes of nothing synced
+    int32 hashed;               ///< Files hashed to decide
+};
+
+/**
+ * @brief Last synced state of files by node, and change classification
+ *
+ * The sync engine records every file it uploads or downloads, and where
+ * every other file it sees is, so a change of any of them can be found by
+ * node. Renames keep the synced state under the new path. A stat
+ * change is then decided by the cheapest test that settles it: a new size
+ * is new content, an unchanged modification time changed nothing synced,
+ * and only a new modification time at the same size costs hashing the
+ * file. Equal hashes make it a metadata change; the new time is taken
+ * over so the next touch compares against it.
+ *
+ * A file without a recorded state, or one that cannot be hashed, is
+ * classified as a content change: uploading is always correct.
+ *
+ * Hashing runs without the lock held.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class LocalChangeClassifier {
+public:
+    /**
+     * @brief Content hash of a local file, empty on failure
+     */
+    typedef std::function<BString(const BString& path)> HashFunction;
+
+    /**
+     * @brief Constructor
+     *
+     * @param hash Computes QuickXorHash of a local file
+     */
+    explicit LocalChangeClassifier(const HashFunction& hash);
+
+    /**
+     * @brief Destructor
+     */
+    ~LocalChangeClassifier();
+
+    /**
+     * @brief Record the state a file was synced in
+     *
+     * @param node File node
+     * @param state Path, size, modification time and hash
+     */
+    void Remember(const node_ref& node, const LocalFileState& state);
+
+    /**
+     * @brief Forget a file
+     *
+     * @param node File node
+     */
+    void Forget(const node_ref& node);
+
+    /**
+     * @brief Record where a file is now
+     *
+     * A known file keeps its synced state under the new path; an unknown
+     * one is recorded as never synced, so its changes are uploaded.
+     *
+     * @param node File node
+     * @param path Current local path
+     */
+    void Locate(const node_ref& node, const BString& path);
+
+    /**
+     * @brief Move the files recorded at or below a path
+     *
+     * @param from Local path before a rename
+     * @param to Local path after it
+     */
+    void MoveTree(const BString& from, const BString& to);
+
+    /**
+     * @brief Get the local path of a file
+     *
+     * @param node File node
+     * @param path Receives the path
+     * @return false if the node is not known
+     */
+    bool PathFor(const node_ref& node, BString& path) const;
+
+    /**
+     * @brief Get the state a file was last synced in
+     *
+     * @param node File node
+     * @param state Receives the state; its size is -1 if never synced
+     * @return false if the node is not known
+     */
+    bool StateOf(const node_ref& node, LocalFileState& state) const;
+
+    /**
+     * @brief Classify a stat change
+     *
+     * @param node File node
+     * @param size Current size
+     * @param modified Current modification time
+     * @param hash Receives the content hash if it was computed
+     * @return kLocalChangeContent, kLocalChangeMetadata or kLocalChangeNone
+     */
+    LocalChangeKind ClassifyStat(const node_ref& node, off_t size,
+                                 time_t modified, BString& hash);
+
+    /**
+     * @brief Classify an attribute change
+     *
+     * @param node File node
+     * @return kLocalChangeAttributes, or kLocalChangeContent if the node
+     *         is not known or was never synced
+     */
+    LocalChangeKind ClassifyAttributes(const node_ref& node);
+
+    /**
+     * @brief Count known files
+     *
+     * @return Number of files
+     */
+    int32 CountFiles() const;
+
+    /**
+     * @brief Get the classification counters
+     *
+     * @return Counters since construction
+     */
+    LocalChangeStats Stats() const;
+
+private:
+    typedef std::pair<dev_t, ino_t> NodeKey;
+
+    /**
+     * @brief Map key of a node
+     */
+    static NodeKey _Key(const node_ref& node);
+
+private:
+    mutable BLocker fLock;                      ///< Protects everything below
+    std::map<NodeKey, LocalFileState> fFiles;   ///< Synced states by node
+    LocalChangeStats fStats;                    ///< Classification counters
+    HashFunction fHash;                         ///< Content hash function
+};
+
+} // namespace OneDrive
+
+#endif // LOCAL_CHANGE_CLASSIFIER_H
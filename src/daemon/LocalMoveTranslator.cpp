@@ -0,0 +1,101 @@
+/**
+ * @file LocalMoveTranslator.cpp
+ * @brief Implementation of the local move translator
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "LocalMoveTranslator.h"
+
+#include <Entry.h>
+
+using namespace OneDrive;
+
+/**
+ * @brief Constructor
+ */
+LocalMoveTranslator::LocalMoveTranslator(const BPath& root,
+    const SyncFilter& filter)
+    : fRoot(root),
+      fFilter(filter)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+LocalMoveTranslator::~LocalMoveTranslator()
+{
+}
+
+/**
+ * @brief Translate a B_ENTRY_MOVED notification
+ */
+LocalMoveKind
+LocalMoveTranslator::Translate(const BMessage* message, SyncItem& item) const
+{
+    entry_ref from;
+    entry_ref to;
+    const char* fromName;
+    const char* name;
+    if (message == NULL
+        || message->FindInt32("device", &to.device) != B_OK
+        || message->FindInt64("from directory", &from.directory) != B_OK
+        || message->FindInt64("to directory", &to.directory) != B_OK
+        || message->FindString("from name", &fromName) != B_OK
+        || message->FindString("name", &name) != B_OK) {
+        return kLocalMoveIgnored;
+    }
+    from.device = to.device;
+    from.set_name(fromName);
+    to.set_name(name);
+
+    BPath previous(&from);
+    BPath current(&to);
+    bool wasSynced = previous.InitCheck() == B_OK && fFilter(previous);
+    bool isSynced = current.InitCheck() == B_OK && fFilter(current);
+
+    if (wasSynced && isSynced) {
+        item.operation = kSyncOpMove;
+        item.status = kSyncStatusPending;
+        item.localPath = current.Path();
+        item.remotePath = RemotePathFor(current);
+        item.previousPath = RemotePathFor(previous);
+        item.localModified = 0;
+        item.remoteModified = 0;
+        item.size = 0;
+        item.retryCount = 0;
+        item.isPinned = false;
+        item.priority = kSyncPriorityNormal;
+        return kLocalMoveWithin;
+    }
+    if (isSynced) {
+        item.localPath = current.Path();
+        return kLocalMoveIn;
+    }
+    if (wasSynced) {
+        item.localPath = previous.Path();
+        return kLocalMoveOut;
+    }
+    return kLocalMoveIgnored;
+}
+
+/**
+ * @brief Get the remote path of a local path in the sync folder
+ */
+BString
+LocalMoveTranslator::RemotePathFor(const BPath& localPath) const
+{
+    BString remotePath(localPath.Path());
+    BString syncRoot(fRoot.Path());
+
+    if (remotePath.StartsWith(syncRoot)) {
+        remotePath.Remove(0, syncRoot.Length());
+    }
+    if (!remotePath.StartsWith("/")) {
+        remotePath.Prepend("/");
+    }
+
+    return remotePath;
+}
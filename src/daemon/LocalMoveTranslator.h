@@ -0,0 +1,100 @@
+/**
+ * @file LocalMoveTranslator.h
+ * @brief Turns local renames and moves into sync operations
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Node monitoring reports a rename or move as one B_ENTRY_MOVED, however
+ * much is below the entry. Syncing only its new location would upload the
+ * whole tree again and leave the old copy on the drive; the
+ * LocalMoveTranslator tells where the entry was and which one operation
+ * the drive needs.
+ */
+
+#ifndef LOCAL_MOVE_TRANSLATOR_H
+#define LOCAL_MOVE_TRANSLATOR_H
+
+#include <Message.h>
+#include <Path.h>
+#include <String.h>
+
+#include <functional>
+
+#include "SyncEngine.h"
+
+namespace OneDrive {
+
+/**
+ * @brief What a local move needs synced
+ */
+enum LocalMoveKind {
+    kLocalMoveIgnored = 0,      ///< Neither location is synced
+    kLocalMoveWithin,           ///< Both are: move on the drive
+    kLocalMoveIn,               ///< Only the new one: upload it
+    kLocalMoveOut               ///< Only the old one: delete it remotely
+};
+
+/**
+ * @brief Sync operation of a B_ENTRY_MOVED notification
+ *
+ * The old location is rebuilt from the "from directory" and "from name"
+ * fields; the directory an entry leaves still exists when it is reported.
+ * Whether each location is synced is up to the engine's filter, which
+ * also keeps everything outside the sync folder out.
+ *
+ * A move within the synced tree becomes a single kSyncOpMove of the entry,
+ * which carries a folder's whole subtree on the server. Moves in and out
+ * are left to the engine, which knows how to upload and delete.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class LocalMoveTranslator {
+public:
+    /**
+     * @brief Whether a local path is synced
+     */
+    typedef std::function<bool(const BPath& path)> SyncFilter;
+
+    /**
+     * @brief Constructor
+     *
+     * @param root Local sync folder
+     * @param filter Whether a local path is synced
+     */
+    LocalMoveTranslator(const BPath& root, const SyncFilter& filter);
+
+    /**
+     * @brief Destructor
+     */
+    ~LocalMoveTranslator();
+
+    /**
+     * @brief Translate a B_ENTRY_MOVED notification
+     *
+     * @param message Node monitor message
+     * @param item Receives the move for kLocalMoveWithin; otherwise its
+     *        localPath is the entry's new path (kLocalMoveIn) or old path
+     *        (kLocalMoveOut)
+     * @return What the move needs synced, kLocalMoveIgnored for a message
+     *         that is not a usable move
+     */
+    LocalMoveKind Translate(const BMessage* message, SyncItem& item) const;
+
+    /**
+     * @brief Get the remote path of a local path in the sync folder
+     *
+     * @param localPath Local path
+     * @return Remote path, starting with "/"
+     */
+    BString RemotePathFor(const BPath& localPath) const;
+
+private:
+    BPath fRoot;                ///< Local sync folder
+    SyncFilter fFilter;         ///< Whether a local path is synced
+};
+
+} // namespace OneDrive
+
+#endif // LOCAL_MOVE_TRANSLATOR_H
@@ -1,5 +1,7 @@
 #include "OneDriveDaemon.h"
 #include "AttributeManager.h"
+#include "CacheManager.h"
+#include "SyncEngine.h"
 #include "../shared/OneDriveConstants.h"
 #include "../api/OneDriveAPI.h"
 #include "../api/AuthManager.h"
@@ -24,6 +26,7 @@ OneDriveDaemon::OneDriveDaemon()
       fAttributeManager(nullptr),
       fCacheManager(nullptr),
       fAuthManager(nullptr),
+      fAPIClient(nullptr),
       fNetworkMonitor(nullptr),
       fSyncState(SYNC_STOPPED),
       fNetworkAvailable(false),
@@ -99,6 +102,17 @@ OneDriveDaemon::MessageReceived(BMessage* message)
             PostMessage(B_QUIT_REQUESTED);
             break;
             
+        // Requests from Tracker and the virtual folder are the engine's
+        case kMsgSyncRequired:
+        case kMsgCopyItem:
+        case kMsgDropJob:
+            if (fSyncEngine) {
+                fSyncEngine->MessageReceived(message);
+            } else {
+                _LogMessage("WARN", "Sync request before the sync engine exists");
+            }
+            break;
+            
         default:
             BApplication::MessageReceived(message);
             break;
@@ -184,6 +198,15 @@ OneDriveDaemon::LoadSettings()
 {
     _LogMessage("INFO", "Loading settings");
     // TODO: Load settings from file
+    
+    // The folder Tracker and the preferences default to
+    if (fSyncFolder.IsEmpty()) {
+        BPath homePath;
+        if (find_directory(B_USER_DIRECTORY, &homePath) == B_OK) {
+            homePath.Append("OneDrive");
+            fSyncFolder = homePath.Path();
+        }
+    }
     return B_OK;
 }
 
@@ -275,8 +298,8 @@ OneDriveDaemon::_InitializeComponents()
     _LogMessage("INFO", "AuthenticationManager created successfully");
     
     // Initialize OneDrive API client (requires auth manager)
-    OneDriveAPI* apiClient = new OneDriveAPI(*fAuthManager);
-    if (!apiClient) {
+    fAPIClient = new OneDriveAPI(*fAuthManager);
+    if (!fAPIClient) {
         _LogMessage("ERROR", "Failed to create OneDrive API client");
         return;
     }
@@ -284,7 +307,7 @@ OneDriveDaemon::_InitializeComponents()
     
     // Initialize attribute manager
     fAttributeManager = new AttributeManager();
-    if (fAttributeManager && fAttributeManager->Initialize(apiClient) != B_OK) {
+    if (fAttributeManager && fAttributeManager->Initialize(fAPIClient) != B_OK) {
         _LogMessage("ERROR", "Failed to initialize attribute manager");
         delete fAttributeManager;
         fAttributeManager = nullptr;
@@ -302,11 +325,38 @@ OneDriveDaemon::_InitializeComponents()
         }
     }
     
-    // TODO: Initialize sync engine
-    // fSyncEngine = new OneDriveSyncEngine();
+    // Initialize cache manager
+    BPath cachePath;
+    if (find_directory(B_USER_CACHE_DIRECTORY, &cachePath, true) == B_OK
+        && cachePath.Append(APP_NAME) == B_OK) {
+        fCacheManager = new OneDrive::CacheManager(cachePath);
+        if (fCacheManager->Initialize() != B_OK) {
+            _LogMessage("ERROR", "Failed to initialize cache manager");
+            delete fCacheManager;
+            fCacheManager = nullptr;
+        } else {
+            _LogMessage("INFO", "CacheManager initialized successfully");
+        }
+    }
     
-    // TODO: Initialize cache manager
-    // fCacheManager = new CacheManager();
+    // Initialize sync engine; it handles its messages in the daemon's
+    // looper, so it is added as a handler before it starts its timer
+    if (fCacheManager && fAttributeManager && !fSyncFolder.IsEmpty()) {
+        create_directory(fSyncFolder.String(), 0755);
+        fSyncEngine = new OneDrive::OneDriveSyncEngine(*fAPIClient,
+            *fCacheManager, *fAttributeManager, BPath(fSyncFolder.String()));
+        AddHandler(fSyncEngine);
+        if (fSyncEngine->Initialize() != B_OK) {
+            _LogMessage("ERROR", "Failed to initialize sync engine");
+            RemoveHandler(fSyncEngine);
+            delete fSyncEngine;
+            fSyncEngine = nullptr;
+        } else {
+            _LogMessage("INFO", "SyncEngine initialized successfully");
+        }
+    } else {
+        _LogMessage("WARN", "Sync engine not created: components missing");
+    }
     
     // TODO: Initialize network monitor
     // fNetworkMonitor = new NetworkMonitor();
@@ -323,8 +373,22 @@ OneDriveDaemon::_CleanupComponents()
     // TODO: Cleanup network monitor
     // delete fNetworkMonitor; fNetworkMonitor = nullptr;
     
-    // TODO: Cleanup cache manager
-    // delete fCacheManager; fCacheManager = nullptr;
+    // Cleanup sync engine; it uses the cache and attribute managers
+    if (fSyncEngine) {
+        fSyncEngine->Shutdown();
+        RemoveHandler(fSyncEngine);
+        delete fSyncEngine;
+        fSyncEngine = nullptr;
+        _LogMessage("INFO", "SyncEngine cleaned up");
+    }
+    
+    // Cleanup cache manager
+    if (fCacheManager) {
+        fCacheManager->Shutdown();
+        delete fCacheManager;
+        fCacheManager = nullptr;
+        _LogMessage("INFO", "CacheManager cleaned up");
+    }
     
     // Cleanup attribute manager
     if (fAttributeManager) {
@@ -334,8 +398,9 @@ OneDriveDaemon::_CleanupComponents()
         _LogMessage("INFO", "AttributeManager cleaned up");
     }
     
-    // TODO: Cleanup sync engine
-    // delete fSyncEngine; fSyncEngine = nullptr;
+    // Cleanup API client
+    delete fAPIClient;
+    fAPIClient = nullptr;
     
     // Cleanup authentication manager
     if (fAuthManager) {
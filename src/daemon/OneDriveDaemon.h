@@ -22,11 +22,14 @@
 #define B_TRANSLATION_CONTEXT "OneDriveDaemon"
 
 // Forward declarations for component classes
-class OneDriveSyncEngine;    ///< Handles file synchronization logic
 class AttributeManager;      ///< Manages BFS attribute synchronization
-class CacheManager;          ///< Handles local file caching
 class AuthenticationManager; ///< Manages OAuth2 authentication
 class NetworkMonitor;        ///< Monitors network connectivity
+class OneDriveAPI;           ///< Microsoft Graph API client
+namespace OneDrive {
+    class CacheManager;          ///< Handles local file caching
+    class OneDriveSyncEngine;    ///< Handles file synchronization logic
+}
 
 /**
  * @brief Message constants for inter-component communication
@@ -243,10 +246,11 @@ public:
 private:
     /// @name Core Components
     /// @{
-    OneDriveSyncEngine*     fSyncEngine;        ///< Handles file synchronization logic
+    OneDrive::OneDriveSyncEngine* fSyncEngine;  ///< Handles file synchronization logic
     AttributeManager*       fAttributeManager;  ///< Manages BFS attribute synchronization
-    CacheManager*          fCacheManager;       ///< Handles local file caching
+    OneDrive::CacheManager* fCacheManager;      ///< Handles local file caching
     AuthenticationManager* fAuthManager;        ///< Manages OAuth2 authentication
+    OneDriveAPI*           fAPIClient;          ///< Graph API client of the components
     NetworkMonitor*        fNetworkMonitor;     ///< Monitors network connectivity
     /// @}
     
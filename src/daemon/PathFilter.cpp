@@ -0,0 +1,469 @@
+/**
+ * @file PathFilter.cpp
+ * @brief Implementation of the compiled path pattern matcher
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "PathFilter.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace OneDrive;
+
+const int32 PathFilter::kMaxStates = 2048;
+const int32 PathFilter::Automaton::kDead;
+
+/**
+ * @brief Automaton node types
+ */
+enum {
+    kNodeLiteral = 0,           ///< One given character
+    kNodeAnyChar,               ///< '?': one character but '/'
+    kNodeClass,                 ///< "[...]": one character of a set
+    kNodeStar,                  ///< '*': any characters but '/'
+    kNodeGlobStar,              ///< "**": any characters
+    kNodeGlobDirEntry,          ///< "**" + '/': skips or enters the body
+    kNodeGlobDirBody,           ///< Any characters, leaves after a '/'
+    kNodeAccept                 ///< End of a pattern
+};
+
+/**
+ * @brief Check a pattern for glob syntax
+ */
+static bool
+HasWildcards(const char* pattern)
+{
+    return strpbrk(pattern, "*?[\\") != NULL;
+}
+
+/**
+ * @brief Constructor
+ */
+PathFilter::Automaton::Automaton()
+    : fPatterns(0),
+      fStart(-1),
+      fResets(0)
+{
+    _Reset();
+}
+
+/**
+ * @brief Drop all patterns
+ */
+void
+PathFilter::Automaton::MakeEmpty()
+{
+    fNodes.clear();
+    fClasses.clear();
+    fStarts.clear();
+    fPatterns = 0;
+    _Reset();
+}
+
+/**
+ * @brief Compile a glob and add it
+ */
+void
+PathFilter::Automaton::Add(const char* pattern, int32 length, bool path)
+{
+    fStarts.push_back(fNodes.size());
+
+    for (int32 i = 0; i < length; i++) {
+        Node node = { kNodeLiteral, (uint8)pattern[i], -1 };
+
+        if (pattern[i] == '*') {
+            node.type = kNodeStar;
+            if (i + 1 < length && pattern[i + 1] == '*') {
+                while (i + 1 < length && pattern[i + 1] == '*') {
+                    i++;
+                }
+                if (path && i + 1 < length && pattern[i + 1] == '/') {
+                    // Zero or more whole folders
+                    i++;
+                    node.type = kNodeGlobDirEntry;
+                    fNodes.push_back(node);
+                    node.type = kNodeGlobDirBody;
+                } else if (path) {
+                    node.type = kNodeGlobStar;
+                }
+            }
+        } else if (pattern[i] == '?') {
+            node.type = kNodeAnyChar;
+        } else if (pattern[i] == '\\' && i + 1 < length) {
+            node.literal = (uint8)pattern[++i];
+        } else if (pattern[i] == '[') {
+            int32 end = i + 1;
+            bool negate = end < length
+                && (pattern[end] == '!' || pattern[end] == '^');
+            if (negate) {
+                end++;
+            }
+            // A ']' right after the opening bracket is a member
+            int32 first = end;
+            if (end < length && pattern[end] == ']') {
+                end++;
+            }
+            while (end < length && pattern[end] != ']') {
+                end++;
+            }
+
+            if (end < length) {
+                uint32 bits[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+                for (int32 j = first; j < end; j++) {
+                    uint8 low = (uint8)pattern[j];
+                    uint8 high = low;
+                    if (j + 2 < end && pattern[j + 1] == '-') {
+                        high = (uint8)pattern[j + 2];
+                        j += 2;
+                    }
+                    for (int32 c = low; c <= high; c++) {
+                        bits[c >> 5] |= 1u << (c & 31);
+                    }
+                }
+                node.type = kNodeClass;
+                node.charClass = fClasses.size() / 8;
+                for (int32 word = 0; word < 8; word++) {
+                    fClasses.push_back(negate ? ~bits[word] : bits[word]);
+                }
+                i = end;
+            }
+            // Without a closing bracket, '[' is an ordinary character
+        }
+
+        fNodes.push_back(node);
+    }
+
+    Node accept = { kNodeAccept, 0, -1 };
+    fNodes.push_back(accept);
+    fPatterns++;
+
+    // Existing states know nothing of the new pattern
+    _Reset();
+}
+
+/**
+ * @brief Get the state before the first character
+ */
+int32
+PathFilter::Automaton::Start()
+{
+    if (fStart < 0) {
+        std::vector<int32> nodes;
+        for (size_t i = 0; i < fStarts.size(); i++) {
+            _Closure(fStarts[i], nodes);
+        }
+        fStart = _StateFor(nodes);
+    }
+    return fStart;
+}
+
+/**
+ * @brief Follow a character, building the next state if needed
+ */
+int32
+PathFilter::Automaton::Step(int32 state, uint8 c)
+{
+    int32 next = fStates[state].next[c];
+    if (next >= 0) {
+        return next;
+    }
+
+    std::vector<int32> nodes;
+    const std::vector<int32>& current = fStates[state].nodes;
+    for (size_t i = 0; i < current.size(); i++) {
+        int32 index = current[i];
+        const Node& node = fNodes[index];
+        switch (node.type) {
+            case kNodeLiteral:
+                if (c == node.literal) {
+                    _Closure(index + 1, nodes);
+                }
+                break;
+            case kNodeAnyChar:
+                if (c != '/') {
+                    _Closure(index + 1, nodes);
+                }
+                break;
+            case kNodeClass:
+                if (c != '/' && (fClasses[node.charClass * 8 + (c >> 5)]
+                        & (1u << (c & 31))) != 0) {
+                    _Closure(index + 1, nodes);
+                }
+                break;
+            case kNodeStar:
+                if (c != '/') {
+                    _Closure(index, nodes);
+                }
+                break;
+            case kNodeGlobStar:
+                _Closure(index, nodes);
+                break;
+            case kNodeGlobDirBody:
+                nodes.push_back(index);
+                if (c == '/') {
+                    _Closure(index + 1, nodes);
+                }
+                break;
+        }
+    }
+
+    int32 resets = fResets;
+    next = _StateFor(nodes);
+    if (resets == fResets) {
+        fStates[state].next[c] = next;
+    }
+    return next;
+}
+
+/**
+ * @brief Add a node and the nodes reachable without input
+ */
+void
+PathFilter::Automaton::_Closure(int32 node, std::vector<int32>& nodes) const
+{
+    switch (fNodes[node].type) {
+        case kNodeStar:
+        case kNodeGlobStar:
+            nodes.push_back(node);
+            _Closure(node + 1, nodes);
+            break;
+        case kNodeGlobDirEntry:
+            nodes.push_back(node + 1);
+            _Closure(node + 2, nodes);
+            break;
+        default:
+            nodes.push_back(node);
+            break;
+    }
+}
+
+/**
+ * @brief Find or create the state for a set of nodes
+ */
+int32
+PathFilter::Automaton::_StateFor(std::vector<int32>& nodes)
+{
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+    std::map<std::vector<int32>, int32>::iterator found
+        = fStateIndex.find(nodes);
+    if (found != fStateIndex.end()) {
+        return found->second;
+    }
+
+    if ((int32)fStates.size() >= kMaxStates) {
+        _Reset();
+        if (nodes.empty()) {
+            return kDead;
+        }
+    }
+
+    State state;
+    state.nodes = nodes;
+    state.accepting = false;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (fNodes[nodes[i]].type == kNodeAccept) {
+            state.accepting = true;
+            break;
+        }
+    }
+    memset(state.next, 0xff, sizeof(state.next));
+
+    int32 index = fStates.size();
+    fStates.push_back(state);
+    fStateIndex[nodes] = index;
+    return index;
+}
+
+/**
+ * @brief Drop every state but the dead one
+ */
+void
+PathFilter::Automaton::_Reset()
+{
+    fStates.clear();
+    fStateIndex.clear();
+    fStart = -1;
+    fResets++;
+
+    State dead;
+    dead.accepting = false;
+    memset(dead.next, 0, sizeof(dead.next));
+    fStates.push_back(dead);
+    fStateIndex[dead.nodes] = kDead;
+}
+
+/**
+ * @brief Constructor
+ */
+PathFilter::PathFilter()
+    : fLock("PathFilter Lock"),
+      fPatterns(0)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+PathFilter::~PathFilter()
+{
+}
+
+/**
+ * @brief Compile a pattern list, replacing the previous one
+ */
+void
+PathFilter::SetPatterns(const BStringList& patterns)
+{
+    BAutolock lock(fLock);
+
+    fNames.clear();
+    fExtensions.clear();
+    fStrings.clear();
+    fNameGlobs.MakeEmpty();
+    fPathGlobs.MakeEmpty();
+    fPatterns = 0;
+
+    std::vector<bool> isExtension;
+    for (int32 i = 0; i < patterns.CountStrings(); i++) {
+        BString pattern(patterns.StringAt(i));
+        pattern.Trim();
+
+        if (pattern.FindFirst('/') >= 0) {
+            while (pattern.StartsWith("/")) {
+                pattern.Remove(0, 1);
+            }
+            while (pattern.EndsWith("/")) {
+                pattern.Truncate(pattern.Length() - 1);
+            }
+            if (pattern.IsEmpty()) {
+                continue;
+            }
+            fPathGlobs.Add(pattern.String(), pattern.Length(), true);
+        } else if (pattern.IsEmpty()) {
+            continue;
+        } else if (!HasWildcards(pattern.String())) {
+            fStrings.push_back(pattern.String());
+            isExtension.push_back(false);
+        } else if (pattern.StartsWith("*.") && pattern.Length() > 2
+            && !HasWildcards(pattern.String() + 2)) {
+            fStrings.push_back(pattern.String() + 2);
+            isExtension.push_back(true);
+        } else {
+            fNameGlobs.Add(pattern.String(), pattern.Length(), false);
+        }
+        fPatterns++;
+    }
+
+    // Views into fStrings, which no longer grows
+    for (size_t i = 0; i < fStrings.size(); i++) {
+        if (isExtension[i]) {
+            fExtensions.insert(fStrings[i]);
+        } else {
+            fNames.insert(fStrings[i]);
+        }
+    }
+}
+
+/**
+ * @brief Check for patterns
+ */
+bool
+PathFilter::IsEmpty() const
+{
+    BAutolock lock(fLock);
+    return fPatterns == 0;
+}
+
+/**
+ * @brief Match a path
+ */
+bool
+PathFilter::Matches(const char* relativePath, bool anyName) const
+{
+    BAutolock lock(fLock);
+
+    if (fPatterns == 0 || relativePath == NULL) {
+        return false;
+    }
+    while (*relativePath == '/') {
+        relativePath++;
+    }
+
+    int32 state = fPathGlobs.IsEmpty() ? Automaton::kDead : fPathGlobs.Start();
+    const char* name = relativePath;
+    for (const char* p = relativePath; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            // The path up to here is a folder above the path, or the path
+            if (state != Automaton::kDead && fPathGlobs.IsAccepting(state)) {
+                return true;
+            }
+            if (p > name && (anyName || *p == '\0')
+                && _MatchesName(name, p - name)) {
+                return true;
+            }
+            if (*p == '\0') {
+                break;
+            }
+            name = p + 1;
+        }
+        if (state != Automaton::kDead) {
+            state = fPathGlobs.Step(state, (uint8)*p);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get statistics
+ */
+PathFilterStats
+PathFilter::Stats() const
+{
+    BAutolock lock(fLock);
+
+    PathFilterStats stats;
+    stats.patterns = fPatterns;
+    stats.names = fNames.size();
+    stats.extensions = fExtensions.size();
+    stats.globs = fNameGlobs.CountPatterns();
+    stats.pathGlobs = fPathGlobs.CountPatterns();
+    stats.states = fNameGlobs.CountStates() + fPathGlobs.CountStates();
+    return stats;
+}
+
+/**
+ * @brief Match name patterns against one name, fLock held
+ */
+bool
+PathFilter::_MatchesName(const char* name, int32 length) const
+{
+    std::string_view view(name, length);
+    if (!fNames.empty() && fNames.count(view) > 0) {
+        return true;
+    }
+
+    // Every suffix after a dot: "a.tar.gz" is a "tar.gz" and a "gz"
+    if (!fExtensions.empty()) {
+        for (int32 i = 0; i < length - 1; i++) {
+            if (name[i] == '.' && fExtensions.count(view.substr(i + 1)) > 0) {
+                return true;
+            }
+        }
+    }
+
+    if (fNameGlobs.IsEmpty()) {
+        return false;
+    }
+    int32 state = fNameGlobs.Start();
+    for (int32 i = 0; i < length && state != Automaton::kDead; i++) {
+        state = fNameGlobs.Step(state, (uint8)name[i]);
+    }
+    return fNameGlobs.IsAccepting(state);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file PathFilter.h
+ * @brief Compiled include and exclude patterns for sync paths
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Every created or moved file is checked against the configured include
+ * and exclude patterns. The PathFilter compiles a pattern list once, so
+ * that checking a path costs the same for three rules as for three
+ * hundred.
+ */
+
+#ifndef PATH_FILTER_H
+#define PATH_FILTER_H
+
+#include <Locker.h>
+#include <String.h>
+#include <StringList.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace OneDrive {
+
+/**
+ * @brief Statistics of a compiled filter
+ */
+struct PathFilterStats {
+    int32 patterns;             ///< Patterns compiled
+    int32 names;                ///< Hashed exact names
+    int32 extensions;           ///< Hashed extensions ("*.ext")
+    int32 globs;                ///< Patterns in the name automaton
+    int32 pathGlobs;            ///< Patterns in the path automaton
+    int32 states;               ///< Automaton states built so far
+};
+
+/**
+ * @brief Set of glob patterns compiled for matching paths
+ *
+ * Patterns without a '/' match a single name:
+ * - "Thumbs.db": an exact name, looked up in a hash table
+ * - "*.tmp", "*.tar.gz": an extension, looked up in a hash table
+ * - anything else with '*', '?', "[a-z]", "[!0-9]" or '\\' escapes
+ *
+ * Patterns with a '/' match the path relative to the sync folder. There
+ * "**" also matches across folders, and "**" followed by a slash stands
+ * for any number of whole folders, none included. Leading and trailing
+ * slashes are ignored.
+ *
+ * All remaining globs of a kind are merged into one automaton, which is
+ * turned into a DFA lazily, state by state, as paths exercise it. Each
+ * character of a path then costs one table lookup, however many patterns
+ * there are. The DFA cache is bounded and starts over when full.
+ *
+ * A pattern matching a folder also matches everything inside it.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class PathFilter {
+public:
+    /**
+     * @brief Constructor, without patterns
+     */
+    PathFilter();
+
+    /**
+     * @brief Destructor
+     */
+    ~PathFilter();
+
+    /**
+     * @brief Compile a pattern list, replacing the previous one
+     *
+     * @param patterns Patterns, see the class description
+     */
+    void SetPatterns(const BStringList& patterns);
+
+    /**
+     * @brief Check for patterns
+     *
+     * @return true if no pattern is set
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @brief Match a path
+     *
+     * Path patterns match the path or any folder above it. Name patterns
+     * match the last name, or any name on the path if asked to.
+     *
+     * @param relativePath Path relative to the sync folder
+     * @param anyName Match name patterns against every folder name too
+     * @return true if a pattern matches
+     */
+    bool Matches(const char* relativePath, bool anyName) const;
+
+    /**
+     * @brief Get statistics
+     *
+     * @return Snapshot of the counters
+     */
+    PathFilterStats Stats() const;
+
+    static const int32 kMaxStates;      ///< DFA states kept before a reset
+
+private:
+    /**
+     * @brief Lazily determinized automaton over a set of globs
+     */
+    class Automaton {
+    public:
+        Automaton();
+
+        void MakeEmpty();
+        void Add(const char* pattern, int32 length, bool path);
+        bool IsEmpty() const { return fPatterns == 0; }
+        int32 CountPatterns() const { return fPatterns; }
+        int32 CountStates() const { return fStates.size(); }
+
+        int32 Start();
+        int32 Step(int32 state, uint8 c);
+        bool IsAccepting(int32 state) const
+            { return fStates[state].accepting; }
+
+        static const int32 kDead = 0;
+
+    private:
+        struct Node {
+            uint8 type;
+            uint8 literal;
+            int32 charClass;    ///< Index into fClasses
+        };
+
+        struct State {
+            std::vector<int32> nodes;
+            bool accepting;
+            int32 next[256];    ///< -1 until computed
+        };
+
+        void _Closure(int32 node, std::vector<int32>& nodes) const;
+        int32 _StateFor(std::vector<int32>& nodes);
+        void _Reset();
+
+        std::vector<Node> fNodes;
+        std::vector<uint32> fClasses;   ///< 8 words per character class
+        std::vector<int32> fStarts;     ///< First node of each pattern
+        int32 fPatterns;
+
+        std::vector<State> fStates;
+        std::map<std::vector<int32>, int32> fStateIndex;
+        int32 fStart;
+        int32 fResets;
+    };
+
+    bool _MatchesName(const char* name, int32 length) const;
+
+private:
+    mutable BLocker fLock;              ///< Protects the DFA caches
+    std::vector<std::string> fStrings;  ///< Storage of the hashed strings
+    std::unordered_set<std::string_view> fNames;
+    std::unordered_set<std::string_view> fExtensions;
+    mutable Automaton fNameGlobs;
+    mutable Automaton fPathGlobs;
+    int32 fPatterns;
+};
+
+} // namespace OneDrive
+
+#endif // PATH_FILTER_H
@@ -0,0 +1,271 @@
+/**
+ * @file RemoteCrawler.cpp
+ * @brief Implementation of the concurrent remote tree crawler
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "RemoteCrawler.h"
+#include "../api/OneDriveAPI.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+using namespace OneDrive;
+
+const int32 RemoteCrawler::kDefaultFrontierLimit = 1024;
+
+/**
+ * @brief Constructor
+ */
+RemoteCrawler::RemoteCrawler(const ListFunction& list,
+    const ApplyFunction& apply, int32 workers, int32 frontierLimit)
+    : fListFunction(list),
+      fApplyFunction(apply),
+      fWorkerCount(workers > 0 ? workers : 1),
+      fFrontierLimit(frontierLimit > 0 ? frontierLimit : kDefaultFrontierLimit),
+      fLock("RemoteCrawler Lock"),
+      fApplyLock("RemoteCrawler Apply Lock"),
+      fPending(0),
+      fWorkSemaphore(-1),
+      fDoneSemaphore(-1),
+      fFinished(false),
+      fError(B_OK)
+{
+    memset(&fStats, 0, sizeof(fStats));
+}
+
+/**
+ * @brief Destructor
+ */
+RemoteCrawler::~RemoteCrawler()
+{
+}
+
+/**
+ * @brief Crawl a folder and everything below it
+ */
+status_t
+RemoteCrawler::Run(const BString& folderId, const BString& folderPath)
+{
+    fWorkSemaphore = create_sem(0, "crawler work");
+    fDoneSemaphore = create_sem(0, "crawler done");
+    if (fWorkSemaphore < 0 || fDoneSemaphore < 0) {
+        delete_sem(fWorkSemaphore);
+        delete_sem(fDoneSemaphore);
+        return B_NO_MORE_SEMS;
+    }
+
+    {
+        BAutolock lock(fLock);
+        memset(&fStats, 0, sizeof(fStats));
+        fError = B_OK;
+        fFinished = false;
+
+        Folder root;
+        root.id = folderId;
+        root.path = folderPath;
+        fFrontier.push_back(root);
+        fPending = 1;
+        fStats.peakFrontier = 1;
+    }
+
+    bigtime_t start = system_time();
+    release_sem(fWorkSemaphore);
+
+    std::vector<thread_id> workers;
+    for (int32 i = 0; i < fWorkerCount; i++) {
+        thread_id thread = spawn_thread(_WorkerThread, "remote crawler",
+            B_NORMAL_PRIORITY, this);
+        if (thread < 0) {
+            break;
+        }
+        workers.push_back(thread);
+        resume_thread(thread);
+    }
+    if (workers.empty()) {
+        _Fail(B_NO_MORE_THREADS);
+    }
+
+    // Ends when the last folder is done or on the first error
+    acquire_sem(fDoneSemaphore);
+
+    fFinished = true;
+    release_sem_etc(fWorkSemaphore, workers.size(), 0);
+
+    status_t exitValue;
+    for (size_t i = 0; i < workers.size(); i++) {
+        wait_for_thread(workers[i], &exitValue);
+    }
+
+    delete_sem(fWorkSemaphore);
+    delete_sem(fDoneSemaphore);
+    fWorkSemaphore = -1;
+    fDoneSemaphore = -1;
+
+    BAutolock lock(fLock);
+    fFrontier.clear();
+    fStats.elapsed = system_time() - start;
+    if (fStats.elapsed > 0) {
+        fStats.itemsPerSecond = fStats.items * 1000000.0f / fStats.elapsed;
+    }
+
+    return fError;
+}
+
+/**
+ * @brief Abort a running crawl
+ */
+void
+RemoteCrawler::Cancel()
+{
+    _Fail(B_CANCELED);
+}
+
+/**
+ * @brief Get statistics of the last crawl
+ */
+RemoteCrawlStats
+RemoteCrawler::Stats() const
+{
+    BAutolock lock(fLock);
+    return fStats;
+}
+
+/**
+ * @brief Worker thread entry point
+ */
+int32
+RemoteCrawler::_WorkerThread(void* data)
+{
+    static_cast<RemoteCrawler*>(data)->_Work();
+    return 0;
+}
+
+/**
+ * @brief Take folders from the frontier until the crawl ends
+ */
+void
+RemoteCrawler::_Work()
+{
+    while (acquire_sem(fWorkSemaphore) == B_OK && !fFinished) {
+        Folder folder;
+        {
+            BAutolock lock(fLock);
+            if (fFrontier.empty()) {
+                continue;
+            }
+            folder = fFrontier.front();
+            fFrontier.pop_front();
+        }
+
+        _Crawl(folder);
+        _FolderDone();
+    }
+}
+
+/**
+ * @brief List one folder, apply it and dispatch its subfolders
+ */
+void
+RemoteCrawler::_Crawl(const Folder& folder)
+{
+    {
+        BAutolock lock(fLock);
+        if (fError != B_OK) {
+            return;
+        }
+    }
+
+    BList items;
+    status_t status = fListFunction(folder.id, items);
+
+    // Listings carry neither parent nor path; delta items carry both
+    BString parentPath(folder.path);
+    if (!parentPath.EndsWith("/")) {
+        parentPath << "/";
+    }
+    std::vector<Folder> subfolders;
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* item = static_cast<OneDriveItem*>(items.ItemAt(i));
+        item->parentId = folder.id;
+        item->path = parentPath;
+        item->path << item->name;
+        if (item->type == ITEM_TYPE_FOLDER && !item->deleted) {
+            Folder subfolder;
+            subfolder.id = item->id;
+            subfolder.path = item->path;
+            subfolders.push_back(subfolder);
+        }
+    }
+
+    if (status == B_OK) {
+        BAutolock applyLock(fApplyLock);
+        status = fApplyFunction(items);
+    }
+
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        delete static_cast<OneDriveItem*>(items.ItemAt(i));
+    }
+
+    if (status != B_OK) {
+        _Fail(status);
+        return;
+    }
+
+    std::vector<Folder> inlineFolders;
+    {
+        BAutolock lock(fLock);
+        fStats.folders++;
+        fStats.items += items.CountItems();
+
+        for (size_t i = 0; i < subfolders.size(); i++) {
+            if ((int32)fFrontier.size() < fFrontierLimit) {
+                fFrontier.push_back(subfolders[i]);
+                fPending++;
+                release_sem(fWorkSemaphore);
+            } else {
+                inlineFolders.push_back(subfolders[i]);
+            }
+        }
+        if ((int32)fFrontier.size() > fStats.peakFrontier) {
+            fStats.peakFrontier = fFrontier.size();
+        }
+        fStats.inlineFolders += inlineFolders.size();
+    }
+
+    // Frontier full: go depth first rather than wait for room
+    for (size_t i = 0; i < inlineFolders.size(); i++) {
+        _Crawl(inlineFolders[i]);
+    }
+}
+
+/**
+ * @brief Mark one queued folder as done
+ */
+void
+RemoteCrawler::_FolderDone()
+{
+    BAutolock lock(fLock);
+    if (--fPending == 0) {
+        release_sem(fDoneSemaphore);
+    }
+}
+
+/**
+ * @brief Record the first error and end the crawl
+ */
+void
+RemoteCrawler::_Fail(status_t error)
+{
+    BAutolock lock(fLock);
+
+    if (fError == B_OK) {
+        fError = error;
+        if (fDoneSemaphore >= 0) {
+            release_sem(fDoneSemaphore);
+        }
+    }
+}
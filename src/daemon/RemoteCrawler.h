@@ -0,0 +1,168 @@
+/**
+ * @file RemoteCrawler.h
+ * @brief Concurrent enumeration of a remote folder tree
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * When delta cannot be used (shared folders, or an expired delta token
+ * that requires a resync), the remote tree has to be walked folder by
+ * folder. The RemoteCrawler lists independent folders in parallel.
+ */
+
+#ifndef REMOTE_CRAWLER_H
+#define REMOTE_CRAWLER_H
+
+#include <List.h>
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace OneDrive {
+
+/**
+ * @brief Statistics of a crawl
+ */
+struct RemoteCrawlStats {
+    int32 folders;              ///< Folders listed
+    int32 items;                ///< Items listed
+    int32 peakFrontier;         ///< Largest number of queued folders
+    int32 inlineFolders;        ///< Folders crawled inline (frontier full)
+    bigtime_t elapsed;          ///< Wall time of the crawl
+    float itemsPerSecond;       ///< Listing throughput
+};
+
+/**
+ * @brief Parallel breadth-first walker over remote folders
+ *
+ * A pool of workers, sized to the API's connection budget, takes folders
+ * from a shared frontier, lists them and queues their subfolders. Listed
+ * items get their path and parent ID filled in and are handed to the same
+ * apply function as delta pages, one folder per call; apply calls are
+ * serialized.
+ *
+ * The frontier is bounded: when it is full, a worker crawls a discovered
+ * subfolder itself, depth first, instead of queueing it. Memory stays
+ * bounded by the tree depth and workers never block on each other.
+ *
+ * Folder IDs mean whatever the list function makes of them: the engine
+ * also walks dropped local folders, with local paths as IDs.
+ *
+ * @see DeltaPipeline
+ * @since 1.0.0
+ */
+class RemoteCrawler {
+public:
+    /**
+     * @brief List the children of a folder as OneDriveItem objects
+     */
+    typedef std::function<status_t(const BString&, BList&)> ListFunction;
+
+    /**
+     * @brief Apply the listed children of one folder as a batch
+     *
+     * Items stay owned by the crawler and are deleted afterwards.
+     */
+    typedef std::function<status_t(const BList&)> ApplyFunction;
+
+    /**
+     * @brief Constructor
+     *
+     * @param list Folder listing function, called from several threads
+     * @param apply Apply function, called from one thread at a time
+     * @param workers Number of folders listed concurrently
+     * @param frontierLimit Folders queued before crawling inline
+     */
+    RemoteCrawler(const ListFunction& list, const ApplyFunction& apply,
+        int32 workers, int32 frontierLimit = kDefaultFrontierLimit);
+
+    /**
+     * @brief Destructor
+     */
+    ~RemoteCrawler();
+
+    /**
+     * @brief Crawl a folder and everything below it
+     *
+     * @param folderId ID of the folder to start from
+     * @param folderPath Path of that folder ("/" for the drive root)
+     * @return B_OK on success, or the first listing or apply error
+     */
+    status_t Run(const BString& folderId, const BString& folderPath);
+
+    /**
+     * @brief Abort a running crawl
+     */
+    void Cancel();
+
+    /**
+     * @brief Get statistics of the last crawl
+     *
+     * @return Crawl statistics
+     */
+    RemoteCrawlStats Stats() const;
+
+    static const int32 kDefaultFrontierLimit;  ///< Default frontier bound
+
+private:
+    /**
+     * @brief Folder waiting to be listed
+     */
+    struct Folder {
+        BString id;             ///< Folder ID
+        BString path;           ///< Folder path
+    };
+
+    /**
+     * @brief Worker thread entry point
+     */
+    static int32 _WorkerThread(void* data);
+
+    /**
+     * @brief Take folders from the frontier until the crawl ends
+     */
+    void _Work();
+
+    /**
+     * @brief List one folder, apply it and dispatch its subfolders
+     *
+     * @param folder Folder to list
+     */
+    void _Crawl(const Folder& folder);
+
+    /**
+     * @brief Mark one queued folder as done
+     */
+    void _FolderDone();
+
+    /**
+     * @brief Record the first error and end the crawl
+     *
+     * @param error Listing or apply error
+     */
+    void _Fail(status_t error);
+
+private:
+    ListFunction fListFunction;
+    ApplyFunction fApplyFunction;
+    int32 fWorkerCount;
+    int32 fFrontierLimit;
+
+    mutable BLocker fLock;              ///< Protects frontier and stats
+    BLocker fApplyLock;                 ///< Serializes apply calls
+    std::deque<Folder> fFrontier;       ///< Folders waiting for a worker
+    int32 fPending;                     ///< Queued or in-progress folders
+    sem_id fWorkSemaphore;              ///< One count per queued folder
+    sem_id fDoneSemaphore;              ///< Released when the crawl ends
+    volatile bool fFinished;            ///< Workers should exit
+    status_t fError;                    ///< First error
+    RemoteCrawlStats fStats;            ///< Statistics of the crawl
+};
+
+} // namespace OneDrive
+
+#endif // REMOTE_CRAWLER_H
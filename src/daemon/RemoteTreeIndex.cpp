@@ -0,0 +1,1176 @@
+/**
+ * @file RemoteTreeIndex.cpp
+ * @brief Implementation of the in-memory remote tree index
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "RemoteTreeIndex.h"
+#include "../api/OneDriveAPI.h"
+
+#include <Autolock.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace OneDrive;
+
+const char* RemoteTreeIndex::kRootAlias = "root";
+const uint32 RemoteTreeIndex::kSnapshotVersion = 2;
+
+static const uint32 kNoNode = 0xffffffff;       // Also marks empty slots
+static const uint32 kTypeMask = 0x3;            // OneDriveItemType
+static const uint32 kPlaceholderFlag = 0x4;     // Referenced, not yet seen
+static const uint32 kFreeFlag = 0x8;            // On the free list
+static const size_t kMinCompactBytes = 64 * 1024;
+static const uint32 kSnapshotMagic = 'ODti';
+
+/**
+ * @brief Snapshot file header
+ *
+ * Followed by the delta token and the node, string and table arrays, each
+ * starting on an 8-byte boundary. All values are in host byte order; a
+ * snapshot from another machine fails the magic check and is rebuilt.
+ */
+struct RemoteTreeIndex::SnapshotHeader {
+    uint32 magic;                       ///< kSnapshotMagic
+    uint32 version;                     ///< kSnapshotVersion
+    uint32 nodeSize;                    ///< sizeof(RemoteTreeNode)
+    uint32 tokenLength;                 ///< Delta token bytes
+    uint64 fileSize;                    ///< Expected file size
+    uint64 checksum;                    ///< Checksum of everything after
+    uint32 nodeCount;                   ///< Entries in the node array
+    uint32 stringBytes;                 ///< Bytes in the string pool
+    uint32 tableSlots[kTableCount];     ///< Slots per table
+    int32 tableCounts[kTableCount];     ///< Entries per table
+    uint32 freeNodes;                   ///< Free node list head
+    int32 itemCount;                    ///< Live nodes, without root
+    int32 placeholderCount;             ///< Live placeholder nodes
+    uint32 reserved;
+    uint64 deadStringBytes;             ///< Pool bytes of removed IDs
+};
+
+/**
+ * @brief Round a snapshot offset up to 8 bytes
+ */
+static inline size_t
+Align(size_t offset)
+{
+    return (offset + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Checksum of a byte range (Fletcher-style, over 32-bit words)
+ */
+static uint64
+Checksum(const uint8* data, size_t length, uint64 sum = 0)
+{
+    uint64 low = sum & 0xffffffff;
+    uint64 high = sum >> 32;
+    size_t words = length / 4;
+    for (size_t i = 0; i < words; i++) {
+        uint32 word;
+        memcpy(&word, data + i * 4, 4);
+        low += word;
+        high += low;
+    }
+    for (size_t i = words * 4; i < length; i++) {
+        low += data[i];
+        high += low;
+    }
+    return ((high % 0xffffffffu) << 32) | (low % 0xffffffffu);
+}
+
+/**
+ * @brief Write a whole buffer to a file descriptor
+ */
+static status_t
+WriteFully(int fd, const void* data, size_t length)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Make room for more elements, growing by a quarter
+ *
+ * Doubling would leave up to half of a million-entry array unused.
+ */
+template<typename T>
+static void
+Grow(std::vector<T>& array, size_t more)
+{
+    if (array.size() + more > array.capacity()) {
+        array.reserve(array.size() + more + array.size() / 4 + 64);
+    }
+}
+
+/**
+ * @brief FNV-1a hash of a string
+ */
+static uint32
+HashString(const char* string)
+{
+    uint32 hash = 2166136261u;
+    for (; *string != '\0'; string++) {
+        hash = (hash ^ (uint8)*string) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief FNV-1a hash of a string, ignoring ASCII case
+ */
+static uint32
+HashFolded(const char* string)
+{
+    uint32 hash = 2166136261u;
+    for (; *string != '\0'; string++) {
+        hash = (hash ^ (uint8)tolower((uint8)*string)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Combine a parent node and a folded name hash
+ */
+static inline uint32
+ChildKey(uint32 parent, uint32 nameHash)
+{
+    return nameHash ^ (parent * 2654435761u);
+}
+
+/**
+ * @brief Combine a content hash and a file size
+ */
+static inline uint32
+ContentKey(uint32 hash, int64 size)
+{
+    return hash ^ ((uint32)size * 2654435761u) ^ (uint32)(size >> 32);
+}
+
+/**
+ * @brief Constructor
+ */
+RemoteTreeIndex::RemoteTreeIndex()
+    : fLock("RemoteTreeIndex Lock"),
+      fModified(false),
+      fMapping(NULL),
+      fMappingSize(0)
+{
+    _Reset();
+}
+
+/**
+ * @brief Destructor
+ */
+RemoteTreeIndex::~RemoteTreeIndex()
+{
+    _Unmap();
+}
+
+/**
+ * @brief Add, update, move or remove an item
+ */
+void
+RemoteTreeIndex::Apply(const OneDriveItem& item)
+{
+    BAutolock lock(fLock);
+    _Detach();
+    fModified = true;
+    _Apply(item);
+}
+
+/**
+ * @brief Apply a batch of items under a single lock
+ */
+void
+RemoteTreeIndex::Apply(const BList& items)
+{
+    BAutolock lock(fLock);
+    if (items.IsEmpty()) {
+        return;
+    }
+    _Detach();
+    fModified = true;
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        _Apply(*static_cast<OneDriveItem*>(items.ItemAt(i)));
+    }
+}
+
+/**
+ * @brief Find an item by ID
+ */
+bool
+RemoteTreeIndex::FindById(const BString& id, OneDriveItem& item) const
+{
+    BAutolock lock(fLock);
+
+    uint32 node = _FindNode(id.String());
+    if (node == kNoNode) {
+        return false;
+    }
+    _FillItem(node, item);
+    return true;
+}
+
+/**
+ * @brief Find an item by path
+ */
+bool
+RemoteTreeIndex::FindByPath(const BString& path, OneDriveItem& item) const
+{
+    BAutolock lock(fLock);
+
+    uint32 node = _FindPath(path);
+    if (node == kNoNode) {
+        return false;
+    }
+    _FillItem(node, item);
+    return true;
+}
+
+/**
+ * @brief Find a file by content
+ */
+bool
+RemoteTreeIndex::FindByContent(const BString& quickXorHash, off_t size,
+    OneDriveItem& item) const
+{
+    if (quickXorHash.IsEmpty()) {
+        return false;
+    }
+
+    BAutolock lock(fLock);
+
+    uint32 node = _FindContent(quickXorHash.String(), size);
+    if (node == kNoNode) {
+        return false;
+    }
+    _FillItem(node, item);
+    return true;
+}
+
+/**
+ * @brief Find the files with a given content
+ */
+int32
+RemoteTreeIndex::FindAllByContent(const BString& quickXorHash, off_t size,
+    BList& items, int32 maxItems) const
+{
+    if (quickXorHash.IsEmpty()) {
+        return 0;
+    }
+
+    BAutolock lock(fLock);
+
+    const SnapshotArray<uint32>& table = fTables[kContentTable];
+    if (table.empty()) {
+        return 0;
+    }
+
+    // Equal keys share one probe chain
+    const char* hash = quickXorHash.String();
+    int32 found = 0;
+    uint32 mask = table.size() - 1;
+    for (uint32 slot = ContentKey(HashString(hash), size) & mask;
+            table[slot] != kNoNode && found < maxItems;
+            slot = (slot + 1) & mask) {
+        const RemoteTreeNode& file = fNodes[table[slot]];
+        if (file.size == size && strcmp(_String(file.hash), hash) == 0) {
+            OneDriveItem* item = new OneDriveItem();
+            _FillItem(table[slot], *item);
+            items.AddItem(item);
+            found++;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Get the path of an item
+ */
+bool
+RemoteTreeIndex::GetPath(const BString& id, BString& path) const
+{
+    BAutolock lock(fLock);
+
+    uint32 node = _FindNode(id.String());
+    return node != kNoNode && _BuildPath(node, path);
+}
+
+/**
+ * @brief List the children of a folder
+ */
+status_t
+RemoteTreeIndex::GetChildren(const BString& id, BList& items) const
+{
+    BAutolock lock(fLock);
+
+    uint32 node = _FindNode(id.String());
+    if (node == kNoNode) {
+        return B_ENTRY_NOT_FOUND;
+    }
+
+    for (uint32 child = fNodes[node].firstChild; child != kNoNode;
+            child = fNodes[child].nextSibling) {
+        OneDriveItem* item = new OneDriveItem();
+        _FillItem(child, *item);
+        items.AddItem(item);
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Get the number of items
+ */
+int32
+RemoteTreeIndex::CountItems() const
+{
+    BAutolock lock(fLock);
+    return fItemCount - fPlaceholderCount;
+}
+
+/**
+ * @brief Get index statistics
+ */
+RemoteTreeStats
+RemoteTreeIndex::GetStats() const
+{
+    BAutolock lock(fLock);
+
+    RemoteTreeStats stats;
+    stats.items = fItemCount - fPlaceholderCount;
+    stats.placeholders = fPlaceholderCount;
+    stats.stringBytes = fStrings.size();
+    stats.memoryUsage = fNodes.capacity() * sizeof(RemoteTreeNode)
+        + fStrings.capacity();
+    for (int32 table = 0; table < kTableCount; table++) {
+        stats.memoryUsage += fTables[table].capacity() * sizeof(uint32);
+    }
+    stats.mappedBytes = fMapping != NULL ? fMappingSize : 0;
+    return stats;
+}
+
+/**
+ * @brief Drop every item
+ */
+void
+RemoteTreeIndex::MakeEmpty()
+{
+    BAutolock lock(fLock);
+    _Reset();
+    fModified = true;
+}
+
+/**
+ * @brief Check for changes since the index was loaded or saved
+ */
+bool
+RemoteTreeIndex::IsModified() const
+{
+    BAutolock lock(fLock);
+    return fModified;
+}
+
+/**
+ * @brief Write the index as a snapshot file
+ */
+status_t
+RemoteTreeIndex::WriteSnapshot(const char* path, const BString& deltaToken)
+{
+    BAutolock lock(fLock);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kSnapshotMagic;
+    header.version = kSnapshotVersion;
+    header.nodeSize = sizeof(RemoteTreeNode);
+    header.tokenLength = deltaToken.Length();
+    header.nodeCount = fNodes.size();
+    header.stringBytes = fStrings.size();
+    for (int32 table = 0; table < kTableCount; table++) {
+        header.tableSlots[table] = fTables[table].size();
+        header.tableCounts[table] = fTableCounts[table];
+    }
+    header.freeNodes = fFreeNodes;
+    header.itemCount = fItemCount;
+    header.placeholderCount = fPlaceholderCount;
+    header.deadStringBytes = fDeadStringBytes;
+
+    // Sections in file order; padding keeps every array aligned
+    struct Section {
+        const void* data;
+        size_t length;
+    } sections[3 + kTableCount] = {
+        { deltaToken.String(), (size_t)deltaToken.Length() },
+        { fNodes.Data(), fNodes.size() * sizeof(RemoteTreeNode) },
+        { fStrings.Data(), fStrings.size() },
+    };
+    for (int32 table = 0; table < kTableCount; table++) {
+        sections[3 + table].data = fTables[table].Data();
+        sections[3 + table].length = fTables[table].size() * sizeof(uint32);
+    }
+
+    static const uint8 kPadding[8] = { 0 };
+    size_t offset = sizeof(header);
+    uint64 checksum = 0;
+    for (size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); i++) {
+        checksum = Checksum(kPadding, Align(offset) - offset, checksum);
+        offset = Align(offset);
+        checksum = Checksum(static_cast<const uint8*>(sections[i].data),
+            sections[i].length, checksum);
+        offset += sections[i].length;
+    }
+    header.fileSize = offset;
+    header.checksum = checksum;
+
+    BString tempPath(path);
+    tempPath << ".tmp";
+    int fd = open(tempPath.String(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return errno;
+    }
+
+    status_t status = WriteFully(fd, &header, sizeof(header));
+    offset = sizeof(header);
+    for (size_t i = 0; status == B_OK
+            && i < sizeof(sections) / sizeof(sections[0]); i++) {
+        status = WriteFully(fd, kPadding, Align(offset) - offset);
+        offset = Align(offset);
+        if (status == B_OK) {
+            status = WriteFully(fd, sections[i].data, sections[i].length);
+        }
+        offset += sections[i].length;
+    }
+    if (status == B_OK && fsync(fd) != 0) {
+        status = errno;
+    }
+    close(fd);
+
+    if (status == B_OK && rename(tempPath.String(), path) != 0) {
+        status = errno;
+    }
+    if (status != B_OK) {
+        unlink(tempPath.String());
+        return status;
+    }
+
+    fModified = false;
+    return B_OK;
+}
+
+/**
+ * @brief Replace the index with a mapped snapshot
+ */
+status_t
+RemoteTreeIndex::MapSnapshot(const char* path, BString& deltaToken)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? B_ENTRY_NOT_FOUND : errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+        close(fd);
+        return B_BAD_DATA;
+    }
+
+    size_t size = st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return errno;
+    }
+
+    const uint8* base = static_cast<const uint8*>(mapping);
+    const SnapshotHeader* header
+        = reinterpret_cast<const SnapshotHeader*>(base);
+
+    // Layout first, so the checksum pass never reads past the end
+    size_t offsets[3 + kTableCount];
+    size_t lengths[3 + kTableCount] = {
+        header->tokenLength,
+        (size_t)header->nodeCount * sizeof(RemoteTreeNode),
+        header->stringBytes,
+    };
+    bool valid = header->magic == kSnapshotMagic
+        && header->version == kSnapshotVersion
+        && header->nodeSize == sizeof(RemoteTreeNode)
+        && header->fileSize == size
+        && header->nodeCount >= 1 && header->stringBytes >= 1;
+    for (int32 table = 0; valid && table < kTableCount; table++) {
+        uint32 slots = header->tableSlots[table];
+        valid = (slots & (slots - 1)) == 0
+            && header->tableCounts[table] >= 0
+            && (uint32)header->tableCounts[table] <= slots;
+        lengths[3 + table] = (size_t)slots * sizeof(uint32);
+    }
+
+    size_t offset = sizeof(SnapshotHeader);
+    uint64 checksum = 0;
+    for (size_t i = 0; valid && i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        checksum = Checksum(base + offset, Align(offset) - offset, checksum);
+        offset = Align(offset);
+        valid = offset <= size && lengths[i] <= size - offset;
+        if (valid) {
+            offsets[i] = offset;
+            checksum = Checksum(base + offset, lengths[i], checksum);
+            offset += lengths[i];
+        }
+    }
+    valid = valid && offset == size && checksum == header->checksum
+        && base[offsets[2] + lengths[2] - 1] == '\0';
+
+    if (!valid) {
+        munmap(mapping, size);
+        return B_BAD_DATA;
+    }
+
+    BAutolock lock(fLock);
+
+    _Reset();
+    fMapping = mapping;
+    fMappingSize = size;
+
+    deltaToken.SetTo(reinterpret_cast<const char*>(base + offsets[0]),
+        header->tokenLength);
+    fNodes.View(reinterpret_cast<const RemoteTreeNode*>(base + offsets[1]),
+        header->nodeCount);
+    fStrings.View(reinterpret_cast<const char*>(base + offsets[2]),
+        header->stringBytes);
+    for (int32 table = 0; table < kTableCount; table++) {
+        fTables[table].View(
+            reinterpret_cast<const uint32*>(base + offsets[3 + table]),
+            header->tableSlots[table]);
+        fTableCounts[table] = header->tableCounts[table];
+    }
+    fFreeNodes = header->freeNodes;
+    fItemCount = header->itemCount;
+    fPlaceholderCount = header->placeholderCount;
+    fDeadStringBytes = header->deadStringBytes;
+    fModified = false;
+
+    return B_OK;
+}
+
+/**
+ * @brief Add or update one item, lock held
+ */
+void
+RemoteTreeIndex::_Apply(const OneDriveItem& item)
+{
+    if (item.id.IsEmpty()) {
+        return;
+    }
+
+    uint32 node = _FindNode(item.id.String());
+
+    // The drive root has no parent; it learns its real ID here
+    if (item.parentId.IsEmpty()) {
+        if (item.deleted || node == 0) {
+            return;
+        }
+        if (node != kNoNode) {
+            _AdoptChildren(node, 0);
+            _RemoveSubtree(node);
+        }
+        if (fNodes[0].id != 0) {
+            _Remove(kIdTable, 0);
+            fDeadStringBytes += strlen(_String(fNodes[0].id)) + 1;
+        }
+        uint32 id = _AddString(item.id.String());
+        fNodes[0].id = id;
+        _Insert(kIdTable, 0);
+        return;
+    }
+
+    if (item.deleted) {
+        if (node != kNoNode && node != 0) {
+            _RemoveSubtree(node);
+        }
+        return;
+    }
+    if (node == 0) {
+        return;
+    }
+
+    uint32 parent = _FindNode(item.parentId.String());
+    if (parent == kNoNode) {
+        parent = _NewNode(item.parentId.String());
+        fNodes[parent].flags |= kPlaceholderFlag;
+        fPlaceholderCount++;
+    }
+
+    if (node == kNoNode) {
+        node = _NewNode(item.id.String());
+    } else {
+        // A folder cannot move below itself; ignore a corrupt move
+        for (uint32 ancestor = parent; ancestor != kNoNode;
+                ancestor = fNodes[ancestor].parent) {
+            if (ancestor == node) {
+                return;
+            }
+        }
+        if ((fNodes[node].flags & kPlaceholderFlag) != 0) {
+            fNodes[node].flags &= ~kPlaceholderFlag;
+            fPlaceholderCount--;
+        }
+        _Unlink(node);
+    }
+
+    // The content key depends on the size, so drop it before the update
+    _SetHash(node, NULL);
+
+    uint32 name = _InternName(item.name.String());
+    RemoteTreeNode& entry = fNodes[node];
+    entry.name = name;
+    entry.flags = (entry.flags & ~kTypeMask) | ((uint32)item.type & kTypeMask);
+    entry.size = item.size;
+    entry.modified = (uint32)item.modifiedTime;
+    _Link(node, parent);
+
+    if (item.type == ITEM_TYPE_FILE) {
+        _SetHash(node, item.quickXorHash.String());
+    }
+}
+
+/**
+ * @brief Find a node by ID, lock held
+ */
+uint32
+RemoteTreeIndex::_FindNode(const char* id) const
+{
+    if (strcmp(id, kRootAlias) == 0) {
+        return 0;
+    }
+
+    const SnapshotArray<uint32>& table = fTables[kIdTable];
+    if (table.empty()) {
+        return kNoNode;
+    }
+
+    uint32 mask = table.size() - 1;
+    for (uint32 slot = HashString(id) & mask; table[slot] != kNoNode;
+            slot = (slot + 1) & mask) {
+        if (strcmp(_String(fNodes[table[slot]].id), id) == 0) {
+            return table[slot];
+        }
+    }
+    return kNoNode;
+}
+
+/**
+ * @brief Find a child by name, lock held
+ */
+uint32
+RemoteTreeIndex::_FindChild(uint32 parent, const char* name) const
+{
+    const SnapshotArray<uint32>& table = fTables[kChildTable];
+    if (table.empty()) {
+        return kNoNode;
+    }
+
+    uint32 mask = table.size() - 1;
+    for (uint32 slot = ChildKey(parent, HashFolded(name)) & mask;
+            table[slot] != kNoNode; slot = (slot + 1) & mask) {
+        const RemoteTreeNode& child = fNodes[table[slot]];
+        if (child.parent == parent
+            && strcasecmp(_String(child.name), name) == 0) {
+            return table[slot];
+        }
+    }
+    return kNoNode;
+}
+
+/**
+ * @brief Find the node for a path, lock held
+ */
+uint32
+RemoteTreeIndex::_FindPath(const BString& path) const
+{
+    uint32 node = 0;
+    int32 start = 0;
+    BString component;
+
+    while (node != kNoNode && start < path.Length()) {
+        int32 end = path.FindFirst('/', start);
+        if (end < 0) {
+            end = path.Length();
+        }
+        if (end > start) {
+            path.CopyInto(component, start, end - start);
+            node = _FindChild(node, component.String());
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+/**
+ * @brief Find a file by hash and size, lock held
+ */
+uint32
+RemoteTreeIndex::_FindContent(const char* hash, int64 size) const
+{
+    const SnapshotArray<uint32>& table = fTables[kContentTable];
+    if (table.empty()) {
+        return kNoNode;
+    }
+
+    uint32 mask = table.size() - 1;
+    for (uint32 slot = ContentKey(HashString(hash), size) & mask;
+            table[slot] != kNoNode; slot = (slot + 1) & mask) {
+        const RemoteTreeNode& file = fNodes[table[slot]];
+        if (file.size == size && strcmp(_String(file.hash), hash) == 0) {
+            return table[slot];
+        }
+    }
+    return kNoNode;
+}
+
+/**
+ * @brief Set or clear the content hash of a node, lock held
+ */
+void
+RemoteTreeIndex::_SetHash(uint32 node, const char* hash)
+{
+    if (fNodes[node].hash != 0) {
+        _Remove(kContentTable, node);
+        fDeadStringBytes += strlen(_String(fNodes[node].hash)) + 1;
+        fNodes[node].hash = 0;
+    }
+    if (hash != NULL && hash[0] != '\0') {
+        uint32 offset = _AddString(hash);
+        fNodes[node].hash = offset;
+        _Insert(kContentTable, node);
+    }
+}
+
+/**
+ * @brief Allocate a node with the given ID, lock held
+ */
+uint32
+RemoteTreeIndex::_NewNode(const char* id)
+{
+    uint32 node;
+    if (fFreeNodes != kNoNode) {
+        node = fFreeNodes;
+        fFreeNodes = fNodes[node].nextSibling;
+    } else {
+        node = fNodes.size();
+        Grow(fNodes.Owned(), 1);
+        fNodes.Owned().push_back(RemoteTreeNode());
+    }
+
+    uint32 offset = _AddString(id);
+    RemoteTreeNode& entry = fNodes[node];
+    entry.id = offset;
+    entry.name = 0;
+    entry.parent = kNoNode;
+    entry.firstChild = kNoNode;
+    entry.nextSibling = kNoNode;
+    entry.previousSibling = kNoNode;
+    entry.flags = ITEM_TYPE_UNKNOWN;
+    entry.modified = 0;
+    entry.hash = 0;
+    entry.size = 0;
+
+    _Insert(kIdTable, node);
+    fItemCount++;
+    return node;
+}
+
+/**
+ * @brief Attach a node as the first child of a parent, lock held
+ */
+void
+RemoteTreeIndex::_Link(uint32 node, uint32 parent)
+{
+    RemoteTreeNode& entry = fNodes[node];
+    entry.parent = parent;
+    entry.previousSibling = kNoNode;
+    entry.nextSibling = fNodes[parent].firstChild;
+    if (entry.nextSibling != kNoNode) {
+        fNodes[entry.nextSibling].previousSibling = node;
+    }
+    fNodes[parent].firstChild = node;
+
+    _Insert(kChildTable, node);
+}
+
+/**
+ * @brief Detach a node from its parent, lock held
+ */
+void
+RemoteTreeIndex::_Unlink(uint32 node)
+{
+    RemoteTreeNode& entry = fNodes[node];
+    if (entry.parent == kNoNode) {
+        return;
+    }
+
+    // The child key depends on the parent, so remove it first
+    _Remove(kChildTable, node);
+
+    if (entry.previousSibling != kNoNode) {
+        fNodes[entry.previousSibling].nextSibling = entry.nextSibling;
+    } else {
+        fNodes[entry.parent].firstChild = entry.nextSibling;
+    }
+    if (entry.nextSibling != kNoNode) {
+        fNodes[entry.nextSibling].previousSibling = entry.previousSibling;
+    }
+    entry.parent = kNoNode;
+    entry.nextSibling = kNoNode;
+    entry.previousSibling = kNoNode;
+}
+
+/**
+ * @brief Move all children of one node to another, lock held
+ */
+void
+RemoteTreeIndex::_AdoptChildren(uint32 from, uint32 to)
+{
+    uint32 child;
+    while ((child = fNodes[from].firstChild) != kNoNode) {
+        _Unlink(child);
+        _Link(child, to);
+    }
+}
+
+/**
+ * @brief Remove a node and everything below it, lock held
+ */
+void
+RemoteTreeIndex::_RemoveSubtree(uint32 node)
+{
+    _Unlink(node);
+
+    std::vector<uint32> pending(1, node);
+    while (!pending.empty()) {
+        uint32 current = pending.back();
+        pending.pop_back();
+
+        for (uint32 child = fNodes[current].firstChild; child != kNoNode;
+                child = fNodes[child].nextSibling) {
+            pending.push_back(child);
+        }
+
+        // Children still point at their parent, so their keys are valid
+        _SetHash(current, NULL);
+        RemoteTreeNode& entry = fNodes[current];
+        if (entry.parent != kNoNode) {
+            _Remove(kChildTable, current);
+        }
+        _Remove(kIdTable, current);
+        fDeadStringBytes += strlen(_String(entry.id)) + 1;
+        if ((entry.flags & kPlaceholderFlag) != 0) {
+            fPlaceholderCount--;
+        }
+        fItemCount--;
+
+        entry.flags = kFreeFlag;
+        entry.firstChild = kNoNode;
+        entry.nextSibling = fFreeNodes;
+        fFreeNodes = current;
+    }
+
+    if (fDeadStringBytes > kMinCompactBytes
+        && fDeadStringBytes > fStrings.size() / 2) {
+        _CompactStrings();
+    }
+}
+
+/**
+ * @brief Build the path of a node, lock held
+ */
+bool
+RemoteTreeIndex::_BuildPath(uint32 node, BString& path) const
+{
+    path.SetTo("");
+    if (node == 0) {
+        path = "/";
+        return true;
+    }
+
+    std::vector<uint32> chain;
+    for (; node != 0; node = fNodes[node].parent) {
+        if (node == kNoNode) {
+            return false;
+        }
+        chain.push_back(node);
+    }
+    for (size_t i = chain.size(); i-- > 0;) {
+        path << "/" << _String(fNodes[chain[i]].name);
+    }
+    return true;
+}
+
+/**
+ * @brief Fill an item from a node, lock held
+ */
+void
+RemoteTreeIndex::_FillItem(uint32 node, OneDriveItem& item) const
+{
+    const RemoteTreeNode& entry = fNodes[node];
+
+    item.id = entry.id != 0 ? _String(entry.id) : kRootAlias;
+    item.name = _String(entry.name);
+    item.type = (OneDriveItemType)(entry.flags & kTypeMask);
+    item.size = entry.size;
+    item.modifiedTime = entry.modified;
+    item.quickXorHash = entry.hash != 0 ? _String(entry.hash) : "";
+    item.deleted = false;
+
+    item.parentId.SetTo("");
+    if (entry.parent != kNoNode) {
+        uint32 parentId = fNodes[entry.parent].id;
+        item.parentId = parentId != 0 ? _String(parentId) : kRootAlias;
+    }
+    if (!_BuildPath(node, item.path)) {
+        item.path.SetTo("");
+    }
+}
+
+/**
+ * @brief Copy a string into the pool, lock held
+ */
+uint32
+RemoteTreeIndex::_AddString(const char* string)
+{
+    size_t length = strlen(string) + 1;
+    std::vector<char>& strings = fStrings.Owned();
+    Grow(strings, length);
+
+    uint32 offset = strings.size();
+    strings.insert(strings.end(), string, string + length);
+    return offset;
+}
+
+/**
+ * @brief Get the pool offset of a name, adding it once, lock held
+ */
+uint32
+RemoteTreeIndex::_InternName(const char* name)
+{
+    if (name[0] == '\0') {
+        return 0;
+    }
+
+    const SnapshotArray<uint32>& table = fTables[kNameTable];
+    if (!table.empty()) {
+        uint32 mask = table.size() - 1;
+        for (uint32 slot = HashString(name) & mask; table[slot] != kNoNode;
+                slot = (slot + 1) & mask) {
+            if (strcmp(_String(table[slot]), name) == 0) {
+                return table[slot];
+            }
+        }
+    }
+
+    uint32 offset = _AddString(name);
+    _Insert(kNameTable, offset);
+    return offset;
+}
+
+/**
+ * @brief Hash the key of a table entry
+ */
+uint32
+RemoteTreeIndex::_Hash(Table table, uint32 value) const
+{
+    switch (table) {
+        case kIdTable:
+            return HashString(_String(fNodes[value].id));
+        case kChildTable:
+            return ChildKey(fNodes[value].parent,
+                HashFolded(_String(fNodes[value].name)));
+        case kContentTable:
+            return ContentKey(HashString(_String(fNodes[value].hash)),
+                fNodes[value].size);
+        case kNameTable:
+        default:
+            return HashString(_String(value));
+    }
+}
+
+/**
+ * @brief Add an entry, growing the table to keep its load under 3/4
+ */
+void
+RemoteTreeIndex::_Insert(Table table, uint32 value)
+{
+    std::vector<uint32>& slots = fTables[table].Owned();
+
+    if ((fTableCounts[table] + 1) * 4 > (int32)slots.size() * 3) {
+        std::vector<uint32> old;
+        old.swap(slots);
+        slots.assign(old.empty() ? 16 : old.size() * 2, kNoNode);
+        fTableCounts[table] = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i] != kNoNode) {
+                _Insert(table, old[i]);
+            }
+        }
+    }
+
+    uint32 mask = slots.size() - 1;
+    uint32 slot = _Hash(table, value) & mask;
+    while (slots[slot] != kNoNode) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = value;
+    fTableCounts[table]++;
+}
+
+/**
+ * @brief Remove an entry
+ */
+void
+RemoteTreeIndex::_Remove(Table table, uint32 value)
+{
+    std::vector<uint32>& slots = fTables[table].Owned();
+    if (slots.empty()) {
+        return;
+    }
+
+    uint32 mask = slots.size() - 1;
+    uint32 slot = _Hash(table, value) & mask;
+    while (slots[slot] != value) {
+        if (slots[slot] == kNoNode) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift later entries of the probe run back into the hole, so lookups
+    // never need tombstones
+    uint32 next = slot;
+    while (true) {
+        next = (next + 1) & mask;
+        if (slots[next] == kNoNode) {
+            break;
+        }
+        uint32 home = _Hash(table, slots[next]) & mask;
+        bool movable = slot <= next
+            ? (home <= slot || home > next)
+            : (home <= slot && home > next);
+        if (movable) {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+    }
+    slots[slot] = kNoNode;
+    fTableCounts[table]--;
+}
+
+/**
+ * @brief Rebuild the string pool without dead IDs and unused names
+ */
+void
+RemoteTreeIndex::_CompactStrings()
+{
+    std::vector<char> old(1, '\0');
+    old.swap(fStrings.Owned());
+    fTables[kNameTable].View(NULL, 0);
+    fTableCounts[kNameTable] = 0;
+
+    // The other tables hold node indices and hash string contents, so
+    // only names are rehashed
+    for (size_t node = 0; node < fNodes.size(); node++) {
+        RemoteTreeNode& entry = fNodes[node];
+        if ((entry.flags & kFreeFlag) != 0) {
+            continue;
+        }
+        uint32 id = entry.id != 0 ? _AddString(&old[entry.id]) : 0;
+        uint32 name = _InternName(&old[entry.name]);
+        uint32 hash = entry.hash != 0 ? _AddString(&old[entry.hash]) : 0;
+        fNodes[node].id = id;
+        fNodes[node].name = name;
+        fNodes[node].hash = hash;
+    }
+
+    fDeadStringBytes = 0;
+}
+
+/**
+ * @brief Reset to an empty tree with only the root
+ */
+void
+RemoteTreeIndex::_Reset()
+{
+    fNodes.View(NULL, 0);
+    fStrings.View(NULL, 0);
+    fStrings.Owned().assign(1, '\0');
+    for (int32 table = 0; table < kTableCount; table++) {
+        fTables[table].View(NULL, 0);
+        fTableCounts[table] = 0;
+    }
+    _Unmap();
+    fFreeNodes = kNoNode;
+    fItemCount = 0;
+    fPlaceholderCount = 0;
+    fDeadStringBytes = 0;
+
+    // Offset 0 is the empty string: the root has no name and, until the
+    // drive tells us, no ID besides its alias
+    RemoteTreeNode root;
+    memset(&root, 0, sizeof(root));
+    root.parent = kNoNode;
+    root.firstChild = kNoNode;
+    root.nextSibling = kNoNode;
+    root.previousSibling = kNoNode;
+    root.flags = ITEM_TYPE_FOLDER;
+    fNodes.Owned().push_back(root);
+}
+
+/**
+ * @brief Copy mapped arrays into memory and drop the mapping
+ */
+void
+RemoteTreeIndex::_Detach()
+{
+    if (fMapping == NULL) {
+        return;
+    }
+
+    fNodes.Owned();
+    fStrings.Owned();
+    for (int32 table = 0; table < kTableCount; table++) {
+        fTables[table].Owned();
+    }
+    _Unmap();
+}
+
+/**
+ * @brief Unmap the snapshot
+ */
+void
+RemoteTreeIndex::_Unmap()
+{
+    if (fMapping != NULL) {
+        munmap(fMapping, fMappingSize);
+        fMapping = NULL;
+        fMappingSize = 0;
+    }
+}
@@ -0,0 +1,421 @@
+/**
+ * @file RemoteTreeIndex.h
+ * @brief Compact in-memory index of the remote drive namespace
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Without a model of the remote tree every path question is a Graph round
+ * trip. The RemoteTreeIndex keeps every item of the drive in flat arrays,
+ * is updated incrementally from delta and crawl results, and answers ID,
+ * path and content queries without the network. The arrays can be saved as a snapshot
+ * and mapped back at startup.
+ */
+
+#ifndef REMOTE_TREE_INDEX_H
+#define REMOTE_TREE_INDEX_H
+
+#include <List.h>
+#include <Locker.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+struct OneDriveItem;
+
+namespace OneDrive {
+
+/**
+ * @brief Remote tree index statistics
+ */
+struct RemoteTreeStats {
+    int32 items;                ///< Items reachable or waiting for a parent
+    int32 placeholders;         ///< Parents referenced but not yet seen
+    size_t stringBytes;         ///< Size of the ID and name pool
+    size_t memoryUsage;         ///< Heap bytes held by the index
+    size_t mappedBytes;         ///< Snapshot bytes in use through mmap
+};
+
+/**
+ * @brief Node of the remote tree
+ *
+ * Plain data, linked by node index: the node array can be copied or
+ * written out as is. Strings are offsets into the string pool.
+ */
+struct RemoteTreeNode {
+    uint32 id;                  ///< Item ID (string pool offset)
+    uint32 name;                ///< Interned item name (string pool offset)
+    uint32 parent;              ///< Parent node
+    uint32 firstChild;          ///< First child node
+    uint32 nextSibling;         ///< Next node under the same parent
+    uint32 previousSibling;     ///< Previous node under the same parent
+    uint32 flags;               ///< Item type and node state
+    uint32 modified;            ///< Last modification (seconds since epoch)
+    uint32 hash;                ///< QuickXorHash (string pool offset), 0 if
+                                ///< unknown
+    int64 size;                 ///< File size in bytes
+};
+
+/**
+ * @brief Array that reads from a mapped snapshot until first written
+ *
+ * Reads go to the mapped data while there is any; the first write copies
+ * it into a private vector. Writers must go through Owned() or the
+ * non-const subscript.
+ */
+template<typename T>
+class SnapshotArray {
+public:
+    SnapshotArray() : fMapped(NULL), fMappedCount(0) {}
+
+    size_t size() const { return fMapped != NULL ? fMappedCount : fOwned.size(); }
+    size_t capacity() const { return fMapped != NULL ? 0 : fOwned.capacity(); }
+    bool empty() const { return size() == 0; }
+    bool IsMapped() const { return fMapped != NULL; }
+    const T* Data() const { return fMapped != NULL ? fMapped : fOwned.data(); }
+
+    const T& operator[](size_t index) const { return Data()[index]; }
+    T& operator[](size_t index) { return Owned()[index]; }
+
+    /**
+     * @brief Read from mapped memory, dropping private contents
+     */
+    void View(const T* data, size_t count)
+    {
+        std::vector<T>().swap(fOwned);
+        fMapped = data;
+        fMappedCount = count;
+    }
+
+    /**
+     * @brief Get the private contents, copying mapped data first
+     */
+    std::vector<T>& Owned()
+    {
+        if (fMapped != NULL) {
+            fOwned.assign(fMapped, fMapped + fMappedCount);
+            fMapped = NULL;
+            fMappedCount = 0;
+        }
+        return fOwned;
+    }
+
+private:
+    const T* fMapped;
+    size_t fMappedCount;
+    std::vector<T> fOwned;
+};
+
+/**
+ * @brief ID and path index over the whole remote drive
+ *
+ * Nodes live in one array and refer to each other by index. Item IDs and
+ * names are stored once in a string pool; names are interned, so the many
+ * items sharing a name share its bytes. Open-addressing tables of node
+ * indices find a node by ID, a child by parent and name, and a file by
+ * content hash and size, so lookups cost O(1) by ID and content and
+ * O(depth) by path. With typical IDs an item takes well under 100 bytes,
+ * plus 29 for a content hash.
+ *
+ * A snapshot is the arrays written one after the other behind a versioned,
+ * checksummed header. Mapping it makes the index usable at once: lookups
+ * read the mapped pages directly, and the first change copies them into
+ * memory.
+ *
+ * Path components compare case-insensitively (ASCII), like OneDrive.
+ * Items may arrive before their parent; the parent is then kept as a
+ * placeholder until it is seen.
+ *
+ * The index is thread-safe.
+ *
+ * @see OneDriveAPI::ParseDeltaPage
+ * @since 1.0.0
+ */
+class RemoteTreeIndex {
+public:
+    /**
+     * @brief Constructor
+     */
+    RemoteTreeIndex();
+
+    /**
+     * @brief Destructor
+     */
+    ~RemoteTreeIndex();
+
+    /**
+     * @brief Add, update, move or remove an item
+     *
+     * An item without a parent ID is the drive root. Removing a folder
+     * removes everything below it.
+     *
+     * @param item Delta or listing result with ID, parent ID and name
+     */
+    void Apply(const OneDriveItem& item);
+
+    /**
+     * @brief Apply a batch of items under a single lock
+     *
+     * @param items OneDriveItem objects
+     */
+    void Apply(const BList& items);
+
+    /**
+     * @brief Find an item by ID
+     *
+     * @param id Item ID ("root" for the drive root)
+     * @param item Receives ID, name, path, parent ID, type, size and
+     *        modification time
+     * @return true if the item is known
+     */
+    bool FindById(const BString& id, OneDriveItem& item) const;
+
+    /**
+     * @brief Find an item by path
+     *
+     * @param path OneDrive path, "/" for the drive root
+     * @param item Receives the item as for FindById()
+     * @return true if the path exists in the index
+     */
+    bool FindByPath(const BString& path, OneDriveItem& item) const;
+
+    /**
+     * @brief Find a file by content
+     *
+     * @param quickXorHash Base64 QuickXorHash of the content
+     * @param size Content size in bytes
+     * @param item Receives the first file found, as for FindById()
+     * @return true if a file with this hash and size is known
+     */
+    bool FindByContent(const BString& quickXorHash, off_t size,
+        OneDriveItem& item) const;
+
+    /**
+     * @brief Find the files with a given content
+     *
+     * @param quickXorHash Base64 QuickXorHash of the content
+     * @param size Content size in bytes
+     * @param items Receives new OneDriveItem objects owned by the caller
+     * @param maxItems Most files to return
+     * @return Number of files added to items
+     */
+    int32 FindAllByContent(const BString& quickXorHash, off_t size,
+        BList& items, int32 maxItems) const;
+
+    /**
+     * @brief Get the path of an item
+     *
+     * @param id Item ID
+     * @param path Receives the path
+     * @return true if the item is known and attached to the root
+     */
+    bool GetPath(const BString& id, BString& path) const;
+
+    /**
+     * @brief List the children of a folder
+     *
+     * @param id Folder ID
+     * @param items Receives new OneDriveItem objects owned by the caller
+     * @return B_OK, or B_ENTRY_NOT_FOUND for an unknown folder
+     */
+    status_t GetChildren(const BString& id, BList& items) const;
+
+    /**
+     * @brief Get the number of items
+     *
+     * @return Item count, without the root
+     */
+    int32 CountItems() const;
+
+    /**
+     * @brief Get index statistics
+     *
+     * @return Snapshot of the counters
+     */
+    RemoteTreeStats GetStats() const;
+
+    /**
+     * @brief Drop every item, e.g. before a full enumeration
+     */
+    void MakeEmpty();
+
+    /**
+     * @brief Check for changes since the index was loaded or saved
+     *
+     * @return true if a snapshot would differ from the last one
+     */
+    bool IsModified() const;
+
+    /**
+     * @brief Write the index as a snapshot file
+     *
+     * The file is written next to its final name and renamed into place,
+     * so a crash never leaves a torn snapshot.
+     *
+     * @param path Snapshot file
+     * @param deltaToken Delta token the index is current with
+     * @return B_OK on success, or an error code
+     */
+    status_t WriteSnapshot(const char* path, const BString& deltaToken);
+
+    /**
+     * @brief Replace the index with a mapped snapshot
+     *
+     * @param path Snapshot file
+     * @param deltaToken Receives the delta token of the snapshot
+     * @return B_OK, B_ENTRY_NOT_FOUND, or B_BAD_DATA for a snapshot of
+     *         another version or with a bad checksum
+     */
+    status_t MapSnapshot(const char* path, BString& deltaToken);
+
+    static const char* kRootAlias;      ///< ID accepted for the drive root
+    static const uint32 kSnapshotVersion; ///< Snapshot format version
+
+private:
+    /**
+     * @brief Add or update one item, lock held
+     */
+    void _Apply(const OneDriveItem& item);
+
+    /**
+     * @brief Find a node by ID, kNoNode if unknown
+     */
+    uint32 _FindNode(const char* id) const;
+
+    /**
+     * @brief Find a child by name, kNoNode if none
+     */
+    uint32 _FindChild(uint32 parent, const char* name) const;
+
+    /**
+     * @brief Find the node for a path, kNoNode if none
+     */
+    uint32 _FindPath(const BString& path) const;
+
+    /**
+     * @brief Find a file by hash and size, kNoNode if none
+     */
+    uint32 _FindContent(const char* hash, int64 size) const;
+
+    /**
+     * @brief Set or clear the content hash of a node
+     */
+    void _SetHash(uint32 node, const char* hash);
+
+    /**
+     * @brief Allocate a node with the given ID
+     */
+    uint32 _NewNode(const char* id);
+
+    /**
+     * @brief Attach a node as the first child of a parent
+     */
+    void _Link(uint32 node, uint32 parent);
+
+    /**
+     * @brief Detach a node from its parent
+     */
+    void _Unlink(uint32 node);
+
+    /**
+     * @brief Move all children of one node to another
+     */
+    void _AdoptChildren(uint32 from, uint32 to);
+
+    /**
+     * @brief Remove a node and everything below it
+     */
+    void _RemoveSubtree(uint32 node);
+
+    /**
+     * @brief Build the path of a node
+     */
+    bool _BuildPath(uint32 node, BString& path) const;
+
+    /**
+     * @brief Fill an item from a node
+     */
+    void _FillItem(uint32 node, OneDriveItem& item) const;
+
+    /**
+     * @brief Copy a string into the pool
+     */
+    uint32 _AddString(const char* string);
+
+    /**
+     * @brief Get the pool offset of a name, adding it once
+     */
+    uint32 _InternName(const char* name);
+
+    /**
+     * @brief Get a string from the pool
+     */
+    const char* _String(uint32 offset) const { return &fStrings[offset]; }
+
+    /**
+     * @brief Hash tables of the index
+     */
+    enum Table {
+        kIdTable = 0,           ///< Node indices, keyed by item ID
+        kChildTable,            ///< Node indices, keyed by parent and name
+        kNameTable,             ///< Pool offsets, keyed by name
+        kContentTable,          ///< File node indices, keyed by hash and size
+        kTableCount
+    };
+
+    /**
+     * @brief Hash the key of a table entry
+     */
+    uint32 _Hash(Table table, uint32 value) const;
+
+    /**
+     * @brief Add an entry, growing the table to keep its load under 3/4
+     */
+    void _Insert(Table table, uint32 value);
+
+    /**
+     * @brief Remove an entry
+     */
+    void _Remove(Table table, uint32 value);
+
+    /**
+     * @brief Rebuild the string pool without dead IDs and unused names
+     */
+    void _CompactStrings();
+
+    /**
+     * @brief Reset to an empty tree with only the root
+     */
+    void _Reset();
+
+    /**
+     * @brief Copy mapped arrays into memory and drop the mapping
+     */
+    void _Detach();
+
+    /**
+     * @brief Unmap the snapshot, arrays must not refer to it
+     */
+    void _Unmap();
+
+    struct SnapshotHeader;
+
+private:
+    mutable BLocker fLock;
+    SnapshotArray<RemoteTreeNode> fNodes;   ///< Node 0 is the root
+    SnapshotArray<char> fStrings;           ///< IDs and interned names
+    SnapshotArray<uint32> fTables[kTableCount]; ///< Open-addressing slots
+    int32 fTableCounts[kTableCount];        ///< Entries per table
+    uint32 fFreeNodes;                      ///< Free node list head
+    int32 fItemCount;                       ///< Live nodes, without root
+    int32 fPlaceholderCount;                ///< Live placeholder nodes
+    size_t fDeadStringBytes;                ///< Pool bytes of removed IDs
+    bool fModified;                         ///< Changed since load or save
+    void* fMapping;                         ///< Mapped snapshot, or NULL
+    size_t fMappingSize;                    ///< Size of the mapping
+};
+
+} // namespace OneDrive
+
+#endif // REMOTE_TREE_INDEX_H
@@ -0,0 +1,232 @@
+/**
+ * @file RetryScheduler.cpp
+ * @brief Implementation of the delayed retry queue
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "RetryScheduler.h"
+#include "../api/OneDriveAPI.h"
+
+#include <Errors.h>
+
+using namespace OneDrive;
+
+/**
+ * @brief Default backoff per error class
+ */
+static const RetryPolicy kDefaultPolicies[kRetryClassCount] = {
+    { 2000000LL, 300000000LL, 3 },      // Network: 2 s .. 5 min
+    { 30000000LL, 600000000LL, 8 },     // Throttled: 30 s .. 10 min
+    { 5000000LL, 300000000LL, 3 },      // Server: 5 s .. 5 min
+    { 1000000LL, 30000000LL, 3 },       // Conflict: 1 s .. 30 s
+    { 0, 0, 0 }                         // Permanent: never retried
+};
+
+/**
+ * @brief Constructor
+ */
+RetryScheduler::RetryScheduler()
+    : fSequence(0),
+      fRandomState((uint32)system_time() | 1)
+{
+    for (int32 i = 0; i < kRetryClassCount; i++) {
+        fPolicies[i] = kDefaultPolicies[i];
+    }
+}
+
+/**
+ * @brief Classify a sync error for retrying
+ */
+RetryErrorClass
+RetryScheduler::Classify(status_t error)
+{
+    switch (error) {
+        case ONEDRIVE_NETWORK_ERROR:
+        case B_TIMED_OUT:
+        case B_WOULD_BLOCK:
+        case B_INTERRUPTED:
+        case ECONNRESET:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+        case EHOSTUNREACH:
+            return kRetryClassNetwork;
+
+        case ONEDRIVE_RATE_LIMITED:
+            return kRetryClassThrottled;
+
+        case ONEDRIVE_SERVER_ERROR:
+        case ONEDRIVE_API_ERROR:
+        case B_ERROR:
+            return kRetryClassServer;
+
+        case B_BUSY:
+        case B_FILE_EXISTS:
+            return kRetryClassConflict;
+
+        default:
+            return kRetryClassPermanent;
+    }
+}
+
+/**
+ * @brief Get a printable name for an error class
+ */
+const char*
+RetryScheduler::ClassName(RetryErrorClass errorClass)
+{
+    switch (errorClass) {
+        case kRetryClassNetwork:
+            return "network";
+        case kRetryClassThrottled:
+            return "throttled";
+        case kRetryClassServer:
+            return "server";
+        case kRetryClassConflict:
+            return "conflict";
+        default:
+            return "permanent";
+    }
+}
+
+/**
+ * @brief Schedule a failed operation
+ */
+RetryDecision
+RetryScheduler::Schedule(SyncItem& item, status_t error, bigtime_t now)
+{
+    RetryErrorClass errorClass = Classify(error);
+    if (errorClass == kRetryClassPermanent) {
+        fParked.push_back(item);
+        return kRetryParked;
+    }
+
+    if (item.retryCount >= fPolicies[errorClass].maxAttempts) {
+        return kRetryExhausted;
+    }
+
+    Entry entry;
+    entry.dueTime = now + ComputeDelay(errorClass, item.retryCount);
+    entry.sequence = fSequence++;
+    item.retryCount++;
+    entry.item = item;
+
+    fScheduled.push(entry);
+    return kRetryScheduled;
+}
+
+/**
+ * @brief Take the next operation that is due
+ */
+bool
+RetryScheduler::PopReady(bigtime_t now, SyncItem& item)
+{
+    if (fScheduled.empty() || fScheduled.top().dueTime > now) {
+        return false;
+    }
+
+    item = fScheduled.top().item;
+    fScheduled.pop();
+    return true;
+}
+
+/**
+ * @brief Get time at which the next operation becomes due
+ */
+bigtime_t
+RetryScheduler::NextDueTime() const
+{
+    if (fScheduled.empty()) {
+        return B_INFINITE_TIMEOUT;
+    }
+
+    return fScheduled.top().dueTime;
+}
+
+/**
+ * @brief Get backoff delay for an attempt
+ */
+bigtime_t
+RetryScheduler::ComputeDelay(RetryErrorClass errorClass, int32 attempt)
+{
+    const RetryPolicy& policy = fPolicies[errorClass];
+
+    bigtime_t delay = policy.baseDelay;
+    for (int32 i = 0; i < attempt && delay < policy.maxDelay; i++) {
+        delay *= 2;
+    }
+    if (delay > policy.maxDelay) {
+        delay = policy.maxDelay;
+    }
+
+    // Equal jitter: keep half the delay, randomize the other half
+    bigtime_t half = delay / 2;
+    if (half <= 0) {
+        return delay;
+    }
+
+    return half + (bigtime_t)(_NextRandom() % (uint64)(half + 1));
+}
+
+/**
+ * @brief Move all parked operations out of the scheduler
+ */
+int32
+RetryScheduler::ReleaseParked(std::vector<SyncItem>& items)
+{
+    int32 count = fParked.size();
+    items.insert(items.end(), fParked.begin(), fParked.end());
+    fParked.clear();
+    return count;
+}
+
+/**
+ * @brief Drop all scheduled and parked operations
+ */
+void
+RetryScheduler::Clear()
+{
+    while (!fScheduled.empty()) {
+        fScheduled.pop();
+    }
+    fParked.clear();
+}
+
+/**
+ * @brief Replace backoff policy for an error class
+ */
+void
+RetryScheduler::SetPolicy(RetryErrorClass errorClass, const RetryPolicy& policy)
+{
+    if (errorClass < 0 || errorClass >= kRetryClassCount) {
+        return;
+    }
+
+    fPolicies[errorClass] = policy;
+}
+
+/**
+ * @brief Set retry budget for all failure-driven classes
+ */
+void
+RetryScheduler::SetMaxAttempts(int32 maxAttempts)
+{
+    fPolicies[kRetryClassNetwork].maxAttempts = maxAttempts;
+    fPolicies[kRetryClassServer].maxAttempts = maxAttempts;
+    fPolicies[kRetryClassConflict].maxAttempts = maxAttempts;
+}
+
+/**
+ * @brief Get next pseudo-random number for jitter (xorshift32)
+ */
+uint32
+RetryScheduler::_NextRandom()
+{
+    uint32 x = fRandomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fRandomState = x;
+    return x;
+}
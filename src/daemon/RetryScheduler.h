@@ -0,0 +1,225 @@
+/**
+ * @file RetryScheduler.h
+ * @brief Delayed retry queue for failed sync operations
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * The RetryScheduler holds failed sync operations until they become
+ * eligible to run again. Delays grow exponentially with jitter and depend
+ * on why the operation failed; operations that cannot succeed by retrying
+ * are parked instead of being requeued.
+ */
+
+#ifndef RETRY_SCHEDULER_H
+#define RETRY_SCHEDULER_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "SyncEngine.h"
+
+namespace OneDrive {
+
+/**
+ * @brief Why an operation failed, as far as retrying is concerned
+ */
+enum RetryErrorClass {
+    kRetryClassNetwork = 0,     ///< Connection lost or timed out
+    kRetryClassThrottled,       ///< Server asked us to slow down
+    kRetryClassServer,          ///< Transient server-side failure
+    kRetryClassConflict,        ///< Item busy or changed underneath us
+    kRetryClassPermanent,       ///< Retrying cannot help
+    kRetryClassCount
+};
+
+/**
+ * @brief Outcome of scheduling a failed operation
+ */
+enum RetryDecision {
+    kRetryScheduled = 0,        ///< Queued for a later attempt
+    kRetryParked,               ///< Not retryable, parked
+    kRetryExhausted             ///< Retry budget used up
+};
+
+/**
+ * @brief Backoff parameters for one error class
+ */
+struct RetryPolicy {
+    bigtime_t baseDelay;        ///< Delay before the first retry
+    bigtime_t maxDelay;         ///< Upper bound for any delay
+    int32 maxAttempts;          ///< Retries allowed before giving up
+};
+
+/**
+ * @brief Min-heap of failed operations ordered by next eligible time
+ *
+ * Failed operations are classified by error and scheduled with
+ * exponential backoff and "equal jitter": the delay for attempt n is
+ * drawn uniformly from [d/2, d] with d = min(maxDelay, baseDelay * 2^n),
+ * so a burst of failures does not retry in lockstep.
+ *
+ * Permanent failures (authentication, quota, missing items, invalid
+ * requests) are parked: they take no queue or worker capacity until the
+ * owner explicitly releases them, e.g. after re-authentication.
+ *
+ * The scheduler is not thread-safe; the owner serializes access.
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class RetryScheduler {
+public:
+    /**
+     * @brief Constructor
+     */
+    RetryScheduler();
+
+    /**
+     * @brief Classify a sync error for retrying
+     *
+     * @param error Error returned by a sync operation (status_t or
+     *        OneDriveError)
+     * @return Error class
+     */
+    static RetryErrorClass Classify(status_t error);
+
+    /**
+     * @brief Get a printable name for an error class
+     *
+     * @param errorClass Error class
+     * @return Class name
+     */
+    static const char* ClassName(RetryErrorClass errorClass);
+
+    /**
+     * @brief Schedule a failed operation
+     *
+     * Increments the item's retry count when it is scheduled.
+     *
+     * @param item Failed sync item
+     * @param error Error returned by the operation
+     * @param now Current system time
+     * @return What happened to the item
+     */
+    RetryDecision Schedule(SyncItem& item, status_t error, bigtime_t now);
+
+    /**
+     * @brief Take the next operation that is due
+     *
+     * @param now Current system time
+     * @param item Receives the operation
+     * @return true if an operation was due
+     */
+    bool PopReady(bigtime_t now, SyncItem& item);
+
+    /**
+     * @brief Get time at which the next operation becomes due
+     *
+     * @return System time, or B_INFINITE_TIMEOUT if nothing is scheduled
+     */
+    bigtime_t NextDueTime() const;
+
+    /**
+     * @brief Get backoff delay for an attempt
+     *
+     * @param errorClass Error class
+     * @param attempt Zero-based retry attempt
+     * @return Delay in microseconds, including jitter
+     */
+    bigtime_t ComputeDelay(RetryErrorClass errorClass, int32 attempt);
+
+    /**
+     * @brief Move all parked operations out of the scheduler
+     *
+     * @param items Receives the parked operations
+     * @return Number of operations released
+     */
+    int32 ReleaseParked(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Drop all scheduled and parked operations
+     */
+    void Clear();
+
+    /**
+     * @brief Get number of scheduled operations
+     *
+     * @return Operations waiting for their retry time
+     */
+    int32 CountScheduled() const { return fScheduled.size(); }
+
+    /**
+     * @brief Get number of parked operations
+     *
+     * @return Operations that need outside intervention
+     */
+    int32 CountParked() const { return fParked.size(); }
+
+    /**
+     * @brief Get backoff policy for an error class
+     *
+     * @param errorClass Error class
+     * @return Current policy
+     */
+    const RetryPolicy& Policy(RetryErrorClass errorClass) const
+        { return fPolicies[errorClass]; }
+
+    /**
+     * @brief Replace backoff policy for an error class
+     *
+     * @param errorClass Error class
+     * @param policy New policy
+     */
+    void SetPolicy(RetryErrorClass errorClass, const RetryPolicy& policy);
+
+    /**
+     * @brief Set retry budget for all failure-driven classes
+     *
+     * Throttling is not a failure of the item and keeps its own budget.
+     *
+     * @param maxAttempts Retries allowed before giving up
+     */
+    void SetMaxAttempts(int32 maxAttempts);
+
+private:
+    /**
+     * @brief Scheduled operation
+     */
+    struct Entry {
+        bigtime_t dueTime;      ///< When the operation becomes eligible
+        uint32 sequence;        ///< Insertion order for equal due times
+        SyncItem item;          ///< Operation to retry
+
+        bool operator>(const Entry& other) const
+        {
+            if (dueTime != other.dueTime) {
+                return dueTime > other.dueTime;
+            }
+            return sequence > other.sequence;
+        }
+    };
+
+    /**
+     * @brief Get next pseudo-random number for jitter
+     *
+     * @return Random value
+     */
+    uint32 _NextRandom();
+
+private:
+    std::priority_queue<Entry, std::vector<Entry>,
+        std::greater<Entry> > fScheduled;       ///< Min-heap by due time
+    std::vector<SyncItem> fParked;              ///< Non-retryable items
+    RetryPolicy fPolicies[kRetryClassCount];    ///< Backoff per class
+    uint32 fSequence;                           ///< Next insertion number
+    uint32 fRandomState;                        ///< Jitter generator state
+};
+
+} // namespace OneDrive
+
+#endif // RETRY_SCHEDULER_H
@@ -7,6 +7,22 @@
  */
 
 #include "SyncEngine.h"
+#include "AdaptivePoller.h"
+#include "DeltaPipeline.h"
+#include "DropJobTracker.h"
+#include "LocalChangeClassifier.h"
+#include "LocalMoveTranslator.h"
+#include "PathFilter.h"
+#include "RemoteCrawler.h"
+#include "RemoteTreeIndex.h"
+#include "RetryScheduler.h"
+#include "SyncPlanOptimizer.h"
+#include "SyncScheduler.h"
+#include "TransferPipeline.h"
+#include "../api/BandwidthShaper.h"
+#include "../api/NotificationChannel.h"
+#include "../api/QuickXorHash.h"
+#include "../shared/AttributeHelper.h"
 #include "../shared/OneDriveConstants.h"
 #include "../shared/ErrorLogger.h"
 #include "../shared/FileSystemConstants.h"
@@ -21,7 +37,6 @@
 #include <VolumeRoster.h>
 #include <fs_attr.h>
 
-#include <private/libroot/SHA256.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -34,11 +49,69 @@ static const uint32 kMsgProcessQueue = 'prcQ';
 static const uint32 kMsgSyncComplete = 'synC';
 static const uint32 kMsgSyncError = 'synE';
 static const uint32 kMsgProgressUpdate = 'prog';
+static const uint32 kMsgCopyFinished = 'cpyF';
+
+// Result of an operation that a helper thread settles later
+static const status_t kSyncResultPending = B_WOULD_BLOCK;
 
 // Default configuration
 static const int32 kDefaultSyncInterval = 300;  // 5 minutes
+static const bigtime_t kMinPollInterval = 5000000LL; // 5 seconds
+static const bigtime_t kStopTimeout = 30000000LL; // 30 seconds
+static const bigtime_t kPushSafetyInterval = 1800000000LL; // 30 minutes
 static const int32 kDefaultMaxRetries = 3;
+static const char* kRemoteTreeSnapshotName = "remote_tree";
+static const char* kSyncQueueName = "sync_queue";
+static const int32 kQueueMemoryItems = 10000;
 static const off_t kDefaultBandwidthLimit = 0;  // Unlimited
+static const off_t kMinDeduplicateSize = 256 * 1024; // Smaller: just transfer
+static const int32 kMaxLocalCopySources = 8;  // Synced copies tried per file
+static const size_t kCopyBufferSize = 256 * 1024;
+
+/**
+ * @brief Where a server-side copy reports back to
+ */
+struct CopyCompletion {
+    OneDriveAPI* api;           ///< Where a failure is described
+    BMessenger target;          ///< The engine
+    BMessage message;           ///< kMsgCopyFinished, outcome to be added
+};
+
+/**
+ * @brief What a helper thread works on
+ */
+struct HelperStart {
+    OneDriveSyncEngine* engine; ///< Engine the work belongs to
+    std::function<void()> work; ///< Work to run
+};
+
+/**
+ * @brief Copy the rest of one file into another, hashing it if asked
+ */
+static status_t
+CopyFileData(BFile& in, BFile& out, QuickXorHash* hash)
+{
+    uint8* buffer = new uint8[kCopyBufferSize];
+    status_t result = B_OK;
+    
+    ssize_t bytesRead;
+    while ((bytesRead = in.Read(buffer, kCopyBufferSize)) > 0) {
+        if (hash != NULL) {
+            hash->Update(buffer, bytesRead);
+        }
+        ssize_t written = out.Write(buffer, bytesRead);
+        if (written != bytesRead) {
+            result = written < 0 ? written : B_IO_ERROR;
+            break;
+        }
+    }
+    if (bytesRead < 0) {
+        result = bytesRead;
+    }
+    
+    delete[] buffer;
+    return result;
+}
 
 /**
  * @brief Constructor
@@ -50,15 +123,47 @@ OneDriveSyncEngine::OneDriveSyncEngine(OneDriveAPI& api, CacheManager& cache,
       fCache(cache),
       fAttributes(attributes),
       fSyncPath(syncPath),
+      fSyncQueue(std::make_unique<SyncScheduler>(kQueueMemoryItems)),
+      fDropJobs(std::make_unique<DropJobTracker>()),
       fLock("SyncEngine Lock"),
       fInitialized(false),
       fIsSyncing(false),
       fIsPaused(false),
       fStopRequested(false),
       fSyncTimer(NULL),
+      fRetries(std::make_unique<RetryScheduler>()),
+      fPoller(std::make_unique<AdaptivePoller>(kMinPollInterval,
+          kDefaultSyncInterval * 1000000LL)),
+      fRemoteTree(std::make_unique<RemoteTreeIndex>()),
+      fBandwidth(std::make_unique<BandwidthShaper>()),
+      fExcludes(std::make_unique<PathFilter>()),
+      fIncludes(std::make_unique<PathFilter>()),
+      fTransfers(std::make_unique<TransferPipeline>(
+          [this](SyncItem& item) { return _ReadTransfer(item); },
+          [this](SyncItem& item) { return _ProcessSyncItem(item); },
+          [this](SyncItem& item) { return _FinalizeTransfer(item); },
+          [this](SyncItem& item, status_t result) {
+              _TransferDone(item, result);
+          })),
+      fLocalChanges(std::make_unique<LocalChangeClassifier>(
+          [this](const BString& path) {
+              return _CalculateFileHash(BPath(path.String()));
+          })),
+      fLocalMoves(std::make_unique<LocalMoveTranslator>(syncPath,
+          [this](const BPath& path) { return _ShouldSync(path); })),
+      fPushActive(false),
+      fWorkerThread(-1),
+      fWakeSemaphore(-1),
+      fStoppedSemaphore(-1),
+      fQuitting(false),
+      fScanRequested(false),
+      fLocalFilesLocated(false),
+      fPollRequested(false),
+      fStopWaiters(0),
       fConflictHandler(NULL),
       fProgressHandler(NULL),
-      fLastSyncTime(0)
+      fLastSyncTime(0),
+      fStartTime(0)
 {
     // Initialize default configuration
     fConfig.direction = kSyncBidirectional;
@@ -69,7 +174,18 @@ OneDriveSyncEngine::OneDriveSyncEngine(OneDriveAPI& api, CacheManager& cache,
     fConfig.maxRetries = kDefaultMaxRetries;
     fConfig.syncInterval = kDefaultSyncInterval;
     fConfig.bandwidthLimit = kDefaultBandwidthLimit;
+    fConfig.uploadLimit = 0;
+    fConfig.downloadLimit = 0;
     fConfig.wifiOnly = false;
+    fConfig.largeFileThreshold = SyncScheduler::kDefaultLargeFileThreshold;
+    fConfig.largeTransferShare = SyncScheduler::kDefaultLargeShare;
+    fConfig.diskConcurrency = TransferPipeline::kDefaultDiskWorkers;
+    fConfig.transferConcurrency = 0;
+    fConfig.deduplicateUploads = true;
+    fConfig.deduplicateDownloads = true;
+    fRetries->SetMaxAttempts(fConfig.maxRetries);
+    _ApplyBandwidthConfig();
+    fAPI.SetBandwidthShaper(fBandwidth.get());
     
     // Initialize statistics
     memset(&fStats, 0, sizeof(fStats));
@@ -81,6 +197,7 @@ OneDriveSyncEngine::OneDriveSyncEngine(OneDriveAPI& api, CacheManager& cache,
 OneDriveSyncEngine::~OneDriveSyncEngine()
 {
     Shutdown();
+    fAPI.SetBandwidthShaper(NULL);
 }
 
 /**
@@ -96,6 +213,7 @@ OneDriveSyncEngine::Initialize()
     }
     
     LOG_INFO("SyncEngine", "Initializing sync engine for path: %s", fSyncPath.Path());
+    fStartTime = system_time();
     
     // Verify sync path exists
     BDirectory syncDir(fSyncPath.Path());
@@ -115,19 +233,42 @@ OneDriveSyncEngine::Initialize()
         // Not fatal, we can start fresh
     }
     
-    // Start sync timer
+    // Start the sync worker; it sleeps until there is work
+    result = _StartWorker();
+    if (result != B_OK) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to start sync worker");
+        return result;
+    }
+    if (!fSyncQueue->IsEmpty()) {
+        _WakeWorker();
+    }
+    
+    // Start remote poll timer; its interval adapts to the change rate
     BMessage timerMsg(kMsgSyncTimer);
-    fSyncTimer = new BMessageRunner(this, &timerMsg, 
-        fConfig.syncInterval * 1000000LL); // Convert to microseconds
+    fSyncTimer = new BMessageRunner(this, &timerMsg,
+        fPoller->CurrentInterval());
     
     if (!fSyncTimer || fSyncTimer->InitCheck() != B_OK) {
         ErrorLogger::Instance().LogError("SyncEngine", B_ERROR,
             "Failed to create sync timer");
         delete fSyncTimer;
         fSyncTimer = NULL;
+        _StopWorker();
         return B_ERROR;
     }
     
+    // Remote changes are pushed while the notification channel is up;
+    // until then, and whenever it drops, the poll timer takes over
+    fNotifications = std::make_unique<NotificationChannel>(&fAPI,
+        BMessenger(this));
+    result = fNotifications->Start();
+    if (result != B_OK) {
+        LOG_WARNING("SyncEngine", "Notification channel unavailable, "
+            "polling for remote changes");
+        fNotifications.reset();
+    }
+    
     fInitialized = true;
     LOG_INFO("SyncEngine", "Sync engine initialized successfully");
     
@@ -140,27 +281,62 @@ OneDriveSyncEngine::Initialize()
 void
 OneDriveSyncEngine::Shutdown()
 {
-    BAutolock lock(fLock);
-    
-    if (!fInitialized) {
-        return;
+    {
+        BAutolock lock(fLock);
+        
+        if (!fInitialized) {
+            return;
+        }
+        
+        LOG_INFO("SyncEngine", "Shutting down sync engine");
     }
     
-    LOG_INFO("SyncEngine", "Shutting down sync engine");
+    // The channel reports to this handler; stop it before tearing down
+    if (fNotifications) {
+        fNotifications->Stop();
+        fNotifications.reset();
+    }
+    fPushActive = false;
     
-    // Stop sync operations
+    // Stop sync operations; the worker needs the lock to wind down
     StopSync();
+    _StopWorker();
+    
+    // Drop jobs still walking folders give up at their next folder; a
+    // helper may start another before it ends, so wait until none is left
+    fQuitting = true;
+    for (;;) {
+        std::set<thread_id> helpers;
+        {
+            BAutolock lock(fLock);
+            helpers.swap(fHelperThreads);
+        }
+        if (helpers.empty()) {
+            break;
+        }
+        for (std::set<thread_id>::iterator it = helpers.begin();
+                it != helpers.end(); ++it) {
+            status_t exitValue;
+            wait_for_thread(*it, &exitValue);
+        }
+    }
+    
+    BAutolock lock(fLock);
     
     // Stop sync timer
     delete fSyncTimer;
     fSyncTimer = NULL;
     
     // Save sync state
-    _SaveSyncState();
+    _SaveSyncQueue();
+    BString deltaToken = fDeltaToken;
     
     // TODO: Shutdown virtual folder when integrated
     
     fInitialized = false;
+    lock.Unlock();
+    
+    _SaveRemoteTree(deltaToken);
 }
 
 /**
@@ -185,46 +361,18 @@ OneDriveSyncEngine::StartSync(bool fullSync)
     fStopRequested = false;
     fStats.startTime = time(NULL);
     fStats.endTime = 0;
+    fStats.operationsSaved = 0;
+    fFolderIds.clear();
     
     // Clear delta token for full sync
     if (fullSync) {
         fDeltaToken.SetTo("");
     }
     
-    // Start sync in separate thread
-    thread_id syncThread = spawn_thread(
-        [](void* data) -> status_t {
-            OneDriveSyncEngine* engine = static_cast<OneDriveSyncEngine*>(data);
-            
-            // Scan for changes
-            status_t result = engine->_ScanLocalChanges();
-            if (result != B_OK) {
-                ErrorLogger::Instance().LogError("SyncEngine", result,
-                    "Failed to scan local changes");
-                return result;
-            }
-            
-            result = engine->_ScanRemoteChanges();
-            if (result != B_OK) {
-                ErrorLogger::Instance().LogError("SyncEngine", result,
-                    "Failed to scan remote changes");
-                return result;
-            }
-            
-            // Process sync queue
-            engine->_ProcessSyncQueue();
-            
-            return B_OK;
-        },
-        "sync_thread", B_NORMAL_PRIORITY, this
-    );
-    
-    if (syncThread < 0) {
-        fIsSyncing = false;
-        return syncThread;
-    }
+    // The worker scans for changes, then drains the queue
+    fScanRequested = true;
+    _WakeWorker();
     
-    resume_thread(syncThread);
     return B_OK;
 }
 
@@ -243,14 +391,22 @@ OneDriveSyncEngine::StopSync()
     LOG_INFO("SyncEngine", "Stopping sync");
     
     fStopRequested = true;
+    fStopWaiters++;
+    _WakeWorker();
     
-    // Wait for sync to stop (with timeout)
-    int32 timeout = 30; // 30 seconds
-    while (fIsSyncing && timeout > 0) {
-        lock.Unlock();
-        snooze(1000000); // 1 second
-        lock.Lock();
-        timeout--;
+    // The worker stops after the current item and signals us right away
+    lock.Unlock();
+    status_t result = acquire_sem_etc(fStoppedSemaphore, 1,
+        B_RELATIVE_TIMEOUT, kStopTimeout);
+    lock.Lock();
+    
+    if (result != B_OK) {
+        if (fStopWaiters > 0) {
+            fStopWaiters--;
+        } else {
+            // Signalled between the timeout and relocking: consume it
+            acquire_sem_etc(fStoppedSemaphore, 1, B_RELATIVE_TIMEOUT, 0);
+        }
     }
     
     if (fIsSyncing) {
@@ -289,17 +445,15 @@ OneDriveSyncEngine::ResumeSync()
     LOG_INFO("SyncEngine", "Resuming sync");
     fIsPaused = false;
     
-    // Notify processing thread
-    if (Looper()) {
-        Looper()->PostMessage(kMsgProcessQueue, this);
-    }
+    _WakeWorker();
 }
 
 /**
  * @brief Force sync of specific path
  */
 status_t
-OneDriveSyncEngine::SyncPath(const BPath& path, bool recursive)
+OneDriveSyncEngine::SyncPath(const BPath& path, bool recursive,
+    SyncPriority priority)
 {
     BAutolock lock(fLock);
     
@@ -312,33 +466,43 @@ OneDriveSyncEngine::SyncPath(const BPath& path, bool recursive)
     // Create sync item for the path
     SyncItem item;
     item.localPath = path.Path();
+    item.remotePath = _RemotePathFor(path);
     item.status = kSyncStatusPending;
     item.retryCount = 0;
+    item.size = 0;
+    item.priority = priority;
+    
+    // A single existence check, usually answered by the API's path cache
+    BString itemId;
+    bool existsRemotely
+        = fAPI.GetItemIdByPath(item.remotePath, itemId) == ONEDRIVE_OK;
     
     // Determine operation based on file existence
     BEntry entry(path.Path());
     if (entry.Exists()) {
-        // Check if it's in OneDrive
-        OneDriveItem fileInfo;
-        if (fAPI.GetItemInfo(path.Path(), fileInfo) == ONEDRIVE_OK) {
+        // The size picks the scheduling lane
+        entry.GetSize(&item.size);
+        if (existsRemotely) {
             item.operation = kSyncOpUpdate;
-            item.fileId = fileInfo.id;
+            item.fileId = itemId;
         } else {
             item.operation = kSyncOpUpload;
         }
     } else {
-        // Check if it exists in OneDrive
-        OneDriveItem fileInfo;
-        if (fAPI.GetItemInfo(path.Path(), fileInfo) == ONEDRIVE_OK) {
+        if (existsRemotely) {
             item.operation = kSyncOpDownload;
-            item.fileId = fileInfo.id;
+            item.fileId = itemId;
+            OneDriveItem remoteItem;
+            if (fRemoteTree->FindByPath(item.remotePath, remoteItem)) {
+                item.size = remoteItem.size;
+            }
         } else {
             return B_ENTRY_NOT_FOUND;
         }
     }
     
-    // Add to priority queue
-    _AddToQueue(item);
+    // Queue in the lane for its priority and size
+    _AddToQueue(std::move(item));
     
     // Process immediately if not syncing
     if (!fIsSyncing) {
@@ -357,13 +521,18 @@ OneDriveSyncEngine::SetConfig(const SyncConfig& config)
     BAutolock lock(fLock);
     
     fConfig = config;
-    
-    // Update sync timer interval
-    if (fSyncTimer) {
-        delete fSyncTimer;
-        BMessage timerMsg(kMsgSyncTimer);
-        fSyncTimer = new BMessageRunner(this, &timerMsg,
-            fConfig.syncInterval * 1000000LL);
+    fRetries->SetMaxAttempts(fConfig.maxRetries);
+    fSyncQueue->SetLargeFileThreshold(fConfig.largeFileThreshold);
+    fSyncQueue->SetLargeShare(fConfig.largeTransferShare);
+    _ApplyTransferConcurrency();
+    _ApplyBandwidthConfig();
+    fExcludes->SetPatterns(fConfig.excludePatterns);
+    fIncludes->SetPatterns(fConfig.includePatterns);
+    
+    // The sync interval is the ceiling for idle remote polling
+    fPoller->SetLimits(kMinPollInterval, fConfig.syncInterval * 1000000LL);
+    if (fSyncTimer && !fPushActive) {
+        fSyncTimer->SetInterval(fPoller->CurrentInterval());
     }
     
     LOG_INFO("SyncEngine", "Sync configuration updated");
@@ -388,6 +557,44 @@ OneDriveSyncEngine::GetStats() const
         }
     }
     
+    stats.pollInterval = fPoller->CurrentInterval() / 1000000;
+    stats.pollHitRatio = fPoller->HitRatio();
+    stats.pushActive = fPushActive;
+    if (fNotifications) {
+        stats.remoteNotifications = fNotifications->GetStats().notifications;
+    }
+    RemoteTreeStats treeStats = fRemoteTree->GetStats();
+    stats.remoteItems = treeStats.items;
+    stats.remoteIndexBytes = treeStats.memoryUsage;
+    stats.queueBytes = fSyncQueue->MemoryUsage();
+    stats.queueSpilled = fSyncQueue->CountSpilled();
+    stats.userQueueWait = fSyncQueue->LaneStats(kSyncLaneUser).averageWait;
+    stats.smallQueueWait = fSyncQueue->LaneStats(kSyncLaneSmall).averageWait;
+    stats.largeQueueWait = fSyncQueue->LaneStats(kSyncLaneLarge).averageWait;
+    stats.maxQueueWait = 0;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        bigtime_t wait = fSyncQueue->LaneStats((SyncLane)lane).maxWait;
+        if (wait > stats.maxQueueWait) {
+            stats.maxQueueWait = wait;
+        }
+    }
+    TransferPipelineStats transferStats = fTransfers->Stats();
+    stats.diskUtilization
+        = transferStats.stages[kTransferStageDisk].utilization;
+    stats.networkUtilization
+        = transferStats.stages[kTransferStageNetwork].utilization;
+    stats.finalizeUtilization
+        = transferStats.stages[kTransferStageFinalize].utilization;
+    BandwidthStats uploadStats = fBandwidth->Stats(kBandwidthUpload);
+    BandwidthStats downloadStats = fBandwidth->Stats(kBandwidthDownload);
+    stats.uploadRateLimit = uploadStats.limit;
+    stats.downloadRateLimit = downloadStats.limit;
+    stats.throttledTime = uploadStats.throttled + downloadStats.throttled;
+    stats.changesHashed = fLocalChanges->Stats().hashed;
+    AttributeSyncStats attributeStats = fAttributes.GetSyncStats();
+    stats.attributeBacklog = attributeStats.backlog;
+    stats.attributeDrainRate = attributeStats.drainRate;
+    
     return stats;
 }
 
@@ -398,7 +605,7 @@ int32
 OneDriveSyncEngine::GetQueueSize() const
 {
     BAutolock lock(fLock);
-    return fSyncQueue.size();
+    return fSyncQueue->Count();
 }
 
 /**
@@ -419,7 +626,6 @@ OneDriveSyncEngine::HandleNodeMonitor(BMessage* message)
     // Handle different node monitor events
     switch (opcode) {
         case B_ENTRY_CREATED:
-        case B_ENTRY_MOVED:
         {
             entry_ref ref;
             const char* name;
@@ -429,38 +635,115 @@ OneDriveSyncEngine::HandleNodeMonitor(BMessage* message)
                 
                 ref.set_name(name);
                 BPath path(&ref);
+                _LocateLocalEntry(message, path);
                 
-                if (_ShouldSync(path)) {
-                    LOG_INFO("SyncEngine", "File created/moved: %s", path.Path());
+                // Copies made by the daemon arrive by server-side copy
+                if (_ShouldSync(path) && !_IsCopyDestination(path.Path())) {
+                    LOG_INFO("SyncEngine", "File created: %s", path.Path());
                     SyncPath(path, false);
                 }
             }
             break;
         }
         
+        case B_ENTRY_MOVED:
+        {
+            SyncItem item;
+            LocalMoveKind kind = fLocalMoves->Translate(message, item);
+            if (kind == kLocalMoveIgnored) {
+                break;
+            }
+            
+            BPath path(item.localPath.String());
+            if (kind != kLocalMoveOut) {
+                _LocateLocalEntry(message, path);
+            }
+            
+            // Dropped moves are queued by the drop job already
+            if (_IsMoveDestination(item.localPath)) {
+                break;
+            }
+            
+            switch (kind) {
+                case kLocalMoveWithin:
+                    // One server-side move carries a whole folder
+                    LOG_INFO("SyncEngine", "Moved: %s -> %s",
+                        item.previousPath.String(), item.remotePath.String());
+                    _AddToQueue(std::move(item));
+                    break;
+                case kLocalMoveIn:
+                    LOG_INFO("SyncEngine", "Moved in: %s", path.Path());
+                    SyncPath(path, true);
+                    break;
+                case kLocalMoveOut:
+                    LOG_INFO("SyncEngine", "Moved out: %s", path.Path());
+                    _QueueLocalDelete(item.localPath);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        }
+        
         case B_ENTRY_REMOVED:
         {
-            entry_ref ref;
-            if (message->FindInt32("device", &ref.device) == B_OK &&
-                message->FindInt64("node", &ref.directory) == B_OK) {
-                
-                LOG_INFO("SyncEngine", "File removed");
-                // Handle deletion
-                // TODO: Track path for deleted items
+            node_ref node;
+            if (message->FindInt32("device", &node.device) != B_OK ||
+                message->FindInt64("node", &node.node) != B_OK) {
+                break;
+            }
+            
+            // The path it was synced under, or else its name in the
+            // directory it was removed from, while that still exists
+            BString localPath;
+            if (!fLocalChanges->PathFor(node, localPath)) {
+                entry_ref ref;
+                const char* name;
+                ref.device = node.device;
+                if (message->FindInt64("directory", &ref.directory) == B_OK &&
+                    message->FindString("name", &name) == B_OK) {
+                    ref.set_name(name);
+                    BPath path(&ref);
+                    if (path.InitCheck() == B_OK) {
+                        localPath = path.Path();
+                    }
+                }
+            }
+            fLocalChanges->Forget(node);
+            
+            if (!localPath.IsEmpty()) {
+                LOG_INFO("SyncEngine", "File removed: %s", localPath.String());
+                _QueueLocalDelete(localPath);
             }
             break;
         }
         
         case B_STAT_CHANGED:
+        {
+            // Permission, owner and access time changes are not synced
+            int32 fields;
+            if (message->FindInt32("fields", &fields) == B_OK
+                && (fields & (B_STAT_SIZE | B_STAT_MODIFICATION_TIME)) == 0) {
+                break;
+            }
+            
+            node_ref node;
+            if (message->FindInt32("device", &node.device) == B_OK &&
+                message->FindInt64("node", &node.node) == B_OK) {
+                _QueueLocalChange(node, NULL);
+            }
+            break;
+        }
+        
         case B_ATTR_CHANGED:
         {
-            entry_ref ref;
-            if (message->FindInt32("device", &ref.device) == B_OK &&
-                message->FindInt64("node", &ref.directory) == B_OK) {
-                
-                LOG_INFO("SyncEngine", "File/attr changed");
-                // Handle modification
-                // TODO: Track path for modified items
+            node_ref node;
+            const char* attribute;
+            if (fConfig.syncAttributes &&
+                message->FindInt32("device", &node.device) == B_OK &&
+                message->FindInt64("node", &node.node) == B_OK &&
+                message->FindString("attr", &attribute) == B_OK) {
+                _QueueLocalChange(node, attribute);
             }
             break;
         }
@@ -475,15 +758,36 @@ OneDriveSyncEngine::MessageReceived(BMessage* message)
 {
     switch (message->what) {
         case kMsgSyncTimer:
-            if (!fIsSyncing && !fIsPaused) {
-                StartSync(false);
-            }
+            _SyncTimerTick();
             break;
             
         case kMsgProcessQueue:
-            if (!fStopRequested) {
-                _ProcessSyncQueue();
-            }
+            _WakeWorker();
+            break;
+            
+        case kMsgRemoteChangeNotified:
+            _RemoteChangeNotified();
+            break;
+            
+        case kMsgNotificationChannelState:
+            _NotificationChannelChanged(message->GetBool("connected", false));
+            break;
+            
+        case kMsgSyncRequired:
+        case kMsgDownloadFile:
+            _QueueUserRequest(message);
+            break;
+            
+        case kMsgCopyItem:
+            _QueueUserCopy(message);
+            break;
+            
+        case kMsgCopyFinished:
+            _CopyFinished(message);
+            break;
+            
+        case kMsgDropJob:
+            _QueueDropJob(message);
             break;
             
         case B_NODE_MONITOR:
@@ -512,290 +816,2418 @@ OneDriveSyncEngine::_ScanLocalChanges()
         return dir.InitCheck();
     }
     
+    // Files already here when the daemon started are found by node from
+    // then on; entry events keep that current
+    if (!fLocalFilesLocated) {
+        _LocateLocalFiles(fSyncPath);
+        fLocalFilesLocated = true;
+    }
+    
     return B_OK;
 }
 
+/**
+ * @brief Record where every file below a folder is
+ */
+void
+OneDriveSyncEngine::_LocateLocalFiles(const BPath& folder)
+{
+    BDirectory directory(folder.Path());
+    BEntry entry;
+    while (directory.GetNextEntry(&entry) == B_OK) {
+        if (fQuitting) {
+            return;
+        }
+        
+        BPath path;
+        if (entry.GetPath(&path) != B_OK || !_ShouldSync(path)) {
+            continue;
+        }
+        
+        if (entry.IsDirectory()) {
+            _LocateLocalFiles(path);
+        } else if (entry.IsFile()) {
+            node_ref node;
+            if (entry.GetNodeRef(&node) == B_OK) {
+                fLocalChanges->Locate(node, path.Path());
+            }
+        }
+    }
+}
+
+/**
+ * @brief Follow a created or moved entry by node
+ */
+void
+OneDriveSyncEngine::_LocateLocalEntry(BMessage* message, const BPath& path)
+{
+    node_ref node;
+    if (message->FindInt32("device", &node.device) != B_OK
+        || message->FindInt64("node", &node.node) != B_OK) {
+        return;
+    }
+    
+    // What was recorded at the old path, or below a renamed folder, is
+    // now at the new one
+    if (message->GetInt32("opcode", 0) == B_ENTRY_MOVED) {
+        BString previousPath;
+        entry_ref from;
+        const char* fromName;
+        if (!fLocalChanges->PathFor(node, previousPath)
+            && message->FindInt64("from directory", &from.directory) == B_OK
+            && message->FindString("from name", &fromName) == B_OK) {
+            from.device = node.device;
+            from.set_name(fromName);
+            previousPath = BPath(&from).Path();
+        }
+        if (!previousPath.IsEmpty()) {
+            fLocalChanges->MoveTree(previousPath, path.Path());
+        }
+    }
+    
+    // Only files: the stat changes of a folder are its entries changing
+    BEntry entry(path.Path());
+    if (entry.IsFile() && _ShouldSync(path)) {
+        fLocalChanges->Locate(node, path.Path());
+    }
+}
+
 /**
  * @brief Scan remote changes
  */
 status_t
 OneDriveSyncEngine::_ScanRemoteChanges()
 {
-    LOG_INFO("SyncEngine", "Scanning remote changes");
+    LOG_DEBUG("SyncEngine", "Scanning remote changes");
     
-    // Use delta token if available
-    BList items;
-    status_t result;
+    // Every scan is a delta call: a full enumeration without a token,
+    // and usually an empty result with one
+    BString deltaToken;
+    BString newDeltaToken;
+    {
+        BAutolock lock(fLock);
+        deltaToken = fDeltaToken;
+    }
     
-    if (fDeltaToken.IsEmpty()) {
-        // Full scan
-        result = fAPI.ListFolder("/", items);
-    } else {
-        // Delta scan
-        // TODO: Implement delta API call
-        result = fAPI.ListFolder("/", items);
+    // A full enumeration rebuilds the remote tree from scratch
+    if (deltaToken.IsEmpty()) {
+        fRemoteTree->MakeEmpty();
+    }
+    
+    // Fetch, parse and apply overlap, so a long enumeration is bound by
+    // its slowest stage rather than by the sum of all three
+    int32 changes = 0;
+    DeltaPipeline pipeline(
+        [this](const BString& token, BString& page, BString& nextToken,
+            BString& finalToken) -> status_t {
+            return fAPI.FetchDeltaPage(token, page, nextToken, finalToken);
+        },
+        [this](const BString& page, BList& items) -> status_t {
+            return fAPI.ParseDeltaPage(page, items);
+        },
+        [this, &changes](const BList& items) -> status_t {
+            return _ApplyRemoteChanges(items, changes);
+        });
+    
+    status_t result = pipeline.Run(deltaToken, newDeltaToken);
+    
+    DeltaPipelineStats pipelineStats = pipeline.Stats();
+    if (pipelineStats.pages > 1) {
+        LOG_INFO("SyncEngine", "Delta: %d pages, %d items in %d ms "
+            "(fetch %d ms, parse %d ms, apply %d ms, %s-bound)",
+            (int)pipelineStats.pages, (int)pipelineStats.items,
+            (int)(pipelineStats.elapsed / 1000),
+            (int)(pipelineStats.busy[kDeltaStageFetch] / 1000),
+            (int)(pipelineStats.busy[kDeltaStageParse] / 1000),
+            (int)(pipelineStats.busy[kDeltaStageApply] / 1000),
+            DeltaPipeline::StageName(DeltaPipeline::Bottleneck(pipelineStats)));
     }
     
-    if (result != ONEDRIVE_OK) {
+    BAutolock lock(fLock);
+    
+    fStats.deltaPages = pipelineStats.pages;
+    fStats.deltaFetchTime = pipelineStats.busy[kDeltaStageFetch];
+    fStats.deltaParseTime = pipelineStats.busy[kDeltaStageParse];
+    fStats.deltaApplyTime = pipelineStats.busy[kDeltaStageApply];
+    
+    if (result == ONEDRIVE_RESYNC_REQUIRED) {
+        LOG_WARNING("SyncEngine", "Delta token expired, enumerating remote tree");
+        fDeltaToken.SetTo("");
+        lock.Unlock();
+        
+        result = _CrawlRemoteTree(newDeltaToken);
+        if (result != B_OK) {
+            return result;
+        }
+        
+        lock.Lock();
+        fDeltaToken = newDeltaToken;
+        _RemoteTreeReady("crawl");
+        return B_OK;
+    }
+    if (result == B_CANCELED) {
+        return result;
+    }
+    if (result != B_OK) {
         ErrorLogger::Instance().LogError("SyncEngine", result,
             "Failed to get remote changes");
         return result;
     }
     
-    // TODO: Update delta token from response
+    // Only a fully applied run moves the token forward
+    fDeltaToken = newDeltaToken;
+    _RemoteTreeReady("enumeration");
     
-    // Process changes
-    // TODO: Compare with local state and queue sync items
+    // An initial enumeration says nothing about the change rate
+    if (!deltaToken.IsEmpty()) {
+        bigtime_t interval = fPoller->RecordPoll(changes);
+        if (fSyncTimer && !fPushActive) {
+            fSyncTimer->SetInterval(interval);
+        }
+        if (changes > 0) {
+            LOG_INFO("SyncEngine", "%d remote changes, next poll in %d s",
+                changes, (int)(interval / 1000000));
+        }
+    }
     
     return B_OK;
 }
 
 /**
- * @brief Process sync queue
+ * @brief Apply one page of remote changes as a batch
  */
-void
-OneDriveSyncEngine::_ProcessSyncQueue()
+status_t
+OneDriveSyncEngine::_ApplyRemoteChanges(const BList& items, int32& changes)
 {
-    while (!fSyncQueue.empty() && !fStopRequested) {
-        if (fIsPaused) {
-            // Wait for resume
-            snooze(1000000); // 1 second
-            continue;
+    // The whole page goes in under one lock acquisition
+    BAutolock lock(fLock);
+    
+    if (fStopRequested || fQuitting) {
+        return B_CANCELED;
+    }
+    
+    // Where each item was, for the local copies deletes and moves leave
+    BStringList previousPaths;
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* remote = static_cast<OneDriveItem*>(items.ItemAt(i));
+        OneDriveItem previous;
+        previousPaths.Add(fRemoteTree->FindById(remote->id, previous)
+            ? previous.path : BString());
+    }
+    
+    fRemoteTree->Apply(items);
+    
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* remote = static_cast<OneDriveItem*>(items.ItemAt(i));
+        if (remote->parentId.IsEmpty()) {
+            continue; // The drive root itself
         }
+        changes++;
         
-        BAutolock lock(fLock);
-        
-        // Get next item
-        SyncItem item = fSyncQueue.front();
-        fSyncQueue.pop();
-        
-        // Process item
-        lock.Unlock();
-        status_t result = _ProcessSyncItem(item);
-        lock.Lock();
+        // Changed items invalidate exactly their own cached paths
+        fAPI.NotifyRemoteItemChanged(remote->id,
+            remote->deleted ? BString() : remote->path);
         
-        if (result != B_OK) {
-            item.retryCount++;
-            if (item.retryCount < fConfig.maxRetries) {
-                // Retry later
-                _AddToQueue(item);
-            } else {
-                // Max retries reached
-                fStats.failedItems++;
-                LOG_ERROR("SyncEngine", "Failed to sync %s after %d retries",
-                    item.localPath.String(), fConfig.maxRetries);
-            }
-        } else {
-            fStats.completedItems++;
+        // Remember folder IDs so child operations skip path resolution
+        if (remote->type == ITEM_TYPE_FOLDER && !remote->deleted) {
+            _RememberFolderId(remote->path, remote->id);
         }
-        
-        // Send progress update
-        _SendProgressUpdate(item);
     }
     
-    // Sync complete
-    fIsSyncing = false;
-    fStats.endTime = time(NULL);
-    fLastSyncTime = fStats.endTime;
+    if (fConfig.direction == kSyncUploadOnly) {
+        return B_OK;
+    }
+    lock.Unlock();
+    
+    // Comparing with the disk takes a stat per file; queueing takes the
+    // lock per item
+    std::set<BString> reported;
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* remote = static_cast<OneDriveItem*>(items.ItemAt(i));
+        reported.insert(remote->id);
+        if (!remote->parentId.IsEmpty()) {
+            _QueueRemoteChange(*remote, previousPaths.StringAt(i));
+        }
+    }
     
-    // Save state
-    _SaveSyncState();
+    // A moved folder is reported without what it contains
+    for (int32 i = 0; i < items.CountItems(); i++) {
+        OneDriveItem* remote = static_cast<OneDriveItem*>(items.ItemAt(i));
+        const BString& previousPath = previousPaths.StringAt(i);
+        if (remote->type == ITEM_TYPE_FOLDER && !remote->deleted
+            && !previousPath.IsEmpty() && previousPath != remote->path) {
+            _QueueRemoteFolder(remote->id, reported);
+        }
+    }
     
-    // Notify completion
-    BMessage complete(kMsgSyncComplete);
-    complete.AddInt32("total", fStats.totalItems);
-    complete.AddInt32("completed", fStats.completedItems);
-    complete.AddInt32("failed", fStats.failedItems);
+    return B_OK;
+}
+
+/**
+ * @brief Queue the files below a remote folder
+ */
+void
+OneDriveSyncEngine::_QueueRemoteFolder(const BString& folderId,
+                                       const std::set<BString>& reported)
+{
+    BList children;
+    if (fRemoteTree->GetChildren(folderId, children) != B_OK) {
+        return;
+    }
     
-    if (fProgressHandler) {
-        BMessenger(fProgressHandler).SendMessage(&complete);
+    for (int32 i = 0; i < children.CountItems(); i++) {
+        OneDriveItem* child = static_cast<OneDriveItem*>(children.ItemAt(i));
+        if (reported.find(child->id) == reported.end()) {
+            if (child->type == ITEM_TYPE_FOLDER) {
+                _QueueRemoteFolder(child->id, reported);
+            } else {
+                _QueueRemoteChange(*child, BString());
+            }
+        }
+        delete child;
     }
 }
 
 /**
- * @brief Process single sync item
+ * @brief Queue what one remote change needs on disk
  */
-status_t
-OneDriveSyncEngine::_ProcessSyncItem(SyncItem& item)
+void
+OneDriveSyncEngine::_QueueRemoteChange(const OneDriveItem& remote,
+                                       const BString& previousPath)
 {
-    LOG_INFO("SyncEngine", "Processing %s: %s",
-        item.operation == kSyncOpUpload ? "upload" :
-        item.operation == kSyncOpDownload ? "download" :
-        item.operation == kSyncOpUpdate ? "update" :
-        item.operation == kSyncOpDelete ? "delete" :
-        item.operation == kSyncOpMove ? "move" :
-        item.operation == kSyncOpCreateFolder ? "create folder" :
-        "unknown",
-        item.localPath.String());
+    // The old local copy of a deleted, moved or renamed item goes
+    if (!previousPath.IsEmpty()
+        && (remote.deleted || previousPath != remote.path)) {
+        BString oldPath(fSyncPath.Path());
+        oldPath << previousPath;
+        BPath old(oldPath.String());
+        if (BEntry(oldPath.String()).Exists() && _ShouldSync(old)
+            && !_IsCopyDestination(oldPath)) {
+            SyncItem item;
+            item.status = kSyncStatusPending;
+            item.localPath = oldPath;
+            item.remotePath = previousPath;
+            item.localModified = 0;
+            item.remoteModified = 0;
+            item.size = 0;
+            item.retryCount = 0;
+            item.isPinned = false;
+            item.priority = kSyncPriorityNormal;
+            item.operation = kSyncOpDeleteLocal;
+            _AddToQueue(std::move(item));
+        }
+    }
     
-    _UpdateItemStatus(item, kSyncStatusInProgress);
+    if (remote.deleted || remote.type == ITEM_TYPE_FOLDER) {
+        return;
+    }
     
-    status_t result = B_ERROR;
+    BString localPath(fSyncPath.Path());
+    localPath << remote.path;
+    BPath path(localPath.String());
+    if (!_ShouldSync(path) || _IsCopyDestination(localPath)) {
+        return;
+    }
     
-    switch (item.operation) {
-        case kSyncOpUpload:
-            result = _UploadFile(item);
-            break;
-            
-        case kSyncOpDownload:
-            result = _DownloadFile(item);
-            break;
-            
-        case kSyncOpUpdate:
-            result = _UpdateFile(item);
-            break;
-            
-        case kSyncOpDelete:
-            result = _DeleteFile(item);
+    SyncItem item;
+    item.status = kSyncStatusPending;
+    item.localPath = localPath;
+    item.remotePath = remote.path;
+    item.fileId = remote.id;
+    item.remoteHash = remote.quickXorHash;
+    item.localModified = 0;
+    item.remoteModified = remote.modifiedTime;
+    item.size = remote.size;
+    item.retryCount = 0;
+    item.isPinned = false;
+    item.priority = kSyncPriorityNormal;
+    item.operation = kSyncOpDownload;
+    
+    BNode node(localPath.String());
+    node_ref ref;
+    struct stat st;
+    if (node.GetNodeRef(&ref) == B_OK && node.GetStat(&st) == B_OK) {
+        // Our own uploads come back this way, as do files already fetched
+        LocalFileState synced;
+        synced.size = -1;
+        if (fLocalChanges->StateOf(ref, synced) && synced.size >= 0) {
+            if (synced.hash == remote.quickXorHash
+                && !remote.quickXorHash.IsEmpty()) {
+                return;
+            }
+        } else if (st.st_size == remote.size
+            && st.st_mtime == remote.modifiedTime) {
+            return;
+        }
+        
+        // Changed on both sides, or never synced: the update decides
+        bool editedHere = synced.size < 0 || synced.size != st.st_size
+            || synced.modified != st.st_mtime;
+        if (editedHere) {
+            item.operation = kSyncOpUpdate;
+            item.localModified = st.st_mtime;
+        }
+    }
+    
+    _AddToQueue(std::move(item));
+}
+
+/**
+ * @brief Enumerate the remote tree folder by folder
+ */
+status_t
+OneDriveSyncEngine::_CrawlRemoteTree(BString& deltaToken)
+{
+    // Take the token first: changes made during the crawl show up in the
+    // next delta call instead of being lost between listing and token
+    BString page;
+    BString nextToken;
+    OneDriveError error = fAPI.FetchDeltaPage("latest", page, nextToken,
+        deltaToken);
+    if (error != ONEDRIVE_OK) {
+        ErrorLogger::Instance().LogError("SyncEngine", error,
+            "Failed to get current delta token");
+        return error;
+    }
+    
+    fRemoteTree->MakeEmpty();
+    
+    int32 changes = 0;
+    RemoteCrawler crawler(
+        [this](const BString& folderId, BList& items) -> status_t {
+            return fAPI.ListFolderById(folderId, items);
+        },
+        [this, &changes](const BList& items) -> status_t {
+            return _ApplyRemoteChanges(items, changes);
+        },
+        fAPI.GetMaxConcurrentRequests());
+    
+    status_t result = crawler.Run("root", "/");
+    
+    RemoteCrawlStats crawlStats = crawler.Stats();
+    LOG_INFO("SyncEngine", "Crawled %d folders, %d items in %d ms "
+        "(%.0f items/s)", (int)crawlStats.folders, (int)crawlStats.items,
+        (int)(crawlStats.elapsed / 1000), crawlStats.itemsPerSecond);
+    
+    BAutolock lock(fLock);
+    
+    fStats.crawledItems = crawlStats.items;
+    fStats.crawlItemsPerSecond = crawlStats.itemsPerSecond;
+    
+    if (result != B_OK && result != B_CANCELED) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to enumerate remote tree");
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Process sync queue
+ */
+void
+OneDriveSyncEngine::_ProcessSyncQueue()
+{
+    _PromoteDueRetries();
+    _OptimizeQueue();
+    
+    int32 processed = 0;
+    while (true) {
+        BAutolock lock(fLock);
+        
+        if (fStopRequested) {
             break;
-            
-        case kSyncOpMove:
-            result = _MoveFile(item);
+        }
+        
+        // Paused: transfers not yet started go back to the queue, then
+        // the worker sleeps until ResumeSync
+        if (fIsPaused) {
+            lock.Unlock();
+            fTransfers->CancelPending();
+            fTransfers->WaitIdle();
+            return;
+        }
+        
+        _PromoteDueRetries();
+        if (fSyncQueue->IsEmpty()) {
             break;
-            
-        case kSyncOpCreateFolder:
-            result = _CreateFolder(item);
+        }
+        
+        // Get next item
+        SyncItem item;
+        fSyncQueue->Pop(real_time_clock_usecs(), item);
+        fIsSyncing = true;
+        processed++;
+        lock.Unlock();
+        
+        // A stat change is an upload only if the content changed
+        if (item.operation == kSyncOpUpdateMetadata) {
+            _ClassifyStatChange(item);
+        }
+        
+        // An update becomes an upload or a download before it is staged
+        if (item.operation == kSyncOpUpdate) {
+            if (_DetectConflict(item)) {
+                item.operation = kSyncOpConflict;
+            } else {
+                item.operation = item.localModified > item.remoteModified
+                    ? kSyncOpUpload : kSyncOpDownload;
+            }
+        }
+        
+        // Transfers overlap in the pipeline; blocks while its disk stage
+        // is backed up
+        if (_IsTransfer(item)) {
+            _UpdateItemStatus(item, kSyncStatusInProgress);
+            if (fTransfers->Submit(item)) {
+                continue;
+            }
+        } else if (item.operation != kSyncOpCreateFolder) {
+            // Moves, deletes and conflicts may touch a file in transfer
+            fTransfers->WaitIdle();
+        }
+        
+        // Other operations, and transfers without a running pipeline
+        status_t result = _IsTransfer(item) ? _ReadTransfer(item) : B_OK;
+        if (result == B_OK) {
+            result = _ProcessSyncItem(item);
+        }
+        if (result == B_OK && _IsTransfer(item)) {
+            result = _FinalizeTransfer(item);
+        }
+        _CompleteItem(item, result);
+    }
+    
+    // A stop hands staged transfers back to the queue; the rest finish
+    bool stopping;
+    {
+        BAutolock lock(fLock);
+        stopping = fStopRequested;
+    }
+    if (stopping) {
+        fTransfers->CancelPending();
+    }
+    fTransfers->WaitIdle();
+    
+    BAutolock lock(fLock);
+    
+    // Nothing ran and no sync was started: stay quiet
+    if (!fIsSyncing && processed == 0) {
+        return;
+    }
+    
+    // Sync complete; retries still in backoff run in a later pass
+    fIsSyncing = false;
+    fStats.endTime = time(NULL);
+    fLastSyncTime = fStats.endTime;
+    
+    if (fStopWaiters > 0) {
+        release_sem_etc(fStoppedSemaphore, fStopWaiters, 0);
+        fStopWaiters = 0;
+    }
+    
+    // Save state; the remote tree is written once the lock is released
+    _SaveSyncQueue();
+    BString deltaToken = fDeltaToken;
+    
+    // Notify completion
+    BMessage complete(kMsgSyncComplete);
+    complete.AddInt32("total", fStats.totalItems);
+    complete.AddInt32("completed", fStats.completedItems);
+    complete.AddInt32("failed", fStats.failedItems);
+    complete.AddInt32("operationsSaved", fStats.operationsSaved);
+    complete.AddInt32("retried", fStats.retriedItems);
+    complete.AddInt32("parked", fStats.parkedItems);
+    complete.AddInt64("bytesDeduplicated", fStats.bytesDeduplicated);
+    complete.AddInt32("uploadsUnchanged", fStats.uploadsUnchanged);
+    complete.AddInt32("uploadsAvoided", fStats.contentUploadsAvoided);
+    complete.AddInt32("retriesPending", fRetries->CountScheduled());
+    complete.AddInt64("userQueueWait",
+        fSyncQueue->LaneStats(kSyncLaneUser).averageWait);
+    complete.AddInt64("smallQueueWait",
+        fSyncQueue->LaneStats(kSyncLaneSmall).averageWait);
+    complete.AddInt64("largeQueueWait",
+        fSyncQueue->LaneStats(kSyncLaneLarge).averageWait);
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        SyncLaneStats laneStats = fSyncQueue->LaneStats((SyncLane)lane);
+        if (laneStats.dispatched > 0) {
+            LOG_DEBUG("SyncEngine", "%s lane: %d dispatched, wait %d ms mean,"
+                " %d ms max", SyncScheduler::LaneName((SyncLane)lane),
+                (int)laneStats.dispatched, (int)(laneStats.averageWait / 1000),
+                (int)(laneStats.maxWait / 1000));
+        }
+    }
+    
+    if (fProgressHandler) {
+        BMessenger(fProgressHandler).SendMessage(&complete);
+    }
+    lock.Unlock();
+    
+    _SaveRemoteTree(deltaToken);
+}
+
+/**
+ * @brief Record the outcome of a processed item
+ */
+void
+OneDriveSyncEngine::_CompleteItem(SyncItem& item, status_t result)
+{
+    BAutolock lock(fLock);
+    
+    if (result == kSyncResultPending) {
+        // Settled by whatever finishes it, like _CopyFinished()
+        _UpdateItemStatus(item, kSyncStatusInProgress);
+        _SendProgressUpdate(item);
+        return;
+    }
+    
+    if (result == B_OK) {
+        if (item.status != kSyncStatusConflict) {
+            _UpdateItemStatus(item, kSyncStatusCompleted);
+        }
+        fStats.completedItems++;
+        _DropItemDone(item.localPath, true);
+    } else {
+        _UpdateItemStatus(item, kSyncStatusError);
+        item.errorMessage.SetToFormat("Error %s (0x%x)", strerror(result),
+            result);
+        _ScheduleRetry(item, result);
+    }
+    
+    _SendProgressUpdate(item);
+}
+
+/**
+ * @brief Check whether an operation goes through the transfer pipeline
+ */
+bool
+OneDriveSyncEngine::_IsTransfer(const SyncItem& item)
+{
+    return item.operation == kSyncOpUpload
+        || item.operation == kSyncOpDownload;
+}
+
+/**
+ * @brief Disk stage: read and hash uploads, prepare download folders
+ */
+status_t
+OneDriveSyncEngine::_ReadTransfer(SyncItem& item)
+{
+    if (item.operation == kSyncOpDownload) {
+        BPath parentPath;
+        BPath localPath(item.localPath.String());
+        status_t result = localPath.GetParent(&parentPath);
+        if (result == B_OK) {
+            result = create_directory(parentPath.Path(), 0755);
+        }
+        return result;
+    }
+    
+    BEntry entry(item.localPath.String());
+    off_t size;
+    status_t result = entry.GetSize(&size);
+    if (result != B_OK) {
+        return result;
+    }
+    item.size = size;
+    
+    // Hashing reads the whole file, which also warms the cache for the
+    // network stage reading it again
+    if (item.localHash.IsEmpty()) {
+        item.localHash = _CalculateFileHash(BPath(item.localPath.String()));
+        if (item.localHash.IsEmpty()) {
+            return B_IO_ERROR;
+        }
+    }
+    
+    return B_OK;
+}
+
+/**
+ * @brief Finalize stage: cache, attributes and statistics
+ */
+status_t
+OneDriveSyncEngine::_FinalizeTransfer(SyncItem& item)
+{
+    BPath localPath(item.localPath.String());
+    bool pinned = item.isPinned || fCache.IsFolderPinned(localPath);
+    bool upload = item.operation == kSyncOpUpload;
+    
+    if (pinned) {
+        if (upload) {
+            fCache.PinFile(item.fileId);
+        } else {
+            fCache.CacheFile(item.fileId, localPath, localPath, true);
+        }
+    }
+    
+    // Later stat changes of the file are compared with this state
+    _RememberLocalState(item);
+    
+    // Attributes ride along; a failure here does not undo the transfer.
+    // Uploads send them only if any differs from the last upload.
+    if (fConfig.syncAttributes) {
+        status_t result = upload
+            ? fAttributes.UploadAttributeChanges(item.localPath, item.fileId)
+            : fAttributes.SynchronizeAttributes(item.localPath, false);
+        if (result != B_OK) {
+            LOG_WARNING("SyncEngine", "Attributes of %s not synced: %s",
+                item.localPath.String(), strerror(result));
+        }
+    }
+    
+    BAutolock lock(fLock);
+    if (item.unchanged) {
+        fStats.uploadsUnchanged++;
+    } else if (item.deduplicated) {
+        fStats.bytesDeduplicated += item.size;
+        fStats.deduplicatedItems++;
+    } else if (upload) {
+        fStats.bytesUploaded += item.size;
+    } else {
+        fStats.bytesDownloaded += item.size;
+    }
+    
+    // TODO: Update virtual folder state when integrated
+    _UpdateItemStatus(item, kSyncStatusCompleted);
+    
+    return B_OK;
+}
+
+/**
+ * @brief Called by the transfer pipeline when an item leaves it
+ */
+void
+OneDriveSyncEngine::_TransferDone(SyncItem& item, status_t result)
+{
+    if (result == B_CANCELED) {
+        // Never transferred: back in line, not a failure
+        BAutolock lock(fLock);
+        item.status = kSyncStatusPending;
+        fSyncQueue->Push(std::move(item), real_time_clock_usecs());
+        return;
+    }
+    
+    _CompleteItem(item, result);
+}
+
+/**
+ * @brief Apply the configured concurrency to the transfer stages
+ */
+void
+OneDriveSyncEngine::_ApplyTransferConcurrency()
+{
+    // Reading more files at once than connections can send only fills
+    // the network queue; the two limits are still set apart
+    int32 connections = fConfig.transferConcurrency > 0
+        ? fConfig.transferConcurrency : fAPI.GetMaxConcurrentRequests();
+    fTransfers->SetConcurrency(kTransferStageDisk, fConfig.diskConcurrency);
+    fTransfers->SetConcurrency(kTransferStageNetwork, connections);
+}
+
+/**
+ * @brief Run the plan optimizer over the pending queue
+ */
+void
+OneDriveSyncEngine::_OptimizeQueue()
+{
+    BAutolock lock(fLock);
+    
+    if (fSyncQueue->Count() < 2) {
+        return;
+    }
+    
+    // Only the memory window is planned; spilled items queue behind it
+    std::vector<SyncItem> plan;
+    fSyncQueue->TakeWindow(plan);
+    
+    SyncPlanOptimizer optimizer;
+    int32 saved = optimizer.Optimize(plan);
+    
+    fSyncQueue->RestoreWindow(plan);
+    
+    // Collapsed operations will never run; keep totals consistent
+    fStats.totalItems -= saved;
+    fStats.operationsSaved += saved;
+    
+    if (saved > 0) {
+        LOG_INFO("SyncEngine", "Sync plan optimized: %d operations saved", saved);
+    }
+}
+
+/**
+ * @brief Hand a failed item to the retry scheduler
+ */
+void
+OneDriveSyncEngine::_ScheduleRetry(SyncItem& item, status_t result)
+{
+    BAutolock lock(fLock);
+    
+    RetryErrorClass errorClass = RetryScheduler::Classify(result);
+    
+    switch (fRetries->Schedule(item, result, system_time())) {
+        case kRetryScheduled:
+            fStats.retriedItems++;
+            LOG_INFO("SyncEngine", "Retry %d for %s scheduled (%s error)",
+                item.retryCount, item.localPath.String(),
+                RetryScheduler::ClassName(errorClass));
             break;
             
-        case kSyncOpConflict:
-            result = _HandleConflict(item);
+        case kRetryParked:
+            fStats.parkedItems++;
+            LOG_WARNING("SyncEngine", "Parked %s: %s",
+                item.localPath.String(), item.errorMessage.String());
+            _DropItemDone(item.localPath, false);
             break;
             
-        default:
-            LOG_WARNING("SyncEngine", "Unknown sync operation: %d", item.operation);
+        case kRetryExhausted:
+            fStats.failedItems++;
+            LOG_ERROR("SyncEngine", "Failed to sync %s after %d retries",
+                item.localPath.String(), item.retryCount);
+            _DropItemDone(item.localPath, false);
             break;
     }
+}
+
+/**
+ * @brief Move retries that are due into the sync queue
+ */
+int32
+OneDriveSyncEngine::_PromoteDueRetries()
+{
+    BAutolock lock(fLock);
+    
+    bigtime_t now = system_time();
+    int32 promoted = 0;
+    
+    SyncItem item;
+    while (fRetries->PopReady(now, item)) {
+        fSyncQueue->Push(std::move(item), real_time_clock_usecs());
+        promoted++;
+    }
+    
+    return promoted;
+}
+
+/**
+ * @brief Create the wake-up semaphores and spawn the sync worker
+ */
+status_t
+OneDriveSyncEngine::_StartWorker()
+{
+    fQuitting = false;
+    
+    fWakeSemaphore = create_sem(0, "SyncEngine wake");
+    if (fWakeSemaphore < 0) {
+        return fWakeSemaphore;
+    }
+    
+    fStoppedSemaphore = create_sem(0, "SyncEngine stopped");
+    if (fStoppedSemaphore < 0) {
+        delete_sem(fWakeSemaphore);
+        fWakeSemaphore = -1;
+        return fStoppedSemaphore;
+    }
+    
+    // Without transfer stages the worker runs transfers itself
+    _ApplyTransferConcurrency();
+    status_t pipelineResult = fTransfers->Start();
+    if (pipelineResult != B_OK) {
+        LOG_WARNING("SyncEngine", "Transfer pipeline unavailable: %s",
+            strerror(pipelineResult));
+    }
+    
+    fWorkerThread = spawn_thread(_WorkerThread, "sync_worker",
+                                 B_NORMAL_PRIORITY, this);
+    status_t result = fWorkerThread < 0 ? fWorkerThread
+        : resume_thread(fWorkerThread);
+    if (result != B_OK) {
+        if (fWorkerThread >= 0) {
+            kill_thread(fWorkerThread);
+        }
+        fTransfers->Stop();
+        delete_sem(fWakeSemaphore);
+        delete_sem(fStoppedSemaphore);
+        fWorkerThread = -1;
+        fWakeSemaphore = -1;
+        fStoppedSemaphore = -1;
+        return result;
+    }
+    
+    return B_OK;
+}
+
+/**
+ * @brief Ask the sync worker to exit and wait for it
+ */
+void
+OneDriveSyncEngine::_StopWorker()
+{
+    if (fWorkerThread < 0) {
+        return;
+    }
+    
+    fQuitting = true;
+    _WakeWorker();
+    
+    status_t exitValue;
+    wait_for_thread(fWorkerThread, &exitValue);
+    fWorkerThread = -1;
+    
+    // Transfers still staged go back to the queue and are saved with it
+    fTransfers->Stop();
+    
+    delete_sem(fWakeSemaphore);
+    delete_sem(fStoppedSemaphore);
+    fWakeSemaphore = -1;
+    fStoppedSemaphore = -1;
+}
+
+/**
+ * @brief Wake the sync worker
+ */
+void
+OneDriveSyncEngine::_WakeWorker()
+{
+    if (fWakeSemaphore >= 0) {
+        release_sem(fWakeSemaphore);
+    }
+}
+
+/**
+ * @brief Sync worker thread entry point
+ */
+int32
+OneDriveSyncEngine::_WorkerThread(void* data)
+{
+    static_cast<OneDriveSyncEngine*>(data)->_WorkerLoop();
+    return 0;
+}
+
+/**
+ * @brief Sleep until woken or a retry comes due, then run a sync pass
+ */
+void
+OneDriveSyncEngine::_WorkerLoop()
+{
+    while (true) {
+        bigtime_t due;
+        {
+            BAutolock lock(fLock);
+            if (fQuitting) {
+                break;
+            }
+            due = fIsPaused || fStopRequested
+                ? B_INFINITE_TIMEOUT : fRetries->NextDueTime();
+        }
+        
+        // No polling: only a wake-up or the next retry ends the wait
+        status_t result;
+        if (due == B_INFINITE_TIMEOUT) {
+            result = acquire_sem(fWakeSemaphore);
+        } else {
+            result = acquire_sem_etc(fWakeSemaphore, 1, B_ABSOLUTE_TIMEOUT, due);
+        }
+        if (result != B_OK && result != B_TIMED_OUT && result != B_INTERRUPTED) {
+            break;
+        }
+        
+        // One pass serves every wake-up that arrived meanwhile
+        int32 pending;
+        if (get_sem_count(fWakeSemaphore, &pending) == B_OK && pending > 0) {
+            acquire_sem_etc(fWakeSemaphore, pending, B_RELATIVE_TIMEOUT, 0);
+        }
+        
+        bool scan;
+        bool poll;
+        {
+            BAutolock lock(fLock);
+            if (fQuitting) {
+                break;
+            }
+            if (fIsPaused && !fStopRequested) {
+                continue;
+            }
+            scan = fScanRequested && !fStopRequested;
+            poll = fPollRequested && !fStopRequested;
+            fScanRequested = false;
+            fPollRequested = false;
+        }
+        
+        if (scan) {
+            _RunScans();
+        } else if (poll) {
+            _ScanRemoteChanges();
+        }
+        
+        _ProcessSyncQueue();
+    }
+}
+
+/**
+ * @brief Scan local and remote changes into the sync queue
+ */
+status_t
+OneDriveSyncEngine::_RunScans()
+{
+    status_t result = _ScanLocalChanges();
+    if (result != B_OK) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to scan local changes");
+        return result;
+    }
+    
+    result = _ScanRemoteChanges();
+    if (result != B_OK) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to scan remote changes");
+        return result;
+    }
+    
+    return B_OK;
+}
+
+/**
+ * @brief Requeue items parked as not retryable
+ */
+int32
+OneDriveSyncEngine::RetryParkedItems()
+{
+    BAutolock lock(fLock);
+    
+    std::vector<SyncItem> parked;
+    int32 count = fRetries->ReleaseParked(parked);
+    
+    for (size_t i = 0; i < parked.size(); i++) {
+        parked[i].retryCount = 0;
+        fSyncQueue->Push(std::move(parked[i]), real_time_clock_usecs());
+    }
+    
+    if (count > 0) {
+        LOG_INFO("SyncEngine", "Requeued %d parked items", count);
+        _WakeWorker();
+    }
+    
+    return count;
+}
+
+/**
+ * @brief Get ID of an item's parent folder, if known this sync
+ */
+BString
+OneDriveSyncEngine::_KnownParentId(const BString& remotePath) const
+{
+    BAutolock lock(fLock);
+    
+    int32 separator = remotePath.FindLast('/');
+    if (separator <= 0) {
+        return BString();
+    }
+    
+    BString parentPath;
+    remotePath.CopyInto(parentPath, 0, separator);
+    
+    std::map<BString, BString>::const_iterator it = fFolderIds.find(parentPath);
+    if (it != fFolderIds.end()) {
+        return it->second;
+    }
+    
+    // Folders not touched this sync are usually in the remote tree
+    OneDriveItem parent;
+    if (fRemoteTree->FindByPath(parentPath, parent)
+        && parent.type == ITEM_TYPE_FOLDER) {
+        return parent.id;
+    }
+    
+    return BString();
+}
+
+/**
+ * @brief Queue the files named by a Tracker or drag-and-drop request
+ */
+void
+OneDriveSyncEngine::_QueueUserRequest(BMessage* message)
+{
+    // "Sync now" and pinning send "refs"/"ref"; drops send both ends,
+    // of which only the one inside the sync folder matters
+    static const char* kRefFields[] = { "refs", "ref", "source", "destination" };
+    
+    BString syncRoot(fSyncPath.Path());
+    syncRoot << "/";
+    
+    int32 queued = 0;
+    for (size_t field = 0; field < sizeof(kRefFields) / sizeof(kRefFields[0]);
+            field++) {
+        entry_ref ref;
+        for (int32 i = 0; message->FindRef(kRefFields[field], i, &ref) == B_OK;
+                i++) {
+            BPath path(&ref);
+            if (path.InitCheck() != B_OK
+                || !BString(path.Path()).StartsWith(syncRoot)) {
+                continue;
+            }
+            if (SyncPath(path, true, kSyncPriorityUser) == B_OK) {
+                queued++;
+            }
+        }
+    }
+    
+    LOG_INFO("SyncEngine", "User request queued %d items ahead of the backlog",
+        (int)queued);
+}
+
+/**
+ * @brief Queue copies dropped inside the sync folder
+ */
+void
+OneDriveSyncEngine::_QueueUserCopy(BMessage* message)
+{
+    BString syncRoot(fSyncPath.Path());
+    syncRoot << "/";
+    
+    entry_ref destinationRef;
+    BPath destination;
+    if (message->FindRef("destination", &destinationRef) == B_OK) {
+        destination.SetTo(&destinationRef);
+    }
+    bool destinationInside = destination.InitCheck() == B_OK
+        && (BString(destination.Path()) << "/").StartsWith(syncRoot);
+    
+    int32 queued = 0;
+    entry_ref ref;
+    for (int32 i = 0; message->FindRef("source", i, &ref) == B_OK; i++) {
+        BPath source(&ref);
+        if (source.InitCheck() != B_OK) {
+            continue;
+        }
+        
+        if (!destinationInside
+            || !BString(source.Path()).StartsWith(syncRoot)) {
+            // Only content already on the drive can be copied there
+            BMessage request(kMsgSyncRequired);
+            request.AddRef("source", &ref);
+            if (destinationInside) {
+                request.AddRef("destination", &destinationRef);
+            }
+            _QueueUserRequest(&request);
+            continue;
+        }
+        
+        BPath target(destination);
+        target.Append(source.Leaf());
+        
+        SyncItem item;
+        item.operation = kSyncOpCopy;
+        item.status = kSyncStatusPending;
+        item.localPath = target.Path();
+        item.remotePath = _RemotePathFor(target);
+        item.previousPath = _RemotePathFor(source);
+        item.localModified = 0;
+        item.remoteModified = 0;
+        item.size = 0;
+        item.retryCount = 0;
+        item.isPinned = false;
+        item.priority = kSyncPriorityUser;
+        
+        _AddToQueue(std::move(item));
+        queued++;
+    }
+    
+    if (queued == 0) {
+        return;
+    }
+    
+    LOG_INFO("SyncEngine", "Queued %d server-side copies", (int)queued);
+    
+    BAutolock lock(fLock);
+    if (!fIsSyncing) {
+        StartSync(false);
+    }
+}
+
+/**
+ * @brief Start a batched drag-and-drop job
+ */
+void
+OneDriveSyncEngine::_QueueDropJob(BMessage* message)
+{
+    if (!fInitialized) {
+        return;
+    }
+    
+    DropJobClient client;
+    client.clientJob = message->GetInt32("job", 0);
+    message->FindMessenger("reply_to", &client.target);
+    
+    int32 job = fDropJobs->Begin();
+    {
+        BAutolock lock(fLock);
+        fDropClients[job] = client;
+    }
+    
+    // Folders are walked off the looper: a drop of thousands of files
+    // must not hold up node monitor and timer messages
+    BMessage jobMessage(*message);
+    _SpawnHelper("drop job", [this, job, jobMessage]() {
+        _RunDropJob(job, jobMessage);
+    });
+}
+
+/**
+ * @brief Run work on a thread of its own, off the worker and looper
+ */
+void
+OneDriveSyncEngine::_SpawnHelper(const char* name,
+    const std::function<void()>& work)
+{
+    HelperStart* start = new HelperStart;
+    start->engine = this;
+    start->work = work;
+    
+    // Known before it runs, so Shutdown() cannot miss it
+    thread_id thread = spawn_thread(_HelperThread, name, B_LOW_PRIORITY,
+        start);
+    if (thread >= 0) {
+        BAutolock lock(fLock);
+        fHelperThreads.insert(thread);
+    }
+    if (thread < 0 || resume_thread(thread) != B_OK) {
+        LOG_WARNING("SyncEngine", "No thread for %s, running it inline", name);
+        if (thread >= 0) {
+            kill_thread(thread);
+            BAutolock lock(fLock);
+            fHelperThreads.erase(thread);
+        }
+        start->work();
+        delete start;
+    }
+}
+
+/**
+ * @brief Helper thread entry point
+ */
+int32
+OneDriveSyncEngine::_HelperThread(void* data)
+{
+    HelperStart* start = static_cast<HelperStart*>(data);
+    OneDriveSyncEngine* engine = start->engine;
+    
+    start->work();
+    delete start;
+    
+    BAutolock lock(engine->fLock);
+    engine->fHelperThreads.erase(find_thread(NULL));
+    return 0;
+}
+
+/**
+ * @brief Queue the items of a drop job
+ */
+void
+OneDriveSyncEngine::_RunDropJob(int32 job, const BMessage& message)
+{
+    bigtime_t start = system_time();
+    
+    BString syncRoot(fSyncPath.Path());
+    syncRoot << "/";
+    
+    entry_ref destinationRef;
+    BPath destination;
+    if (message.FindRef("destination", &destinationRef) == B_OK) {
+        destination.SetTo(&destinationRef);
+    }
+    bool destinationInside = destination.InitCheck() == B_OK
+        && (BString(destination.Path()) << "/").StartsWith(syncRoot);
+    bool copy = message.GetBool("copy", true);
+    
+    BMessage copies(kMsgCopyItem);
+    copies.AddRef("destination", &destinationRef);
+    
+    entry_ref ref;
+    for (int32 i = 0; message.FindRef("refs", i, &ref) == B_OK; i++) {
+        if (fQuitting) {
+            break;
+        }
+        
+        BPath source(&ref);
+        if (source.InitCheck() != B_OK) {
+            continue;
+        }
+        bool sourceInside = BString(source.Path()).StartsWith(syncRoot);
+        
+        BPath target(destination);
+        if (destinationInside) {
+            target.Append(source.Leaf());
+        }
+        
+        if (sourceInside && destinationInside && copy) {
+            // Copied by the server; the copy settles the target path
+            fDropJobs->AddItem(job, target.Path(), 0);
+            copies.AddRef("source", &ref);
+        } else if (sourceInside && destinationInside) {
+            // Moved on disk by the client; one move carries a whole tree
+            SyncItem item;
+            item.operation = kSyncOpMove;
+            item.status = kSyncStatusPending;
+            item.localPath = target.Path();
+            item.remotePath = _RemotePathFor(target);
+            item.previousPath = _RemotePathFor(source);
+            item.localModified = 0;
+            item.remoteModified = 0;
+            item.size = 0;
+            item.retryCount = 0;
+            item.isPinned = false;
+            item.priority = kSyncPriorityUser;
+            
+            {
+                BAutolock lock(fLock);
+                fMoveDestinations.insert(item.localPath);
+            }
+            fDropJobs->AddItem(job, item.localPath, 0);
+            _AddToQueue(std::move(item));
+        } else if (destinationInside) {
+            // Copied in by the client, which may not be done yet: upload
+            // what the source holds, at its place in the sync folder
+            _EnumerateDrop(job, source, target);
+        } else if (sourceInside) {
+            // Dragged out: make sure the content is there to be copied
+            fDropJobs->AddItem(job, source.Path(), 0);
+            if (SyncPath(source, true, kSyncPriorityUser) != B_OK) {
+                _DropItemDone(source.Path(), false);
+            }
+        }
+    }
+    
+    if (copies.HasRef("source")) {
+        _QueueUserCopy(&copies);
+    }
+    
+    DropJobProgress progress;
+    if (fDropJobs->EnumerationDone(job, progress)) {
+        LOG_INFO("SyncEngine", "Drop job %d: %d items, %lld bytes found in "
+            "%d ms", (int)job, (int)progress.totalItems,
+            (long long)progress.totalBytes,
+            (int)((system_time() - start) / 1000));
+        _ReportDropJob(progress);
+    }
+    
+    BAutolock lock(fLock);
+    if (progress.totalItems > 0 && !fIsSyncing && !fQuitting) {
+        StartSync(false);
+    }
+}
+
+/**
+ * @brief Queue a dropped file or folder and everything below it
+ */
+status_t
+OneDriveSyncEngine::_EnumerateDrop(int32 job, const BPath& source,
+    const BPath& target)
+{
+    BEntry entry(source.Path());
+    struct stat st;
+    status_t status = entry.GetStat(&st);
+    if (status != B_OK) {
+        return status;
+    }
+    if (!_ShouldSync(target)) {
+        return B_OK;
+    }
+    
+    _QueueDroppedEntry(job, target.Path(), S_ISDIR(st.st_mode), st.st_size);
+    if (!S_ISDIR(st.st_mode)) {
+        return B_OK;
+    }
+    
+    // Where an entry below the source goes below the target
+    BString sourceRoot(source.Path());
+    BString targetRoot(target.Path());
+    std::function<BString(const char*)> targetFor
+        = [sourceRoot, targetRoot](const char* path) {
+            BString mapped(targetRoot);
+            mapped << (path + sourceRoot.Length());
+            return mapped;
+        };
+    
+    // The remote crawler walks any tree: here folder IDs are source paths.
+    // Entries not to be synced are left out, so excluded folders are not
+    // entered at all
+    RemoteCrawler crawler(
+        [this, targetFor](const BString& folder, BList& items) -> status_t {
+            BDirectory directory(folder.String());
+            status_t result = directory.InitCheck();
+            if (result != B_OK) {
+                return result;
+            }
+            
+            BEntry child;
+            while (directory.GetNextEntry(&child) == B_OK) {
+                struct stat childStat;
+                BPath childPath;
+                if (child.GetStat(&childStat) != B_OK
+                    || S_ISLNK(childStat.st_mode)
+                    || child.GetPath(&childPath) != B_OK
+                    || !_ShouldSync(BPath(
+                        targetFor(childPath.Path()).String()))) {
+                    continue;
+                }
+                
+                OneDriveItem* item = new OneDriveItem();
+                item->id = childPath.Path();
+                item->name = childPath.Leaf();
+                item->type = S_ISDIR(childStat.st_mode)
+                    ? ITEM_TYPE_FOLDER : ITEM_TYPE_FILE;
+                item->size = childStat.st_size;
+                items.AddItem(item);
+            }
+            return B_OK;
+        },
+        [this, job, targetFor](const BList& items) -> status_t {
+            if (fQuitting) {
+                return B_CANCELED;
+            }
+            for (int32 i = 0; i < items.CountItems(); i++) {
+                const OneDriveItem* item
+                    = static_cast<const OneDriveItem*>(items.ItemAt(i));
+                _QueueDroppedEntry(job, targetFor(item->id.String()),
+                    item->type == ITEM_TYPE_FOLDER, item->size);
+            }
+            return B_OK;
+        },
+        fConfig.diskConcurrency);
+    
+    status = crawler.Run(source.Path(), source.Path());
+    if (status != B_OK && status != B_CANCELED) {
+        ErrorLogger::Instance().LogError("SyncEngine", status,
+            "Failed to enumerate dropped folder");
+    }
+    return status;
+}
+
+/**
+ * @brief Queue one enumerated entry of a drop job
+ */
+void
+OneDriveSyncEngine::_QueueDroppedEntry(int32 job, const BString& localPath,
+    bool isFolder, off_t size)
+{
+    SyncItem item;
+    item.status = kSyncStatusPending;
+    item.localPath = localPath;
+    item.remotePath = _RemotePathFor(BPath(localPath.String()));
+    item.localModified = 0;
+    item.remoteModified = 0;
+    item.size = isFolder ? 0 : size;
+    item.retryCount = 0;
+    item.isPinned = false;
+    item.priority = kSyncPriorityUser;
+    
+    // The remote tree answers locally: no server lookup per dropped file
+    OneDriveItem remote;
+    bool known = fRemoteTree->FindByPath(item.remotePath, remote);
+    if (isFolder) {
+        if (known) {
+            // Nothing to create; a copy falling back to this walk is done
+            _DropItemDone(localPath, true);
+            return;
+        }
+        item.operation = kSyncOpCreateFolder;
+    } else if (known) {
+        item.operation = kSyncOpUpdate;
+        item.fileId = remote.id;
+    } else {
+        item.operation = kSyncOpUpload;
+    }
+    
+    fDropJobs->AddItem(job, localPath, item.size);
+    _AddToQueue(std::move(item));
+}
+
+/**
+ * @brief Settle an item in the drop job it belongs to, if any
+ */
+void
+OneDriveSyncEngine::_DropItemDone(const BString& localPath, bool succeeded)
+{
+    DropJobProgress progress;
+    if (fDropJobs->ItemDone(localPath, succeeded, system_time(), progress)) {
+        _ReportDropJob(progress);
+    }
+}
+
+/**
+ * @brief Send the progress of a drop job to its client
+ */
+void
+OneDriveSyncEngine::_ReportDropJob(const DropJobProgress& progress)
+{
+    BAutolock lock(fLock);
+    
+    std::map<int32, DropJobClient>::iterator client
+        = fDropClients.find(progress.job);
+    if (client == fDropClients.end()) {
+        return;
+    }
+    
+    BMessage report(kMsgDropJobProgress);
+    report.AddInt32("job", client->second.clientJob);
+    report.AddInt32("totalItems", progress.totalItems);
+    report.AddInt32("completedItems", progress.completedItems);
+    report.AddInt32("failedItems", progress.failedItems);
+    report.AddInt64("totalBytes", progress.totalBytes);
+    report.AddInt64("completedBytes", progress.completedBytes);
+    report.AddBool("enumerating", progress.enumerating);
+    report.AddBool("finished", progress.finished);
+    client->second.target.SendMessage(&report);
+    
+    if (progress.finished) {
+        fDropClients.erase(client);
+    }
+}
+
+/**
+ * @brief Map a local path below the sync folder to its remote path
+ */
+BString
+OneDriveSyncEngine::_RemotePathFor(const BPath& localPath) const
+{
+    return fLocalMoves->RemotePathFor(localPath);
+}
+
+/**
+ * @brief Remember the ID of a remote folder for child operations
+ */
+void
+OneDriveSyncEngine::_RememberFolderId(const BString& remotePath,
+                                      const BString& folderId)
+{
+    if (remotePath.IsEmpty() || folderId.IsEmpty()) {
+        return;
+    }
+    
+    BAutolock lock(fLock);
+    fFolderIds[remotePath] = folderId;
+}
+
+/**
+ * @brief Process single sync item
+ */
+status_t
+OneDriveSyncEngine::_ProcessSyncItem(SyncItem& item)
+{
+    LOG_INFO("SyncEngine", "Processing %s: %s",
+        item.operation == kSyncOpUpload ? "upload" :
+        item.operation == kSyncOpDownload ? "download" :
+        item.operation == kSyncOpUpdate ? "update" :
+        item.operation == kSyncOpDelete ? "delete" :
+        item.operation == kSyncOpMove ? "move" :
+        item.operation == kSyncOpCreateFolder ? "create folder" :
+        item.operation == kSyncOpCopy ? "copy" :
+        item.operation == kSyncOpUpdateMetadata ? "metadata" :
+        item.operation == kSyncOpDeleteLocal ? "local delete" :
+        "unknown",
+        item.localPath.String());
+    
+    _UpdateItemStatus(item, kSyncStatusInProgress);
+    
+    status_t result = B_ERROR;
+    
+    switch (item.operation) {
+        case kSyncOpUpload:
+            result = _UploadFile(item);
+            break;
+            
+        case kSyncOpDownload:
+            result = _DownloadFile(item);
+            break;
+            
+        case kSyncOpUpdate:
+            result = _UpdateFile(item);
+            break;
+            
+        case kSyncOpDelete:
+            result = _DeleteFile(item);
+            break;
+            
+        case kSyncOpMove:
+            result = _MoveFile(item);
+            {
+                // The node monitor has reported the move on disk by now
+                BAutolock lock(fLock);
+                fMoveDestinations.erase(item.localPath);
+            }
+            break;
+            
+        case kSyncOpCreateFolder:
+            result = _CreateFolder(item);
+            break;
+            
+        case kSyncOpConflict:
+            result = _HandleConflict(item);
+            break;
+            
+        case kSyncOpCopy:
+            result = _CopyItem(item);
+            break;
+            
+        case kSyncOpUpdateMetadata:
+            result = _UpdateMetadata(item);
+            break;
+            
+        case kSyncOpDeleteLocal:
+            result = _DeleteLocal(item);
+            break;
+            
+        default:
+            LOG_WARNING("SyncEngine", "Unknown sync operation: %d", item.operation);
+            break;
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Upload file
+ */
+status_t
+OneDriveSyncEngine::_UploadFile(SyncItem& item)
+{
+    // Address the parent by ID when known: no server path resolution
+    if (item.parentId.IsEmpty()) {
+        item.parentId = _KnownParentId(item.remotePath);
+    }
+    
+    // Content the drive already holds is copied there, not sent again
+    if (_CopyExistingContent(item)) {
+        _IndexUploadedContent(item);
+        return B_OK;
+    }
+    
+    status_t result;
+    if (!item.parentId.IsEmpty()) {
+        BPath remote(item.remotePath.String());
+        OneDriveItem uploaded;
+        result = fAPI.UploadFileToParent(item.localPath, item.parentId,
+                                        remote.Leaf(), &uploaded);
+        if (result == ONEDRIVE_OK) {
+            item.fileId = uploaded.id;
+        }
+    } else {
+        OneDriveItem uploaded;
+        result = fAPI.UploadFile(item.localPath.String(), 
+                                item.remotePath.String(), NULL, NULL, &uploaded);
+        if (result == ONEDRIVE_OK) {
+            item.fileId = uploaded.id;
+        }
+    }
+    
+    if (result == ONEDRIVE_OK) {
+        _IndexUploadedContent(item);
+    }
+    
+    // Cache, attributes and statistics follow in _FinalizeTransfer()
+    return result;
+}
+
+/**
+ * @brief Upload by server-side copy if the drive has the content
+ */
+bool
+OneDriveSyncEngine::_CopyExistingContent(SyncItem& item)
+{
+    item.deduplicated = false;
+    item.unchanged = false;
+    
+    // A copy costs a request and monitor polls: small files are sent
+    if (!fConfig.deduplicateUploads || item.size < kMinDeduplicateSize
+        || item.localHash.IsEmpty() || item.parentId.IsEmpty()) {
+        return false;
+    }
+    
+    OneDriveItem source;
+    if (!fRemoteTree->FindByContent(item.localHash, item.size, source)) {
+        return false;
+    }
+    
+    BPath remote(item.remotePath.String());
+    if (source.parentId == item.parentId
+        && source.name.ICompare(remote.Leaf()) == 0) {
+        // Nothing was copied: not counted as deduplicated
+        item.fileId = source.id;
+        item.unchanged = true;
+        LOG_INFO("SyncEngine", "%s is unchanged remotely, not uploaded",
+            item.localPath.String());
+        return true;
+    }
+    
+    OneDriveItem copied;
+    OneDriveError error = fAPI.CopyItem(source.id, item.parentId,
+        remote.Leaf(), &copied);
+    if (error != ONEDRIVE_OK) {
+        // The source may be gone since the last delta: send the bytes
+        LOG_WARNING("SyncEngine", "Server-side copy for %s failed, "
+            "uploading: %s", item.localPath.String(),
+            fAPI.GetLastError().String());
+        return false;
+    }
+    
+    item.fileId = copied.id;
+    item.deduplicated = true;
+    LOG_INFO("SyncEngine", "%s copied from %s by the server, %lld bytes "
+        "not uploaded", item.localPath.String(), source.path.String(),
+        (long long)item.size);
+    return true;
+}
+
+/**
+ * @brief Add an uploaded file to the remote tree with its hash
+ */
+void
+OneDriveSyncEngine::_IndexUploadedContent(const SyncItem& item)
+{
+    // Without the parent ID the item would be taken for the drive root
+    if (item.fileId.IsEmpty() || item.parentId.IsEmpty()
+        || item.localHash.IsEmpty()) {
+        return;
+    }
+    
+    BPath remote(item.remotePath.String());
+    OneDriveItem uploaded;
+    uploaded.id = item.fileId;
+    uploaded.parentId = item.parentId;
+    uploaded.name = remote.Leaf();
+    uploaded.type = ITEM_TYPE_FILE;
+    uploaded.size = item.size;
+    uploaded.modifiedTime = item.localModified;
+    uploaded.quickXorHash = item.localHash;
+    fRemoteTree->Apply(uploaded);
+}
+
+/**
+ * @brief Download file
+ */
+status_t
+OneDriveSyncEngine::_DownloadFile(SyncItem& item)
+{
+    // The parent folder was created by _ReadTransfer(); cache, attributes
+    // and statistics follow in _FinalizeTransfer()
+    item.unchanged = false;
+    item.deduplicated = _CopyLocalContent(item);
+    if (item.deduplicated) {
+        return B_OK;
+    }
+    
+    return fAPI.DownloadFile(item.fileId, item.localPath.String());
+}
+
+/**
+ * @brief Download by local copy if the content is already on disk
+ */
+bool
+OneDriveSyncEngine::_CopyLocalContent(SyncItem& item)
+{
+    if (!fConfig.deduplicateDownloads || item.fileId.IsEmpty()) {
+        return false;
+    }
+    
+    OneDriveItem remote;
+    if (!fRemoteTree->FindById(item.fileId, remote)
+        || remote.quickXorHash.IsEmpty() || remote.size < kMinDeduplicateSize) {
+        return false;
+    }
+    
+    // Cached files first, then synced files the remote tree says match
+    BStringList sources;
+    CacheEntry cached;
+    if (fCache.FindByChecksum(remote.quickXorHash, remote.size, cached)) {
+        sources.Add(cached.localPath.Path());
+    }
+    
+    BList matches;
+    fRemoteTree->FindAllByContent(remote.quickXorHash, remote.size, matches,
+        kMaxLocalCopySources);
+    for (int32 i = 0; i < matches.CountItems(); i++) {
+        OneDriveItem* match = static_cast<OneDriveItem*>(matches.ItemAt(i));
+        if (match->id != item.fileId && !match->path.IsEmpty()) {
+            BString localPath(fSyncPath.Path());
+            localPath << match->path;
+            sources.Add(localPath);
+        }
+        delete match;
+    }
+    
+    BPath target(item.localPath.String());
+    for (int32 i = 0; i < sources.CountStrings(); i++) {
+        BPath source(sources.StringAt(i).String());
+        if (source == target) {
+            continue;
+        }
+        
+        // A source edited since it was indexed fails the hash check
+        if (_CopyVerified(source, target, remote.quickXorHash, remote.size)
+                == B_OK) {
+            item.size = remote.size;
+            LOG_INFO("SyncEngine", "%s copied from %s, %lld bytes not "
+                "downloaded", item.localPath.String(), source.Path(),
+                (long long)remote.size);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+/**
+ * @brief Copy a file, checking the copy against a content hash
+ */
+status_t
+OneDriveSyncEngine::_CopyVerified(const BPath& source, const BPath& target,
+                                  const BString& hash, off_t size)
+{
+    BFile in(source.Path(), B_READ_ONLY);
+    status_t result = in.InitCheck();
+    if (result != B_OK) {
+        return result;
+    }
+    
+    off_t sourceSize;
+    if (in.GetSize(&sourceSize) != B_OK || sourceSize != size) {
+        return B_BAD_DATA;
+    }
+    
+    BPath parent;
+    result = target.GetParent(&parent);
+    if (result != B_OK) {
+        return result;
+    }
+    BString tempPath(parent.Path());
+    tempPath << "/." << target.Leaf() << FileSystem::kTempFileExtension;
+    
+    // Registered, so the node monitor does not take it for a new file
+    // even where hidden files are synced
+    {
+        BAutolock lock(fLock);
+        fCopyDestinations.insert(tempPath);
+    }
+    
+    BFile out(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    result = out.InitCheck();
+    if (result != B_OK) {
+        BAutolock lock(fLock);
+        fCopyDestinations.erase(tempPath);
+        return result;
+    }
+    
+    // The bytes written are the bytes hashed
+    QuickXorHash quickXor;
+    result = CopyFileData(in, out, &quickXor);
+    if (result == B_OK && quickXor.Base64() != hash) {
+        result = B_BAD_DATA;
+    }
+    if (result == B_OK) {
+        result = out.Sync();
+    }
+    out.Unset();
+    
+    BEntry temp(tempPath.String());
+    if (result == B_OK) {
+        result = temp.Rename(target.Path(), true);
+    }
+    if (result != B_OK) {
+        temp.Remove();
+    }
+    
+    BAutolock lock(fLock);
+    fCopyDestinations.erase(tempPath);
+    return result;
+}
+
+/**
+ * @brief Update file
+ */
+status_t
+OneDriveSyncEngine::_UpdateFile(SyncItem& item)
+{
+    // Detect conflict
+    if (_DetectConflict(item)) {
+        item.operation = kSyncOpConflict;
+        return _HandleConflict(item);
+    }
+    
+    // Determine update direction; it is kept for finalizing and retries
+    if (item.localModified > item.remoteModified) {
+        item.operation = kSyncOpUpload;
+        return _UploadFile(item);
+    } else {
+        item.operation = kSyncOpDownload;
+        return _DownloadFile(item);
+    }
+}
+
+/**
+ * @brief Delete file
+ */
+status_t
+OneDriveSyncEngine::_DeleteFile(SyncItem& item)
+{
+    // Replaced meanwhile, e.g. by a save through a temporary file: the
+    // new file is synced on its own and the remote one must stay
+    BEntry local(item.localPath.String());
+    if (local.Exists()) {
+        return B_OK;
+    }
+    
+    if (_ResolveFileId(item) != B_OK) {
+        // Never uploaded, or gone remotely already
+        return B_OK;
+    }
+    
+    // Delete from OneDrive; a folder goes with everything below it
+    status_t result = fAPI.DeleteItem(item.fileId);
+    
+    if (result == ONEDRIVE_OK) {
+        // Remove from cache
+        fCache.EvictFile(item.fileId);
+    } else if (result == ONEDRIVE_FILE_NOT_FOUND) {
+        return B_OK;
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Remove the local copy of a remotely deleted item
+ */
+status_t
+OneDriveSyncEngine::_DeleteLocal(SyncItem& item)
+{
+    // Deleted and then uploaded again before this ran
+    OneDriveItem remote;
+    if (fRemoteTree->FindByPath(item.remotePath, remote)) {
+        return B_OK;
+    }
+    
+    return _RemoveLocalTree(BPath(item.localPath.String()));
+}
+
+/**
+ * @brief Remove a local file, or a folder tree, left as synced
+ */
+status_t
+OneDriveSyncEngine::_RemoveLocalTree(const BPath& path)
+{
+    BEntry entry(path.Path());
+    if (!entry.Exists()) {
+        return B_OK;
+    }
+    
+    if (entry.IsDirectory()) {
+        // Listed first: removing entries while reading the directory
+        // may skip some
+        BStringList childPaths;
+        BDirectory directory(&entry);
+        BEntry child;
+        while (directory.GetNextEntry(&child) == B_OK) {
+            BPath childPath;
+            if (child.GetPath(&childPath) == B_OK) {
+                childPaths.Add(childPath.Path());
+            }
+        }
+        
+        for (int32 i = 0; i < childPaths.CountStrings(); i++) {
+            status_t result = _RemoveLocalTree(
+                BPath(childPaths.StringAt(i).String()));
+            if (result != B_OK) {
+                return result;
+            }
+        }
+        
+        // Kept files keep their folder
+        directory.Rewind();
+        if (directory.CountEntries() > 0) {
+            return B_OK;
+        }
+        return entry.Remove();
+    }
+    
+    BNode node(&entry);
+    node_ref ref;
+    struct stat st;
+    if (node.GetNodeRef(&ref) != B_OK || node.GetStat(&st) != B_OK) {
+        return B_OK;
+    }
+    
+    // Never synced: uploaded on its own since it was created
+    LocalFileState synced;
+    if (!fLocalChanges->StateOf(ref, synced) || synced.size < 0) {
+        return B_OK;
+    }
+    
+    // Edited since: the edit wins and goes up again
+    if (synced.size != st.st_size || synced.modified != st.st_mtime) {
+        LOG_INFO("SyncEngine", "Keeping locally changed file: %s",
+            path.Path());
+        SyncPath(path, false);
+        return B_OK;
+    }
+    
+    fLocalChanges->Forget(ref);
+    return entry.Remove();
+}
+
+/**
+ * @brief Move file
+ */
+status_t
+OneDriveSyncEngine::_MoveFile(SyncItem& item)
+{
+    if (item.fileId.IsEmpty()) {
+        if (item.previousPath.IsEmpty()) {
+            return B_BAD_VALUE;
+        }
+        
+        status_t result = fAPI.GetItemIdByPath(item.previousPath, item.fileId);
+        if (result != ONEDRIVE_OK) {
+            return result;
+        }
+    }
+    
+    // A folder move carries its whole subtree on the server
+    BPath destination(item.remotePath.String());
+    BPath destinationParent;
+    destination.GetParent(&destinationParent);
+    
+    // The drive root has no ID to resolve; it is addressed by path
+    if (item.parentId.IsEmpty()) {
+        item.parentId = _KnownParentId(item.remotePath);
+    }
+    if (item.parentId.IsEmpty() && BString(destinationParent.Path()) != "/") {
+        status_t result = fAPI.GetItemIdByPath(destinationParent.Path(),
+            item.parentId);
+        if (result != ONEDRIVE_OK) {
+            return result;
+        }
+    }
+    
+    return fAPI.MoveItem(item.fileId, item.parentId, destinationParent.Path(),
+                        destination.Leaf());
+}
+
+/**
+ * @brief Copy a file or folder within the drive
+ */
+status_t
+OneDriveSyncEngine::_CopyItem(SyncItem& item)
+{
+    if (item.previousPath.IsEmpty()) {
+        return B_BAD_VALUE;
+    }
+    
+    if (item.fileId.IsEmpty()) {
+        OneDriveItem source;
+        if (fRemoteTree->FindByPath(item.previousPath, source)) {
+            item.fileId = source.id;
+        } else {
+            status_t result = fAPI.GetItemIdByPath(item.previousPath,
+                item.fileId);
+            if (result != ONEDRIVE_OK) {
+                return result;
+            }
+        }
+    }
+    
+    BPath remote(item.remotePath.String());
+    if (item.parentId.IsEmpty()) {
+        item.parentId = _KnownParentId(item.remotePath);
+    }
+    if (item.parentId.IsEmpty()) {
+        BPath remoteParent;
+        remote.GetParent(&remoteParent);
+        status_t result = fAPI.GetItemIdByPath(remoteParent.Path(),
+            item.parentId);
+        if (result != ONEDRIVE_OK) {
+            return result;
+        }
+    }
+    
+    // The content is on disk already: keep the new files from being
+    // taken for uploads, and copy a tree of any size off the worker
+    {
+        BAutolock lock(fLock);
+        fCopyDestinations.insert(item.localPath);
+    }
+    
+    SyncItem copy(item);
+    _SpawnHelper("local copy", [this, copy]() { _RunCopy(copy); });
+    return kSyncResultPending;
+}
+
+/**
+ * @brief Make a copy on disk, then start its server-side copy
+ */
+void
+OneDriveSyncEngine::_RunCopy(const SyncItem& item)
+{
+    BString sourcePath(fSyncPath.Path());
+    sourcePath << item.previousPath;
+    off_t bytes = 0;
+    status_t result = _CopyLocalTree(BPath(sourcePath.String()),
+        BPath(item.localPath.String()), bytes);
+    
+    CopyCompletion* completion = new CopyCompletion;
+    completion->api = &fAPI;
+    completion->target = BMessenger(this);
+    completion->message.what = kMsgCopyFinished;
+    completion->message.AddString("localPath", item.localPath);
+    completion->message.AddInt64("size", bytes);
+    
+    if (result != B_OK) {
+        // No server copy: whatever arrived on disk is uploaded instead
+        BString errorText("Local copy failed: ");
+        errorText << strerror(result);
+        completion->message.AddString("errorText", errorText);
+        _CopyCompleted(ONEDRIVE_FILE_NOT_FOUND, OneDriveItem(), completion);
+        return;
+    }
+    
+    // ...and let the server copy its own
+    BPath remote(item.remotePath.String());
+    OneDriveError error = fAPI.StartCopy(item.fileId, item.parentId,
+        remote.Leaf(), _CopyCompleted, completion);
+    if (error != ONEDRIVE_OK) {
+        _CopyCompleted(error, OneDriveItem(), completion);
+    }
+}
+
+/**
+ * @brief Copy a file or folder tree on disk, attributes included
+ */
+status_t
+OneDriveSyncEngine::_CopyLocalTree(const BPath& source,
+                                   const BPath& destination, off_t& bytes)
+{
+    BEntry entry(source.Path());
+    if (!entry.Exists()) {
+        return B_ENTRY_NOT_FOUND;
+    }
+    if (entry.IsSymLink()) {
+        return B_OK; // Links are not synced
+    }
+    
+    if (entry.IsDirectory()) {
+        status_t result = create_directory(destination.Path(), 0755);
+        if (result != B_OK) {
+            return result;
+        }
+        
+        BDirectory directory(source.Path());
+        BEntry child;
+        while (directory.GetNextEntry(&child) == B_OK) {
+            BPath childPath;
+            child.GetPath(&childPath);
+            BPath target(destination);
+            target.Append(childPath.Leaf());
+            result = _CopyLocalTree(childPath, target, bytes);
+            if (result != B_OK) {
+                return result;
+            }
+        }
+        
+        BNode sourceNode(source.Path());
+        BNode destinationNode(destination.Path());
+        AttributeHelper::CopyAllAttributes(sourceNode, destinationNode);
+        return B_OK;
+    }
+    
+    BFile in(source.Path(), B_READ_ONLY);
+    BFile out(destination.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    status_t result = in.InitCheck();
+    if (result == B_OK) {
+        result = out.InitCheck();
+    }
+    if (result == B_OK) {
+        result = CopyFileData(in, out, NULL);
+    }
+    if (result != B_OK) {
+        return result;
+    }
+    
+    AttributeHelper::CopyAllAttributes(in, out);
+    
+    off_t size;
+    if (in.GetSize(&size) == B_OK) {
+        bytes += size;
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Completion callback of a server-side copy
+ */
+void
+OneDriveSyncEngine::_CopyCompleted(OneDriveError error,
+                                   const OneDriveItem& copied, void* userData)
+{
+    CopyCompletion* completion = static_cast<CopyCompletion*>(userData);
+    completion->message.AddInt32("error", error);
+    completion->message.AddString("id", copied.id);
+    if (error != ONEDRIVE_OK && !completion->message.HasString("errorText")) {
+        completion->message.AddString("errorText",
+            completion->api->GetLastError());
+    }
+    completion->target.SendMessage(&completion->message);
+    delete completion;
+}
+
+/**
+ * @brief Record a finished server-side copy
+ */
+void
+OneDriveSyncEngine::_CopyFinished(BMessage* message)
+{
+    BString localPath = message->GetString("localPath", "");
+    off_t size = message->GetInt64("size", 0);
+    int32 error = message->GetInt32("error", ONEDRIVE_API_ERROR);
     
-    if (result == B_OK) {
-        _UpdateItemStatus(item, kSyncStatusCompleted);
-    } else {
-        _UpdateItemStatus(item, kSyncStatusError);
-        item.errorMessage.SetToFormat("Error %s (0x%x)", strerror(result), result);
+    {
+        BAutolock lock(fLock);
+        fCopyDestinations.erase(localPath);
+        if (error == ONEDRIVE_OK) {
+            fStats.bytesDeduplicated += size;
+            fStats.deduplicatedItems++;
+            fStats.completedItems++;
+        }
     }
     
-    return result;
+    if (error == ONEDRIVE_OK) {
+        // The next delta brings the copy into the remote tree
+        LOG_INFO("SyncEngine", "%s copied by the server, %lld bytes not "
+            "uploaded", localPath.String(), (long long)size);
+        _DropItemDone(localPath, true);
+        return;
+    }
+    
+    LOG_WARNING("SyncEngine", "Server-side copy to %s failed, uploading: %s",
+        localPath.String(), message->GetString("errorText", "unknown error"));
+    
+    // Uploaded as if dropped there: a folder entry by entry, walked off
+    // the looper. The walk queues the copy's own path again, so a drop
+    // job waiting for the copy waits for the uploads instead.
+    BPath path(localPath.String());
+    int32 job = fDropJobs->JobOf(localPath);
+    _SpawnHelper("copy fallback", [this, path, job]() {
+        if (_EnumerateDrop(job, path, path) != B_OK) {
+            _DropItemDone(path.Path(), false);
+            return;
+        }
+        BAutolock lock(fLock);
+        if (!fIsSyncing && !fQuitting) {
+            StartSync(false);
+        }
+    });
 }
 
 /**
- * @brief Upload file
+ * @brief Check for a path made by a copy still in progress
+ */
+bool
+OneDriveSyncEngine::_IsCopyDestination(const BString& path) const
+{
+    BAutolock lock(fLock);
+    
+    for (std::set<BString>::const_iterator it = fCopyDestinations.begin();
+            it != fCopyDestinations.end(); ++it) {
+        if (path == *it || SyncPlanOptimizer::IsDescendant(path, *it)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Check for a path a dropped move is waiting to move remotely
+ */
+bool
+OneDriveSyncEngine::_IsMoveDestination(const BString& path) const
+{
+    BAutolock lock(fLock);
+    return fMoveDestinations.find(path) != fMoveDestinations.end();
+}
+
+/**
+ * @brief Sync a stat change that left the content as it was
  */
 status_t
-OneDriveSyncEngine::_UploadFile(SyncItem& item)
+OneDriveSyncEngine::_UpdateMetadata(SyncItem& item)
 {
-    BFile file(item.localPath.String(), B_READ_ONLY);
-    if (file.InitCheck() != B_OK) {
-        return file.InitCheck();
+    if (item.localModified == 0) {
+        return B_OK;
     }
     
-    // Check if we should cache it
-    if (item.isPinned || fCache.IsFolderPinned(BPath(item.localPath.String()))) {
-        fCache.PinFile(item.fileId);
+    status_t result = _ResolveFileId(item);
+    if (result != B_OK) {
+        return result;
     }
     
-    // Upload file
-    status_t result = fAPI.UploadFile(item.localPath.String(), 
-                                     item.remotePath.String());
-    
+    BMessage metadata;
+    metadata.AddInt64("modified", item.localModified);
+    result = fAPI.UpdateItemMetadata(item.fileId, metadata);
     if (result == ONEDRIVE_OK) {
-        // TODO: Get file ID from upload response
-        
-        // TODO: Update virtual folder state when integrated
-        
-        // Update stats
-        fStats.bytesUploaded += item.size;
-        
-        // TODO: Sync attributes when fully implemented
+        BAutolock lock(fLock);
+        fStats.contentUploadsAvoided++;
     }
-    
     return result;
 }
 
 /**
- * @brief Download file
+ * @brief Find the remote ID of an item's file, if not set yet
  */
 status_t
-OneDriveSyncEngine::_DownloadFile(SyncItem& item)
+OneDriveSyncEngine::_ResolveFileId(SyncItem& item)
 {
-    // Create parent directory if needed
-    BPath parentPath;
-    BPath localPath(item.localPath.String());
-    localPath.GetParent(&parentPath);
+    if (!item.fileId.IsEmpty()) {
+        return B_OK;
+    }
     
-    create_directory(parentPath.Path(), 0755);
+    OneDriveItem remote;
+    if (fRemoteTree->FindByPath(item.remotePath, remote)) {
+        item.fileId = remote.id;
+        return B_OK;
+    }
+    
+    return fAPI.GetItemIdByPath(item.remotePath, item.fileId);
+}
+
+/**
+ * @brief Queue the sync of a stat or attribute change
+ */
+void
+OneDriveSyncEngine::_QueueLocalChange(const node_ref& node,
+    const char* attribute)
+{
+    BString localPath;
+    if (!fLocalChanges->PathFor(node, localPath)) {
+        return;
+    }
     
-    // Download file
-    status_t result = fAPI.DownloadFile(item.fileId, item.localPath.String());
+    BPath path(localPath.String());
+    if (!_ShouldSync(path) || _IsCopyDestination(localPath)) {
+        return;
+    }
     
-    if (result == ONEDRIVE_OK) {
-        // Cache if pinned
-        if (item.isPinned || fCache.IsFolderPinned(localPath)) {
-            fCache.CacheFile(item.fileId, localPath, localPath, true);
+    if (attribute != NULL) {
+        // Bursts are coalesced per file there; a file never synced is
+        // uploaded instead
+        if (fLocalChanges->ClassifyAttributes(node) == kLocalChangeContent) {
+            SyncPath(path, false);
+            return;
         }
-        
-        // TODO: Update virtual folder state when integrated
-        
-        // Update stats
-        fStats.bytesDownloaded += item.size;
-        
-        // TODO: Sync attributes when fully implemented
+        fAttributes.QueueAttributeChange(localPath, attribute);
+        return;
     }
     
-    return result;
+    LOG_DEBUG("SyncEngine", "Stat data changed: %s", localPath.String());
+    
+    SyncItem item;
+    item.status = kSyncStatusPending;
+    item.localPath = localPath;
+    item.remotePath = _RemotePathFor(path);
+    item.localModified = 0;
+    item.remoteModified = 0;
+    item.size = 0;
+    item.retryCount = 0;
+    item.isPinned = false;
+    item.priority = kSyncPriorityNormal;
+    item.operation = kSyncOpUpdateMetadata;
+    
+    _AddToQueue(std::move(item));
 }
 
 /**
- * @brief Update file
+ * @brief Queue the remote delete of a locally removed file or folder
  */
-status_t
-OneDriveSyncEngine::_UpdateFile(SyncItem& item)
+void
+OneDriveSyncEngine::_QueueLocalDelete(const BString& localPath)
 {
-    // Detect conflict
-    if (_DetectConflict(item)) {
-        item.operation = kSyncOpConflict;
-        return _HandleConflict(item);
+    BPath path(localPath.String());
+    if (!_ShouldSync(path) || _IsCopyDestination(localPath)) {
+        return;
     }
     
-    // Determine update direction
-    if (item.localModified > item.remoteModified) {
-        // Upload local changes
-        return _UploadFile(item);
-    } else {
-        // Download remote changes
-        return _DownloadFile(item);
-    }
+    SyncItem item;
+    item.status = kSyncStatusPending;
+    item.localPath = localPath;
+    item.remotePath = _RemotePathFor(path);
+    item.localModified = 0;
+    item.remoteModified = 0;
+    item.size = 0;
+    item.retryCount = 0;
+    item.isPinned = false;
+    item.priority = kSyncPriorityNormal;
+    item.operation = kSyncOpDelete;
+    
+    _AddToQueue(std::move(item));
 }
 
 /**
- * @brief Delete file
+ * @brief Decide what a queued stat change needs
  */
-status_t
-OneDriveSyncEngine::_DeleteFile(SyncItem& item)
+void
+OneDriveSyncEngine::_ClassifyStatChange(SyncItem& item)
 {
-    // Delete from OneDrive
-    status_t result = fAPI.DeleteItem(item.fileId);
+    item.localModified = 0;
     
-    if (result == ONEDRIVE_OK) {
-        // Remove from cache
-        fCache.EvictFile(item.fileId);
-        
-        // Delete local file if it exists
-        BEntry entry(item.localPath.String());
-        if (entry.Exists()) {
-            entry.Remove();
-        }
+    BNode node(item.localPath.String());
+    node_ref ref;
+    struct stat st;
+    if (node.GetNodeRef(&ref) != B_OK || node.GetStat(&st) != B_OK) {
+        // Removed again; that is synced on its own
+        return;
     }
     
-    return result;
+    BString hash;
+    switch (fLocalChanges->ClassifyStat(ref, st.st_size, st.st_mtime, hash)) {
+        case kLocalChangeContent:
+            item.operation = kSyncOpUpload;
+            item.size = st.st_size;
+            item.localHash = hash;
+            break;
+            
+        case kLocalChangeMetadata:
+            item.localModified = st.st_mtime;
+            break;
+            
+        default:
+            break;
+    }
 }
 
 /**
- * @brief Move file
+ * @brief Record the state a file was just synced in
  */
-status_t
-OneDriveSyncEngine::_MoveFile(SyncItem& item)
+void
+OneDriveSyncEngine::_RememberLocalState(const SyncItem& item)
 {
-    // TODO: Implement move operation
-    return B_NOT_SUPPORTED;
+    BNode node(item.localPath.String());
+    node_ref ref;
+    struct stat st;
+    if (node.GetNodeRef(&ref) != B_OK || node.GetStat(&st) != B_OK) {
+        return;
+    }
+    
+    LocalFileState state;
+    state.path = item.localPath;
+    state.size = st.st_size;
+    state.modified = st.st_mtime;
+    if (item.operation == kSyncOpUpload) {
+        state.hash = item.localHash;
+    } else {
+        OneDriveItem remote;
+        if (fRemoteTree->FindByPath(item.remotePath, remote)) {
+            state.hash = remote.quickXorHash;
+        }
+    }
+    fLocalChanges->Remember(ref, state);
 }
 
 /**
@@ -811,10 +3243,24 @@ OneDriveSyncEngine::_CreateFolder(SyncItem& item)
     BPath parentPath;
     path.GetParent(&parentPath);
     
-    status_t result = fAPI.CreateFolder(parentPath.Path(), folderName);
+    // Parents of new trees are created first, so nested folders can be
+    // created by parent ID without resolving their path on the server
+    if (item.parentId.IsEmpty()) {
+        item.parentId = _KnownParentId(item.remotePath);
+    }
+    
+    OneDriveItem created;
+    status_t result;
+    if (!item.parentId.IsEmpty()) {
+        result = fAPI.CreateFolderInParent(item.parentId, folderName, &created);
+    } else {
+        result = fAPI.CreateFolder(parentPath.Path(), folderName, &created);
+    }
     
     if (result == ONEDRIVE_OK) {
-        // TODO: Get folder ID from response
+        // Carry the new ID straight into the children's operations
+        item.fileId = created.id;
+        _RememberFolderId(item.remotePath, created.id);
         
         // Create local folder if needed
         create_directory(item.localPath.String(), 0755);
@@ -833,14 +3279,20 @@ OneDriveSyncEngine::_HandleConflict(SyncItem& item)
 {
     LOG_WARNING("SyncEngine", "Conflict detected for %s", item.localPath.String());
     
-    fStats.conflictItems++;
+    {
+        BAutolock lock(fLock);
+        fStats.conflictItems++;
+    }
     
-    // Apply conflict resolution strategy
+    // Apply conflict resolution strategy; a transfer it settles on is
+    // then finalized and retried like any other
     switch (fConfig.conflictMode) {
         case kConflictLocalWins:
+            item.operation = kSyncOpUpload;
             return _UploadFile(item);
             
         case kConflictRemoteWins:
+            item.operation = kSyncOpDownload;
             return _DownloadFile(item);
             
         case kConflictRename:
@@ -853,6 +3305,7 @@ OneDriveSyncEngine::_HandleConflict(SyncItem& item)
             entry.Rename(conflictPath.String());
             
             // Download remote version
+            item.operation = kSyncOpDownload;
             return _DownloadFile(item);
         }
         
@@ -906,17 +3359,14 @@ OneDriveSyncEngine::_DetectConflict(const SyncItem& item)
  * @brief Add item to sync queue
  */
 void
-OneDriveSyncEngine::_AddToQueue(const SyncItem& item)
+OneDriveSyncEngine::_AddToQueue(SyncItem&& item)
 {
     BAutolock lock(fLock);
     
-    fSyncQueue.push(item);
+    fSyncQueue->Push(std::move(item), real_time_clock_usecs());
     fStats.totalItems++;
     
-    // Notify processing thread
-    if (Looper()) {
-        Looper()->PostMessage(kMsgProcessQueue, this);
-    }
+    _WakeWorker();
 }
 
 /**
@@ -949,6 +3399,7 @@ OneDriveSyncEngine::_SendProgressUpdate(const SyncItem& item)
     progress.AddInt32("failedItems", fStats.failedItems);
     progress.AddInt64("bytesUploaded", fStats.bytesUploaded);
     progress.AddInt64("bytesDownloaded", fStats.bytesDownloaded);
+    progress.AddInt64("bytesDeduplicated", fStats.bytesDeduplicated);
     
     if (!item.errorMessage.IsEmpty()) {
         progress.AddString("error", item.errorMessage);
@@ -963,22 +3414,126 @@ OneDriveSyncEngine::_SendProgressUpdate(const SyncItem& item)
 status_t
 OneDriveSyncEngine::_LoadSyncState()
 {
-    // TODO: Load from persistent storage
-    // For now, return not found
-    return B_ENTRY_NOT_FOUND;
+    // Work queued in the last session comes back first; from here on the
+    // queue spills to disk beyond its memory window
+    BPath path;
+    status_t result = _GetCachePath(kSyncQueueName, path);
+    if (result == B_OK) {
+        result = fSyncQueue->Open(path.Path());
+    }
+    if (result != B_OK) {
+        LOG_WARNING("SyncEngine", "Could not restore the sync queue: %s",
+            strerror(result));
+    }
+    if (!fSyncQueue->IsEmpty()) {
+        fStats.totalItems += fSyncQueue->Count();
+        LOG_INFO("SyncEngine", "Restored %d queued operations (%d on disk)",
+            (int)fSyncQueue->Count(), (int)fSyncQueue->CountSpilled());
+    }
+    
+    result = _GetCachePath(kRemoteTreeSnapshotName, path);
+    if (result != B_OK) {
+        return result;
+    }
+    
+    // The mapped snapshot is used as is; only the delta since its token
+    // has to be fetched
+    BString deltaToken;
+    result = fRemoteTree->MapSnapshot(path.Path(), deltaToken);
+    if (result != B_OK) {
+        if (result != B_ENTRY_NOT_FOUND) {
+            LOG_WARNING("SyncEngine", "Ignoring remote tree snapshot: %s",
+                strerror(result));
+        }
+        return result;
+    }
+    
+    BAutolock lock(fLock);
+    fDeltaToken = deltaToken;
+    fStats.remoteTreeFromSnapshot = true;
+    _RemoteTreeReady("snapshot");
+    
+    return B_OK;
+}
+
+/**
+ * @brief Save the sync queue, fLock held
+ */
+status_t
+OneDriveSyncEngine::_SaveSyncQueue()
+{
+    status_t result = fSyncQueue->Save();
+    if (result != B_OK && result != B_NO_INIT) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to save sync queue");
+        return result;
+    }
+    return B_OK;
 }
 
 /**
- * @brief Save sync state
+ * @brief Write the remote tree snapshot, without fLock
  */
 status_t
-OneDriveSyncEngine::_SaveSyncState()
+OneDriveSyncEngine::_SaveRemoteTree(const BString& deltaToken)
 {
-    // TODO: Save to persistent storage
-    LOG_INFO("SyncEngine", "Saving sync state (delta token: %s)", 
-        fDeltaToken.String());
+    if (!fRemoteTree->IsModified()) {
+        return B_OK;
+    }
     
-    return B_OK;
+    LOG_INFO("SyncEngine", "Saving remote tree (delta token: %s)",
+        deltaToken.String());
+    
+    BPath path;
+    status_t result = _GetCachePath(kRemoteTreeSnapshotName, path);
+    if (result == B_OK) {
+        bigtime_t start = system_time();
+        result = fRemoteTree->WriteSnapshot(path.Path(), deltaToken);
+        LOG_DEBUG("SyncEngine", "Remote tree snapshot written in %d ms",
+            (int)((system_time() - start) / 1000));
+    }
+    if (result != B_OK) {
+        ErrorLogger::Instance().LogError("SyncEngine", result,
+            "Failed to save remote tree snapshot");
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Get a file in the cache folder, creating the folder
+ */
+status_t
+OneDriveSyncEngine::_GetCachePath(const char* name, BPath& path) const
+{
+    status_t result = find_directory(B_USER_CACHE_DIRECTORY, &path, true);
+    if (result == B_OK) {
+        result = path.Append(APP_NAME);
+    }
+    if (result == B_OK) {
+        result = create_directory(path.Path(), 0755);
+    }
+    if (result == B_OK) {
+        result = path.Append(name);
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Record when the remote tree first became usable
+ */
+void
+OneDriveSyncEngine::_RemoteTreeReady(const char* source)
+{
+    if (fStats.remoteTreeReadyTime != 0) {
+        return;
+    }
+    
+    fStats.remoteTreeReadyTime = system_time() - fStartTime;
+    LOG_INFO("SyncEngine", "Remote tree ready from %s: %d items, %d ms "
+        "after startup", source, (int)fRemoteTree->CountItems(),
+        (int)(fStats.remoteTreeReadyTime / 1000));
 }
 
 /**
@@ -998,9 +3553,8 @@ OneDriveSyncEngine::_CalculateFileHash(const BPath& path)
         return "";
     }
     
-    // Initialize SHA256
-    BPrivate::SHA256 sha;
-    sha.Init();
+    // QuickXorHash: the hash OneDrive keeps for every remote file
+    QuickXorHash hash;
     
     // Read and hash file in chunks
     const size_t kBufferSize = 64 * 1024; // 64KB chunks
@@ -1016,24 +3570,13 @@ OneDriveSyncEngine::_CalculateFileHash(const BPath& path)
             return "";
         }
         
-        sha.Update(buffer, bytesRead);
+        hash.Update(buffer, bytesRead);
         remaining -= bytesRead;
     }
     
     delete[] buffer;
     
-    // Get digest
-    const uint8* digest = sha.Digest();
-    
-    // Convert to hex string
-    BString hashStr;
-    char hexBuf[3];
-    for (int i = 0; i < 32; i++) { // SHA256 produces 32 bytes
-        sprintf(hexBuf, "%02x", digest[i]);
-        hashStr << hexBuf;
-    }
-    
-    return hashStr;
+    return hash.Base64();
 }
 
 /**
@@ -1048,11 +3591,14 @@ OneDriveSyncEngine::_ShouldSync(const BPath& path)
     
     BString pathStr(path.Path());
     
-    // Check if within sync folder
+    // Check if within sync folder, not merely sharing its name's prefix
     BString syncStr(fSyncPath.Path());
-    if (!pathStr.StartsWith(syncStr)) {
+    if (!pathStr.StartsWith(syncStr)
+        || (pathStr.Length() > syncStr.Length()
+            && pathStr.ByteAt(syncStr.Length()) != '/')) {
         return false;
     }
+    const char* relativePath = pathStr.String() + syncStr.Length();
     
     // Get filename
     BString filename(path.Leaf());
@@ -1062,78 +3608,93 @@ OneDriveSyncEngine::_ShouldSync(const BPath& path)
         return false;
     }
     
-    // Check exclude patterns
-    for (int32 i = 0; i < fConfig.excludePatterns.CountStrings(); i++) {
-        // TODO: Implement pattern matching
-        if (filename == fConfig.excludePatterns.StringAt(i)) {
-            return false;
-        }
+    // An excluded folder excludes everything inside it
+    if (fExcludes->Matches(relativePath, true)) {
+        return false;
     }
     
     // Check include patterns if any
-    if (fConfig.includePatterns.CountStrings() > 0) {
-        bool included = false;
-        for (int32 i = 0; i < fConfig.includePatterns.CountStrings(); i++) {
-            // TODO: Implement pattern matching
-            if (filename == fConfig.includePatterns.StringAt(i)) {
-                included = true;
-                break;
-            }
-        }
-        if (!included) {
-            return false;
-        }
+    if (!fIncludes->IsEmpty() && !fIncludes->Matches(relativePath, false)) {
+        return false;
     }
     
     return true;
 }
 
 /**
- * @brief Apply bandwidth limit
+ * @brief Apply the configured limits and schedule to the shaper
  */
 void
-OneDriveSyncEngine::_ApplyBandwidthLimit(off_t bytesTransferred)
+OneDriveSyncEngine::_ApplyBandwidthConfig()
 {
-    if (fConfig.bandwidthLimit <= 0) {
-        return; // No limit
+    fBandwidth->SetLimit(kBandwidthUpload, fConfig.uploadLimit > 0
+        ? fConfig.uploadLimit : fConfig.bandwidthLimit);
+    fBandwidth->SetLimit(kBandwidthDownload, fConfig.downloadLimit > 0
+        ? fConfig.downloadLimit : fConfig.bandwidthLimit);
+    
+    if (fBandwidth->SetSchedule(fConfig.bandwidthSchedule.String()) != B_OK) {
+        LOG_WARNING("SyncEngine", "Ignoring invalid bandwidth schedule: %s",
+                   fConfig.bandwidthSchedule.String());
     }
+}
+
+/**
+ * @brief Sync timer tick
+ */
+void
+OneDriveSyncEngine::_SyncTimerTick()
+{
+    BAutolock lock(fLock);
     
-    // Simple bandwidth limiting - sleep if we're going too fast
-    static bigtime_t lastCheck = 0;
-    static off_t lastBytes = 0;
-    
-    bigtime_t now = system_time();
-    if (lastCheck == 0) {
-        lastCheck = now;
-        lastBytes = bytesTransferred;
-        return;
+    // Poll for remote changes; local changes arrive via node monitoring
+    if (fInitialized && !fIsPaused) {
+        fPollRequested = true;
+        _WakeWorker();
     }
+}
+
+/**
+ * @brief Handle a remote change notification
+ */
+void
+OneDriveSyncEngine::_RemoteChangeNotified()
+{
+    BAutolock lock(fLock);
     
-    bigtime_t elapsed = now - lastCheck;
-    if (elapsed >= 1000000) { // Check every second
-        off_t bytesThisPeriod = bytesTransferred - lastBytes;
-        float currentRate = (float)bytesThisPeriod / (elapsed / 1000000.0f);
-        
-        if (currentRate > fConfig.bandwidthLimit) {
-            // Sleep to reduce rate
-            bigtime_t sleepTime = (bigtime_t)((bytesThisPeriod - fConfig.bandwidthLimit) * 
-                                             1000000.0f / fConfig.bandwidthLimit);
-            snooze(sleepTime);
-        }
-        
-        lastCheck = now;
-        lastBytes = bytesTransferred;
+    // Notifications carry no details; fetch the delta. Bursts coalesce
+    // into one pass since the worker folds pending wake-ups together.
+    if (fInitialized && !fIsPaused) {
+        fPoller->RecordActivity();
+        fPollRequested = true;
+        _WakeWorker();
     }
 }
 
 /**
- * @brief Sync timer tick
+ * @brief Switch between notification-driven and polling mode
  */
 void
-OneDriveSyncEngine::_SyncTimerTick()
+OneDriveSyncEngine::_NotificationChannelChanged(bool connected)
 {
-    // Start sync if not already running
-    if (!fIsSyncing && !fIsPaused) {
-        StartSync(false);
+    BAutolock lock(fLock);
+    
+    if (fPushActive == connected) {
+        return;
+    }
+    fPushActive = connected;
+    
+    LOG_INFO("SyncEngine", "Remote changes now %s",
+        connected ? "pushed by notification" : "polled");
+    
+    // While pushed, polling is only a safety net for lost notifications
+    if (fSyncTimer) {
+        fSyncTimer->SetInterval(connected ? kPushSafetyInterval
+            : fPoller->CurrentInterval());
+    }
+    
+    // Changes may have gone unnoticed while switching over
+    if (fInitialized && !fIsPaused) {
+        fPollRequested = true;
+        _WakeWorker();
     }
 }
\ No newline at end of file
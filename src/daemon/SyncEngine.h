@@ -18,14 +18,19 @@
 #include <Locker.h>
 #include <Message.h>
 #include <MessageRunner.h>
+#include <Messenger.h>
 #include <Path.h>
 #include <String.h>
 #include <StringList.h>
+#include <Node.h>
 #include <NodeMonitor.h>
+#include <OS.h>
 
+#include <atomic>
+#include <functional>
 #include <map>
-#include <queue>
 #include <memory>
+#include <set>
 
 // Include necessary headers for the classes we use
 #include "../api/OneDriveAPI.h"
@@ -44,7 +49,12 @@ enum SyncOperation {
     kSyncOpDelete,          ///< Delete file
     kSyncOpMove,            ///< Move/rename file
     kSyncOpCreateFolder,    ///< Create folder
-    kSyncOpConflict         ///< Handle conflict
+    kSyncOpConflict,        ///< Handle conflict
+    kSyncOpCopy,            ///< Copy within the drive (previousPath is
+                            ///< the source)
+    kSyncOpUpdateMetadata,  ///< Stat change: PATCH the modification time,
+                            ///< or upload if the content changed
+    kSyncOpDeleteLocal      ///< Remote delete: remove the local copy
 };
 
 /**
@@ -59,6 +69,14 @@ enum SyncItemStatus {
     kSyncStatusSkipped      ///< Skipped (filtered out)
 };
 
+/**
+ * @brief Sync item priority
+ */
+enum SyncPriority {
+    kSyncPriorityNormal = 0,    ///< Found by scans and change monitoring
+    kSyncPriorityUser           ///< Requested by the user (Sync now, drops)
+};
+
 /**
  * @brief Sync direction
  */
@@ -85,18 +103,27 @@ enum ConflictResolution {
 struct SyncItem {
     BString localPath;          ///< Local file path
     BString remotePath;         ///< Remote file path
+    BString previousPath;       ///< Previous remote path (move operations)
     BString fileId;             ///< OneDrive file ID
+    BString parentId;           ///< Remote parent folder ID, when known
     SyncOperation operation;    ///< Operation to perform
     SyncItemStatus status;      ///< Current status
     time_t localModified;       ///< Local modification time
     time_t remoteModified;      ///< Remote modification time
     off_t size;                 ///< File size
     BString eTag;               ///< Remote ETag
-    BString localHash;          ///< Local file hash
+    BString localHash;          ///< Local file hash (QuickXorHash)
     BString remoteHash;         ///< Remote file hash
     int32 retryCount;           ///< Number of retry attempts
     BString errorMessage;       ///< Error message if failed
     bool isPinned;              ///< Pinned for offline access
+    SyncPriority priority;      ///< Scheduling priority
+    bigtime_t queuedTime;       ///< When it was queued (wall-clock usecs)
+    bool deduplicated;          ///< Transferred by copying content already
+                                ///< on the drive (uploads) or on disk
+                                ///< (downloads); set by each attempt
+    bool unchanged;             ///< Upload skipped: the drive already holds
+                                ///< this file as is; set by each attempt
 };
 
 /**
@@ -112,6 +139,42 @@ struct SyncStats {
     time_t startTime;           ///< Sync start time
     time_t endTime;             ///< Sync end time
     float throughput;           ///< Average throughput (KB/s)
+    int32 operationsSaved;      ///< Operations removed by plan optimization
+    int32 retriedItems;         ///< Retries scheduled with backoff
+    int32 parkedItems;          ///< Items parked as not retryable
+    int32 pollInterval;         ///< Current remote poll interval (seconds)
+    float pollHitRatio;         ///< Fraction of polls that found changes
+    bool pushActive;            ///< Remote changes arrive by notification
+    int32 remoteNotifications;  ///< Change notifications received
+    int32 deltaPages;           ///< Pages in the last delta run
+    bigtime_t deltaFetchTime;   ///< Last delta run: time fetching pages
+    bigtime_t deltaParseTime;   ///< Last delta run: time parsing pages
+    bigtime_t deltaApplyTime;   ///< Last delta run: time applying pages
+    int32 crawledItems;         ///< Items listed by the last tree crawl
+    float crawlItemsPerSecond;  ///< Listing rate of the last tree crawl
+    int32 remoteItems;          ///< Items in the remote tree index
+    size_t remoteIndexBytes;    ///< Memory held by the remote tree index
+    size_t queueBytes;          ///< Memory held by the sync queue
+    int32 queueSpilled;         ///< Queued items waiting on disk
+    bigtime_t remoteTreeReadyTime; ///< From startup to a usable remote tree
+    bool remoteTreeFromSnapshot; ///< Remote tree was mapped from a snapshot
+    bigtime_t userQueueWait;    ///< Mean queue wait of user requests
+    bigtime_t smallQueueWait;   ///< Mean queue wait of small operations
+    bigtime_t largeQueueWait;   ///< Mean queue wait of large transfers
+    bigtime_t maxQueueWait;     ///< Longest queue wait of any operation
+    float diskUtilization;      ///< Busy share of the transfer disk workers
+    float networkUtilization;   ///< Busy share of the transfer connections
+    float finalizeUtilization;  ///< Busy share of the finalize workers
+    off_t uploadRateLimit;      ///< Upload limit in effect (bytes/sec)
+    off_t downloadRateLimit;    ///< Download limit in effect (bytes/sec)
+    bigtime_t throttledTime;    ///< Time transfers waited for bandwidth
+    off_t bytesDeduplicated;    ///< Transfer bytes replaced by copies
+    int32 deduplicatedItems;    ///< Transfers done by copying content
+    int32 uploadsUnchanged;     ///< Uploads the drive already held as is
+    int32 contentUploadsAvoided; ///< Local changes synced by metadata PATCH
+    int32 changesHashed;        ///< Stat changes hashed to classify them
+    int32 attributeBacklog;     ///< Files with attribute changes to upload
+    float attributeDrainRate;   ///< Attribute uploads per busy second
 };
 
 /**
@@ -126,11 +189,37 @@ struct SyncConfig {
     int32 maxRetries;                   ///< Max retry attempts
     int32 syncInterval;                 ///< Sync interval (seconds)
     off_t bandwidthLimit;               ///< Bandwidth limit (bytes/sec)
+    off_t uploadLimit;                  ///< Upload limit, 0 for bandwidthLimit
+    off_t downloadLimit;                ///< Download limit, 0 for bandwidthLimit
+    BString bandwidthSchedule;          ///< Time-of-day limits, see
+                                        ///< BandwidthShaper::SetSchedule()
     bool wifiOnly;                      ///< Only sync on WiFi
-    BStringList excludePatterns;        ///< File patterns to exclude
-    BStringList includePatterns;        ///< File patterns to include
+    BStringList excludePatterns;        ///< Patterns to exclude, see PathFilter
+    BStringList includePatterns;        ///< Patterns to include, see PathFilter
+    off_t largeFileThreshold;           ///< Transfers from here are large
+    float largeTransferShare;           ///< Bytes reserved for large ones
+    int32 diskConcurrency;              ///< Files read and hashed at once
+    int32 transferConcurrency;          ///< Transfers at once, 0 for the
+                                        ///< API's connection budget
+    bool deduplicateUploads;            ///< Copy content the drive already
+                                        ///< has instead of uploading it
+    bool deduplicateDownloads;          ///< Copy content already on disk
+                                        ///< instead of downloading it
 };
 
+class AdaptivePoller;
+class BandwidthShaper;
+class DropJobTracker;
+class LocalChangeClassifier;
+class LocalMoveTranslator;
+class NotificationChannel;
+class PathFilter;
+class RemoteTreeIndex;
+class RetryScheduler;
+class SyncScheduler;
+class TransferPipeline;
+struct DropJobProgress;
+
 /**
  * @brief Manages bidirectional synchronization between local and cloud
  * 
@@ -232,9 +321,21 @@ public:
      * 
      * @param path Path to sync
      * @param recursive Whether to sync recursively
+     * @param priority Scheduling priority of the resulting operation
      * @return B_OK on success
      */
-    status_t SyncPath(const BPath& path, bool recursive = true);
+    status_t SyncPath(const BPath& path, bool recursive = true,
+        SyncPriority priority = kSyncPriorityNormal);
+    
+    /**
+     * @brief Requeue items parked as not retryable
+     * 
+     * Call once the cause has been fixed, e.g. after re-authentication
+     * or when quota has been freed.
+     * 
+     * @return Number of items requeued
+     */
+    int32 RetryParkedItems();
     
     /**
      * @brief Get sync configuration
@@ -300,6 +401,25 @@ private:
      */
     status_t _ScanLocalChanges();
     
+    /**
+     * @brief Record where every file below a folder is
+     * 
+     * @param folder Local folder
+     */
+    void _LocateLocalFiles(const BPath& folder);
+    
+    /**
+     * @brief Follow a created or moved entry by node
+     * 
+     * A moved entry takes what was recorded under its old path along; a
+     * file is recorded under its new one, so its stat and attribute
+     * changes are found.
+     * 
+     * @param message B_ENTRY_CREATED or B_ENTRY_MOVED
+     * @param path Local path of the entry now
+     */
+    void _LocateLocalEntry(BMessage* message, const BPath& path);
+    
     /**
      * @brief Scan remote changes
      * 
@@ -307,11 +427,301 @@ private:
      */
     status_t _ScanRemoteChanges();
     
+    /**
+     * @brief Apply one page of remote changes as a batch
+     * 
+     * @param items OneDriveItem objects of the page
+     * @param changes Incremented by the number of changed items
+     * @return B_OK, or B_CANCELED if the sync is stopping
+     */
+    status_t _ApplyRemoteChanges(const BList& items, int32& changes);
+    
+    /**
+     * @brief Queue what one remote change needs on disk
+     * 
+     * Files missing locally are downloaded, and files that differ from
+     * their last synced state become updates. Deleted, moved and renamed
+     * items remove their old local copy. Folders are created by the first
+     * download into them; empty ones are not created.
+     * 
+     * @param remote Changed item, already applied to the remote tree
+     * @param previousPath Remote path before the change, empty if new
+     */
+    void _QueueRemoteChange(const OneDriveItem& remote,
+                            const BString& previousPath);
+    
+    /**
+     * @brief Queue the files below a remote folder
+     * 
+     * Used for moved folders, whose contents the delta does not report.
+     * 
+     * @param folderId Remote folder ID
+     * @param reported IDs reported by the delta page, queued already
+     */
+    void _QueueRemoteFolder(const BString& folderId,
+                            const std::set<BString>& reported);
+    
+    /**
+     * @brief Enumerate the remote tree folder by folder
+     * 
+     * Used when delta cannot continue (expired token). Folders are listed
+     * concurrently and applied like delta pages.
+     * 
+     * @param deltaToken Receives a fresh delta token taken before the crawl
+     * @return B_OK on success
+     */
+    status_t _CrawlRemoteTree(BString& deltaToken);
+    
     /**
      * @brief Process sync queue
      */
     void _ProcessSyncQueue();
     
+    /**
+     * @brief Record the outcome of a processed item
+     * 
+     * Counts it as completed or hands it to the retry scheduler, then
+     * reports progress.
+     * 
+     * @param item Processed item
+     * @param result Result of the operation
+     */
+    void _CompleteItem(SyncItem& item, status_t result);
+    
+    /**
+     * @brief Check whether an operation goes through the transfer pipeline
+     * 
+     * @param item Sync item
+     * @return true for uploads and downloads
+     */
+    static bool _IsTransfer(const SyncItem& item);
+    
+    /**
+     * @brief Disk stage: read and hash uploads, prepare download folders
+     * 
+     * @param item Upload or download
+     * @return B_OK on success
+     */
+    status_t _ReadTransfer(SyncItem& item);
+    
+    /**
+     * @brief Finalize stage: cache, attributes and statistics
+     * 
+     * @param item Completed upload or download
+     * @return B_OK on success
+     */
+    status_t _FinalizeTransfer(SyncItem& item);
+    
+    /**
+     * @brief Called by the transfer pipeline when an item leaves it
+     * 
+     * @param item Transferred item
+     * @param result Result, B_CANCELED if it never finished
+     */
+    void _TransferDone(SyncItem& item, status_t result);
+    
+    /**
+     * @brief Apply the configured concurrency to the transfer stages
+     */
+    void _ApplyTransferConcurrency();
+    
+    /**
+     * @brief Run the plan optimizer over the pending queue
+     * 
+     * Collapses whole-subtree deletes and moves and orders new folder
+     * trees parent-first. Updates the operations saved statistic.
+     */
+    void _OptimizeQueue();
+    
+    /**
+     * @brief Hand a failed item to the retry scheduler
+     * 
+     * @param item Failed sync item
+     * @param result Error returned by the operation
+     */
+    void _ScheduleRetry(SyncItem& item, status_t result);
+    
+    /**
+     * @brief Move retries that are due into the sync queue
+     * 
+     * @return Number of items moved
+     */
+    int32 _PromoteDueRetries();
+    
+    /**
+     * @brief Create the wake-up semaphores and spawn the sync worker
+     * 
+     * @return B_OK on success
+     */
+    status_t _StartWorker();
+    
+    /**
+     * @brief Ask the sync worker to exit and wait for it
+     */
+    void _StopWorker();
+    
+    /**
+     * @brief Wake the sync worker
+     * 
+     * Called whenever there is something for the worker to act on: new
+     * work, resume, stop or shutdown.
+     */
+    void _WakeWorker();
+    
+    /**
+     * @brief Sync worker thread entry point
+     * 
+     * @param data Pointer to the sync engine
+     * @return Thread exit code
+     */
+    static int32 _WorkerThread(void* data);
+    
+    /**
+     * @brief Sleep until woken or a retry comes due, then run a sync pass
+     * 
+     * The worker blocks on a semaphore between passes, so an idle engine
+     * causes no wake-ups at all.
+     */
+    void _WorkerLoop();
+    
+    /**
+     * @brief Scan local and remote changes into the sync queue
+     * 
+     * @return B_OK on success
+     */
+    status_t _RunScans();
+    
+    /**
+     * @brief Get ID of an item's parent folder, if known this sync
+     * 
+     * Folder IDs are learned from folder creation and remote listings, so
+     * child operations can address their parent by ID.
+     * 
+     * @param remotePath Remote path of the child item
+     * @return Parent folder ID, or an empty string if unknown
+     */
+    BString _KnownParentId(const BString& remotePath) const;
+    
+    /**
+     * @brief Remember the ID of a remote folder for child operations
+     * 
+     * @param remotePath Remote path of the folder
+     * @param folderId OneDrive ID of the folder
+     */
+    void _RememberFolderId(const BString& remotePath, const BString& folderId);
+    
+    /**
+     * @brief Queue the files named by a user request
+     * 
+     * Handles "Sync now" from Tracker, pinning, drag-and-drop and
+     * download requests. The operations go to the user lane and run
+     * before the rest of the backlog.
+     * 
+     * @param message kMsgSyncRequired or kMsgDownloadFile
+     */
+    void _QueueUserRequest(BMessage* message);
+    
+    /**
+     * @brief Queue copies dropped inside the sync folder
+     * 
+     * Copies with both ends inside the sync folder become kSyncOpCopy
+     * operations in the user lane; the others are synced as drops.
+     * 
+     * @param message kMsgCopyItem with "source" and "destination" refs
+     */
+    void _QueueUserCopy(BMessage* message);
+    
+    /**
+     * @brief Start a batched drag-and-drop job
+     * 
+     * The refs are handed to a background thread, which walks dropped
+     * folders and queues one item per entry. Progress of the whole job is
+     * reported to "reply_to" as kMsgDropJobProgress.
+     * 
+     * @param message kMsgDropJob with "refs", "destination", "copy", "job"
+     *        and "reply_to"
+     */
+    void _QueueDropJob(BMessage* message);
+    
+    /**
+     * @brief Run work on a thread of its own, off the worker and looper
+     * 
+     * Shutdown() waits for it. Without a thread the work runs inline.
+     * 
+     * @param name Thread name
+     * @param work Work to run
+     */
+    void _SpawnHelper(const char* name, const std::function<void()>& work);
+    
+    /**
+     * @brief Helper thread entry point
+     */
+    static int32 _HelperThread(void* data);
+    
+    /**
+     * @brief Queue the items of a drop job
+     * 
+     * Copies and moves inside the sync folder become one operation per
+     * ref. Files and folders dropped into the sync folder are enumerated,
+     * folders by several workers at once.
+     * 
+     * @param job Drop job ID
+     * @param message kMsgDropJob
+     */
+    void _RunDropJob(int32 job, const BMessage& message);
+    
+    /**
+     * @brief Queue a dropped file or folder and everything below it
+     * 
+     * The source is walked, not the target: a drop from outside is
+     * enumerated while Tracker is still copying it in. Each entry is
+     * queued at its place below the target.
+     * 
+     * @param job Drop job ID, or 0 to queue without progress tracking
+     * @param source Dropped entry, where its content is complete
+     * @param target Where it is synced, inside the sync folder
+     * @return B_OK on success, B_CANCELED on shutdown
+     */
+    status_t _EnumerateDrop(int32 job, const BPath& source,
+        const BPath& target);
+    
+    /**
+     * @brief Queue one enumerated entry of a drop job
+     * 
+     * Entries the remote tree already has as folders need nothing; files
+     * it has are updated, the others uploaded or created.
+     * 
+     * @param job Drop job ID
+     * @param localPath Entry inside the sync folder
+     * @param isFolder Whether the entry is a folder
+     * @param size File size
+     */
+    void _QueueDroppedEntry(int32 job, const BString& localPath,
+                            bool isFolder, off_t size);
+    
+    /**
+     * @brief Settle an item in the drop job it belongs to, if any
+     * 
+     * @param localPath Local path of a completed or abandoned item
+     * @param succeeded Whether the item was synced
+     */
+    void _DropItemDone(const BString& localPath, bool succeeded);
+    
+    /**
+     * @brief Send the progress of a drop job to its client
+     * 
+     * @param progress Job progress; a finished job is forgotten
+     */
+    void _ReportDropJob(const DropJobProgress& progress);
+    
+    /**
+     * @brief Map a local path below the sync folder to its remote path
+     * 
+     * @param localPath Local path inside the sync folder
+     * @return Remote path relative to the OneDrive root
+     */
+    BString _RemotePathFor(const BPath& localPath) const;
+    
     /**
      * @brief Process single sync item
      * 
@@ -328,6 +738,28 @@ private:
      */
     status_t _UploadFile(SyncItem& item);
     
+    /**
+     * @brief Upload by server-side copy if the drive has the content
+     * 
+     * Looks the local hash and size up in the remote tree. A match in
+     * another place is copied there by the server and marks the item
+     * deduplicated; the upload's own target with this content needs
+     * nothing at all and marks it unchanged.
+     * 
+     * @param item Hashed upload with a known parent ID
+     * @return true if the content is now in place, false to upload
+     */
+    bool _CopyExistingContent(SyncItem& item);
+    
+    /**
+     * @brief Add an uploaded file to the remote tree with its hash
+     * 
+     * Identical files later in the same sync can then be copied.
+     * 
+     * @param item Completed upload
+     */
+    void _IndexUploadedContent(const SyncItem& item);
+    
     /**
      * @brief Download file
      * 
@@ -336,6 +768,34 @@ private:
      */
     status_t _DownloadFile(SyncItem& item);
     
+    /**
+     * @brief Download by local copy if the content is already on disk
+     * 
+     * Looks the remote hash and size up among cached files and, through
+     * the remote tree, among synced files with the same content. A
+     * candidate is only taken once its copy hashes to the remote hash.
+     * 
+     * @param item Download of a file in the remote tree
+     * @return true if the content is now in place, false to download
+     */
+    bool _CopyLocalContent(SyncItem& item);
+    
+    /**
+     * @brief Copy a file, checking the copy against a content hash
+     * 
+     * The copy is written next to the target under a hidden temporary
+     * name and only renamed over it when its QuickXorHash matches.
+     * 
+     * @param source File with the expected content
+     * @param target Destination, replaced on success
+     * @param hash Expected QuickXorHash
+     * @param size Expected size
+     * @return B_OK if the target now has the content, B_BAD_DATA if the
+     *         source differs
+     */
+    status_t _CopyVerified(const BPath& source, const BPath& target,
+                           const BString& hash, off_t size);
+    
     /**
      * @brief Update file
      * 
@@ -352,6 +812,26 @@ private:
      */
     status_t _DeleteFile(SyncItem& item);
     
+    /**
+     * @brief Remove the local copy of a remotely deleted item
+     * 
+     * Only files unchanged since they were last synced are removed; a
+     * local edit is kept and uploaded again. Folders go once empty.
+     * Nothing is removed if the path exists remotely again.
+     * 
+     * @param item kSyncOpDeleteLocal item
+     * @return B_OK on success
+     */
+    status_t _DeleteLocal(SyncItem& item);
+    
+    /**
+     * @brief Remove a local file, or a folder tree, left as synced
+     * 
+     * @param path Local path
+     * @return B_OK if it is gone or was kept on purpose
+     */
+    status_t _RemoveLocalTree(const BPath& path);
+    
     /**
      * @brief Move file
      * 
@@ -368,6 +848,139 @@ private:
      */
     status_t _CreateFolder(SyncItem& item);
     
+    /**
+     * @brief Copy a file or folder within the drive
+     * 
+     * The copy is made on disk from the local source and on the server by
+     * Graph's copy action, so no content is uploaded. Both run on a helper
+     * thread, see _RunCopy(); _CopyFinished() handles the outcome.
+     * 
+     * @param item Copy with the source in previousPath
+     * @return B_WOULD_BLOCK once the source and destination folder IDs are
+     *         known and the copy has started; it is settled by
+     *         _CopyFinished()
+     */
+    status_t _CopyItem(SyncItem& item);
+    
+    /**
+     * @brief Make a copy on disk, then start its server-side copy
+     * 
+     * Runs on a helper thread, as the tree may be large. A failed local
+     * copy is reported to _CopyFinished() like a failed server copy.
+     * 
+     * @param item Copy resolved by _CopyItem()
+     */
+    void _RunCopy(const SyncItem& item);
+    
+    /**
+     * @brief Sync a stat change that left the content as it was
+     * 
+     * Sends the new modification time as fileSystemInfo. Items found to
+     * change nothing the drive keeps complete without a request.
+     * 
+     * @param item Item classified by _ClassifyStatChange()
+     * @return B_OK on success
+     */
+    status_t _UpdateMetadata(SyncItem& item);
+    
+    /**
+     * @brief Find the remote ID of an item's file, if not set yet
+     * 
+     * @param item Item with remotePath set
+     * @return B_OK if item.fileId is set
+     */
+    status_t _ResolveFileId(SyncItem& item);
+    
+    /**
+     * @brief Queue the sync of a stat or attribute change
+     * 
+     * Stat changes are queued as metadata updates. Attribute changes go to
+     * the attribute manager, which uploads each file once per burst; a
+     * file never synced is uploaded instead.
+     * 
+     * @param node Changed node
+     * @param attribute Name of the changed attribute, NULL for stat data
+     */
+    void _QueueLocalChange(const node_ref& node, const char* attribute);
+    
+    /**
+     * @brief Queue the remote delete of a locally removed file or folder
+     * 
+     * A removed folder reports every entry below it; the plan optimizer
+     * collapses those into the folder's delete.
+     * 
+     * @param localPath Path the entry was removed from
+     */
+    void _QueueLocalDelete(const BString& localPath);
+    
+    /**
+     * @brief Decide what a queued stat change needs
+     * 
+     * Turns the item into an upload if the content changed. Otherwise it
+     * stays a metadata update, with localModified set to the time to send
+     * or 0 if there is nothing to send.
+     * 
+     * @param item kSyncOpUpdateMetadata item
+     */
+    void _ClassifyStatChange(SyncItem& item);
+    
+    /**
+     * @brief Record the state a file was just synced in
+     * 
+     * @param item Completed upload or download
+     */
+    void _RememberLocalState(const SyncItem& item);
+    
+    /**
+     * @brief Copy a file or folder tree on disk, attributes included
+     * 
+     * @param source Existing file or folder
+     * @param destination Path of the copy
+     * @param bytes Incremented by the bytes copied
+     * @return B_OK on success
+     */
+    status_t _CopyLocalTree(const BPath& source, const BPath& destination,
+                            off_t& bytes);
+    
+    /**
+     * @brief Completion callback of a server-side copy
+     * 
+     * Runs on the API's monitor thread and posts the outcome back to the
+     * engine as kMsgCopyFinished, with the error text of a failure read
+     * there, right after it happened.
+     */
+    static void _CopyCompleted(OneDriveError error, const OneDriveItem& copied,
+                               void* userData);
+    
+    /**
+     * @brief Record a finished server-side copy
+     * 
+     * Settles the copy in the statistics and in the drop job waiting for
+     * it. A failed copy falls back to uploading the local copy, a folder
+     * entry by entry as a drop would be, walked on a helper thread; the
+     * drop job waits for those uploads instead.
+     * 
+     * @param message kMsgCopyFinished
+     */
+    void _CopyFinished(BMessage* message);
+    
+    /**
+     * @brief Check for a path made by a copy still in progress
+     * 
+     * @param path Local path
+     * @return true if the server copy will bring the path remotely too,
+     *         or if it is the temporary file of a verified copy
+     */
+    bool _IsCopyDestination(const BString& path) const;
+    
+    /**
+     * @brief Check for a path a dropped move is waiting to move remotely
+     * 
+     * @param path Local path
+     * @return true if a queued move will bring the path remotely too
+     */
+    bool _IsMoveDestination(const BString& path) const;
+    
     /**
      * @brief Handle conflict
      * 
@@ -387,9 +1000,9 @@ private:
     /**
      * @brief Add item to sync queue
      * 
-     * @param item Item to add
+     * @param item Item to add, moved into the queue
      */
-    void _AddToQueue(const SyncItem& item);
+    void _AddToQueue(SyncItem&& item);
     
     /**
      * @brief Update sync status
@@ -414,17 +1027,46 @@ private:
     status_t _LoadSyncState();
     
     /**
-     * @brief Save sync state
+     * @brief Save the sync queue, fLock held
+     * 
+     * @return B_OK on success
+     */
+    status_t _SaveSyncQueue();
+    
+    /**
+     * @brief Write the remote tree snapshot, without fLock
+     * 
+     * Writing the whole tree takes long; the index locks itself.
      * 
+     * @param deltaToken Delta token, copied under fLock
      * @return B_OK on success
      */
-    status_t _SaveSyncState();
+    status_t _SaveRemoteTree(const BString& deltaToken);
+    
+    /**
+     * @brief Get a file in the cache folder, creating the folder
+     * 
+     * @param name File name
+     * @param path Receives the path
+     * @return B_OK on success
+     */
+    status_t _GetCachePath(const char* name, BPath& path) const;
+    
+    /**
+     * @brief Record when the remote tree first became usable
+     * 
+     * @param source Where the tree came from, for the log
+     */
+    void _RemoteTreeReady(const char* source);
     
     /**
      * @brief Calculate file hash
      * 
+     * Uses QuickXorHash, which OneDrive reports for every remote file, so
+     * local and remote content can be compared.
+     * 
      * @param path File path
-     * @return Hash string
+     * @return Base64 hash, empty on a read error
      */
     BString _CalculateFileHash(const BPath& path);
     
@@ -437,16 +1079,26 @@ private:
     bool _ShouldSync(const BPath& path);
     
     /**
-     * @brief Apply bandwidth limit
-     * 
-     * @param bytesTransferred Bytes transferred so far
+     * @brief Apply the configured limits and schedule to the shaper
      */
-    void _ApplyBandwidthLimit(off_t bytesTransferred);
+    void _ApplyBandwidthConfig();
     
     /**
      * @brief Sync timer tick
      */
     void _SyncTimerTick();
+    
+    /**
+     * @brief Handle a remote change notification
+     */
+    void _RemoteChangeNotified();
+    
+    /**
+     * @brief Switch between notification-driven and polling mode
+     * 
+     * @param connected Whether the notification channel is up
+     */
+    void _NotificationChannelChanged(bool connected);
 
 private:
     OneDriveAPI& fAPI;                      ///< OneDrive API client
@@ -455,8 +1107,25 @@ private:
     BPath fSyncPath;                        ///< Root sync folder
     
     SyncConfig fConfig;                     ///< Sync configuration
-    std::queue<SyncItem> fSyncQueue;        ///< Queue of items to sync
-    std::map<BString, SyncItem> fActiveItems; ///< Currently syncing items
+    std::unique_ptr<SyncScheduler> fSyncQueue; ///< Lanes of items to sync
+    std::map<BString, BString> fFolderIds;  ///< Remote folder path -> ID known this sync
+    std::set<BString> fCopyDestinations;    ///< Local copies awaiting their
+                                            ///< server-side copy, and
+                                            ///< verified copies in progress
+    std::set<BString> fMoveDestinations;    ///< Local targets of dropped
+                                            ///< moves not yet moved remotely
+    
+    /**
+     * @brief Client of a drag-and-drop job
+     */
+    struct DropJobClient {
+        BMessenger target;                  ///< Receives progress reports
+        int32 clientJob;                    ///< Job ID the client uses
+    };
+    
+    std::unique_ptr<DropJobTracker> fDropJobs; ///< Drop job progress
+    std::map<int32, DropJobClient> fDropClients; ///< Drop job -> client
+    std::set<thread_id> fHelperThreads;     ///< Drop jobs and helpers running
     mutable BLocker fLock;                  ///< Thread safety lock
     
     bool fInitialized;                      ///< Initialization flag
@@ -465,11 +1134,33 @@ private:
     bool fStopRequested;                    ///< Stop requested flag
     
     BMessageRunner* fSyncTimer;             ///< Periodic sync timer
+    std::unique_ptr<RetryScheduler> fRetries; ///< Delayed retry queue
+    std::unique_ptr<AdaptivePoller> fPoller; ///< Remote poll cadence
+    std::unique_ptr<NotificationChannel> fNotifications; ///< Push channel
+    std::unique_ptr<RemoteTreeIndex> fRemoteTree; ///< Remote namespace
+    std::unique_ptr<BandwidthShaper> fBandwidth; ///< Shared transfer rate limits
+    std::unique_ptr<PathFilter> fExcludes;  ///< Compiled exclude patterns
+    std::unique_ptr<PathFilter> fIncludes;  ///< Compiled include patterns
+    std::unique_ptr<TransferPipeline> fTransfers; ///< Disk/network stages
+    std::unique_ptr<LocalChangeClassifier> fLocalChanges; ///< Synced state
+                                            ///< of local files by node
+    std::unique_ptr<LocalMoveTranslator> fLocalMoves; ///< Renames and moves
+    bool fPushActive;                       ///< Polling only as safety net
+    
+    thread_id fWorkerThread;                ///< Persistent sync worker
+    sem_id fWakeSemaphore;                  ///< Released when there is work
+    sem_id fStoppedSemaphore;               ///< Released when a stop completes
+    std::atomic<bool> fQuitting;            ///< Worker exit requested
+    bool fScanRequested;                    ///< Next pass scans for changes
+    bool fLocalFilesLocated;                ///< Local files recorded by node
+    bool fPollRequested;                    ///< Next pass polls remote delta
+    int32 fStopWaiters;                     ///< Threads blocked in StopSync
     BHandler* fConflictHandler;             ///< Conflict resolution handler
     BHandler* fProgressHandler;             ///< Progress update handler
     
     SyncStats fStats;                       ///< Current sync statistics
     time_t fLastSyncTime;                   ///< Last successful sync
+    bigtime_t fStartTime;                   ///< When Initialize() started
     BString fDeltaToken;                    ///< Delta sync token
 };
 
@@ -0,0 +1,328 @@
+/**
+ * @file SyncPlanOptimizer.cpp
+ * @brief Implementation of the sync plan optimization pass
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "SyncPlanOptimizer.h"
+#include "../shared/ErrorLogger.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace OneDrive;
+
+/**
+ * @brief Constructor
+ */
+SyncPlanOptimizer::SyncPlanOptimizer()
+    : fCollapsedDeletes(0),
+      fCollapsedMoves(0),
+      fChildrenOfNewFolders(0)
+{
+}
+
+/**
+ * @brief Optimize a batch of sync operations in place
+ */
+int32
+SyncPlanOptimizer::Optimize(std::vector<SyncItem>& plan)
+{
+    fCollapsedDeletes = 0;
+    fCollapsedMoves = 0;
+    fChildrenOfNewFolders = 0;
+
+    if (plan.size() < 2) {
+        return 0;
+    }
+
+    _CollapseDeletes(plan);
+    _CollapseMoves(plan);
+    _OrderPlan(plan);
+
+    if (OperationsSaved() > 0 || fChildrenOfNewFolders > 0) {
+        LOG_INFO("SyncPlanner", "Plan optimized: %d deletes and %d moves "
+            "collapsed, %d operations target new folders",
+            fCollapsedDeletes, fCollapsedMoves, fChildrenOfNewFolders);
+    }
+
+    return OperationsSaved();
+}
+
+/**
+ * @brief Check whether a path lies strictly below another path
+ */
+bool
+SyncPlanOptimizer::IsDescendant(const BString& path, const BString& ancestor)
+{
+    if (ancestor.IsEmpty() || path.Length() <= ancestor.Length()) {
+        return false;
+    }
+
+    if (!path.StartsWith(ancestor)) {
+        return false;
+    }
+
+    // Root ("/") is an ancestor of every absolute path
+    if (ancestor.ByteAt(ancestor.Length() - 1) == '/') {
+        return true;
+    }
+
+    return path.ByteAt(ancestor.Length()) == '/';
+}
+
+/**
+ * @brief Get the remote path an operation is keyed on
+ */
+BString
+SyncPlanOptimizer::PlanPath(const SyncItem& item)
+{
+    return item.remotePath.IsEmpty() ? item.localPath : item.remotePath;
+}
+
+/**
+ * @brief Remove deletes whose ancestor folder is also deleted
+ */
+void
+SyncPlanOptimizer::_CollapseDeletes(std::vector<SyncItem>& plan)
+{
+    std::set<BString> deleted;
+    for (size_t i = 0; i < plan.size(); i++) {
+        if (plan[i].operation == kSyncOpDelete) {
+            deleted.insert(PlanPath(plan[i]));
+        }
+    }
+
+    if (deleted.size() < 2) {
+        return;
+    }
+
+    std::vector<SyncItem> collapsed;
+    collapsed.reserve(plan.size());
+
+    for (size_t i = 0; i < plan.size(); i++) {
+        const SyncItem& item = plan[i];
+        if (item.operation == kSyncOpDelete
+            && !_FindAncestor(PlanPath(item), deleted).IsEmpty()) {
+            // Covered by the recursive server-side delete of the ancestor
+            fCollapsedDeletes++;
+            continue;
+        }
+        collapsed.push_back(item);
+    }
+
+    plan.swap(collapsed);
+}
+
+/**
+ * @brief Remove moves implied by an ancestor folder move
+ */
+void
+SyncPlanOptimizer::_CollapseMoves(std::vector<SyncItem>& plan)
+{
+    // Source path -> destination path for every move in the batch
+    std::map<BString, BString> moves;
+    std::set<BString> sources;
+    for (size_t i = 0; i < plan.size(); i++) {
+        const SyncItem& item = plan[i];
+        if (item.operation == kSyncOpMove && !item.previousPath.IsEmpty()) {
+            moves[item.previousPath] = PlanPath(item);
+            sources.insert(item.previousPath);
+        }
+    }
+
+    if (moves.size() < 2) {
+        return;
+    }
+
+    std::vector<SyncItem> collapsed;
+    collapsed.reserve(plan.size());
+
+    for (size_t i = 0; i < plan.size(); i++) {
+        SyncItem& item = plan[i];
+        if (item.operation != kSyncOpMove || item.previousPath.IsEmpty()) {
+            collapsed.push_back(item);
+            continue;
+        }
+
+        BString ancestor = _FindAncestor(item.previousPath, sources);
+        if (ancestor.IsEmpty()) {
+            collapsed.push_back(item);
+            continue;
+        }
+
+        // Where the ancestor move will leave this item
+        BString suffix;
+        item.previousPath.CopyInto(suffix, ancestor.Length(),
+            item.previousPath.Length() - ancestor.Length());
+        BString implied = moves[ancestor];
+        implied << suffix;
+
+        if (implied == PlanPath(item)) {
+            fCollapsedMoves++;
+            continue;
+        }
+
+        // Item moves elsewhere; it will be found at its implied location
+        item.previousPath = implied;
+        collapsed.push_back(item);
+    }
+
+    plan.swap(collapsed);
+}
+
+/**
+ * @brief Order the plan so new parents precede their children
+ */
+void
+SyncPlanOptimizer::_OrderPlan(std::vector<SyncItem>& plan)
+{
+    // Every path an operation touches, sorted: a subtree is a range
+    std::multimap<BString, size_t> paths;
+    std::vector<size_t> creates;
+    for (size_t i = 0; i < plan.size(); i++) {
+        paths.insert(std::make_pair(PlanPath(plan[i]), i));
+        if (!plan[i].previousPath.IsEmpty()) {
+            paths.insert(std::make_pair(plan[i].previousPath, i));
+        }
+        if (plan[i].operation == kSyncOpCreateFolder) {
+            creates.push_back(i);
+        }
+    }
+
+    if (creates.empty()) {
+        return;
+    }
+
+    std::set<BString> newFolders;
+    for (size_t i = 0; i < creates.size(); i++) {
+        newFolders.insert(PlanPath(plan[creates[i]]));
+    }
+    for (size_t i = 0; i < plan.size(); i++) {
+        if (!_FindAncestor(PlanPath(plan[i]), newFolders).IsEmpty()) {
+            fChildrenOfNewFolders++;
+        }
+    }
+
+    // Everything runs at its own position, except that a folder creation
+    // moves up to just before the first operation below it. It never
+    // passes an earlier operation on its own path or an ancestor's, so
+    // all other operations keep their relative order.
+    std::vector<size_t> anchors(plan.size());
+    for (size_t i = 0; i < plan.size(); i++) {
+        anchors[i] = i;
+    }
+
+    // Deepest first, so a parent moves ahead of its moved children
+    std::stable_sort(creates.begin(), creates.end(),
+        [&plan](size_t a, size_t b) {
+            return _Depth(PlanPath(plan[a])) > _Depth(PlanPath(plan[b]));
+        });
+
+    for (size_t i = 0; i < creates.size(); i++) {
+        size_t create = creates[i];
+        BString folder = PlanPath(plan[create]);
+
+        BString first(folder);
+        first << "/";
+        BString last(folder);
+        last << "0";    // '0' follows '/'
+        size_t anchor = create;
+        for (std::multimap<BString, size_t>::const_iterator it
+                = paths.lower_bound(first);
+                it != paths.end() && it->first < last; it++) {
+            anchor = std::min(anchor, anchors[it->second]);
+        }
+
+        size_t earliest = 0;
+        BString ancestor(folder);
+        while (!ancestor.IsEmpty()) {
+            std::pair<std::multimap<BString, size_t>::const_iterator,
+                std::multimap<BString, size_t>::const_iterator> range
+                = paths.equal_range(ancestor);
+            for (std::multimap<BString, size_t>::const_iterator it
+                    = range.first; it != range.second; it++) {
+                if (it->second < create) {
+                    earliest = std::max(earliest, it->second + 1);
+                }
+            }
+
+            int32 separator = ancestor.FindLast('/');
+            if (separator < 0 || ancestor == "/") {
+                break;
+            }
+            ancestor.Truncate(separator > 0 ? separator : 1);
+        }
+
+        anchors[create] = std::max(anchor, earliest);
+    }
+
+    // Ties: a folder goes before the operation it was moved ahead of,
+    // and shallower folders before deeper ones
+    std::vector<size_t> order(plan.size());
+    for (size_t i = 0; i < plan.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&plan, &anchors](size_t a, size_t b) {
+            if (anchors[a] != anchors[b]) {
+                return anchors[a] < anchors[b];
+            }
+            bool createA = plan[a].operation == kSyncOpCreateFolder;
+            bool createB = plan[b].operation == kSyncOpCreateFolder;
+            if (createA != createB) {
+                return createA;
+            }
+            if (createA) {
+                return _Depth(PlanPath(plan[a])) < _Depth(PlanPath(plan[b]));
+            }
+            return false;
+        });
+
+    std::vector<SyncItem> ordered;
+    ordered.reserve(plan.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        ordered.push_back(std::move(plan[order[i]]));
+    }
+    plan.swap(ordered);
+}
+
+/**
+ * @brief Find the closest ancestor of a path contained in a set
+ */
+BString
+SyncPlanOptimizer::_FindAncestor(const BString& path,
+    const std::set<BString>& paths)
+{
+    int32 separator = path.FindLast('/');
+    while (separator >= 0) {
+        BString parent;
+        path.CopyInto(parent, 0, separator > 0 ? separator : 1);
+        if (parent != path && paths.find(parent) != paths.end()) {
+            return parent;
+        }
+        if (separator == 0) {
+            break;
+        }
+        separator = path.FindLast('/', separator - 1);
+    }
+
+    return BString();
+}
+
+/**
+ * @brief Get path depth (number of separators)
+ */
+int32
+SyncPlanOptimizer::_Depth(const BString& path)
+{
+    int32 depth = 0;
+    for (int32 i = 0; i < path.Length(); i++) {
+        if (path.ByteAt(i) == '/') {
+            depth++;
+        }
+    }
+    return depth;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file SyncPlanOptimizer.h
+ * @brief Plan optimization pass for queued sync operations
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * The SyncPlanOptimizer rewrites a batch of pending sync operations before
+ * they are executed. Whole-subtree deletes and moves are collapsed into a
+ * single server-side folder operation, and new folder trees are ordered
+ * parent-first so their children can be addressed by parent ID.
+ */
+
+#ifndef SYNC_PLAN_OPTIMIZER_H
+#define SYNC_PLAN_OPTIMIZER_H
+
+#include <String.h>
+
+#include <set>
+#include <vector>
+
+#include "SyncEngine.h"
+
+namespace OneDrive {
+
+/**
+ * @brief Collapses and orders a batch of sync operations
+ *
+ * A locally deleted or moved directory produces one node monitor event per
+ * descendant. The remote side only needs the folder-level operation, since
+ * OneDrive deletes and moves folders recursively. The optimizer removes the
+ * redundant descendant operations and orders the remaining plan by what
+ * depends on what:
+ *
+ * - A folder creation moves ahead of the first operation below it, or
+ *   that moves something below it, so its ID is known by then
+ * - Operations on the same path keep their relative order, so an upload
+ *   followed by a delete still ends with the delete
+ * - Everything else keeps its original position
+ *
+ * @see OneDriveSyncEngine
+ * @since 1.0.0
+ */
+class SyncPlanOptimizer {
+public:
+    /**
+     * @brief Constructor
+     */
+    SyncPlanOptimizer();
+
+    /**
+     * @brief Optimize a batch of sync operations in place
+     *
+     * @param plan Operations to optimize, rewritten in execution order
+     * @return Number of operations removed from the plan
+     */
+    int32 Optimize(std::vector<SyncItem>& plan);
+
+    /**
+     * @brief Get number of operations removed by the last run
+     *
+     * @return Total operations saved
+     */
+    int32 OperationsSaved() const
+        { return fCollapsedDeletes + fCollapsedMoves; }
+
+    /**
+     * @brief Get number of descendant deletes collapsed by the last run
+     *
+     * @return Collapsed delete count
+     */
+    int32 CollapsedDeletes() const { return fCollapsedDeletes; }
+
+    /**
+     * @brief Get number of descendant moves collapsed by the last run
+     *
+     * @return Collapsed move count
+     */
+    int32 CollapsedMoves() const { return fCollapsedMoves; }
+
+    /**
+     * @brief Get number of operations placed inside a new folder tree
+     *
+     * These operations can be addressed by the parent's ID once it has
+     * been created, avoiding a path lookup per child.
+     *
+     * @return Count of operations targeting newly created folders
+     */
+    int32 ChildrenOfNewFolders() const { return fChildrenOfNewFolders; }
+
+    /**
+     * @brief Check whether a path lies strictly below another path
+     *
+     * @param path Path to test
+     * @param ancestor Candidate ancestor path
+     * @return true if path is a descendant of ancestor
+     */
+    static bool IsDescendant(const BString& path, const BString& ancestor);
+
+    /**
+     * @brief Get the remote path an operation is keyed on
+     *
+     * @param item Sync item
+     * @return Remote path, or local path if no remote path is set
+     */
+    static BString PlanPath(const SyncItem& item);
+
+private:
+    /**
+     * @brief Remove deletes whose ancestor folder is also deleted
+     *
+     * @param plan Operations to rewrite
+     */
+    void _CollapseDeletes(std::vector<SyncItem>& plan);
+
+    /**
+     * @brief Remove moves implied by an ancestor folder move
+     *
+     * @param plan Operations to rewrite
+     */
+    void _CollapseMoves(std::vector<SyncItem>& plan);
+
+    /**
+     * @brief Order the plan so new parents precede their children
+     *
+     * @param plan Operations to reorder
+     */
+    void _OrderPlan(std::vector<SyncItem>& plan);
+
+    /**
+     * @brief Find the closest ancestor of a path contained in a set
+     *
+     * @param path Path whose ancestors are checked
+     * @param paths Set of candidate ancestor paths
+     * @return Matching ancestor, or an empty string if none
+     */
+    static BString _FindAncestor(const BString& path,
+        const std::set<BString>& paths);
+
+    /**
+     * @brief Get path depth (number of separators)
+     *
+     * @param path Path to measure
+     * @return Depth of the path
+     */
+    static int32 _Depth(const BString& path);
+
+private:
+    int32 fCollapsedDeletes;        ///< Deletes removed in last run
+    int32 fCollapsedMoves;          ///< Moves removed in last run
+    int32 fChildrenOfNewFolders;    ///< Operations under new folders
+};
+
+} // namespace OneDrive
+
+#endif // SYNC_PLAN_OPTIMIZER_H
@@ -0,0 +1,1135 @@
+/**
+ * @file SyncQueue.cpp
+ * @brief Implementation of the compact sync operation queue
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "SyncQueue.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace OneDrive;
+
+const int32 SyncQueue::kDefaultMemoryLimit = 8192;
+
+static const uint32 kEmptySlot = 0xffffffff;
+static const uint32 kNoPath = 0xffffffff;
+static const uint8 kPinnedFlag = 0x01;
+static const size_t kMinCompactBytes = 256 * 1024;
+
+static const uint32 kSegmentMagic = 'ODqs';
+static const uint32 kSaveMagic = 'ODqw';
+static const uint32 kQueueFormatVersion = 2;
+static const off_t kSegmentBytes = 16 * 1024 * 1024;
+static const size_t kIOChunkBytes = 64 * 1024;
+static const uint32 kMaxRecordBytes = 1024 * 1024;
+static const char* kSaveName = "window";
+
+/**
+ * @brief Start of every segment file
+ */
+struct SyncQueue::SegmentHeader {
+    uint32 magic;               ///< kSegmentMagic
+    uint32 version;             ///< kQueueFormatVersion
+};
+
+/**
+ * @brief Start of the saved window, followed by its records
+ */
+struct SyncQueue::SaveHeader {
+    uint32 magic;               ///< kSaveMagic
+    uint32 version;             ///< kQueueFormatVersion
+    uint32 readSegment;         ///< Oldest segment still to read
+    int32 count;                ///< Records that follow
+    int64 readOffset;           ///< Next record in readSegment
+};
+
+/**
+ * @brief Fixed part of a record on disk, followed by nine strings
+ *
+ * Records are [uint32 length][SpillRecord][uint32 length][bytes]...,
+ * in host byte order: the files never leave this machine.
+ */
+struct SpillRecord {
+    uint8 operation;
+    uint8 status;
+    uint8 pinned;
+    uint8 priority;
+    int32 retryCount;
+    int64 localModified;
+    int64 remoteModified;
+    int64 size;
+    int64 queuedTime;
+};
+
+// Hash blob encodings: [encoding][length][bytes]
+enum {
+    kHashText = 0,              // Stored as given (e.g. base64)
+    kHashLowerHex,              // Hex digits decoded to binary
+    kHashUpperHex
+};
+
+/**
+ * @brief Make room for more elements, growing by a quarter
+ *
+ * Doubling would leave up to half of a large pool unused.
+ */
+template<typename T>
+static void
+Grow(std::vector<T>& array, size_t more)
+{
+    if (array.size() + more > array.capacity()) {
+        array.reserve(array.size() + more + array.size() / 4 + 64);
+    }
+}
+
+/**
+ * @brief FNV-1a hash of a string
+ */
+static uint32
+HashString(const char* string)
+{
+    uint32 hash = 2166136261u;
+    for (; *string != '\0'; string++) {
+        hash = (hash ^ (uint8)*string) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Value of a hex digit in the given case, or -1
+ */
+static int
+HexValue(char digit, bool upper)
+{
+    if (digit >= '0' && digit <= '9') {
+        return digit - '0';
+    }
+    char first = upper ? 'A' : 'a';
+    if (digit >= first && digit <= first + 5) {
+        return digit - first + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Write a whole buffer to a file descriptor
+ */
+static status_t
+WriteFully(int fd, const void* data, size_t length)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Append a length-prefixed string
+ */
+static void
+AppendString(std::vector<char>& buffer, const BString& string)
+{
+    uint32 length = string.Length();
+    const char* bytes = reinterpret_cast<const char*>(&length);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(length));
+    buffer.insert(buffer.end(), string.String(), string.String() + length);
+}
+
+/**
+ * @brief Read a length-prefixed string
+ */
+static bool
+ReadString(const char*& data, const char* end, BString& string)
+{
+    uint32 length;
+    if ((size_t)(end - data) < sizeof(length)) {
+        return false;
+    }
+    memcpy(&length, data, sizeof(length));
+    data += sizeof(length);
+    if ((size_t)(end - data) < length) {
+        return false;
+    }
+    string.SetTo(data, length);
+    data += length;
+    return true;
+}
+
+/**
+ * @brief Append an item as a length-prefixed record
+ */
+static void
+SerializeItem(const SyncItem& item, std::vector<char>& buffer)
+{
+    size_t start = buffer.size();
+    buffer.resize(start + sizeof(uint32));
+
+    SpillRecord record;
+    record.operation = item.operation;
+    record.status = item.status;
+    record.pinned = item.isPinned;
+    record.priority = item.priority;
+    record.retryCount = item.retryCount;
+    record.localModified = item.localModified;
+    record.remoteModified = item.remoteModified;
+    record.size = item.size;
+    record.queuedTime = item.queuedTime;
+    const char* bytes = reinterpret_cast<const char*>(&record);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(record));
+
+    AppendString(buffer, item.localPath);
+    AppendString(buffer, item.remotePath);
+    AppendString(buffer, item.previousPath);
+    AppendString(buffer, item.fileId);
+    AppendString(buffer, item.parentId);
+    AppendString(buffer, item.eTag);
+    AppendString(buffer, item.localHash);
+    AppendString(buffer, item.remoteHash);
+    AppendString(buffer, item.errorMessage);
+
+    uint32 length = buffer.size() - start - sizeof(uint32);
+    memcpy(&buffer[start], &length, sizeof(length));
+}
+
+/**
+ * @brief Read an item from a record body
+ */
+static bool
+DeserializeItem(const char* data, size_t length, SyncItem& item)
+{
+    const char* end = data + length;
+    SpillRecord record;
+    if (length < sizeof(record)) {
+        return false;
+    }
+    memcpy(&record, data, sizeof(record));
+    data += sizeof(record);
+
+    item.operation = (SyncOperation)record.operation;
+    item.status = (SyncItemStatus)record.status;
+    item.isPinned = record.pinned != 0;
+    item.priority = (SyncPriority)record.priority;
+    item.retryCount = record.retryCount;
+    item.localModified = record.localModified;
+    item.remoteModified = record.remoteModified;
+    item.size = record.size;
+    item.queuedTime = record.queuedTime;
+
+    return ReadString(data, end, item.localPath)
+        && ReadString(data, end, item.remotePath)
+        && ReadString(data, end, item.previousPath)
+        && ReadString(data, end, item.fileId)
+        && ReadString(data, end, item.parentId)
+        && ReadString(data, end, item.eTag)
+        && ReadString(data, end, item.localHash)
+        && ReadString(data, end, item.remoteHash)
+        && ReadString(data, end, item.errorMessage);
+}
+
+/**
+ * @brief Constructor
+ */
+SyncQueue::SyncQueue(int32 memoryLimit)
+    : fMemoryLimit(memoryLimit > 0 ? memoryLimit : kDefaultMemoryLimit),
+      fSpilledCount(0),
+      fKeptSegment(0),
+      fReadSegment(0),
+      fReadOffset(sizeof(SegmentHeader)),
+      fReadFd(-1),
+      fWriteSegment(0),
+      fWriteOffset(0),
+      fWriteFd(-1)
+{
+    _Reset();
+}
+
+/**
+ * @brief Destructor
+ */
+SyncQueue::~SyncQueue()
+{
+    _FlushSpill();
+    if (fReadFd >= 0) {
+        close(fReadFd);
+    }
+    if (fWriteFd >= 0) {
+        close(fWriteFd);
+    }
+}
+
+/**
+ * @brief Spill to a directory and load the operations saved there
+ */
+status_t
+SyncQueue::Open(const char* directory)
+{
+    if (!fDirectory.IsEmpty()) {
+        return B_NOT_ALLOWED;
+    }
+    if (mkdir(directory, 0700) != 0 && errno != EEXIST) {
+        return errno;
+    }
+
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        return errno;
+    }
+    fDirectory = directory;
+
+    bool found = false;
+    uint32 first = 0;
+    uint32 last = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        unsigned int number;
+        char extra;
+        if (sscanf(entry->d_name, "segment.%u%c", &number, &extra) != 1) {
+            continue;
+        }
+        if (!found || number < first) {
+            first = number;
+        }
+        if (!found || number > last) {
+            last = number;
+        }
+        found = true;
+    }
+    closedir(dir);
+
+    // The saved window comes first, then the segments from its position
+    uint32 readSegment = first;
+    off_t readOffset = sizeof(SegmentHeader);
+    status_t status = B_OK;
+
+    BString savePath(fDirectory);
+    savePath << "/" << kSaveName;
+    int fd = open(savePath.String(), O_RDONLY);
+    if (fd >= 0) {
+        SaveHeader header;
+        off_t offset = sizeof(header);
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+            || header.magic != kSaveMagic
+            || header.version != kQueueFormatVersion) {
+            status = B_BAD_DATA;
+        } else {
+            readSegment = header.readSegment;
+            readOffset = header.readOffset;
+            if (_ReadRecords(fd, offset, header.count, true) != header.count) {
+                status = B_BAD_DATA;
+            }
+        }
+        close(fd);
+    }
+
+    fKeptSegment = fReadSegment = fWriteSegment = readSegment;
+    fReadOffset = readOffset;
+    if (!found) {
+        return status;
+    }
+
+    // Segments before the read position were consumed before the save
+    for (uint32 segment = first; segment <= last && segment < readSegment;
+            segment++) {
+        unlink(_SegmentPath(segment).String());
+    }
+    if (readSegment > last) {
+        return status;
+    }
+    if (readSegment < first) {
+        fKeptSegment = fReadSegment = first;
+        fReadOffset = sizeof(SegmentHeader);
+    }
+
+    // Count what is left; appends go after the last whole record
+    bool lastValid = false;
+    for (uint32 segment = fReadSegment; segment <= last; segment++) {
+        int segmentFd = _OpenSegment(segment);
+        if (segmentFd < 0) {
+            continue;
+        }
+        off_t offset = segment == fReadSegment
+            ? fReadOffset : (off_t)sizeof(SegmentHeader);
+        fSpilledCount += _ReadRecords(segmentFd, offset, INT32_MAX, false);
+        close(segmentFd);
+        if (segment == last) {
+            lastValid = truncate(_SegmentPath(segment).String(), offset) == 0;
+            fWriteOffset = offset;
+        }
+    }
+
+    fWriteSegment = last;
+    if (lastValid) {
+        fWriteFd = open(_SegmentPath(last).String(), O_WRONLY | O_APPEND);
+    }
+    if (fWriteFd < 0) {
+        unlink(_SegmentPath(last).String());
+        fWriteSegment = last + 1;
+    }
+    if (fSpilledCount == 0) {
+        // Nothing past the saved position: the segments are not needed
+        _DropSegments();
+        _ReleaseSegments(fReadSegment);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Make the whole queue durable
+ */
+status_t
+SyncQueue::Save()
+{
+    if (fDirectory.IsEmpty()) {
+        return B_NO_INIT;
+    }
+
+    status_t status = _FlushSpill();
+    if (status == B_OK && fWriteFd >= 0 && fsync(fWriteFd) != 0) {
+        status = errno;
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    SaveHeader header;
+    header.magic = kSaveMagic;
+    header.version = kQueueFormatVersion;
+    header.readSegment = fReadSegment;
+    header.count = fItems.size();
+    header.readOffset = fReadOffset;
+
+    std::vector<char> data((const char*)&header,
+        (const char*)&header + sizeof(header));
+    SyncItem item;
+    for (size_t i = 0; i < fItems.size(); i++) {
+        _Decode(fItems[i], item);
+        SerializeItem(item, data);
+    }
+
+    BString path(fDirectory);
+    path << "/" << kSaveName;
+    BString tempPath(path);
+    tempPath << ".tmp";
+    int fd = open(tempPath.String(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return errno;
+    }
+
+    status = WriteFully(fd, &data[0], data.size());
+    if (status == B_OK && fsync(fd) != 0) {
+        status = errno;
+    }
+    close(fd);
+
+    if (status == B_OK && rename(tempPath.String(), path.String()) != 0) {
+        status = errno;
+    }
+    if (status != B_OK) {
+        unlink(tempPath.String());
+        return status;
+    }
+
+    // The saved window no longer reads from the segments before it
+    _ReleaseSegments(header.readSegment);
+    return B_OK;
+}
+
+/**
+ * @brief Append an operation
+ */
+void
+SyncQueue::Push(SyncItem&& item)
+{
+    // Once anything is on disk, later items follow it there to keep order
+    if (!fDirectory.IsEmpty()
+        && (fSpilledCount > 0 || (int32)fItems.size() >= fMemoryLimit)
+        && _Spill(item) == B_OK) {
+        return;
+    }
+
+    // No directory, or the disk failed: memory beats losing the item
+    _Store(item);
+}
+
+/**
+ * @brief Take the oldest operation
+ */
+bool
+SyncQueue::Pop(SyncItem& item)
+{
+    if (fItems.empty() && fSpilledCount > 0) {
+        _Refill();
+    }
+    if (fItems.empty()) {
+        return false;
+    }
+
+    _Decode(fItems.front(), item);
+    fItems.pop_front();
+    fPoppedSinceCompact++;
+
+    if (fItems.empty()) {
+        _Reset();
+    } else if (fPool.size() > kMinCompactBytes
+        && fPoppedSinceCompact > (int32)fItems.size()) {
+        _Compact();
+    }
+    return true;
+}
+
+/**
+ * @brief Get the queue time of the oldest operation
+ */
+bigtime_t
+SyncQueue::OldestQueuedTime()
+{
+    if (fItems.empty() && fSpilledCount > 0) {
+        _Refill();
+    }
+    return fItems.empty() ? 0 : fItems.front().queuedTime;
+}
+
+/**
+ * @brief Take the operations held in memory, oldest first
+ */
+void
+SyncQueue::TakeWindow(std::vector<SyncItem>& items)
+{
+    _TakeMemory(items);
+}
+
+/**
+ * @brief Put operations back at the head of the queue
+ */
+void
+SyncQueue::RestoreWindow(std::vector<SyncItem>& items)
+{
+    std::vector<SyncItem> rest;
+    _TakeMemory(rest);
+
+    for (size_t i = 0; i < items.size(); i++) {
+        _Store(items[i]);
+    }
+    for (size_t i = 0; i < rest.size(); i++) {
+        _Store(rest[i]);
+    }
+    items.clear();
+}
+
+/**
+ * @brief Get the bytes held in memory by the queue
+ */
+size_t
+SyncQueue::MemoryUsage() const
+{
+    return fItems.size() * sizeof(CompactSyncItem)
+        + fPool.capacity()
+        + fPaths.capacity() * sizeof(PathEntry)
+        + (fStringTable.capacity() + fPathTable.capacity()) * sizeof(uint32)
+        + fWriteBuffer.capacity();
+}
+
+/**
+ * @brief Drop every operation, including spilled ones
+ */
+void
+SyncQueue::MakeEmpty()
+{
+    std::deque<CompactSyncItem>().swap(fItems);
+    _Reset();
+    if (!fDirectory.IsEmpty()) {
+        _DropSegments();
+    }
+}
+
+/**
+ * @brief Turn an item into a record
+ */
+void
+SyncQueue::_Encode(const SyncItem& item, CompactSyncItem& compact)
+{
+    compact.localPath = _InternPath(item.localPath);
+    compact.remotePath = _InternPath(item.remotePath);
+    compact.previousPath = _InternPath(item.previousPath);
+    compact.fileId = _InternString(item.fileId.String());
+    compact.parentId = _InternString(item.parentId.String());
+    compact.eTag = _InternString(item.eTag.String());
+    compact.localHash = _AddHash(item.localHash);
+    compact.remoteHash = _AddHash(item.remoteHash);
+    compact.errorMessage = _InternString(item.errorMessage.String());
+    compact.retryCount = item.retryCount;
+    compact.operation = item.operation;
+    compact.status = item.status;
+    compact.flags = item.isPinned ? kPinnedFlag : 0;
+    compact.priority = item.priority;
+    compact.localModified = item.localModified;
+    compact.remoteModified = item.remoteModified;
+    compact.size = item.size;
+    compact.queuedTime = item.queuedTime;
+}
+
+/**
+ * @brief Turn a record back into an item
+ */
+void
+SyncQueue::_Decode(const CompactSyncItem& compact, SyncItem& item) const
+{
+    _BuildPath(compact.localPath, item.localPath);
+    _BuildPath(compact.remotePath, item.remotePath);
+    _BuildPath(compact.previousPath, item.previousPath);
+    item.fileId = _String(compact.fileId);
+    item.parentId = _String(compact.parentId);
+    item.eTag = _String(compact.eTag);
+    _GetHash(compact.localHash, item.localHash);
+    _GetHash(compact.remoteHash, item.remoteHash);
+    item.errorMessage = _String(compact.errorMessage);
+    item.retryCount = compact.retryCount;
+    item.operation = (SyncOperation)compact.operation;
+    item.status = (SyncItemStatus)compact.status;
+    item.isPinned = (compact.flags & kPinnedFlag) != 0;
+    item.priority = (SyncPriority)compact.priority;
+    item.localModified = compact.localModified;
+    item.remoteModified = compact.remoteModified;
+    item.size = compact.size;
+    item.queuedTime = compact.queuedTime;
+}
+
+/**
+ * @brief Add an operation to the in-memory window
+ */
+void
+SyncQueue::_Store(const SyncItem& item)
+{
+    CompactSyncItem compact;
+    _Encode(item, compact);
+    fItems.push_back(compact);
+}
+
+/**
+ * @brief Take the window, oldest first
+ */
+void
+SyncQueue::_TakeMemory(std::vector<SyncItem>& items)
+{
+    items.reserve(items.size() + fItems.size());
+    for (size_t i = 0; i < fItems.size(); i++) {
+        items.push_back(SyncItem());
+        _Decode(fItems[i], items.back());
+    }
+    std::deque<CompactSyncItem>().swap(fItems);
+    _Reset();
+}
+
+/**
+ * @brief Get the pool offset of a string, adding it once
+ */
+uint32
+SyncQueue::_InternString(const char* string)
+{
+    if (string[0] == '\0') {
+        return 0;
+    }
+
+    if (!fStringTable.empty()) {
+        uint32 mask = fStringTable.size() - 1;
+        for (uint32 slot = HashString(string) & mask;
+                fStringTable[slot] != kEmptySlot; slot = (slot + 1) & mask) {
+            if (strcmp(_String(fStringTable[slot]), string) == 0) {
+                return fStringTable[slot];
+            }
+        }
+    }
+
+    size_t length = strlen(string) + 1;
+    Grow(fPool, length);
+    uint32 offset = fPool.size();
+    fPool.insert(fPool.end(), string, string + length);
+    _InsertSlot(fStringTable, fStringCount, offset, false);
+    return offset;
+}
+
+/**
+ * @brief Get the ID of a path, adding its missing components
+ */
+uint32
+SyncQueue::_InternPath(const BString& path)
+{
+    if (path.IsEmpty()) {
+        return kNoPath;
+    }
+
+    uint32 parent = 0;
+    int32 start = 0;
+    BString component;
+
+    while (start < path.Length()) {
+        int32 end = path.FindFirst('/', start);
+        if (end < 0) {
+            end = path.Length();
+        }
+        if (end == start) {
+            start++;
+            continue;
+        }
+
+        path.CopyInto(component, start, end - start);
+        uint32 name = _InternString(component.String());
+
+        uint32 found = kEmptySlot;
+        uint32 mask = fPathTable.size() - 1;
+        for (uint32 slot = _PathHash(parent, name) & mask;
+                fPathTable[slot] != kEmptySlot; slot = (slot + 1) & mask) {
+            const PathEntry& entry = fPaths[fPathTable[slot]];
+            if (entry.parent == parent && entry.name == name) {
+                found = fPathTable[slot];
+                break;
+            }
+        }
+        if (found == kEmptySlot) {
+            found = fPaths.size();
+            PathEntry entry = { parent, name };
+            Grow(fPaths, 1);
+            fPaths.push_back(entry);
+            _InsertSlot(fPathTable, fPathCount, found, true);
+        }
+
+        parent = found;
+        start = end + 1;
+    }
+    return parent;
+}
+
+/**
+ * @brief Rebuild a path from its ID
+ */
+void
+SyncQueue::_BuildPath(uint32 path, BString& string) const
+{
+    if (path == kNoPath) {
+        string.SetTo("");
+        return;
+    }
+    if (path == 0) {
+        string = "/";
+        return;
+    }
+
+    int32 length = 0;
+    for (uint32 node = path; node != 0; node = fPaths[node].parent) {
+        length += strlen(_String(fPaths[node].name)) + 1;
+    }
+
+    // Fill from the end, walking up from the leaf
+    string.SetTo("");
+    char* buffer = string.LockBuffer(length + 1);
+    char* end = buffer + length;
+    *end = '\0';
+    for (uint32 node = path; node != 0; node = fPaths[node].parent) {
+        const char* name = _String(fPaths[node].name);
+        size_t nameLength = strlen(name);
+        end -= nameLength;
+        memcpy(end, name, nameLength);
+        *--end = '/';
+    }
+    string.UnlockBuffer(length);
+}
+
+/**
+ * @brief Store a hash, as a binary digest when it is hex
+ */
+uint32
+SyncQueue::_AddHash(const BString& hash)
+{
+    int32 length = hash.Length();
+    if (length == 0) {
+        return 0;
+    }
+
+    uint8 encoding = kHashText;
+    if (length % 2 == 0 && length <= 2 * 255) {
+        for (int upper = 0; upper < 2 && encoding == kHashText; upper++) {
+            bool hex = true;
+            for (int32 i = 0; hex && i < length; i++) {
+                hex = HexValue(hash[i], upper) >= 0;
+            }
+            if (hex) {
+                encoding = upper ? kHashUpperHex : kHashLowerHex;
+            }
+        }
+    }
+
+    Grow(fPool, 2 + length);
+    uint32 offset = fPool.size();
+    if (encoding == kHashText) {
+        if (length > 255) {
+            length = 255;
+        }
+        fPool.push_back(kHashText);
+        fPool.push_back((uint8)length);
+        fPool.insert(fPool.end(), hash.String(), hash.String() + length);
+        return offset;
+    }
+
+    // Digits in a verified case: "00".."ff" decode to single bytes
+    bool upper = encoding == kHashUpperHex;
+    fPool.push_back(encoding);
+    fPool.push_back((uint8)(length / 2));
+    for (int32 i = 0; i < length; i += 2) {
+        fPool.push_back((char)(HexValue(hash[i], upper) << 4
+            | HexValue(hash[i + 1], upper)));
+    }
+    return offset;
+}
+
+/**
+ * @brief Get a hash back in its original form
+ */
+void
+SyncQueue::_GetHash(uint32 offset, BString& hash) const
+{
+    hash.SetTo("");
+    if (offset == 0) {
+        return;
+    }
+
+    uint8 encoding = fPool[offset];
+    uint8 length = fPool[offset + 1];
+    const uint8* bytes = (const uint8*)&fPool[offset + 2];
+    if (encoding == kHashText) {
+        hash.SetTo((const char*)bytes, length);
+        return;
+    }
+
+    const char* digits = encoding == kHashUpperHex
+        ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* buffer = hash.LockBuffer(length * 2 + 1);
+    for (int32 i = 0; i < length; i++) {
+        buffer[2 * i] = digits[bytes[i] >> 4];
+        buffer[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+    buffer[length * 2] = '\0';
+    hash.UnlockBuffer(length * 2);
+}
+
+/**
+ * @brief Insert into an open-addressing table, growing it under 3/4 load
+ */
+void
+SyncQueue::_InsertSlot(std::vector<uint32>& table, int32& count, uint32 value,
+    bool paths)
+{
+    if ((count + 1) * 4 > (int32)table.size() * 3) {
+        std::vector<uint32> old;
+        old.swap(table);
+        table.assign(old.empty() ? 64 : old.size() * 2, kEmptySlot);
+        count = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i] != kEmptySlot) {
+                _InsertSlot(table, count, old[i], paths);
+            }
+        }
+    }
+
+    uint32 hash = paths
+        ? _PathHash(fPaths[value].parent, fPaths[value].name)
+        : HashString(_String(value));
+    uint32 mask = table.size() - 1;
+    uint32 slot = hash & mask;
+    while (table[slot] != kEmptySlot) {
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = value;
+    count++;
+}
+
+/**
+ * @brief Hash a parent path and an interned name
+ */
+uint32
+SyncQueue::_PathHash(uint32 parent, uint32 name) const
+{
+    return (parent * 2654435761u) ^ (name * 40503u + 0x9e3779b9u);
+}
+
+/**
+ * @brief Re-encode the remaining items into a fresh pool
+ */
+void
+SyncQueue::_Compact()
+{
+    std::vector<SyncItem> items;
+    _TakeMemory(items);
+    for (size_t i = 0; i < items.size(); i++) {
+        _Store(items[i]);
+    }
+}
+
+/**
+ * @brief Drop pool and tables
+ */
+void
+SyncQueue::_Reset()
+{
+    // Offset 0 is the empty string, path 0 is "/"
+    std::vector<char>(1, '\0').swap(fPool);
+    std::vector<PathEntry>(1).swap(fPaths);
+    std::vector<uint32>().swap(fStringTable);
+    std::vector<uint32>(64, kEmptySlot).swap(fPathTable);
+    fStringCount = 0;
+    fPathCount = 0;
+    fPoppedSinceCompact = 0;
+}
+
+/**
+ * @brief Append an operation to the write segment
+ */
+status_t
+SyncQueue::_Spill(const SyncItem& item)
+{
+    if (fWriteFd >= 0 && fWriteOffset >= kSegmentBytes) {
+        status_t status = _FlushSpill();
+        if (status != B_OK) {
+            return status;
+        }
+        close(fWriteFd);
+        fWriteFd = -1;
+        fWriteSegment++;
+    }
+    if (fWriteFd < 0) {
+        status_t status = _CreateSegment(fWriteSegment);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    size_t length = fWriteBuffer.size();
+    SerializeItem(item, fWriteBuffer);
+    fWriteOffset += fWriteBuffer.size() - length;
+    fSpilledCount++;
+
+    // A failed write stays buffered and is retried; Save() reports it
+    if (fWriteBuffer.size() >= kIOChunkBytes) {
+        _FlushSpill();
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Write buffered spill records to the segment file
+ */
+status_t
+SyncQueue::_FlushSpill()
+{
+    if (fWriteBuffer.empty() || fWriteFd < 0) {
+        return B_OK;
+    }
+
+    status_t status = WriteFully(fWriteFd, &fWriteBuffer[0],
+        fWriteBuffer.size());
+    if (status == B_OK) {
+        fWriteBuffer.clear();
+    }
+    return status;
+}
+
+/**
+ * @brief Start a new write segment
+ */
+status_t
+SyncQueue::_CreateSegment(uint32 segment)
+{
+    int fd = open(_SegmentPath(segment).String(),
+        O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0) {
+        return errno;
+    }
+
+    SegmentHeader header;
+    header.magic = kSegmentMagic;
+    header.version = kQueueFormatVersion;
+    status_t status = WriteFully(fd, &header, sizeof(header));
+    if (status != B_OK) {
+        close(fd);
+        unlink(_SegmentPath(segment).String());
+        return status;
+    }
+
+    fWriteFd = fd;
+    fWriteSegment = segment;
+    fWriteOffset = sizeof(header);
+    return B_OK;
+}
+
+/**
+ * @brief Open a segment for reading, checking its header
+ */
+int
+SyncQueue::_OpenSegment(uint32 segment) const
+{
+    int fd = open(_SegmentPath(segment).String(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    SegmentHeader header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || header.magic != kSegmentMagic
+        || header.version != kQueueFormatVersion) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Read the window back from the oldest segments
+ */
+void
+SyncQueue::_Refill()
+{
+    // The read segment may still be the one being written
+    _FlushSpill();
+
+    while ((int32)fItems.size() < fMemoryLimit && fSpilledCount > 0) {
+        if (fReadFd < 0) {
+            fReadFd = _OpenSegment(fReadSegment);
+        }
+        if (fReadFd >= 0) {
+            fSpilledCount -= _ReadRecords(fReadFd, fReadOffset,
+                fMemoryLimit - fItems.size(), true);
+            if ((int32)fItems.size() >= fMemoryLimit) {
+                break;
+            }
+        }
+
+        // Segment used up; one that is still written to means we are done
+        if (fReadSegment >= fWriteSegment) {
+            fSpilledCount = 0;
+            break;
+        }
+        if (fReadFd >= 0) {
+            close(fReadFd);
+            fReadFd = -1;
+        }
+        fReadSegment++;
+        fReadOffset = sizeof(SegmentHeader);
+    }
+
+    if (fSpilledCount <= 0) {
+        _DropSegments();
+    }
+}
+
+/**
+ * @brief Read whole records, stopping at the end or a torn record
+ */
+int32
+SyncQueue::_ReadRecords(int fd, off_t& offset, int32 limit, bool decode)
+{
+    std::vector<char> buffer;
+    size_t wanted = kIOChunkBytes;
+    int32 count = 0;
+
+    while (count < limit) {
+        buffer.resize(wanted);
+        ssize_t bytes = pread(fd, &buffer[0], wanted, offset);
+        if (bytes <= 0) {
+            break;
+        }
+
+        size_t position = 0;
+        uint32 length = 0;
+        while (count < limit && bytes - position >= sizeof(length)) {
+            memcpy(&length, &buffer[position], sizeof(length));
+            if (length > kMaxRecordBytes
+                || bytes - position - sizeof(length) < length) {
+                break;
+            }
+            if (decode) {
+                SyncItem item;
+                if (DeserializeItem(&buffer[position + sizeof(length)], length,
+                        item)) {
+                    _Store(item);
+                }
+            }
+            position += sizeof(length) + length;
+            count++;
+        }
+        offset += position;
+
+        if (position == 0) {
+            // A record longer than the buffer, or the end of the data
+            if ((size_t)bytes < wanted || length > kMaxRecordBytes
+                || bytes < (ssize_t)sizeof(length)) {
+                break;
+            }
+            wanted = sizeof(length) + length;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Close every segment and start over after them
+ */
+void
+SyncQueue::_DropSegments()
+{
+    if (fReadFd >= 0) {
+        close(fReadFd);
+        fReadFd = -1;
+    }
+    if (fWriteFd >= 0) {
+        close(fWriteFd);
+        fWriteFd = -1;
+    }
+
+    std::vector<char>().swap(fWriteBuffer);
+    fSpilledCount = 0;
+    fWriteSegment++;
+    fReadSegment = fWriteSegment;
+    fReadOffset = sizeof(SegmentHeader);
+    fWriteOffset = 0;
+}
+
+/**
+ * @brief Delete the kept segments before one
+ */
+void
+SyncQueue::_ReleaseSegments(uint32 end)
+{
+    for (; fKeptSegment < end; fKeptSegment++) {
+        unlink(_SegmentPath(fKeptSegment).String());
+    }
+}
+
+/**
+ * @brief Get the path of a segment file
+ */
+BString
+SyncQueue::_SegmentPath(uint32 segment) const
+{
+    BString path(fDirectory);
+    path << "/segment.";
+    path << segment;
+    return path;
+}
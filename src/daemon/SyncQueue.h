@@ -0,0 +1,347 @@
+/**
+ * @file SyncQueue.h
+ * @brief Compact FIFO of pending sync operations
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * An initial sync can queue hundreds of thousands of operations. Held as
+ * SyncItem objects, each one carries its own heap copy of every path, ID
+ * and hash. The SyncQueue stores fixed-size records instead and keeps the
+ * strings once, in a shared pool. Beyond a bounded window, operations go
+ * to segment files on disk, so memory use does not grow with the backlog.
+ */
+
+#ifndef SYNC_QUEUE_H
+#define SYNC_QUEUE_H
+
+#include "SyncEngine.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <deque>
+#include <vector>
+
+namespace OneDrive {
+
+/**
+ * @brief Queued operation with its strings replaced by pool references
+ */
+struct CompactSyncItem {
+    uint32 localPath;           ///< Path ID
+    uint32 remotePath;          ///< Path ID
+    uint32 previousPath;        ///< Path ID
+    uint32 fileId;              ///< Interned string, 0 if empty
+    uint32 parentId;            ///< Interned string, 0 if empty
+    uint32 eTag;                ///< Interned string, 0 if empty
+    uint32 localHash;           ///< Hash blob, 0 if none
+    uint32 remoteHash;          ///< Hash blob, 0 if none
+    uint32 errorMessage;        ///< Interned string, only after a failure
+    int32 retryCount;           ///< Number of retry attempts
+    uint8 operation;            ///< SyncOperation
+    uint8 status;               ///< SyncItemStatus
+    uint8 flags;                ///< Pinned state
+    uint8 priority;             ///< SyncPriority
+    int64 localModified;        ///< Local modification time
+    int64 remoteModified;       ///< Remote modification time
+    int64 size;                 ///< File size
+    int64 queuedTime;           ///< When it was queued
+};
+
+/**
+ * @brief FIFO of sync operations in compact form
+ *
+ * Paths are interned as (parent, name) pairs, so a deep tree stores every
+ * folder name once and each queued path costs one small entry. IDs, ETags
+ * and names share one string pool; hex hashes are kept as fixed binary
+ * digests. Items are handed over by move: Push() takes an rvalue, Pop()
+ * fills the caller's item. Paths come back in canonical form: repeated and
+ * trailing slashes are dropped.
+ *
+ * The pool is append-only. It is dropped when the window empties, and
+ * rebuilt from the remaining items once most of it belongs to items that
+ * already left.
+ *
+ * Once Open() gave it a directory, the queue keeps at most a window of
+ * operations in memory. When the window is full, later operations are
+ * appended to segment files and read back in order as the window drains.
+ * Save() records the window and the read position, so everything queued
+ * survives a restart; fully read segments are deleted only once a Save()
+ * has moved past them. After a crash, operations taken since the last
+ * Save() are handed out again.
+ *
+ * Not thread-safe; the sync engine guards it with its own lock.
+ *
+ * @see SyncItem
+ * @since 1.0.0
+ */
+class SyncQueue {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param memoryLimit Operations kept in memory once spilling is enabled
+     */
+    SyncQueue(int32 memoryLimit = kDefaultMemoryLimit);
+
+    /**
+     * @brief Destructor
+     */
+    ~SyncQueue();
+
+    /**
+     * @brief Spill to a directory and load the operations saved there
+     *
+     * @param directory Folder for segment files, created if missing
+     * @return B_OK, or an error code; the queue then stays in memory
+     */
+    status_t Open(const char* directory);
+
+    /**
+     * @brief Make the whole queue durable
+     *
+     * Writes the in-memory window and the read position next to the
+     * segments, and flushes pending spill writes.
+     *
+     * @return B_OK, B_NO_INIT without a directory, or an error code
+     */
+    status_t Save();
+
+    /**
+     * @brief Append an operation
+     *
+     * @param item Operation, left in a valid but unspecified state
+     */
+    void Push(SyncItem&& item);
+
+    /**
+     * @brief Take the oldest operation
+     *
+     * @param item Receives the operation
+     * @return false if the queue is empty
+     */
+    bool Pop(SyncItem& item);
+
+    /**
+     * @brief Take the operations held in memory, oldest first
+     *
+     * Spilled operations stay queued behind them; hand the window back
+     * with RestoreWindow().
+     *
+     * @param items Receives the operations
+     */
+    void TakeWindow(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Put operations back at the head of the queue
+     *
+     * @param items Operations, moved from
+     */
+    void RestoreWindow(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Get the number of queued operations
+     *
+     * @return Operation count, in memory and on disk
+     */
+    int32 Count() const { return fItems.size() + fSpilledCount; }
+
+    /**
+     * @brief Get the number of operations on disk
+     *
+     * @return Spilled operation count
+     */
+    int32 CountSpilled() const { return fSpilledCount; }
+
+    /**
+     * @brief Check for queued operations
+     *
+     * @return true if the queue is empty
+     */
+    bool IsEmpty() const { return fItems.empty() && fSpilledCount == 0; }
+
+    /**
+     * @brief Get the queue time of the oldest operation
+     *
+     * Reads the window back from disk if only spilled operations remain.
+     *
+     * @return Its queuedTime, or 0 if the queue is empty
+     */
+    bigtime_t OldestQueuedTime();
+
+    /**
+     * @brief Get the bytes held in memory by the queue
+     *
+     * @return Records, pool, tables and write buffer
+     */
+    size_t MemoryUsage() const;
+
+    /**
+     * @brief Drop every operation, including spilled ones
+     */
+    void MakeEmpty();
+
+    static const int32 kDefaultMemoryLimit; ///< Default window size
+
+private:
+    /**
+     * @brief Interned path: a name below a parent path
+     */
+    struct PathEntry {
+        uint32 parent;          ///< Parent path ID, 0 is "/"
+        uint32 name;            ///< Interned name
+    };
+
+    SyncQueue(const SyncQueue&);
+    SyncQueue& operator=(const SyncQueue&);
+
+    /**
+     * @brief Turn an item into a record
+     */
+    void _Encode(const SyncItem& item, CompactSyncItem& compact);
+
+    /**
+     * @brief Turn a record back into an item
+     */
+    void _Decode(const CompactSyncItem& compact, SyncItem& item) const;
+
+    /**
+     * @brief Add an operation to the in-memory window
+     */
+    void _Store(const SyncItem& item);
+
+    /**
+     * @brief Take the window, oldest first
+     */
+    void _TakeMemory(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Append an operation to the write segment
+     */
+    status_t _Spill(const SyncItem& item);
+
+    /**
+     * @brief Write buffered spill records to the segment file
+     */
+    status_t _FlushSpill();
+
+    /**
+     * @brief Start a new write segment
+     */
+    status_t _CreateSegment(uint32 segment);
+
+    /**
+     * @brief Open a segment for reading, checking its header
+     */
+    int _OpenSegment(uint32 segment) const;
+
+    /**
+     * @brief Read the window back from the oldest segments
+     */
+    void _Refill();
+
+    /**
+     * @brief Read whole records, stopping at the end or a torn record
+     *
+     * @return Number of records read; with decode, they join the window
+     */
+    int32 _ReadRecords(int fd, off_t& offset, int32 limit, bool decode);
+
+    /**
+     * @brief Close every segment and start over after them
+     *
+     * The files stay until a Save() no longer reads from them.
+     */
+    void _DropSegments();
+
+    /**
+     * @brief Delete the kept segments before one
+     */
+    void _ReleaseSegments(uint32 end);
+
+    /**
+     * @brief Get the path of a segment file
+     */
+    BString _SegmentPath(uint32 segment) const;
+
+    /**
+     * @brief Get the pool offset of a string, adding it once
+     */
+    uint32 _InternString(const char* string);
+
+    /**
+     * @brief Get the ID of a path, adding its missing components
+     */
+    uint32 _InternPath(const BString& path);
+
+    /**
+     * @brief Rebuild a path from its ID
+     */
+    void _BuildPath(uint32 path, BString& string) const;
+
+    /**
+     * @brief Store a hash, as a binary digest when it is hex
+     */
+    uint32 _AddHash(const BString& hash);
+
+    /**
+     * @brief Get a hash back in its original form
+     */
+    void _GetHash(uint32 offset, BString& hash) const;
+
+    /**
+     * @brief Get a string from the pool
+     */
+    const char* _String(uint32 offset) const { return &fPool[offset]; }
+
+    /**
+     * @brief Insert into an open-addressing table, growing it under 3/4 load
+     */
+    void _InsertSlot(std::vector<uint32>& table, int32& count, uint32 value,
+        bool paths);
+
+    /**
+     * @brief Hash a parent path and an interned name
+     */
+    uint32 _PathHash(uint32 parent, uint32 name) const;
+
+    /**
+     * @brief Re-encode the remaining items into a fresh pool
+     */
+    void _Compact();
+
+    /**
+     * @brief Drop pool and tables
+     */
+    void _Reset();
+
+    struct SegmentHeader;
+    struct SaveHeader;
+
+private:
+    std::deque<CompactSyncItem> fItems;     ///< Queued records, oldest first
+    std::vector<char> fPool;                ///< Strings and hash blobs
+    std::vector<PathEntry> fPaths;          ///< Interned paths, 0 is "/"
+    std::vector<uint32> fStringTable;       ///< Pool offsets by string
+    std::vector<uint32> fPathTable;         ///< Path IDs by parent+name
+    int32 fStringCount;                     ///< Entries in fStringTable
+    int32 fPathCount;                       ///< Entries in fPathTable
+    int32 fPoppedSinceCompact;              ///< Items gone since last rebuild
+
+    int32 fMemoryLimit;                     ///< Window size when spilling
+    BString fDirectory;                     ///< Segment folder, empty if none
+    int32 fSpilledCount;                    ///< Operations on disk
+    uint32 fKeptSegment;                    ///< Oldest segment on disk
+    uint32 fReadSegment;                    ///< Segment read next
+    off_t fReadOffset;                      ///< Next record in fReadSegment
+    int fReadFd;                            ///< fReadSegment, or -1
+    uint32 fWriteSegment;                   ///< Segment being appended to
+    off_t fWriteOffset;                     ///< Its size, buffer included
+    int fWriteFd;                           ///< fWriteSegment, or -1
+    std::vector<char> fWriteBuffer;         ///< Records not yet written
+};
+
+} // namespace OneDrive
+
+#endif // SYNC_QUEUE_H
@@ -0,0 +1,445 @@
+/**
+ * @file SyncScheduler.cpp
+ * @brief Implementation of the multi-lane sync scheduler
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "SyncScheduler.h"
+#include "SyncQueue.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+using namespace OneDrive;
+
+const off_t SyncScheduler::kDefaultLargeFileThreshold = 8 * 1024 * 1024;
+const float SyncScheduler::kDefaultLargeShare = 0.2f;
+const bigtime_t SyncScheduler::kDefaultAgingInterval = 60000000LL;
+
+// Bytes over which the reserved share is measured; older bytes fade out
+static const off_t kShareWindowBytes = 256 * 1024 * 1024;
+
+static const float kLaneWeight[kSyncLaneCount] = { 2.0f, 1.0f, 0.0f };
+static const char* kLaneNames[kSyncLaneCount] = { "user", "small", "large" };
+
+/**
+ * @brief Check whether an operation moves file content
+ */
+static bool
+IsTransfer(const SyncItem& item)
+{
+    return item.operation == kSyncOpUpload
+        || item.operation == kSyncOpDownload
+        || item.operation == kSyncOpUpdate;
+}
+
+/**
+ * @brief Get the paths whose operations must stay in order
+ */
+static int32
+PinnedPaths(const SyncItem& item, BString paths[2])
+{
+    int32 count = 0;
+    const BString& path = item.remotePath.IsEmpty()
+        ? item.localPath : item.remotePath;
+    if (!path.IsEmpty()) {
+        paths[count++] = path;
+    }
+    if (item.operation == kSyncOpMove && !item.previousPath.IsEmpty()) {
+        paths[count++] = item.previousPath;
+    }
+    return count;
+}
+
+/**
+ * @brief Constructor
+ */
+SyncScheduler::SyncScheduler(int32 memoryLimit)
+    : fLargeFileThreshold(kDefaultLargeFileThreshold),
+      fLargeShare(kDefaultLargeShare),
+      fAgingInterval(kDefaultAgingInterval)
+{
+    int32 laneLimit = memoryLimit / kSyncLaneCount;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        fLanes[lane].reset(new SyncQueue(laneLimit));
+    }
+    memset(fCounters, 0, sizeof(fCounters));
+}
+
+/**
+ * @brief Destructor
+ */
+SyncScheduler::~SyncScheduler()
+{
+}
+
+/**
+ * @brief Spill lanes to folders below a directory and load them
+ */
+status_t
+SyncScheduler::Open(const char* directory)
+{
+    if (mkdir(directory, 0700) != 0 && errno != EEXIST) {
+        return errno;
+    }
+
+    status_t result = B_OK;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        BString path(directory);
+        path << "/" << kLaneNames[lane];
+        status_t status = fLanes[lane]->Open(path.String());
+        if (status != B_OK && result == B_OK) {
+            result = status;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Make every lane durable
+ */
+status_t
+SyncScheduler::Save()
+{
+    status_t result = B_OK;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        status_t status = fLanes[lane]->Save();
+        if (status != B_OK && result == B_OK) {
+            result = status;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Get the lane an operation belongs to
+ */
+SyncLane
+SyncScheduler::LaneFor(const SyncItem& item) const
+{
+    // Creations must not wait behind what will be uploaded into them
+    if (item.priority == kSyncPriorityUser
+        || item.operation == kSyncOpCreateFolder) {
+        return kSyncLaneUser;
+    }
+
+    if (IsTransfer(item) && item.size >= fLargeFileThreshold) {
+        return kSyncLaneLarge;
+    }
+    return kSyncLaneSmall;
+}
+
+/**
+ * @brief Queue an operation
+ */
+void
+SyncScheduler::Push(SyncItem&& item, bigtime_t now)
+{
+    item.queuedTime = now;
+    SyncLane lane = _Pin(item);
+    fLanes[lane]->Push(std::move(item));
+}
+
+/**
+ * @brief Take the operation that should run next
+ */
+bool
+SyncScheduler::Pop(bigtime_t now, SyncItem& item)
+{
+    int32 lane = _NextLane(now);
+    if (lane < 0 || !fLanes[lane]->Pop(item)) {
+        return false;
+    }
+    _Unpin(item);
+
+    _Dispatched((SyncLane)lane, item, now);
+    return true;
+}
+
+/**
+ * @brief Take the operations held in memory, for planning
+ */
+void
+SyncScheduler::TakeWindow(std::vector<SyncItem>& items)
+{
+    std::vector<SyncItem> lanes[kSyncLaneCount];
+    size_t next[kSyncLaneCount];
+    size_t total = 0;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        fLanes[lane]->TakeWindow(lanes[lane]);
+        next[lane] = 0;
+        total += lanes[lane].size();
+    }
+
+    // Merged by queue time, each lane keeping its own order
+    items.reserve(items.size() + total);
+    for (;;) {
+        int32 oldest = -1;
+        for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+            if (next[lane] < lanes[lane].size() && (oldest < 0
+                    || lanes[lane][next[lane]].queuedTime
+                        < lanes[oldest][next[oldest]].queuedTime)) {
+                oldest = lane;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        SyncItem& item = lanes[oldest][next[oldest]++];
+        _Unpin(item);
+        items.push_back(std::move(item));
+    }
+}
+
+/**
+ * @brief Put operations back at the head of their lanes
+ */
+void
+SyncScheduler::RestoreWindow(std::vector<SyncItem>& items)
+{
+    std::vector<SyncItem> lanes[kSyncLaneCount];
+    for (size_t i = 0; i < items.size(); i++) {
+        SyncLane lane = _Pin(items[i]);
+        lanes[lane].push_back(std::move(items[i]));
+    }
+    items.clear();
+
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        fLanes[lane]->RestoreWindow(lanes[lane]);
+    }
+}
+
+/**
+ * @brief Get the number of queued operations
+ */
+int32
+SyncScheduler::Count() const
+{
+    int32 count = 0;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        count += fLanes[lane]->Count();
+    }
+    return count;
+}
+
+/**
+ * @brief Get the number of operations on disk
+ */
+int32
+SyncScheduler::CountSpilled() const
+{
+    int32 count = 0;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        count += fLanes[lane]->CountSpilled();
+    }
+    return count;
+}
+
+/**
+ * @brief Check for queued operations
+ */
+bool
+SyncScheduler::IsEmpty() const
+{
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        if (!fLanes[lane]->IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Get the bytes held in memory
+ */
+size_t
+SyncScheduler::MemoryUsage() const
+{
+    size_t bytes = 0;
+    for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+        bytes += fLanes[lane]->MemoryUsage();
+    }
+    return bytes;
+}
+
+/**
+ * @brief Get statistics of a lane
+ */
+SyncLaneStats
+SyncScheduler::LaneStats(SyncLane lane) const
+{
+    const LaneCounters& counters = fCounters[lane];
+
+    SyncLaneStats stats;
+    stats.queued = fLanes[lane]->Count();
+    stats.dispatched = counters.dispatched;
+    stats.dispatchedBytes = counters.dispatchedBytes;
+    stats.averageWait = counters.dispatched > 0
+        ? counters.totalWait / counters.dispatched : 0;
+    stats.maxWait = counters.maxWait;
+    return stats;
+}
+
+/**
+ * @brief Get a printable name for a lane
+ */
+const char*
+SyncScheduler::LaneName(SyncLane lane)
+{
+    return lane >= 0 && lane < kSyncLaneCount ? kLaneNames[lane] : "unknown";
+}
+
+/**
+ * @brief Set the size from which a transfer is large
+ */
+void
+SyncScheduler::SetLargeFileThreshold(off_t threshold)
+{
+    // Queued items keep their lane; only new ones are sorted by this
+    fLargeFileThreshold = threshold > 0 ? threshold : kDefaultLargeFileThreshold;
+}
+
+/**
+ * @brief Set the share of bytes reserved for large transfers
+ */
+void
+SyncScheduler::SetLargeShare(float share)
+{
+    fLargeShare = share < 0.0f ? 0.0f : (share > 1.0f ? 1.0f : share);
+}
+
+/**
+ * @brief Set the wait that is worth one lane of priority
+ */
+void
+SyncScheduler::SetAgingInterval(bigtime_t interval)
+{
+    fAgingInterval = interval > 0 ? interval : kDefaultAgingInterval;
+}
+
+/**
+ * @brief Pick the lane to serve next, -1 if all are empty
+ */
+int32
+SyncScheduler::_NextLane(bigtime_t now)
+{
+    // Aging never passes the user lane: it holds the folder creations
+    // that operations in the other lanes may depend on
+    if (!fLanes[kSyncLaneUser]->IsEmpty()) {
+        return kSyncLaneUser;
+    }
+
+    // Reserved share next: large transfers keep moving under a steady
+    // stream of small ones
+    if (!fLanes[kSyncLaneLarge]->IsEmpty() && fLargeShare > 0.0f) {
+        off_t total = 0;
+        for (int32 lane = 0; lane < kSyncLaneCount; lane++) {
+            total += fCounters[lane].recentBytes;
+        }
+        if (fCounters[kSyncLaneLarge].recentBytes < fLargeShare * total) {
+            return kSyncLaneLarge;
+        }
+    }
+
+    int32 best = -1;
+    float bestScore = 0.0f;
+    for (int32 lane = kSyncLaneSmall; lane < kSyncLaneCount; lane++) {
+        if (fLanes[lane]->IsEmpty()) {
+            continue;
+        }
+
+        bigtime_t wait = now - fLanes[lane]->OldestQueuedTime();
+        float score = kLaneWeight[lane]
+            + (wait > 0 ? (float)wait / fAgingInterval : 0.0f);
+        if (best < 0 || score > bestScore) {
+            best = lane;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Account for a dispatched operation
+ */
+void
+SyncScheduler::_Dispatched(SyncLane lane, const SyncItem& item, bigtime_t now)
+{
+    LaneCounters& counters = fCounters[lane];
+    off_t bytes = IsTransfer(item) && item.size > 0 ? item.size : 0;
+    bigtime_t wait = now - item.queuedTime;
+    if (wait < 0) {
+        wait = 0;
+    }
+
+    counters.dispatched++;
+    counters.dispatchedBytes += bytes;
+    counters.totalWait += wait;
+    if (wait > counters.maxWait) {
+        counters.maxWait = wait;
+    }
+
+    // Metadata operations still count, so the share has a base to work on
+    counters.recentBytes += bytes > 0 ? bytes : 1;
+
+    off_t total = 0;
+    for (int32 i = 0; i < kSyncLaneCount; i++) {
+        total += fCounters[i].recentBytes;
+    }
+    while (total > kShareWindowBytes) {
+        total = 0;
+        for (int32 i = 0; i < kSyncLaneCount; i++) {
+            fCounters[i].recentBytes /= 2;
+            total += fCounters[i].recentBytes;
+        }
+    }
+}
+
+/**
+ * @brief Get the lane of an operation about to be queued, and hold its
+ *        paths there
+ */
+SyncLane
+SyncScheduler::_Pin(const SyncItem& item)
+{
+    BString paths[2];
+    int32 count = PinnedPaths(item, paths);
+
+    // Behind what is already pending on the same path
+    SyncLane lane = LaneFor(item);
+    for (int32 i = 0; i < count; i++) {
+        std::map<BString, PathPin>::const_iterator found = fPins.find(paths[i]);
+        if (found != fPins.end()) {
+            lane = (SyncLane)found->second.lane;
+            break;
+        }
+    }
+
+    for (int32 i = 0; i < count; i++) {
+        PathPin& pin = fPins[paths[i]];
+        if (pin.count == 0) {
+            pin.lane = lane;
+        }
+        pin.count++;
+    }
+    return lane;
+}
+
+/**
+ * @brief Release the paths of an operation leaving the lanes
+ */
+void
+SyncScheduler::_Unpin(const SyncItem& item)
+{
+    BString paths[2];
+    int32 count = PinnedPaths(item, paths);
+    for (int32 i = 0; i < count; i++) {
+        std::map<BString, PathPin>::iterator found = fPins.find(paths[i]);
+        if (found != fPins.end() && --found->second.count <= 0) {
+            fPins.erase(found);
+        }
+    }
+}
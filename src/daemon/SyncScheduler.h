@@ -0,0 +1,274 @@
+/**
+ * @file SyncScheduler.h
+ * @brief Priority and size aware ordering of pending sync operations
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * A single FIFO makes a user wait for "Sync now" behind the whole backlog,
+ * and makes thousands of small documents wait behind one large image. The
+ * SyncScheduler keeps pending operations in lanes and decides which lane
+ * goes next.
+ */
+
+#ifndef SYNC_SCHEDULER_H
+#define SYNC_SCHEDULER_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "SyncEngine.h"
+
+namespace OneDrive {
+
+class SyncQueue;
+
+/**
+ * @brief Scheduling class of a sync operation
+ */
+enum SyncLane {
+    kSyncLaneUser = 0,          ///< Requested by the user, folder creations
+    kSyncLaneSmall,             ///< Metadata and small transfers
+    kSyncLaneLarge,             ///< Transfers of large files
+    kSyncLaneCount
+};
+
+/**
+ * @brief Statistics of one lane
+ */
+struct SyncLaneStats {
+    int32 queued;               ///< Operations waiting
+    int32 dispatched;           ///< Operations handed out
+    off_t dispatchedBytes;      ///< Bytes of the operations handed out
+    bigtime_t averageWait;      ///< Mean time from queueing to dispatch
+    bigtime_t maxWait;          ///< Longest time from queueing to dispatch
+};
+
+/**
+ * @brief Multi-lane queue of sync operations
+ *
+ * User-requested operations go first, and so do folder creations: a new
+ * folder needs its ID before anything below it can be uploaded, whatever
+ * lane that went to, so the user lane is never passed over. Other
+ * operations are split by size: metadata changes and small files are
+ * favored, so many documents land before one large transfer. Two rules
+ * keep the large lane moving:
+ *
+ * - While the user lane is empty, the large lane is served whenever its
+ *   share of recently dispatched bytes is below the reserved share.
+ * - Otherwise the small or large lane with the best score goes next,
+ *   where the score is the lane weight plus the wait of its oldest
+ *   operation in aging intervals. A waiting operation therefore
+ *   eventually beats any newer one, and neither lane starves.
+ *
+ * Operations on one path run in the order they were queued: while one is
+ * pending, later ones on the same path, or the source of a move, join it
+ * in its lane whatever their own priority and size. The plan window is
+ * handed out merged by queue time, as the optimizer expects.
+ *
+ * Each lane is a SyncQueue; lanes spill to their own folder once Open()
+ * was called. Which lane holds a path is only known for operations
+ * queued since then. Times are wall-clock microseconds, so queue times survive a
+ * restart.
+ *
+ * The scheduler is not thread-safe; the owner serializes access.
+ *
+ * @see SyncQueue
+ * @since 1.0.0
+ */
+class SyncScheduler {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param memoryLimit Operations kept in memory, over all lanes
+     */
+    SyncScheduler(int32 memoryLimit);
+
+    /**
+     * @brief Destructor
+     */
+    ~SyncScheduler();
+
+    /**
+     * @brief Spill lanes to folders below a directory and load them
+     *
+     * @param directory Folder for the lanes, created if missing
+     * @return B_OK, or the first lane error
+     */
+    status_t Open(const char* directory);
+
+    /**
+     * @brief Make every lane durable
+     *
+     * @return B_OK, B_NO_INIT without a directory, or an error code
+     */
+    status_t Save();
+
+    /**
+     * @brief Get the lane an operation belongs to
+     *
+     * @param item Sync operation
+     * @return Lane
+     */
+    SyncLane LaneFor(const SyncItem& item) const;
+
+    /**
+     * @brief Queue an operation
+     *
+     * @param item Operation, moved from; its queue time is set to now
+     * @param now Current wall-clock time
+     */
+    void Push(SyncItem&& item, bigtime_t now);
+
+    /**
+     * @brief Take the operation that should run next
+     *
+     * @param now Current wall-clock time
+     * @param item Receives the operation
+     * @return false if nothing is queued
+     */
+    bool Pop(bigtime_t now, SyncItem& item);
+
+    /**
+     * @brief Take the operations held in memory, for planning
+     *
+     * @param items Receives the operations, oldest first
+     */
+    void TakeWindow(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Put operations back at the head of their lanes
+     *
+     * Operations on one path keep their order, in the lane of the first.
+     *
+     * @param items Operations in planned order, moved from
+     */
+    void RestoreWindow(std::vector<SyncItem>& items);
+
+    /**
+     * @brief Get the number of queued operations
+     *
+     * @return Operation count over all lanes
+     */
+    int32 Count() const;
+
+    /**
+     * @brief Get the number of operations on disk
+     *
+     * @return Spilled operation count over all lanes
+     */
+    int32 CountSpilled() const;
+
+    /**
+     * @brief Check for queued operations
+     *
+     * @return true if every lane is empty
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @brief Get the bytes held in memory
+     *
+     * @return Memory use over all lanes
+     */
+    size_t MemoryUsage() const;
+
+    /**
+     * @brief Get statistics of a lane
+     *
+     * @param lane Lane
+     * @return Snapshot of the counters
+     */
+    SyncLaneStats LaneStats(SyncLane lane) const;
+
+    /**
+     * @brief Get a printable name for a lane
+     *
+     * @param lane Lane
+     * @return Lane name
+     */
+    static const char* LaneName(SyncLane lane);
+
+    /**
+     * @brief Set the size from which a transfer is large
+     *
+     * @param threshold Size in bytes
+     */
+    void SetLargeFileThreshold(off_t threshold);
+
+    /**
+     * @brief Set the share of bytes reserved for large transfers
+     *
+     * @param share Fraction between 0 and 1
+     */
+    void SetLargeShare(float share);
+
+    /**
+     * @brief Set the wait that is worth one lane of priority
+     *
+     * @param interval Aging interval in microseconds
+     */
+    void SetAgingInterval(bigtime_t interval);
+
+    static const off_t kDefaultLargeFileThreshold; ///< 8 MB
+    static const float kDefaultLargeShare;          ///< 0.2
+    static const bigtime_t kDefaultAgingInterval;   ///< 60 seconds
+
+private:
+    /**
+     * @brief Pick the lane to serve next, -1 if all are empty
+     */
+    int32 _NextLane(bigtime_t now);
+
+    /**
+     * @brief Account for a dispatched operation
+     */
+    void _Dispatched(SyncLane lane, const SyncItem& item, bigtime_t now);
+
+    /**
+     * @brief Get the lane of an operation about to be queued, and hold
+     *        its paths there
+     */
+    SyncLane _Pin(const SyncItem& item);
+
+    /**
+     * @brief Release the paths of an operation leaving the lanes
+     */
+    void _Unpin(const SyncItem& item);
+
+    /**
+     * @brief Lane holding operations on a path, and how many
+     */
+    struct PathPin {
+        int32 lane;
+        int32 count;
+    };
+
+    /**
+     * @brief Per-lane counters
+     */
+    struct LaneCounters {
+        int32 dispatched;
+        off_t dispatchedBytes;
+        off_t recentBytes;      ///< Decaying byte count for the share
+        bigtime_t totalWait;
+        bigtime_t maxWait;
+    };
+
+private:
+    std::unique_ptr<SyncQueue> fLanes[kSyncLaneCount];
+    LaneCounters fCounters[kSyncLaneCount];
+    std::map<BString, PathPin> fPins;   ///< Paths with queued operations
+    off_t fLargeFileThreshold;
+    float fLargeShare;
+    bigtime_t fAgingInterval;
+};
+
+} // namespace OneDrive
+
+#endif // SYNC_SCHEDULER_H
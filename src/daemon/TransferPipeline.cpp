@@ -0,0 +1,470 @@
+/**
+ * @file TransferPipeline.cpp
+ * @brief Implementation of the staged transfer pipeline
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ */
+
+#include "TransferPipeline.h"
+
+#include <Autolock.h>
+
+using namespace OneDrive;
+
+const int32 TransferPipeline::kDefaultDiskWorkers = 2;
+const int32 TransferPipeline::kDefaultNetworkWorkers = 4;
+const int32 TransferPipeline::kDefaultFinalizeWorkers = 1;
+
+// Queue slots in front of a stage, per worker of that stage
+static const int32 kQueueSlotsPerWorker = 2;
+
+static const char* kStageNames[kTransferStageCount] = {
+    "disk", "network", "finalize"
+};
+static const char* kThreadNames[kTransferStageCount] = {
+    "transfer disk", "transfer network", "transfer finalize"
+};
+
+/**
+ * @brief Constructor
+ */
+TransferPipeline::TransferPipeline(const StageFunction& disk,
+    const StageFunction& network, const StageFunction& finalize,
+    const DoneFunction& done)
+    : fDoneFunction(done),
+      fLock("TransferPipeline Lock"),
+      fRunning(false),
+      fStartTime(0),
+      fInFlight(0),
+      fIdle(create_sem(0, "transfer idle")),
+      fIdleWaiters(0)
+{
+    const StageFunction* functions[kTransferStageCount]
+        = { &disk, &network, &finalize };
+    const int32 workers[kTransferStageCount] = { kDefaultDiskWorkers,
+        kDefaultNetworkWorkers, kDefaultFinalizeWorkers };
+
+    for (int32 i = 0; i < kTransferStageCount; i++) {
+        Stage& stage = fStages[i];
+        stage.pipeline = this;
+        stage.index = (TransferStage)i;
+        stage.function = *functions[i];
+        stage.workers = workers[i];
+        stage.running = 0;
+        stage.active = 0;
+        stage.processed = 0;
+        stage.busy = 0;
+        stage.stalled = 0;
+        stage.filled = create_sem(0, kThreadNames[i]);
+        stage.room = create_sem(0, kThreadNames[i]);
+        stage.takers = 0;
+        stage.putters = 0;
+    }
+}
+
+/**
+ * @brief Destructor
+ */
+TransferPipeline::~TransferPipeline()
+{
+    Stop();
+
+    for (int32 i = 0; i < kTransferStageCount; i++) {
+        delete_sem(fStages[i].filled);
+        delete_sem(fStages[i].room);
+    }
+    delete_sem(fIdle);
+}
+
+/**
+ * @brief Spawn the stage workers
+ */
+status_t
+TransferPipeline::Start()
+{
+    BAutolock lock(fLock);
+
+    if (fRunning) {
+        return B_OK;
+    }
+
+    fRunning = true;
+    fStartTime = system_time();
+    for (int32 i = 0; i < kTransferStageCount; i++) {
+        Stage& stage = fStages[i];
+        stage.processed = 0;
+        stage.busy = 0;
+        stage.stalled = 0;
+
+        status_t status = _SpawnWorkers(stage);
+        if (stage.running == 0) {
+            // A stage without workers would hold every item forever
+            lock.Unlock();
+            Stop();
+            return status != B_OK ? status : B_ERROR;
+        }
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Cancel waiting items and wait for the workers to exit
+ */
+void
+TransferPipeline::Stop()
+{
+    std::vector<thread_id> threads;
+    {
+        BAutolock lock(fLock);
+        if (!fRunning) {
+            return;
+        }
+        fRunning = false;
+        for (int32 i = 0; i < kTransferStageCount; i++) {
+            _WakeAll(fStages[i]);
+        }
+        threads.swap(fThreads);
+    }
+
+    CancelPending();
+
+    // Workers finish their current item; its next stage turns it away
+    for (size_t i = 0; i < threads.size(); i++) {
+        status_t exitValue;
+        wait_for_thread(threads[i], &exitValue);
+    }
+
+    // Anything put between the cancel and the workers exiting
+    CancelPending();
+}
+
+/**
+ * @brief Set the number of workers of a stage
+ */
+void
+TransferPipeline::SetConcurrency(TransferStage stage, int32 workers)
+{
+    if (stage < 0 || stage >= kTransferStageCount) {
+        return;
+    }
+
+    BAutolock lock(fLock);
+
+    Stage& target = fStages[stage];
+    target.workers = workers > 0 ? workers : 1;
+    if (!fRunning) {
+        return;
+    }
+
+    if (target.running < target.workers) {
+        _SpawnWorkers(target);
+    } else if (target.running > target.workers) {
+        // Idle workers notice they are surplus and exit
+        _WakeAll(target);
+    }
+
+    // The queue in front of the stage grew or shrank with it
+    if (target.putters > 0) {
+        release_sem_etc(target.room, target.putters, 0);
+        target.putters = 0;
+    }
+}
+
+/**
+ * @brief Get the number of workers of a stage
+ */
+int32
+TransferPipeline::Concurrency(TransferStage stage) const
+{
+    if (stage < 0 || stage >= kTransferStageCount) {
+        return 0;
+    }
+
+    BAutolock lock(fLock);
+    return fStages[stage].workers;
+}
+
+/**
+ * @brief Queue an item for the disk stage
+ */
+bool
+TransferPipeline::Submit(SyncItem& item)
+{
+    {
+        BAutolock lock(fLock);
+        if (!fRunning) {
+            return false;
+        }
+        fInFlight++;
+    }
+
+    bigtime_t stalled = 0;
+    if (_Put(fStages[kTransferStageDisk], item, stalled)) {
+        return true;
+    }
+
+    // Stopped while waiting for room: the caller keeps the item
+    BAutolock lock(fLock);
+    fInFlight--;
+    if (fInFlight == 0 && fIdleWaiters > 0) {
+        release_sem_etc(fIdle, fIdleWaiters, 0);
+        fIdleWaiters = 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Hand back every item still waiting for a stage
+ */
+int32
+TransferPipeline::CancelPending()
+{
+    std::vector<SyncItem> cancelled;
+    {
+        BAutolock lock(fLock);
+        for (int32 i = 0; i < kTransferStageCount; i++) {
+            Stage& stage = fStages[i];
+            for (size_t j = 0; j < stage.items.size(); j++) {
+                cancelled.push_back(std::move(stage.items[j]));
+            }
+            stage.items.clear();
+            if (stage.putters > 0) {
+                release_sem_etc(stage.room, stage.putters, 0);
+                stage.putters = 0;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cancelled.size(); i++) {
+        _Finish(cancelled[i], B_CANCELED);
+    }
+    return cancelled.size();
+}
+
+/**
+ * @brief Wait until no item is left in the pipeline
+ */
+void
+TransferPipeline::WaitIdle()
+{
+    while (true) {
+        {
+            BAutolock lock(fLock);
+            if (fInFlight == 0) {
+                return;
+            }
+            fIdleWaiters++;
+        }
+        acquire_sem(fIdle);
+    }
+}
+
+/**
+ * @brief Get the number of items in the pipeline
+ */
+int32
+TransferPipeline::CountInFlight() const
+{
+    BAutolock lock(fLock);
+    return fInFlight;
+}
+
+/**
+ * @brief Get statistics since Start()
+ */
+TransferPipelineStats
+TransferPipeline::Stats() const
+{
+    BAutolock lock(fLock);
+
+    TransferPipelineStats stats;
+    stats.elapsed = fStartTime > 0 ? system_time() - fStartTime : 0;
+    for (int32 i = 0; i < kTransferStageCount; i++) {
+        const Stage& stage = fStages[i];
+        TransferStageStats& out = stats.stages[i];
+        out.workers = stage.workers;
+        out.active = stage.active;
+        out.queued = stage.items.size();
+        out.processed = stage.processed;
+        out.busy = stage.busy;
+        out.stalled = stage.stalled;
+        out.utilization = stats.elapsed > 0
+            ? (float)stage.busy / ((float)stats.elapsed * stage.workers) : 0.0f;
+        if (out.utilization > 1.0f) {
+            out.utilization = 1.0f;
+        }
+    }
+    return stats;
+}
+
+/**
+ * @brief Get a printable name for a stage
+ */
+const char*
+TransferPipeline::StageName(TransferStage stage)
+{
+    return stage >= 0 && stage < kTransferStageCount
+        ? kStageNames[stage] : "unknown";
+}
+
+/**
+ * @brief Worker thread entry point
+ */
+int32
+TransferPipeline::_WorkerThread(void* data)
+{
+    Stage* stage = static_cast<Stage*>(data);
+    stage->pipeline->_Work(*stage);
+    return 0;
+}
+
+/**
+ * @brief Take items of a stage until stopped or no longer needed
+ */
+void
+TransferPipeline::_Work(Stage& stage)
+{
+    SyncItem item;
+    while (_Take(stage, item)) {
+        bigtime_t start = system_time();
+        status_t result = stage.function(item);
+        bigtime_t busy = system_time() - start;
+
+        {
+            BAutolock lock(fLock);
+            stage.active--;
+            stage.processed++;
+            stage.busy += busy;
+        }
+
+        if (result != B_OK || stage.index == kTransferStageFinalize) {
+            _Finish(item, result);
+            continue;
+        }
+
+        bigtime_t stalled = 0;
+        bool accepted = _Put(fStages[stage.index + 1], item, stalled);
+        {
+            BAutolock lock(fLock);
+            stage.stalled += stalled;
+        }
+        if (!accepted) {
+            _Finish(item, B_CANCELED);
+        }
+    }
+}
+
+/**
+ * @brief Take the next item, false when the worker should exit
+ */
+bool
+TransferPipeline::_Take(Stage& stage, SyncItem& item)
+{
+    BAutolock lock(fLock);
+
+    while (true) {
+        if (!fRunning || stage.running > stage.workers) {
+            stage.running--;
+            return false;
+        }
+        if (!stage.items.empty()) {
+            item = std::move(stage.items.front());
+            stage.items.pop_front();
+            stage.active++;
+            if (stage.putters > 0) {
+                release_sem(stage.room);
+                stage.putters--;
+            }
+            return true;
+        }
+
+        stage.takers++;
+        lock.Unlock();
+        acquire_sem(stage.filled);
+        lock.Lock();
+    }
+}
+
+/**
+ * @brief Queue an item for a stage, waiting for room
+ */
+bool
+TransferPipeline::_Put(Stage& stage, SyncItem& item, bigtime_t& stalled)
+{
+    BAutolock lock(fLock);
+
+    while (true) {
+        if (!fRunning) {
+            return false;
+        }
+        if ((int32)stage.items.size() < stage.workers * kQueueSlotsPerWorker) {
+            stage.items.push_back(std::move(item));
+            if (stage.takers > 0) {
+                release_sem(stage.filled);
+                stage.takers--;
+            }
+            return true;
+        }
+
+        stage.putters++;
+        lock.Unlock();
+        bigtime_t start = system_time();
+        acquire_sem(stage.room);
+        stalled += system_time() - start;
+        lock.Lock();
+    }
+}
+
+/**
+ * @brief Hand an item to the done function
+ */
+void
+TransferPipeline::_Finish(SyncItem& item, status_t result)
+{
+    fDoneFunction(item, result);
+
+    BAutolock lock(fLock);
+    fInFlight--;
+    if (fInFlight == 0 && fIdleWaiters > 0) {
+        release_sem_etc(fIdle, fIdleWaiters, 0);
+        fIdleWaiters = 0;
+    }
+}
+
+/**
+ * @brief Spawn workers up to the stage limit, fLock held
+ */
+status_t
+TransferPipeline::_SpawnWorkers(Stage& stage)
+{
+    status_t status = B_OK;
+    while (stage.running < stage.workers) {
+        thread_id thread = spawn_thread(_WorkerThread,
+            kThreadNames[stage.index], B_NORMAL_PRIORITY, &stage);
+        if (thread < 0) {
+            status = thread;
+            break;
+        }
+        fThreads.push_back(thread);
+        stage.running++;
+        resume_thread(thread);
+    }
+    return status;
+}
+
+/**
+ * @brief Wake every thread waiting on a stage, fLock held
+ */
+void
+TransferPipeline::_WakeAll(Stage& stage)
+{
+    if (stage.takers > 0) {
+        release_sem_etc(stage.filled, stage.takers, 0);
+        stage.takers = 0;
+    }
+    if (stage.putters > 0) {
+        release_sem_etc(stage.room, stage.putters, 0);
+        stage.putters = 0;
+    }
+}
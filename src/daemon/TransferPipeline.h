@@ -0,0 +1,264 @@
+/**
+ * @file TransferPipeline.h
+ * @brief Staged disk, network and finalize work for file transfers
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * A transfer reads and hashes a file, sends or receives it, and then
+ * updates the cache and local state. Run as one call per file, adding
+ * parallelism either floods the disk with readers or leaves connections
+ * idle. The TransferPipeline runs the three steps as stages, each with
+ * its own workers and queue.
+ */
+
+#ifndef TRANSFER_PIPELINE_H
+#define TRANSFER_PIPELINE_H
+
+#include <Locker.h>
+#include <OS.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "SyncEngine.h"
+
+namespace OneDrive {
+
+/**
+ * @brief Pipeline stages
+ */
+enum TransferStage {
+    kTransferStageDisk = 0,     ///< Local reads, hashing, folder creation
+    kTransferStageNetwork,      ///< Upload or download
+    kTransferStageFinalize,     ///< Attributes, cache and state updates
+    kTransferStageCount
+};
+
+/**
+ * @brief Statistics of one stage
+ */
+struct TransferStageStats {
+    int32 workers;              ///< Concurrency limit
+    int32 active;               ///< Items being worked on
+    int32 queued;               ///< Items waiting for a worker
+    int32 processed;            ///< Items through the stage
+    bigtime_t busy;             ///< Worker time spent on items
+    bigtime_t stalled;          ///< Worker time blocked on the next stage
+    float utilization;          ///< Busy share of the worker time
+};
+
+/**
+ * @brief Statistics of a pipeline
+ */
+struct TransferPipelineStats {
+    bigtime_t elapsed;          ///< Time since Start()
+    TransferStageStats stages[kTransferStageCount];
+};
+
+/**
+ * @brief Three-stage pipeline over transfer operations
+ *
+ * Every stage has a pool of worker threads and a bounded queue in front
+ * of it, two items per worker. A worker hands its item to the next stage
+ * and blocks while that queue is full, so a slow network holds back disk
+ * reads instead of letting read files pile up. Disk and network
+ * concurrency are set independently and can change while running.
+ *
+ * An item leaves the pipeline after the finalize stage, or after the
+ * first stage that fails; the done function is then called on the
+ * worker's thread. Items cancelled before their last stage are handed to
+ * it with B_CANCELED.
+ *
+ * Busy time over worker time gives each stage's utilization: a stage near
+ * 100% limits throughput, one far below it has workers to spare.
+ *
+ * @see DeltaPipeline
+ * @since 1.0.0
+ */
+class TransferPipeline {
+public:
+    /**
+     * @brief Work of one stage on an item
+     *
+     * Called from several threads at once; the item belongs to the call.
+     */
+    typedef std::function<status_t(SyncItem&)> StageFunction;
+
+    /**
+     * @brief Called once per item when it leaves the pipeline
+     */
+    typedef std::function<void(SyncItem&, status_t)> DoneFunction;
+
+    /**
+     * @brief Constructor
+     *
+     * @param disk Disk stage
+     * @param network Network stage
+     * @param finalize Finalize stage
+     * @param done Completion function
+     */
+    TransferPipeline(const StageFunction& disk, const StageFunction& network,
+        const StageFunction& finalize, const DoneFunction& done);
+
+    /**
+     * @brief Destructor
+     *
+     * Stops the pipeline.
+     */
+    ~TransferPipeline();
+
+    /**
+     * @brief Spawn the stage workers
+     *
+     * @return B_OK, or an error if no worker could be spawned
+     */
+    status_t Start();
+
+    /**
+     * @brief Cancel waiting items and wait for the workers to exit
+     *
+     * Items being worked on finish their current stage first.
+     */
+    void Stop();
+
+    /**
+     * @brief Set the number of workers of a stage
+     *
+     * @param stage Stage
+     * @param workers Worker count, at least 1
+     */
+    void SetConcurrency(TransferStage stage, int32 workers);
+
+    /**
+     * @brief Get the number of workers of a stage
+     *
+     * @param stage Stage
+     * @return Worker count
+     */
+    int32 Concurrency(TransferStage stage) const;
+
+    /**
+     * @brief Queue an item for the disk stage
+     *
+     * Blocks while the disk queue is full.
+     *
+     * @param item Item, moved from only on success
+     * @return false if the pipeline is not running
+     */
+    bool Submit(SyncItem& item);
+
+    /**
+     * @brief Hand back every item still waiting for a stage
+     *
+     * @return Number of items passed to the done function as cancelled
+     */
+    int32 CancelPending();
+
+    /**
+     * @brief Wait until no item is left in the pipeline
+     */
+    void WaitIdle();
+
+    /**
+     * @brief Get the number of items in the pipeline
+     *
+     * @return Submitted items not yet done
+     */
+    int32 CountInFlight() const;
+
+    /**
+     * @brief Get statistics since Start()
+     *
+     * @return Snapshot of the counters
+     */
+    TransferPipelineStats Stats() const;
+
+    /**
+     * @brief Get a printable name for a stage
+     *
+     * @param stage Stage
+     * @return Stage name
+     */
+    static const char* StageName(TransferStage stage);
+
+    static const int32 kDefaultDiskWorkers;     ///< 2
+    static const int32 kDefaultNetworkWorkers;  ///< 4
+    static const int32 kDefaultFinalizeWorkers; ///< 1
+
+private:
+    /**
+     * @brief Queue and workers of one stage
+     */
+    struct Stage {
+        TransferPipeline* pipeline;
+        TransferStage index;
+        StageFunction function;
+        std::deque<SyncItem> items;     ///< Waiting for a worker
+        int32 workers;                  ///< Concurrency limit
+        int32 running;                  ///< Worker threads alive
+        int32 active;                   ///< Items being worked on
+        int32 processed;
+        bigtime_t busy;
+        bigtime_t stalled;
+        sem_id filled;                  ///< Released for takers
+        sem_id room;                    ///< Released for putters
+        int32 takers;                   ///< Workers waiting for an item
+        int32 putters;                  ///< Threads waiting for room
+    };
+
+    TransferPipeline(const TransferPipeline&);
+    TransferPipeline& operator=(const TransferPipeline&);
+
+    /**
+     * @brief Worker thread entry point
+     */
+    static int32 _WorkerThread(void* data);
+
+    /**
+     * @brief Take items of a stage until stopped or no longer needed
+     */
+    void _Work(Stage& stage);
+
+    /**
+     * @brief Take the next item, false when the worker should exit
+     */
+    bool _Take(Stage& stage, SyncItem& item);
+
+    /**
+     * @brief Queue an item for a stage, waiting for room
+     */
+    bool _Put(Stage& stage, SyncItem& item, bigtime_t& stalled);
+
+    /**
+     * @brief Hand an item to the done function
+     */
+    void _Finish(SyncItem& item, status_t result);
+
+    /**
+     * @brief Spawn workers up to the stage limit, fLock held
+     */
+    status_t _SpawnWorkers(Stage& stage);
+
+    /**
+     * @brief Wake every thread waiting on a stage, fLock held
+     */
+    void _WakeAll(Stage& stage);
+
+private:
+    Stage fStages[kTransferStageCount];
+    DoneFunction fDoneFunction;
+
+    mutable BLocker fLock;              ///< Protects everything below
+    std::vector<thread_id> fThreads;    ///< Workers ever spawned
+    bool fRunning;                      ///< Between Start() and Stop()
+    bigtime_t fStartTime;
+    int32 fInFlight;                    ///< Submitted, not yet done
+    sem_id fIdle;                       ///< Released when in flight is 0
+    int32 fIdleWaiters;
+};
+
+} // namespace OneDrive
+
+#endif // TRANSFER_PIPELINE_H
@@ -106,6 +106,10 @@ DragDropHandler::MessageReceived(BMessage* message)
             break;
         }
         
+        case kMsgDropJobProgress:
+            _UpdateProgress(message);
+            break;
+        
         default:
             BHandler::MessageReceived(message);
             break;
@@ -134,7 +138,7 @@ DragDropHandler::IsOneDrivePath(const entry_ref& ref)
  */
 status_t
 DragDropHandler::ProcessDrop(BMessage* refs, const entry_ref& destination,
-                            uint32 modifiers)
+                            uint32 modifiers, int32* job)
 {
     if (!refs) {
         return B_BAD_VALUE;
@@ -142,64 +146,62 @@ DragDropHandler::ProcessDrop(BMessage* refs, const entry_ref& destination,
     
     // Check if destination is OneDrive
     bool isOneDriveTarget = IsOneDrivePath(destination);
+    BDirectory destinationDir(&destination);
+    
+    // All refs go in one job; the daemon stats and expands them
+    BMessage jobMsg(kMsgDropJob);
+    jobMsg.AddRef("destination", &destination);
     
-    // Process each dropped item
     entry_ref ref;
     int32 itemCount = 0;
+    bool moved = false;
     DragDropOperation commonOp = kDragDropCopy;
     
     for (int32 i = 0; refs->FindRef("refs", i, &ref) == B_OK; i++) {
-        DragDropInfo* info = new DragDropInfo();
-        info->source = ref;
-        info->destination = destination;
-        info->isOneDriveSource = IsOneDrivePath(ref);
-        info->isOneDriveTarget = isOneDriveTarget;
-        
-        // Determine operation
-        info->operation = _DetermineOperation(ref, destination, modifiers);
-        if (i == 0) {
-            commonOp = info->operation;
+        bool isOneDriveSource = IsOneDrivePath(ref);
+        if (!isOneDriveSource && !isOneDriveTarget) {
+            continue;
         }
         
-        // Get file size
-        BEntry entry(&ref);
-        struct stat st;
-        if (entry.GetStat(&st) == B_OK) {
-            info->size = st.st_size;
+        DragDropOperation operation = _DetermineOperation(isOneDriveSource,
+            isOneDriveTarget, modifiers);
+        if (itemCount == 0) {
+            commonOp = operation;
         }
         
-        // Handle the operation
-        status_t result = B_OK;
-        
-        if (info->isOneDriveSource && info->isOneDriveTarget) {
-            // Move/copy within OneDrive
-            if (info->operation == kDragDropMove) {
-                result = _HandleOneDriveMove(*info);
-            } else {
-                result = _HandleOneDriveCopy(*info);
+        if (isOneDriveSource && isOneDriveTarget
+            && operation == kDragDropMove) {
+            // A rename on disk; the daemon moves the remote item
+            if (_HandleOneDriveMove(ref, destinationDir) != B_OK) {
+                continue;
             }
-        } else if (!info->isOneDriveSource && info->isOneDriveTarget) {
-            // Upload to OneDrive
-            result = _HandleUpload(*info);
-        } else if (info->isOneDriveSource && !info->isOneDriveTarget) {
-            // Download from OneDrive
-            result = _HandleDownload(*info);
+            moved = true;
         }
         
-        if (result == B_OK) {
-            BAutolock lock(fLock);
-            fActiveOperations.AddItem(info);
-            itemCount++;
-        } else {
-            delete info;
-        }
+        jobMsg.AddRef("refs", &ref);
+        itemCount++;
     }
     
-    // Show feedback
-    if (itemCount > 0) {
-        _ShowOperationFeedback(commonOp, itemCount);
+    if (itemCount == 0) {
+        return B_OK;
+    }
+    
+    // Refs inside OneDrive were either all moved or are all to be copied
+    jobMsg.AddBool("copy", !moved);
+    
+    int32 jobId = _SendToDaemon(jobMsg, commonOp, itemCount);
+    if (jobId < 0) {
+        ErrorLogger::Instance().LogError("DragDropHandler", jobId,
+            "Failed to send drop to daemon");
+        return jobId;
+    }
+    if (job != NULL) {
+        *job = jobId;
     }
     
+    // Show feedback
+    _ShowOperationFeedback(commonOp, itemCount);
+    
     return B_OK;
 }
 
@@ -219,7 +221,18 @@ DragDropHandler::CancelOperation(int32 operation)
 bool
 DragDropHandler::GetProgress(int32 operation, off_t& completed, off_t& total)
 {
-    // TODO: Implement progress tracking
+    BAutolock lock(fLock);
+    
+    for (int32 i = 0; i < fActiveOperations.CountItems(); i++) {
+        DragDropInfo* info
+            = static_cast<DragDropInfo*>(fActiveOperations.ItemAt(i));
+        if (info->id == operation) {
+            completed = info->completed;
+            total = info->total;
+            return true;
+        }
+    }
+    
     return false;
 }
 
@@ -227,13 +240,10 @@ DragDropHandler::GetProgress(int32 operation, off_t& completed, off_t& total)
  * @brief Determine operation type
  */
 DragDropOperation
-DragDropHandler::_DetermineOperation(const entry_ref& source,
-                                    const entry_ref& destination,
+DragDropHandler::_DetermineOperation(bool isOneDriveSource,
+                                    bool isOneDriveTarget,
                                     uint32 modifiers)
 {
-    bool isOneDriveSource = IsOneDrivePath(source);
-    bool isOneDriveTarget = IsOneDrivePath(destination);
-    
     // Check keyboard modifiers
     if (modifiers & B_OPTION_KEY) {
         return kDragDropCopy;  // Option key forces copy
@@ -258,88 +268,24 @@ DragDropHandler::_DetermineOperation(const entry_ref& source,
     return kDragDropCopy;
 }
 
-/**
- * @brief Handle upload operation
- */
-status_t
-DragDropHandler::_HandleUpload(const DragDropInfo& info)
-{
-    LOG_INFO("DragDropHandler", "Uploading file to OneDrive");
-    
-    // Send upload request to daemon
-    BMessage uploadMsg(kMsgSyncRequired);
-    uploadMsg.AddRef("source", &info.source);
-    uploadMsg.AddRef("destination", &info.destination);
-    uploadMsg.AddInt32("operation", kDragDropUpload);
-    
-    BMessenger daemon(APP_SIGNATURE);
-    return daemon.SendMessage(&uploadMsg);
-}
-
-/**
- * @brief Handle download operation
- */
-status_t
-DragDropHandler::_HandleDownload(const DragDropInfo& info)
-{
-    LOG_INFO("DragDropHandler", "Downloading file from OneDrive");
-    
-    // Send download request to daemon
-    BMessage downloadMsg(kMsgDownloadFile);
-    downloadMsg.AddRef("source", &info.source);
-    downloadMsg.AddRef("destination", &info.destination);
-    downloadMsg.AddBool("move", false);
-    
-    BMessenger daemon(APP_SIGNATURE);
-    return daemon.SendMessage(&downloadMsg);
-}
-
 /**
  * @brief Handle move within OneDrive
  */
 status_t
-DragDropHandler::_HandleOneDriveMove(const DragDropInfo& info)
+DragDropHandler::_HandleOneDriveMove(const entry_ref& source,
+                                    BDirectory& destination)
 {
-    LOG_INFO("DragDropHandler", "Moving file within OneDrive");
+    BEntry entry(&source);
     
-    // Local move first
-    BEntry entry(&info.source);
-    BDirectory destDir(&info.destination);
-    
-    status_t result = entry.MoveTo(&destDir);
+    status_t result = entry.MoveTo(&destination);
     if (result != B_OK) {
         ErrorLogger::Instance().LogError("DragDropHandler", result, "Failed to move file");
         return result;
     }
     
-    // Notify daemon of the move
-    BMessage moveMsg('move');
-    moveMsg.AddRef("source", &info.source);
-    moveMsg.AddRef("destination", &info.destination);
-    
-    BMessenger daemon(APP_SIGNATURE);
-    daemon.SendMessage(&moveMsg);
-    
     return B_OK;
 }
 
-/**
- * @brief Handle copy within OneDrive
- */
-status_t
-DragDropHandler::_HandleOneDriveCopy(const DragDropInfo& info)
-{
-    LOG_INFO("DragDropHandler", "Copying file within OneDrive");
-    
-    // Send copy request to daemon (it will handle the cloud copy)
-    BMessage copyMsg('copy');
-    copyMsg.AddRef("source", &info.source);
-    copyMsg.AddRef("destination", &info.destination);
-    
-    BMessenger daemon(APP_SIGNATURE);
-    return daemon.SendMessage(&copyMsg);
-}
-
 /**
  * @brief Show operation feedback
  */
@@ -380,29 +326,77 @@ DragDropHandler::_ShowOperationFeedback(DragDropOperation operation, int32 itemC
  * @brief Update operation progress
  */
 void
-DragDropHandler::_UpdateProgress(int32 operation, off_t completed, off_t total)
+DragDropHandler::_UpdateProgress(BMessage* report)
 {
+    int32 operation = report->GetInt32("job", -1);
+    bool finished = report->GetBool("finished", false);
+    
+    BAutolock lock(fLock);
+    
+    for (int32 i = 0; i < fActiveOperations.CountItems(); i++) {
+        DragDropInfo* info
+            = static_cast<DragDropInfo*>(fActiveOperations.ItemAt(i));
+        if (info->id != operation) {
+            continue;
+        }
+        
+        info->totalItems = report->GetInt32("totalItems", 0);
+        info->completedItems = report->GetInt32("completedItems", 0);
+        info->completed = report->GetInt64("completedBytes", 0);
+        info->total = report->GetInt64("totalBytes", 0);
+        info->enumerating = report->GetBool("enumerating", false);
+        
+        if (finished) {
+            LOG_INFO("DragDropHandler", "Drop job %d done: %d of %d items",
+                (int)operation, (int)info->completedItems,
+                (int)info->totalItems);
+            fActiveOperations.RemoveItem(i);
+            delete info;
+        }
+        break;
+    }
+    
     // TODO: Update progress display
 }
 
 /**
- * @brief Send operation to daemon
+ * @brief Send a drop job to the daemon
  */
 int32
-DragDropHandler::_SendToDaemon(const DragDropInfo& info)
+DragDropHandler::_SendToDaemon(BMessage& job, DragDropOperation operation,
+                              int32 itemCount)
 {
-    int32 opId = fNextOperationId++;
+    DragDropInfo* info = new DragDropInfo();
+    info->operation = operation;
+    info->itemCount = itemCount;
+    info->totalItems = 0;
+    info->completedItems = 0;
+    info->completed = 0;
+    info->total = 0;
+    info->enumerating = true;
+    job.FindRef("destination", &info->destination);
+    
+    int32 id;
+    {
+        BAutolock lock(fLock);
+        id = info->id = fNextOperationId++;
+        fActiveOperations.AddItem(info);
+    }
     
-    BMessage msg('drop');
-    msg.AddInt32("operation_id", opId);
-    msg.AddRef("source", &info.source);
-    msg.AddRef("destination", &info.destination);
-    msg.AddInt32("operation", info.operation);
+    job.AddInt32("job", id);
+    job.AddMessenger("reply_to", BMessenger(this));
     
+    // Reports may arrive, and end the job, before this returns
     BMessenger daemon(APP_SIGNATURE);
-    daemon.SendMessage(&msg);
+    status_t result = daemon.SendMessage(&job);
+    if (result != B_OK) {
+        BAutolock lock(fLock);
+        fActiveOperations.RemoveItem(info);
+        delete info;
+        return result;
+    }
     
-    return opId;
+    return id;
 }
 
 // OneDriveTrackerView implementation
@@ -12,6 +12,7 @@
 #ifndef DRAG_DROP_HANDLER_H
 #define DRAG_DROP_HANDLER_H
 
+#include <Directory.h>
 #include <Entry.h>
 #include <Handler.h>
 #include <List.h>
@@ -33,15 +34,21 @@ enum DragDropOperation {
 };
 
 /**
- * @brief Drag and drop operation info
+ * @brief Drag and drop job info
+ *
+ * One drop is one job, however many items it carries. The counters are
+ * the daemon's, as last reported.
  */
 struct DragDropInfo {
-    entry_ref source;           ///< Source file/folder
+    int32 id;                   ///< Job ID
     entry_ref destination;      ///< Destination folder
-    DragDropOperation operation;///< Operation type
-    bool isOneDriveSource;      ///< Source is in OneDrive
-    bool isOneDriveTarget;      ///< Target is in OneDrive
-    off_t size;                 ///< File size (for progress)
+    DragDropOperation operation;///< Operation of the first item
+    int32 itemCount;            ///< Items dropped
+    int32 totalItems;           ///< Items found in dropped folders so far
+    int32 completedItems;       ///< Items synced
+    off_t completed;            ///< Bytes synced
+    off_t total;                ///< Bytes found so far
+    bool enumerating;           ///< Daemon still walks dropped folders
 };
 
 /**
@@ -51,6 +58,11 @@ struct DragDropInfo {
  * folders and local filesystem, handling uploads, downloads, and
  * moves appropriately.
  * 
+ * Nothing is stat'ed or expanded on Tracker's thread: a drop goes to the
+ * daemon as a single job message with all its refs. The daemon walks
+ * dropped folders in the background and reports the job's progress
+ * back, which GetProgress() returns.
+ * 
  * @see VirtualFolder
  * @since 1.0.0
  */
@@ -87,10 +99,11 @@ public:
      * @param refs Files being dropped
      * @param destination Drop target folder
      * @param modifiers Keyboard modifiers (for copy/move/link)
+     * @param job Receives the job ID for GetProgress(), if not NULL
      * @return B_OK on success
      */
     status_t ProcessDrop(BMessage* refs, const entry_ref& destination,
-                        uint32 modifiers);
+                        uint32 modifiers, int32* job = NULL);
     
     /**
      * @brief Cancel ongoing operation
@@ -102,7 +115,9 @@ public:
     /**
      * @brief Get operation progress
      * 
-     * @param operation Operation ID
+     * The total grows while the daemon walks dropped folders.
+     * 
+     * @param operation Job ID returned by ProcessDrop()
      * @param completed Bytes completed
      * @param total Total bytes
      * @return true if operation is active
@@ -113,46 +128,26 @@ private:
     /**
      * @brief Determine operation type
      * 
-     * @param source Source file
-     * @param destination Destination folder
+     * @param isOneDriveSource Source is in OneDrive
+     * @param isOneDriveTarget Destination is in OneDrive
      * @param modifiers Keyboard modifiers
      * @return Operation type
      */
-    DragDropOperation _DetermineOperation(const entry_ref& source,
-                                         const entry_ref& destination,
+    DragDropOperation _DetermineOperation(bool isOneDriveSource,
+                                         bool isOneDriveTarget,
                                          uint32 modifiers);
     
-    /**
-     * @brief Handle upload operation
-     * 
-     * @param info Operation info
-     * @return B_OK on success
-     */
-    status_t _HandleUpload(const DragDropInfo& info);
-    
-    /**
-     * @brief Handle download operation
-     * 
-     * @param info Operation info
-     * @return B_OK on success
-     */
-    status_t _HandleDownload(const DragDropInfo& info);
-    
     /**
      * @brief Handle move within OneDrive
      * 
-     * @param info Operation info
-     * @return B_OK on success
-     */
-    status_t _HandleOneDriveMove(const DragDropInfo& info);
-    
-    /**
-     * @brief Handle copy within OneDrive
+     * Moves on disk; the daemon moves the remote item with the job.
      * 
-     * @param info Operation info
+     * @param source Item to move
+     * @param destination Destination folder
      * @return B_OK on success
      */
-    status_t _HandleOneDriveCopy(const DragDropInfo& info);
+    status_t _HandleOneDriveMove(const entry_ref& source,
+                                 BDirectory& destination);
     
     /**
      * @brief Show operation feedback
@@ -165,22 +160,23 @@ private:
     /**
      * @brief Update operation progress
      * 
-     * @param operation Operation ID
-     * @param completed Bytes completed
-     * @param total Total bytes
+     * @param report kMsgDropJobProgress from the daemon
      */
-    void _UpdateProgress(int32 operation, off_t completed, off_t total);
+    void _UpdateProgress(BMessage* report);
     
     /**
-     * @brief Send operation to daemon
+     * @brief Send a drop job to the daemon
      * 
-     * @param info Operation info
-     * @return Operation ID
+     * @param job kMsgDropJob with the refs and destination
+     * @param operation Operation of the first item
+     * @param itemCount Number of refs
+     * @return Job ID, or an error code
      */
-    int32 _SendToDaemon(const DragDropInfo& info);
+    int32 _SendToDaemon(BMessage& job, DragDropOperation operation,
+                        int32 itemCount);
 
 private:
-    BList fActiveOperations;    ///< List of active operations
+    BList fActiveOperations;    ///< DragDropInfo of active jobs
     mutable BLocker fLock;      ///< Thread safety lock
     int32 fNextOperationId;     ///< Next operation ID
 };
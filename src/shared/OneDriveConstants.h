@@ -63,6 +63,9 @@
 enum {
     kMsgDownloadFile = 'dlfl',      ///< Request to download a file
     kMsgSyncRequired = 'syrq',      ///< Sync is required for folder changes
+    kMsgCopyItem = 'copy',          ///< Copy within the sync folder
+    kMsgDropJob = 'drpj',           ///< Batched drag-and-drop job
+    kMsgDropJobProgress = 'drpp',   ///< Aggregate progress of a drop job
     kMsgUpdateIcon = 'upic',        ///< Update file/folder icon
     kMsgConflictDetected = 'cfdt',  ///< Conflict detected during sync
     kMsgFolderAdded = 'flad',       ///< New sync folder added
@@ -7,7 +7,7 @@
  * 
  * Comprehensive unit tests for the OneDriveAPI class covering:
  * - Microsoft Graph API communication
- * - File operations (upload, download, list, delete)
+ * - File operations (upload, download, list, delete, server-side copy)
  * - Folder operations (create, list, navigate)
  * - Metadata synchronization including BFS attributes
  * - Error handling and rate limiting
@@ -21,6 +21,7 @@
 #include <Message.h>
 #include <File.h>
 #include <Directory.h>
+#include <OS.h>
 #include <Path.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -110,6 +111,11 @@ public:
      */
     void TestDeleteItem();
     
+    /**
+     * @brief Test asynchronous server-side copies
+     */
+    void TestStartCopy();
+    
     /**
      * @brief Test metadata update
      */
@@ -150,6 +156,11 @@ public:
      */
     void TestConcurrentRequests();
     
+    /**
+     * @brief Test that metadata updates of two workers overlap
+     */
+    void TestConcurrentMetadataUpdates();
+    
     /**
      * @brief Test API quota and limits
      */
@@ -189,6 +200,42 @@ private:
      */
     static bool _ProgressCallback(int64 current, int64 total, void* userData);
     
+    /**
+     * @brief Outcome of an asynchronous copy
+     */
+    struct CopyOutcome {
+        sem_id done;
+        int32 completions;
+        OneDriveError error;
+        BString id;
+        float progress;
+    };
+    
+    /**
+     * @brief Completion callback for copy tests
+     */
+    static void _CopyCompleted(OneDriveError error, const OneDriveItem& copied,
+        void* userData);
+    
+    /**
+     * @brief Progress callback for copy tests
+     */
+    static void _CopyProgress(float progress, void* userData);
+    
+    /**
+     * @brief A metadata update run on a thread of its own
+     */
+    struct MetadataUpdate {
+        OneDriveAPI* api;
+        BString itemId;
+        OneDriveError result;
+    };
+    
+    /**
+     * @brief Thread running a metadata update
+     */
+    static int32 _UpdateMetadataThread(void* data);
+    
     /**
      * @brief Test data for progress tracking
      */
@@ -479,6 +526,40 @@ void OneDriveAPITest::TestDeleteItem()
     }
 }
 
+void OneDriveAPITest::TestStartCopy()
+{
+    CopyOutcome outcome;
+    outcome.done = create_sem(0, "copy test");
+    outcome.completions = 0;
+    outcome.error = ONEDRIVE_API_ERROR;
+    outcome.progress = 0;
+    
+    OneDriveError result = fAPI->StartCopy("mock_file_1", "root", "copy.txt",
+        _CopyCompleted, &outcome, _CopyProgress);
+    
+    if (result == ONEDRIVE_OK) {
+        // The monitor thread reports exactly once
+        CPPUNIT_ASSERT_EQUAL((status_t)B_OK,
+            acquire_sem_etc(outcome.done, 1, B_RELATIVE_TIMEOUT, 10000000));
+        CPPUNIT_ASSERT_EQUAL(ONEDRIVE_OK, outcome.error);
+        CPPUNIT_ASSERT(outcome.id.Length() > 0);
+        CPPUNIT_ASSERT(outcome.progress == 1.0f);
+        CPPUNIT_ASSERT_EQUAL((status_t)B_TIMED_OUT,
+            acquire_sem_etc(outcome.done, 1, B_RELATIVE_TIMEOUT, 100000));
+        CPPUNIT_ASSERT_EQUAL((int32)1, outcome.completions);
+    } else {
+        // A copy that did not start reports nothing
+        CPPUNIT_ASSERT_EQUAL((status_t)B_TIMED_OUT,
+            acquire_sem_etc(outcome.done, 1, B_RELATIVE_TIMEOUT, 100000));
+    }
+    
+    // Nobody would learn the outcome
+    CPPUNIT_ASSERT_EQUAL(ONEDRIVE_INVALID_REQUEST,
+        fAPI->StartCopy("mock_file_1", "root", "copy.txt", NULL, NULL));
+    
+    delete_sem(outcome.done);
+}
+
 void OneDriveAPITest::TestUpdateItemMetadata()
 {
     // First create an item to update
@@ -623,6 +704,45 @@ void OneDriveAPITest::TestConcurrentRequests()
     }
 }
 
+void OneDriveAPITest::TestConcurrentMetadataUpdates()
+{
+    BMessage metadata;
+    metadata.AddString("description", "Concurrent update");
+    
+    // One update after the other first
+    bigtime_t start = system_time();
+    if (fAPI->UpdateItemMetadata("item-1", metadata) != ONEDRIVE_OK) {
+        return;  // Not authenticated in this environment
+    }
+    CPPUNIT_ASSERT_EQUAL(ONEDRIVE_OK,
+        fAPI->UpdateItemMetadata("item-2", metadata));
+    bigtime_t sequential = system_time() - start;
+    
+    // Then the same two from two workers
+    MetadataUpdate updates[2];
+    thread_id threads[2];
+    start = system_time();
+    for (int32 i = 0; i < 2; i++) {
+        updates[i].api = fAPI;
+        updates[i].itemId.SetToFormat("item-%d", (int)i + 1);
+        updates[i].result = ONEDRIVE_NETWORK_ERROR;
+        threads[i] = spawn_thread(_UpdateMetadataThread, "metadata update",
+            B_NORMAL_PRIORITY, &updates[i]);
+        CPPUNIT_ASSERT(threads[i] >= 0);
+        resume_thread(threads[i]);
+    }
+    for (int32 i = 0; i < 2; i++) {
+        status_t exitValue;
+        wait_for_thread(threads[i], &exitValue);
+        CPPUNIT_ASSERT_EQUAL(ONEDRIVE_OK, updates[i].result);
+    }
+    bigtime_t concurrent = system_time() - start;
+    
+    // Holding the API lock across the request would make the workers take
+    // turns, as long as one after the other
+    CPPUNIT_ASSERT(concurrent < sequential * 3 / 4);
+}
+
 void OneDriveAPITest::TestQuotaLimits()
 {
     // Test quota information retrieval
@@ -646,6 +766,15 @@ void OneDriveAPITest::TestQuotaLimits()
     }
 }
 
+int32 OneDriveAPITest::_UpdateMetadataThread(void* data)
+{
+    MetadataUpdate* update = static_cast<MetadataUpdate*>(data);
+    BMessage metadata;
+    metadata.AddString("description", "Concurrent update");
+    update->result = update->api->UpdateItemMetadata(update->itemId, metadata);
+    return 0;
+}
+
 status_t OneDriveAPITest::_SetupAuthentication()
 {
     // Set up test client ID
@@ -707,6 +836,21 @@ void OneDriveAPITest::_VerifyOneDriveItem(const OneDriveItem& item)
     CPPUNIT_ASSERT(item.eTag.Length() > 0);
 }
 
+void OneDriveAPITest::_CopyCompleted(OneDriveError error,
+    const OneDriveItem& copied, void* userData)
+{
+    CopyOutcome* outcome = static_cast<CopyOutcome*>(userData);
+    outcome->completions++;
+    outcome->error = error;
+    outcome->id = copied.id;
+    release_sem(outcome->done);
+}
+
+void OneDriveAPITest::_CopyProgress(float progress, void* userData)
+{
+    static_cast<CopyOutcome*>(userData)->progress = progress;
+}
+
 bool OneDriveAPITest::_ProgressCallback(int64 current, int64 total, void* userData)
 {
     ProgressData* data = static_cast<ProgressData*>(userData);
@@ -747,6 +891,8 @@ CppUnit::Test* OneDriveAPITestSuite()
         "TestCreateFolder", &OneDriveAPITest::TestCreateFolder));
     suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
         "TestDeleteItem", &OneDriveAPITest::TestDeleteItem));
+    suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
+        "TestStartCopy", &OneDriveAPITest::TestStartCopy));
     suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
         "TestUpdateItemMetadata", &OneDriveAPITest::TestUpdateItemMetadata));
     suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
@@ -763,6 +909,8 @@ CppUnit::Test* OneDriveAPITestSuite()
         "TestProgressCallbacks", &OneDriveAPITest::TestProgressCallbacks));
     suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
         "TestConcurrentRequests", &OneDriveAPITest::TestConcurrentRequests));
+    suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
+        "TestConcurrentMetadataUpdates", &OneDriveAPITest::TestConcurrentMetadataUpdates));
     suite->addTest(new CppUnit::TestCaller<OneDriveAPITest>(
         "TestQuotaLimits", &OneDriveAPITest::TestQuotaLimits));
     
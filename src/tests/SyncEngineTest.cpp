@@ -0,0 +1,3117 @@
+/**
+ * @file SyncEngineTest.cpp
+ * @brief Unit tests for sync engine components
+ * @author Haiku OneDrive Team
+ * @version 1.0.0
+ * @date 2025-08-15
+ *
+ * Unit tests for the self-contained building blocks of the sync engine:
+ * - Sync plan optimization (subtree collapsing, dependency ordering)
+ * - Path to item ID resolution cache
+ * - Retry scheduling with backoff
+ * - Adaptive remote poll interval
+ * - Remote change notification channel, against a local stand-in server
+ * - Pipelined delta enumeration
+ * - Concurrent remote tree crawl
+ * - In-memory remote tree index and its mapped snapshot
+ * - Compact sync queue and its spill to disk
+ * - Priority and size aware scheduling of queued operations
+ * - Staged disk, network and finalize work of transfers
+ * - Shared bandwidth limits and their schedule
+ * - Compiled include and exclude patterns
+ * - Content fingerprints and lookups for deduplicated transfers
+ * - Aggregate progress of batched drag-and-drop jobs
+ * - Content, metadata and attribute changes told apart
+ * - Local folder moves synced as one server-side move
+ * - Attribute change bursts and diffs to the last upload
+ * - Per-file ordering and drain rate of parallel attribute workers
+ * - Allocation-free attribute reads through a reusable buffer
+ */
+
+#include <cppunit/TestCase.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/TestCaller.h>
+#include <Message.h>
+#include <NodeMonitor.h>
+#include <String.h>
+#include <StringList.h>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "../api/BandwidthShaper.h"
+#include "../api/ItemPathCache.h"
+#include "../api/NotificationChannel.h"
+#include "../api/OneDriveAPI.h"
+#include "../api/QuickXorHash.h"
+#include "../daemon/AdaptivePoller.h"
+#include "../daemon/AttributeBuffer.h"
+#include "../daemon/AttributeCoalescer.h"
+#include "../daemon/AttributeManager.h"
+#include "../daemon/DeltaPipeline.h"
+#include "../daemon/DropJobTracker.h"
+#include "../daemon/LocalChangeClassifier.h"
+#include "../daemon/LocalMoveTranslator.h"
+#include "../daemon/PathFilter.h"
+#include "../daemon/RemoteCrawler.h"
+#include "../daemon/RemoteTreeIndex.h"
+#include "../daemon/RetryScheduler.h"
+#include "../daemon/SyncPlanOptimizer.h"
+#include "../daemon/SyncQueue.h"
+#include "../daemon/SyncScheduler.h"
+#include "../daemon/TransferPipeline.h"
+
+using namespace OneDrive;
+
+/**
+ * @brief Test fixture for sync engine components
+ */
+class SyncEngineTest : public CppUnit::TestCase {
+public:
+    /**
+     * @brief Constructor
+     */
+    SyncEngineTest();
+
+    /**
+     * @brief Destructor
+     */
+    virtual ~SyncEngineTest();
+
+    // Test cases
+
+    /**
+     * @brief Test that descendant deletes collapse into the folder delete
+     */
+    void TestCollapseSubtreeDelete();
+
+    /**
+     * @brief Test that descendant moves collapse into the folder move
+     */
+    void TestCollapseSubtreeMove();
+
+    /**
+     * @brief Test parent-first ordering of new folder trees
+     */
+    void TestNewTreeParentFirst();
+
+    /**
+     * @brief Test that ordering keeps per-path order and moves into new folders
+     */
+    void TestPlanKeepsPathOrder();
+
+    /**
+     * @brief Test path ancestry helper
+     */
+    void TestIsDescendant();
+
+    /**
+     * @brief Test positive and negative path cache entries
+     */
+    void TestPathCacheLookup();
+
+    /**
+     * @brief Test precise invalidation by item ID and by move
+     */
+    void TestPathCacheInvalidation();
+
+    /**
+     * @brief Test LRU eviction and hit counters
+     */
+    void TestPathCacheEviction();
+
+    /**
+     * @brief Test retries become eligible in backoff order
+     */
+    void TestRetryOrdering();
+
+    /**
+     * @brief Test backoff growth, jitter bounds and caps
+     */
+    void TestRetryBackoff();
+
+    /**
+     * @brief Test parking of permanent failures and retry budgets
+     */
+    void TestRetryParking();
+
+    /**
+     * @brief Test poll interval tightening and back-off
+     */
+    void TestAdaptivePollInterval();
+
+    /**
+     * @brief Test notification URL, payload and handshake parsing
+     */
+    void TestNotificationProtocol();
+
+    /**
+     * @brief Test a notification round trip against a stand-in server
+     */
+    void TestNotificationStandIn();
+
+    /**
+     * @brief Test that delta pages flow in order through overlapping stages
+     */
+    void TestDeltaPipelineOrder();
+
+    /**
+     * @brief Test that a stage error stops the pipeline without a token
+     */
+    void TestDeltaPipelineError();
+
+    /**
+     * @brief Test that a crawl lists every folder concurrently, once
+     */
+    void TestRemoteCrawler();
+
+    /**
+     * @brief Test that a bounded frontier and a listing error end a crawl
+     */
+    void TestRemoteCrawlerFrontier();
+
+    /**
+     * @brief Test ID and path lookups across adds, moves and deletes
+     */
+    void TestRemoteTreeIndex();
+
+    /**
+     * @brief Test that items arriving before their parent are attached
+     */
+    void TestRemoteTreeIndexPlaceholders();
+
+    /**
+     * @brief Test memory per item and lookups on a large tree
+     */
+    void TestRemoteTreeIndexScale();
+
+    /**
+     * @brief Test that a mapped snapshot answers lookups and takes changes
+     */
+    void TestRemoteTreeSnapshot();
+
+    /**
+     * @brief Test that damaged or foreign snapshots are rejected
+     */
+    void TestRemoteTreeSnapshotValidation();
+
+    /**
+     * @brief Test that queued items come back whole and in order
+     */
+    void TestSyncQueueRoundTrip();
+
+    /**
+     * @brief Test memory per item and throughput on a large backlog
+     */
+    void TestSyncQueueFootprint();
+
+    /**
+     * @brief Test that a spilling queue keeps order in bounded memory
+     */
+    void TestSyncQueueSpill();
+
+    /**
+     * @brief Test that queued operations survive a restart
+     */
+    void TestSyncQueueRestart();
+
+    /**
+     * @brief Test that segments read back since the last save survive a crash
+     */
+    void TestSyncQueueRefillCrash();
+
+    /**
+     * @brief Test lane order and the byte share reserved for large files
+     */
+    void TestSchedulerLanes();
+
+    /**
+     * @brief Test that waiting operations age past newer ones
+     */
+    void TestSchedulerAging();
+
+    /**
+     * @brief Test that folder creations run before older operations below them
+     */
+    void TestSchedulerParentFirst();
+
+    /**
+     * @brief Test that operations on one file stay in order across lanes
+     */
+    void TestSchedulerSamePathOrder();
+
+    /**
+     * @brief Test stage concurrency limits, failures and cancellation
+     */
+    void TestTransferPipeline();
+
+    /**
+     * @brief Test token buckets, fair sharing and schedule parsing
+     */
+    void TestBandwidthShaper();
+
+    /**
+     * @brief Test glob, "**" path and extension pattern semantics
+     */
+    void TestPathFilter();
+
+    /**
+     * @brief Benchmark a million paths against hundreds of patterns
+     */
+    void TestPathFilterScaling();
+
+    /**
+     * @brief Test QuickXorHash digests against known values
+     */
+    void TestQuickXorHash();
+
+    /**
+     * @brief Test finding files by content hash and size
+     */
+    void TestRemoteTreeContent();
+
+    /**
+     * @brief Test drop job totals, throttled reports and completion
+     */
+    void TestDropJobProgress();
+
+    /**
+     * @brief Test telling content from timestamp and attribute changes,
+     *        and following renamed files
+     */
+    void TestLocalChangeClassification();
+
+    /**
+     * @brief Test that moving a populated folder is one remote move
+     */
+    void TestLocalFolderMove();
+
+    /**
+     * @brief Test one upload per attribute burst, with only the diff
+     */
+    void TestAttributeCoalescing();
+
+    /**
+     * @brief Test that workers never take a file twice at once
+     */
+    void TestAttributeWorkerOrdering();
+
+    /**
+     * @brief Test reading the attributes of 100k files through
+     *        AttributeManager without allocating
+     */
+    void TestAttributeReadScale();
+
+private:
+    /**
+     * @brief Helper to build a sync item
+     */
+    static SyncItem _MakeItem(SyncOperation operation, const char* remotePath,
+        const char* previousPath = "");
+};
+
+SyncEngineTest::SyncEngineTest()
+    : CppUnit::TestCase("SyncEngineTest")
+{
+}
+
+SyncEngineTest::~SyncEngineTest()
+{
+}
+
+void SyncEngineTest::TestCollapseSubtreeDelete()
+{
+    std::vector<SyncItem> plan;
+    plan.push_back(_MakeItem(kSyncOpDelete, "/Photos/2024/a.jpg"));
+    plan.push_back(_MakeItem(kSyncOpDelete, "/Photos/2024/b.jpg"));
+    plan.push_back(_MakeItem(kSyncOpDelete, "/Photos/2024"));
+    plan.push_back(_MakeItem(kSyncOpDelete, "/Photos"));
+    plan.push_back(_MakeItem(kSyncOpDelete, "/PhotosBackup/c.jpg"));
+
+    SyncPlanOptimizer optimizer;
+    int32 saved = optimizer.Optimize(plan);
+
+    // Only the top-level folder delete and the unrelated sibling remain
+    CPPUNIT_ASSERT_EQUAL((int32)3, saved);
+    CPPUNIT_ASSERT_EQUAL((size_t)2, plan.size());
+    CPPUNIT_ASSERT(plan[0].remotePath == "/Photos");
+    CPPUNIT_ASSERT(plan[1].remotePath == "/PhotosBackup/c.jpg");
+}
+
+void SyncEngineTest::TestCollapseSubtreeMove()
+{
+    std::vector<SyncItem> plan;
+    plan.push_back(_MakeItem(kSyncOpMove, "/Archive/Docs", "/Docs"));
+    plan.push_back(_MakeItem(kSyncOpMove, "/Archive/Docs/a.txt", "/Docs/a.txt"));
+    plan.push_back(_MakeItem(kSyncOpMove, "/Elsewhere/b.txt", "/Docs/b.txt"));
+
+    SyncPlanOptimizer optimizer;
+    int32 saved = optimizer.Optimize(plan);
+
+    CPPUNIT_ASSERT_EQUAL((int32)1, saved);
+    CPPUNIT_ASSERT_EQUAL((size_t)2, plan.size());
+
+    // The item that leaves the moved folder is found at its implied path
+    CPPUNIT_ASSERT(plan[1].remotePath == "/Elsewhere/b.txt");
+    CPPUNIT_ASSERT(plan[1].previousPath == "/Archive/Docs/b.txt");
+}
+
+void SyncEngineTest::TestNewTreeParentFirst()
+{
+    std::vector<SyncItem> plan;
+    plan.push_back(_MakeItem(kSyncOpUpload, "/New/Sub/file2"));
+    plan.push_back(_MakeItem(kSyncOpCreateFolder, "/New/Sub"));
+    plan.push_back(_MakeItem(kSyncOpUpload, "/New/file1"));
+    plan.push_back(_MakeItem(kSyncOpCreateFolder, "/New"));
+
+    SyncPlanOptimizer optimizer;
+    CPPUNIT_ASSERT_EQUAL((int32)0, optimizer.Optimize(plan));
+    CPPUNIT_ASSERT_EQUAL((int32)3, optimizer.ChildrenOfNewFolders());
+
+    CPPUNIT_ASSERT(plan[0].remotePath == "/New");
+    CPPUNIT_ASSERT(plan[1].remotePath == "/New/Sub");
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, plan[2].operation);
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, plan[3].operation);
+}
+
+void SyncEngineTest::TestPlanKeepsPathOrder()
+{
+    std::vector<SyncItem> plan;
+    plan.push_back(_MakeItem(kSyncOpDelete, "/Old/x"));
+    plan.push_back(_MakeItem(kSyncOpUpload, "/A"));
+    plan.push_back(_MakeItem(kSyncOpMove, "/New/b", "/b"));
+    plan.push_back(_MakeItem(kSyncOpCreateFolder, "/New"));
+    plan.push_back(_MakeItem(kSyncOpUpload, "/x"));
+    plan.push_back(_MakeItem(kSyncOpDelete, "/x"));
+
+    SyncPlanOptimizer optimizer;
+    CPPUNIT_ASSERT_EQUAL((int32)0, optimizer.Optimize(plan));
+    CPPUNIT_ASSERT_EQUAL((size_t)6, plan.size());
+
+    // The new folder goes just ahead of the move into it, nothing else
+    // changes place, and the upload of /x still precedes its delete
+    CPPUNIT_ASSERT(plan[0].remotePath == "/Old/x");
+    CPPUNIT_ASSERT(plan[1].remotePath == "/A");
+    CPPUNIT_ASSERT_EQUAL(kSyncOpCreateFolder, plan[2].operation);
+    CPPUNIT_ASSERT_EQUAL(kSyncOpMove, plan[3].operation);
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, plan[4].operation);
+    CPPUNIT_ASSERT(plan[4].remotePath == "/x");
+    CPPUNIT_ASSERT_EQUAL(kSyncOpDelete, plan[5].operation);
+    CPPUNIT_ASSERT(plan[5].remotePath == "/x");
+}
+
+void SyncEngineTest::TestIsDescendant()
+{
+    CPPUNIT_ASSERT(SyncPlanOptimizer::IsDescendant("/a/b", "/a"));
+    CPPUNIT_ASSERT(SyncPlanOptimizer::IsDescendant("/a/b/c", "/a"));
+    CPPUNIT_ASSERT(SyncPlanOptimizer::IsDescendant("/a", "/"));
+    CPPUNIT_ASSERT(!SyncPlanOptimizer::IsDescendant("/ab", "/a"));
+    CPPUNIT_ASSERT(!SyncPlanOptimizer::IsDescendant("/a", "/a"));
+}
+
+void SyncEngineTest::TestPathCacheLookup()
+{
+    ItemPathCache cache;
+    BString itemId;
+    BString eTag;
+
+    CPPUNIT_ASSERT_EQUAL(kPathCacheMiss, cache.Lookup("/Docs/a.txt", itemId));
+
+    cache.Insert("/Docs/a.txt", "ID-A", "etag-1");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/Docs/a.txt", itemId, &eTag));
+    CPPUNIT_ASSERT(itemId == "ID-A");
+    CPPUNIT_ASSERT(eTag == "etag-1");
+
+    // Trailing separators share the key
+    cache.Insert("/Docs/", "ID-DOCS");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/Docs", itemId));
+    CPPUNIT_ASSERT(itemId == "ID-DOCS");
+
+    cache.InsertNotFound("/Docs/missing.txt");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheNotFound, cache.Lookup("/Docs/missing.txt", itemId));
+
+    // Expired negative entries fall back to the server
+    cache.SetNegativeTTL(-1);
+    CPPUNIT_ASSERT_EQUAL(kPathCacheMiss, cache.Lookup("/Docs/missing.txt", itemId));
+}
+
+void SyncEngineTest::TestPathCacheInvalidation()
+{
+    ItemPathCache cache;
+    BString itemId;
+    BString path;
+
+    cache.Insert("/Photos", "ID-P");
+    cache.Insert("/Photos/2024", "ID-P24");
+    cache.Insert("/Photos/2024/a.jpg", "ID-A");
+    cache.Insert("/PhotosBackup/b.jpg", "ID-B");
+
+    // A delta result for the folder drops its subtree only
+    cache.InvalidateItem("ID-P24");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheMiss, cache.Lookup("/Photos/2024/a.jpg", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/Photos", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/PhotosBackup/b.jpg", itemId));
+
+    // A move keeps the IDs under the new path
+    cache.Insert("/Photos/2024", "ID-P24");
+    cache.Insert("/Photos/2024/a.jpg", "ID-A");
+    cache.Move("/Photos", "/Archive/Photos");
+
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/Archive/Photos/2024/a.jpg", itemId));
+    CPPUNIT_ASSERT(itemId == "ID-A");
+    CPPUNIT_ASSERT(cache.PathForItem("ID-P24", path));
+    CPPUNIT_ASSERT(path == "/Archive/Photos/2024");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheNotFound, cache.Lookup("/Photos", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheMiss, cache.Lookup("/Photos/2024/a.jpg", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/PhotosBackup/b.jpg", itemId));
+}
+
+void SyncEngineTest::TestPathCacheEviction()
+{
+    ItemPathCache cache(2);
+    BString itemId;
+
+    cache.Insert("/a", "ID-A");
+    cache.Insert("/b", "ID-B");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/a", itemId));
+
+    // "/b" is now least recently used
+    cache.Insert("/c", "ID-C");
+    CPPUNIT_ASSERT_EQUAL(kPathCacheMiss, cache.Lookup("/b", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/a", itemId));
+    CPPUNIT_ASSERT_EQUAL(kPathCacheHit, cache.Lookup("/c", itemId));
+
+    PathCacheStats stats = cache.GetStats();
+    CPPUNIT_ASSERT_EQUAL((int64)3, stats.hits);
+    CPPUNIT_ASSERT_EQUAL((int64)1, stats.misses);
+    CPPUNIT_ASSERT_EQUAL((int64)1, stats.evictions);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.entries);
+
+    BMessage message;
+    CPPUNIT_ASSERT_EQUAL(B_OK, cache.GetStats(message));
+    CPPUNIT_ASSERT_EQUAL(0.75f, message.GetFloat("path_cache_hit_rate", 0.0f));
+}
+
+void SyncEngineTest::TestRetryOrdering()
+{
+    RetryScheduler scheduler;
+    SyncItem network = _MakeItem(kSyncOpUpload, "/network");
+    SyncItem throttled = _MakeItem(kSyncOpUpload, "/throttled");
+
+    bigtime_t now = 1000000000LL;
+    CPPUNIT_ASSERT_EQUAL(kRetryScheduled,
+        scheduler.Schedule(throttled, ONEDRIVE_RATE_LIMITED, now));
+    CPPUNIT_ASSERT_EQUAL(kRetryScheduled,
+        scheduler.Schedule(network, ONEDRIVE_NETWORK_ERROR, now));
+    CPPUNIT_ASSERT_EQUAL((int32)1, network.retryCount);
+
+    // Nothing is eligible before its backoff has elapsed
+    SyncItem item;
+    CPPUNIT_ASSERT(!scheduler.PopReady(now, item));
+    CPPUNIT_ASSERT(scheduler.NextDueTime() > now);
+
+    // Network retries (1-2 s) come due long before throttled ones (15-30 s)
+    CPPUNIT_ASSERT(scheduler.PopReady(now + 2000000LL, item));
+    CPPUNIT_ASSERT(item.remotePath == "/network");
+    CPPUNIT_ASSERT(!scheduler.PopReady(now + 2000000LL, item));
+
+    CPPUNIT_ASSERT(scheduler.PopReady(now + 30000000LL, item));
+    CPPUNIT_ASSERT(item.remotePath == "/throttled");
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)B_INFINITE_TIMEOUT, scheduler.NextDueTime());
+}
+
+void SyncEngineTest::TestRetryBackoff()
+{
+    RetryScheduler scheduler;
+    RetryPolicy policy = { 1000000LL, 8000000LL, 10 };
+    scheduler.SetPolicy(kRetryClassServer, policy);
+
+    for (int32 attempt = 0; attempt < 6; attempt++) {
+        bigtime_t expected = 1000000LL << attempt;
+        if (expected > policy.maxDelay) {
+            expected = policy.maxDelay;
+        }
+
+        for (int32 sample = 0; sample < 20; sample++) {
+            bigtime_t delay = scheduler.ComputeDelay(kRetryClassServer, attempt);
+            CPPUNIT_ASSERT(delay >= expected / 2);
+            CPPUNIT_ASSERT(delay <= expected);
+        }
+    }
+}
+
+void SyncEngineTest::TestRetryParking()
+{
+    RetryScheduler scheduler;
+    scheduler.SetMaxAttempts(2);
+
+    CPPUNIT_ASSERT_EQUAL(kRetryClassPermanent,
+        RetryScheduler::Classify(ONEDRIVE_AUTH_ERROR));
+    CPPUNIT_ASSERT_EQUAL(kRetryClassConflict, RetryScheduler::Classify(B_BUSY));
+    CPPUNIT_ASSERT_EQUAL(kRetryClassServer,
+        RetryScheduler::Classify(ONEDRIVE_SERVER_ERROR));
+
+    // Permanent failures are parked, not scheduled
+    SyncItem quota = _MakeItem(kSyncOpUpload, "/quota");
+    CPPUNIT_ASSERT_EQUAL(kRetryParked,
+        scheduler.Schedule(quota, ONEDRIVE_QUOTA_EXCEEDED, 0));
+    CPPUNIT_ASSERT_EQUAL((int32)0, scheduler.CountScheduled());
+    CPPUNIT_ASSERT_EQUAL((int32)1, scheduler.CountParked());
+
+    // Failure-driven classes honor the retry budget
+    SyncItem server = _MakeItem(kSyncOpUpload, "/server");
+    CPPUNIT_ASSERT_EQUAL(kRetryScheduled,
+        scheduler.Schedule(server, ONEDRIVE_SERVER_ERROR, 0));
+    CPPUNIT_ASSERT_EQUAL(kRetryScheduled,
+        scheduler.Schedule(server, ONEDRIVE_SERVER_ERROR, 0));
+    CPPUNIT_ASSERT_EQUAL(kRetryExhausted,
+        scheduler.Schedule(server, ONEDRIVE_SERVER_ERROR, 0));
+
+    std::vector<SyncItem> released;
+    CPPUNIT_ASSERT_EQUAL((int32)1, scheduler.ReleaseParked(released));
+    CPPUNIT_ASSERT(released[0].remotePath == "/quota");
+    CPPUNIT_ASSERT_EQUAL((int32)0, scheduler.CountParked());
+}
+
+void SyncEngineTest::TestAdaptivePollInterval()
+{
+    const bigtime_t kMin = 5000000LL;
+    const bigtime_t kMax = 300000000LL;
+    AdaptivePoller poller(kMin, kMax);
+
+    // Idle polls back off to the ceiling
+    bigtime_t interval = poller.CurrentInterval();
+    for (int32 i = 0; i < 20; i++) {
+        bigtime_t next = poller.RecordPoll(0);
+        CPPUNIT_ASSERT(next >= interval);
+        interval = next;
+    }
+    CPPUNIT_ASSERT_EQUAL(kMax, interval);
+
+    // Remote activity tightens the cadence and keeps it fast for a while
+    CPPUNIT_ASSERT_EQUAL(kMin, poller.RecordPoll(4));
+    for (int32 i = 0; i < AdaptivePoller::kFastPolls; i++) {
+        CPPUNIT_ASSERT_EQUAL(kMin, poller.RecordPoll(0));
+    }
+    CPPUNIT_ASSERT_EQUAL(2 * kMin, poller.RecordPoll(0));
+
+    CPPUNIT_ASSERT_EQUAL((int32)25, poller.PollCount());
+    CPPUNIT_ASSERT_EQUAL((int32)1, poller.PollHits());
+    CPPUNIT_ASSERT(poller.HitRatio() > 0.039f && poller.HitRatio() < 0.041f);
+
+    // A lower ceiling takes effect immediately
+    poller.SetLimits(kMin, kMin);
+    CPPUNIT_ASSERT_EQUAL(kMin, poller.CurrentInterval());
+}
+
+void SyncEngineTest::TestNotificationProtocol()
+{
+    bool secure;
+    BString host, path, query;
+    uint16 port;
+
+    CPPUNIT_ASSERT(NotificationChannel::ParseUrl(
+        "https://f3hb0mpua.svc.ms/zbaehwg/callback?snthgk=1ff3-2345", secure,
+        host, port, path, query));
+    CPPUNIT_ASSERT(secure);
+    CPPUNIT_ASSERT(host == "f3hb0mpua.svc.ms");
+    CPPUNIT_ASSERT_EQUAL((uint16)443, port);
+    CPPUNIT_ASSERT(path == "/zbaehwg/callback");
+    CPPUNIT_ASSERT(query == "snthgk=1ff3-2345");
+
+    CPPUNIT_ASSERT(NotificationChannel::ParseUrl("http://127.0.0.1:8765",
+        secure, host, port, path, query));
+    CPPUNIT_ASSERT(!secure);
+    CPPUNIT_ASSERT_EQUAL((uint16)8765, port);
+    CPPUNIT_ASSERT(path == "/");
+    CPPUNIT_ASSERT(query.IsEmpty());
+
+    CPPUNIT_ASSERT(!NotificationChannel::ParseUrl("ftp://host/", secure,
+        host, port, path, query));
+    CPPUNIT_ASSERT(!NotificationChannel::ParseUrl("http://host:99999/",
+        secure, host, port, path, query));
+
+    // EIO 3 framing counts characters, not bytes
+    BStringList packets;
+    CPPUNIT_ASSERT_EQUAL((int32)3, NotificationChannel::DecodePayload(
+        "2:403:3ok7:42[\"\xc3\xa9\"]", packets));
+    CPPUNIT_ASSERT(packets.StringAt(0) == "40");
+    CPPUNIT_ASSERT(packets.StringAt(1) == "3ok");
+    CPPUNIT_ASSERT(NotificationChannel::IsEventPacket(packets.StringAt(2)));
+
+    // EIO 4 framing separates packets with a record separator
+    packets.MakeEmpty();
+    CPPUNIT_ASSERT_EQUAL((int32)2, NotificationChannel::DecodePayload(
+        "42/ns,[\"notification\",{\"a\":1}]\x1e" "3", packets));
+    CPPUNIT_ASSERT(packets.StringAt(1) == "3");
+    CPPUNIT_ASSERT(!NotificationChannel::IsEventPacket(packets.StringAt(1)));
+
+    BString sid;
+    bigtime_t pingInterval, pingTimeout;
+    CPPUNIT_ASSERT(NotificationChannel::ParseHandshake(
+        "0{\"sid\":\"abc\",\"upgrades\":[],\"pingInterval\":25000,"
+        "\"pingTimeout\":5000}", sid, pingInterval, pingTimeout));
+    CPPUNIT_ASSERT(sid == "abc");
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)25000000, pingInterval);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)5000000, pingTimeout);
+    CPPUNIT_ASSERT(!NotificationChannel::ParseHandshake("40", sid,
+        pingInterval, pingTimeout));
+}
+
+/**
+ * @brief Minimal socket.io (EIO 3 polling) stand-in server
+ *
+ * Answers the handshake, accepts posted packets, delivers one change
+ * event on the first poll and holds later polls until stopped.
+ */
+struct StandInNotificationServer {
+    int listenSocket;
+    uint16 port;
+    volatile bool quitting;
+    thread_id acceptThread;
+    std::vector<thread_id> connectionThreads;
+    std::vector<int> connectionSockets;
+    BLocker lock;
+    int32 polls;
+    BString posted;
+
+    StandInNotificationServer()
+        : listenSocket(-1), port(0), quitting(false), acceptThread(-1),
+          polls(0)
+    {
+        listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(listenSocket, (sockaddr*)&address, sizeof(address)) == 0
+            && listen(listenSocket, 4) == 0
+            && getsockname(listenSocket, (sockaddr*)&address, &length) == 0) {
+            port = ntohs(address.sin_port);
+            acceptThread = spawn_thread(_AcceptThread, "stand-in accept",
+                B_NORMAL_PRIORITY, this);
+            resume_thread(acceptThread);
+        }
+    }
+
+    ~StandInNotificationServer()
+    {
+        quitting = true;
+        shutdown(listenSocket, SHUT_RDWR);
+        close(listenSocket);
+        status_t exitValue;
+        if (acceptThread >= 0) {
+            wait_for_thread(acceptThread, &exitValue);
+        }
+        for (size_t i = 0; i < connectionThreads.size(); i++) {
+            shutdown(connectionSockets[i], SHUT_RDWR);
+            wait_for_thread(connectionThreads[i], &exitValue);
+            close(connectionSockets[i]);
+        }
+    }
+
+    static int32 _AcceptThread(void* data)
+    {
+        StandInNotificationServer* server
+            = static_cast<StandInNotificationServer*>(data);
+        while (!server->quitting) {
+            int connection = accept(server->listenSocket, NULL, NULL);
+            if (connection < 0) {
+                break;
+            }
+            BAutolock locker(server->lock);
+            server->connectionSockets.push_back(connection);
+            thread_id thread = spawn_thread(_ConnectionThread,
+                "stand-in connection", B_NORMAL_PRIORITY,
+                new Connection(server, connection));
+            server->connectionThreads.push_back(thread);
+            resume_thread(thread);
+        }
+        return 0;
+    }
+
+    struct Connection {
+        Connection(StandInNotificationServer* server, int socket)
+            : server(server), socket(socket) {}
+        StandInNotificationServer* server;
+        int socket;
+    };
+
+    static int32 _ConnectionThread(void* data)
+    {
+        Connection* args = static_cast<Connection*>(data);
+        StandInNotificationServer* server = args->server;
+        int connection = args->socket;
+        delete args;
+
+        BString buffer;
+        char chunk[1024];
+
+        while (!server->quitting) {
+            int32 headerEnd;
+            while ((headerEnd = buffer.FindFirst("\r\n\r\n")) < 0) {
+                ssize_t bytesRead = read(connection, chunk, sizeof(chunk));
+                if (bytesRead <= 0) {
+                    return 0;
+                }
+                buffer.Append(chunk, bytesRead);
+            }
+            BString headers;
+            buffer.CopyInto(headers, 0, headerEnd);
+            buffer.Remove(0, headerEnd + 4);
+
+            int32 contentLength = 0;
+            int32 lengthHeader = headers.FindFirst("Content-Length: ");
+            if (lengthHeader >= 0) {
+                contentLength = atoi(headers.String() + lengthHeader + 16);
+            }
+            while (buffer.Length() < contentLength) {
+                ssize_t bytesRead = read(connection, chunk, sizeof(chunk));
+                if (bytesRead <= 0) {
+                    return 0;
+                }
+                buffer.Append(chunk, bytesRead);
+            }
+            BString body;
+            buffer.CopyInto(body, 0, contentLength);
+            buffer.Remove(0, contentLength);
+
+            BString payload;
+            if (headers.StartsWith("POST")) {
+                BAutolock locker(server->lock);
+                server->posted << body << "\n";
+                payload = "ok";
+            } else if (headers.FindFirst("sid=") < 0) {
+                BString open("0{\"sid\":\"standin\",\"upgrades\":[],"
+                    "\"pingInterval\":25000,\"pingTimeout\":5000}");
+                payload << open.Length() << ":" << open << "2:40";
+            } else {
+                int32 poll;
+                {
+                    BAutolock locker(server->lock);
+                    poll = ++server->polls;
+                }
+                if (poll == 1) {
+                    BString event("42/notifications,[\"notification\","
+                        "{\"clientState\":null}]");
+                    payload << event.Length() << ":" << event;
+                } else {
+                    while (!server->quitting) {
+                        snooze(20000);
+                    }
+                    payload = "1:6";
+                }
+            }
+
+            BString response("HTTP/1.1 200 OK\r\n");
+            response << "Content-Type: text/plain; charset=UTF-8\r\n";
+            response << "Content-Length: " << payload.Length() << "\r\n\r\n";
+            response << payload;
+            if (send(connection, response.String(), response.Length(),
+                    MSG_NOSIGNAL) < 0) {
+                return 0;
+            }
+        }
+        return 0;
+    }
+};
+
+void SyncEngineTest::TestNotificationStandIn()
+{
+    StandInNotificationServer server;
+    CPPUNIT_ASSERT(server.port != 0);
+
+    BString url("http://127.0.0.1:");
+    url << server.port << "/notifications?token=standin";
+
+    NotificationChannel channel(NULL, BMessenger());
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, channel.Start(url));
+
+    bigtime_t deadline = system_time() + 5000000LL;
+    while (channel.GetStats().notifications == 0
+        && system_time() < deadline) {
+        snooze(10000);
+    }
+
+    NotificationChannelStats stats = channel.GetStats();
+    CPPUNIT_ASSERT(stats.connected);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.connects);
+    CPPUNIT_ASSERT_EQUAL((int32)0, stats.failures);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.notifications);
+    {
+        BAutolock locker(server.lock);
+        CPPUNIT_ASSERT(server.posted.FindFirst("40/notifications,") >= 0);
+    }
+
+    // The held poll does not delay stopping
+    bigtime_t stopStart = system_time();
+    channel.Stop();
+    CPPUNIT_ASSERT(system_time() - stopStart < 2000000LL);
+    CPPUNIT_ASSERT(!channel.IsConnected());
+}
+
+/**
+ * @brief Fake delta source: pages "1".."count", each with "page" items
+ */
+static status_t
+FakeFetchPage(const BString& token, BString& page, BString& nextToken,
+    BString& deltaToken, int32 count)
+{
+    snooze(20000);
+    int32 number = token.IsEmpty() ? 1 : atoi(token.String());
+    page.SetTo("");
+    page << number;
+    nextToken.SetTo("");
+    if (number < count) {
+        nextToken << number + 1;
+    } else {
+        deltaToken = "final";
+    }
+    return B_OK;
+}
+
+static status_t
+FakeParsePage(const BString& page, BList& items)
+{
+    snooze(20000);
+    int32 number = atoi(page.String());
+    for (int32 i = 0; i < number; i++) {
+        OneDriveItem* item = new OneDriveItem();
+        item->name = page;
+        items.AddItem(item);
+    }
+    return B_OK;
+}
+
+void SyncEngineTest::TestDeltaPipelineOrder()
+{
+    const int32 kPages = 6;
+    std::vector<int32> applied;
+
+    DeltaPipeline pipeline(
+        [](const BString& token, BString& page, BString& nextToken,
+            BString& deltaToken) -> status_t {
+            return FakeFetchPage(token, page, nextToken, deltaToken, kPages);
+        },
+        FakeParsePage,
+        [&applied](const BList& items) -> status_t {
+            snooze(20000);
+            applied.push_back(items.CountItems());
+            return B_OK;
+        }, 2);
+
+    BString deltaToken;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, pipeline.Run("", deltaToken));
+    CPPUNIT_ASSERT(deltaToken == "final");
+
+    // Pages arrive whole and in order
+    CPPUNIT_ASSERT_EQUAL((size_t)kPages, applied.size());
+    for (int32 i = 0; i < kPages; i++) {
+        CPPUNIT_ASSERT_EQUAL(i + 1, applied[i]);
+    }
+
+    DeltaPipelineStats stats = pipeline.Stats();
+    CPPUNIT_ASSERT_EQUAL(kPages, stats.pages);
+    CPPUNIT_ASSERT_EQUAL((int32)(kPages * (kPages + 1) / 2), stats.items);
+
+    // Stages overlapped: the run took less than their combined work
+    bigtime_t work = stats.busy[kDeltaStageFetch]
+        + stats.busy[kDeltaStageParse] + stats.busy[kDeltaStageApply];
+    CPPUNIT_ASSERT(stats.busy[kDeltaStageFetch] >= kPages * 20000);
+    CPPUNIT_ASSERT(stats.elapsed < work);
+}
+
+void SyncEngineTest::TestDeltaPipelineError()
+{
+    int32 appliedPages = 0;
+    int32 fetchedPages = 0;
+
+    DeltaPipeline pipeline(
+        [&fetchedPages](const BString& token, BString& page,
+            BString& nextToken, BString& deltaToken) -> status_t {
+            fetchedPages++;
+            return FakeFetchPage(token, page, nextToken, deltaToken, 100);
+        },
+        [](const BString& page, BList& items) -> status_t {
+            if (page == "3") {
+                return B_BAD_DATA;
+            }
+            return FakeParsePage(page, items);
+        },
+        [&appliedPages](const BList& items) -> status_t {
+            appliedPages++;
+            return B_OK;
+        });
+
+    BString deltaToken("unchanged");
+    CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_DATA,
+        pipeline.Run("", deltaToken));
+    CPPUNIT_ASSERT(deltaToken == "unchanged");
+
+    // Pages parsed before the error may or may not reach apply
+    CPPUNIT_ASSERT(appliedPages <= 2);
+
+    // Bounded buffers keep the fetch stage from running far ahead
+    CPPUNIT_ASSERT(fetchedPages <= 3 + 2 * DeltaPipeline::kDefaultDepth + 1);
+}
+
+/**
+ * @brief Fake remote tree: folder "r" and every folder with an ID shorter
+ *        than four characters has subfolders ID+"0".."2"; each folder has
+ *        one file ID+"f"
+ */
+static status_t
+FakeListFolder(const BString& folderId, BList& items, int32* active,
+    int32* peak)
+{
+    int32 running = atomic_add(active, 1) + 1;
+    int32 seen = *peak;
+    while (running > seen && atomic_test_and_set(peak, running, seen) != seen) {
+        seen = *peak;
+    }
+    snooze(5000);
+    atomic_add(active, -1);
+
+    const char* suffixes = "012f";
+    int32 count = folderId.Length() < 4 ? 4 : 1;
+    for (int32 i = 4 - count; i < 4; i++) {
+        OneDriveItem* item = new OneDriveItem();
+        item->id = folderId;
+        item->id << suffixes[i];
+        item->name.SetTo("n");
+        item->name << suffixes[i];
+        item->type = suffixes[i] == 'f' ? ITEM_TYPE_FILE : ITEM_TYPE_FOLDER;
+        items.AddItem(item);
+    }
+    return B_OK;
+}
+
+void SyncEngineTest::TestRemoteCrawler()
+{
+    int32 active = 0;
+    int32 peak = 0;
+    int32 applying = 0;
+    bool overlapped = false;
+    std::vector<OneDriveItem> applied;
+
+    RemoteCrawler crawler(
+        [&active, &peak](const BString& folderId, BList& items) -> status_t {
+            return FakeListFolder(folderId, items, &active, &peak);
+        },
+        [&](const BList& items) -> status_t {
+            if (atomic_add(&applying, 1) != 0) {
+                overlapped = true;
+            }
+            for (int32 i = 0; i < items.CountItems(); i++) {
+                applied.push_back(
+                    *static_cast<OneDriveItem*>(items.ItemAt(i)));
+            }
+            atomic_add(&applying, -1);
+            return B_OK;
+        }, 4);
+
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, crawler.Run("r", "/"));
+
+    // 1 + 3 + 9 + 27 folders, each listing one file besides its subfolders
+    RemoteCrawlStats stats = crawler.Stats();
+    CPPUNIT_ASSERT_EQUAL((int32)40, stats.folders);
+    CPPUNIT_ASSERT_EQUAL((int32)79, stats.items);
+    CPPUNIT_ASSERT_EQUAL((size_t)79, applied.size());
+    CPPUNIT_ASSERT(stats.itemsPerSecond > 0);
+
+    // "r01f" is "/n0/n1/nf" below "r01"
+    for (size_t i = 0; i < applied.size(); i++) {
+        const OneDriveItem& item = applied[i];
+        BString parentId(item.id);
+        parentId.Truncate(parentId.Length() - 1);
+        CPPUNIT_ASSERT(item.parentId == parentId);
+
+        BString path;
+        for (int32 j = 1; j < item.id.Length(); j++) {
+            path << "/n" << item.id[j];
+        }
+        CPPUNIT_ASSERT(item.path == path);
+    }
+
+    // Folders were listed in parallel, changes applied one batch at a time
+    CPPUNIT_ASSERT(peak > 1 && peak <= 4);
+    CPPUNIT_ASSERT(!overlapped);
+}
+
+void SyncEngineTest::TestRemoteCrawlerFrontier()
+{
+    int32 active = 0;
+    int32 peak = 0;
+    int32 appliedItems = 0;
+
+    RemoteCrawler bounded(
+        [&active, &peak](const BString& folderId, BList& items) -> status_t {
+            return FakeListFolder(folderId, items, &active, &peak);
+        },
+        [&appliedItems](const BList& items) -> status_t {
+            appliedItems += items.CountItems();
+            return B_OK;
+        }, 3, 2);
+
+    // A full frontier turns workers depth first instead of dropping folders
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, bounded.Run("r", "/"));
+    RemoteCrawlStats stats = bounded.Stats();
+    CPPUNIT_ASSERT_EQUAL((int32)79, appliedItems);
+    CPPUNIT_ASSERT(stats.peakFrontier <= 2);
+    CPPUNIT_ASSERT(stats.inlineFolders > 0);
+
+    RemoteCrawler failing(
+        [&active, &peak](const BString& folderId, BList& items) -> status_t {
+            if (folderId == "r1") {
+                return B_IO_ERROR;
+            }
+            return FakeListFolder(folderId, items, &active, &peak);
+        },
+        [](const BList& items) -> status_t {
+            return B_OK;
+        }, 3);
+
+    CPPUNIT_ASSERT_EQUAL((status_t)B_IO_ERROR, failing.Run("r", "/"));
+    CPPUNIT_ASSERT(failing.Stats().folders < 40);
+}
+
+/**
+ * @brief Build a delta-style item
+ */
+static OneDriveItem
+MakeRemoteItem(const char* id, const char* parentId, const char* name,
+    OneDriveItemType type = ITEM_TYPE_FILE, bool deleted = false)
+{
+    OneDriveItem item;
+    item.id = id;
+    item.parentId = parentId;
+    item.name = name;
+    item.type = type;
+    item.size = type == ITEM_TYPE_FILE ? 100 : 0;
+    item.deleted = deleted;
+    return item;
+}
+
+void SyncEngineTest::TestRemoteTreeIndex()
+{
+    RemoteTreeIndex index;
+    index.Apply(MakeRemoteItem("R", "", ""));
+    index.Apply(MakeRemoteItem("A", "R", "Docs", ITEM_TYPE_FOLDER));
+    index.Apply(MakeRemoteItem("B", "A", "Work", ITEM_TYPE_FOLDER));
+    index.Apply(MakeRemoteItem("C", "B", "report.txt"));
+    index.Apply(MakeRemoteItem("D", "root", "notes.txt"));
+    CPPUNIT_ASSERT_EQUAL((int32)4, index.CountItems());
+
+    OneDriveItem item;
+    CPPUNIT_ASSERT(index.FindById("C", item));
+    CPPUNIT_ASSERT(item.path == "/Docs/Work/report.txt");
+    CPPUNIT_ASSERT(item.parentId == "B");
+    CPPUNIT_ASSERT_EQUAL((off_t)100, item.size);
+
+    // The alias and the real root ID are the same node
+    CPPUNIT_ASSERT(index.FindById("D", item));
+    CPPUNIT_ASSERT(item.parentId == "R");
+    CPPUNIT_ASSERT(index.FindById("root", item));
+    CPPUNIT_ASSERT(item.path == "/");
+
+    // Paths compare like OneDrive, without case
+    CPPUNIT_ASSERT(index.FindByPath("/docs/WORK/Report.TXT", item));
+    CPPUNIT_ASSERT(item.id == "C");
+    CPPUNIT_ASSERT(!index.FindByPath("/Docs/report.txt", item));
+
+    // Moving a folder moves its subtree without touching it
+    index.Apply(MakeRemoteItem("B", "R", "Archive", ITEM_TYPE_FOLDER));
+    BString path;
+    CPPUNIT_ASSERT(index.GetPath("C", path));
+    CPPUNIT_ASSERT(path == "/Archive/report.txt");
+    CPPUNIT_ASSERT(!index.FindByPath("/Docs/Work", item));
+
+    BList children;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, index.GetChildren("root", children));
+    CPPUNIT_ASSERT_EQUAL((int32)3, children.CountItems());
+    for (int32 i = 0; i < children.CountItems(); i++) {
+        delete static_cast<OneDriveItem*>(children.ItemAt(i));
+    }
+
+    // A folder cannot become its own descendant
+    index.Apply(MakeRemoteItem("B", "C", "Loop", ITEM_TYPE_FOLDER));
+    CPPUNIT_ASSERT(index.GetPath("B", path));
+    CPPUNIT_ASSERT(path == "/Archive");
+
+    // Deleting a folder drops everything below it
+    index.Apply(MakeRemoteItem("B", "R", "Archive", ITEM_TYPE_FOLDER, true));
+    CPPUNIT_ASSERT(!index.FindById("C", item));
+    CPPUNIT_ASSERT(!index.FindByPath("/Archive", item));
+    CPPUNIT_ASSERT_EQUAL((int32)2, index.CountItems());
+
+    index.MakeEmpty();
+    CPPUNIT_ASSERT_EQUAL((int32)0, index.CountItems());
+    CPPUNIT_ASSERT(!index.FindById("A", item));
+}
+
+void SyncEngineTest::TestRemoteTreeIndexPlaceholders()
+{
+    RemoteTreeIndex index;
+
+    // Children first: the parents wait as placeholders
+    index.Apply(MakeRemoteItem("F", "E", "photo.jpg"));
+    index.Apply(MakeRemoteItem("E", "R", "Pictures", ITEM_TYPE_FOLDER));
+    index.Apply(MakeRemoteItem("G", "R", "todo.txt"));
+
+    RemoteTreeStats stats = index.GetStats();
+    CPPUNIT_ASSERT_EQUAL((int32)3, stats.items);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.placeholders);
+
+    OneDriveItem item;
+    CPPUNIT_ASSERT(index.FindById("F", item));
+    CPPUNIT_ASSERT(item.path.IsEmpty());
+
+    // The root arrives last and takes over its placeholder's children
+    index.Apply(MakeRemoteItem("R", "", ""));
+    stats = index.GetStats();
+    CPPUNIT_ASSERT_EQUAL((int32)3, stats.items);
+    CPPUNIT_ASSERT_EQUAL((int32)0, stats.placeholders);
+    CPPUNIT_ASSERT(index.FindByPath("/Pictures/photo.jpg", item));
+    CPPUNIT_ASSERT(item.id == "F");
+    CPPUNIT_ASSERT(index.FindById("R", item));
+    CPPUNIT_ASSERT(item.path == "/");
+}
+
+void SyncEngineTest::TestRemoteTreeIndexScale()
+{
+    // 100 folders of 1000 files with OneDrive-sized IDs and shared names
+    const int32 kFolders = 100;
+    const int32 kFiles = 1000;
+    RemoteTreeIndex index;
+    char id[32];
+    char parentId[32];
+    char name[32];
+
+    for (int32 folder = 0; folder < kFolders; folder++) {
+        snprintf(parentId, sizeof(parentId), "D4648F06C91D9D3D!%05d", folder);
+        snprintf(name, sizeof(name), "Folder %d", folder);
+        index.Apply(MakeRemoteItem(parentId, "root", name, ITEM_TYPE_FOLDER));
+        for (int32 file = 0; file < kFiles; file++) {
+            snprintf(id, sizeof(id), "D4648F06C91D9D3D!%d", 100000
+                + folder * kFiles + file);
+            snprintf(name, sizeof(name), "IMG_%04d.JPG", file);
+            index.Apply(MakeRemoteItem(id, parentId, name));
+        }
+    }
+
+    RemoteTreeStats stats = index.GetStats();
+    CPPUNIT_ASSERT_EQUAL(kFolders * (kFiles + 1), stats.items);
+    CPPUNIT_ASSERT(stats.memoryUsage / stats.items < 100);
+
+    OneDriveItem item;
+    CPPUNIT_ASSERT(index.FindByPath("/Folder 42/img_0999.jpg", item));
+    CPPUNIT_ASSERT(item.id == "D4648F06C91D9D3D!142999");
+
+    // Deleting most of the tree reclaims its IDs
+    for (int32 folder = 0; folder < kFolders - 1; folder++) {
+        snprintf(id, sizeof(id), "D4648F06C91D9D3D!%05d", folder);
+        index.Apply(MakeRemoteItem(id, "root", "", ITEM_TYPE_FOLDER, true));
+    }
+    stats = index.GetStats();
+    CPPUNIT_ASSERT_EQUAL(kFiles + 1, stats.items);
+    CPPUNIT_ASSERT(stats.stringBytes < (size_t)(kFiles + 1) * 64);
+    CPPUNIT_ASSERT(index.FindByPath("/Folder 99/IMG_0000.JPG", item));
+    CPPUNIT_ASSERT(item.id == "D4648F06C91D9D3D!199000");
+}
+
+/**
+ * @brief Fill an index with folders of files
+ */
+static void
+FillRemoteTree(RemoteTreeIndex& index, int32 folders, int32 files)
+{
+    char id[32];
+    char parentId[32];
+    char name[32];
+
+    index.Apply(MakeRemoteItem("R", "", ""));
+    for (int32 folder = 0; folder < folders; folder++) {
+        snprintf(parentId, sizeof(parentId), "D4648F06C91D9D3D!%05d", folder);
+        snprintf(name, sizeof(name), "Folder %d", folder);
+        index.Apply(MakeRemoteItem(parentId, "R", name, ITEM_TYPE_FOLDER));
+        for (int32 file = 0; file < files; file++) {
+            snprintf(id, sizeof(id), "D4648F06C91D9D3D!%d",
+                100000 + folder * files + file);
+            snprintf(name, sizeof(name), "IMG_%04d.JPG", file);
+            index.Apply(MakeRemoteItem(id, parentId, name));
+        }
+    }
+}
+
+void SyncEngineTest::TestRemoteTreeSnapshot()
+{
+    const char* kSnapshot = "/tmp/onedrive_remote_tree_test";
+    const int32 kFolders = 100;
+    const int32 kFiles = 500;
+
+    RemoteTreeIndex original;
+    FillRemoteTree(original, kFolders, kFiles);
+    size_t builtMemory = original.GetStats().memoryUsage;
+
+    CPPUNIT_ASSERT(original.IsModified());
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK,
+        original.WriteSnapshot(kSnapshot, "token_42"));
+    CPPUNIT_ASSERT(!original.IsModified());
+
+    RemoteTreeIndex mapped;
+    BString token;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, mapped.MapSnapshot(kSnapshot, token));
+    OneDriveItem item;
+    CPPUNIT_ASSERT(mapped.FindByPath("/Folder 7/IMG_0123.JPG", item));
+
+    // Ready without rebuilding: lookups read the mapping directly
+    CPPUNIT_ASSERT(token == "token_42");
+    CPPUNIT_ASSERT(item.id == "D4648F06C91D9D3D!103623");
+    CPPUNIT_ASSERT(item.parentId == "D4648F06C91D9D3D!00007");
+    RemoteTreeStats stats = mapped.GetStats();
+    CPPUNIT_ASSERT_EQUAL(kFolders * (kFiles + 1), stats.items);
+    CPPUNIT_ASSERT(stats.mappedBytes > 0);
+    CPPUNIT_ASSERT(stats.memoryUsage < stats.mappedBytes / 10);
+    CPPUNIT_ASSERT(stats.memoryUsage < builtMemory / 10);
+    CPPUNIT_ASSERT(!mapped.IsModified());
+
+    // The first change moves the arrays into memory and keeps working
+    mapped.Apply(MakeRemoteItem("D4648F06C91D9D3D!103623",
+        "D4648F06C91D9D3D!00008", "moved.jpg"));
+    stats = mapped.GetStats();
+    CPPUNIT_ASSERT_EQUAL((size_t)0, stats.mappedBytes);
+    CPPUNIT_ASSERT(mapped.IsModified());
+    CPPUNIT_ASSERT(!mapped.FindByPath("/Folder 7/IMG_0123.JPG", item));
+    CPPUNIT_ASSERT(mapped.FindByPath("/Folder 8/MOVED.JPG", item));
+    mapped.Apply(MakeRemoteItem("N", "R", "New", ITEM_TYPE_FOLDER));
+    CPPUNIT_ASSERT_EQUAL(kFolders * (kFiles + 1) + 1, mapped.CountItems());
+
+    // A rewritten snapshot round-trips the change
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK,
+        mapped.WriteSnapshot(kSnapshot, "token_43"));
+    RemoteTreeIndex reloaded;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK,
+        reloaded.MapSnapshot(kSnapshot, token));
+    CPPUNIT_ASSERT(token == "token_43");
+    CPPUNIT_ASSERT(reloaded.FindByPath("/folder 8/moved.jpg", item));
+    CPPUNIT_ASSERT(reloaded.FindById("N", item));
+
+    unlink(kSnapshot);
+}
+
+void SyncEngineTest::TestRemoteTreeSnapshotValidation()
+{
+    const char* kSnapshot = "/tmp/onedrive_remote_tree_test";
+    RemoteTreeIndex index;
+    FillRemoteTree(index, 3, 10);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, index.WriteSnapshot(kSnapshot, "t"));
+
+    BString token;
+    RemoteTreeIndex target;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_ENTRY_NOT_FOUND,
+        target.MapSnapshot("/tmp/onedrive_remote_tree_missing", token));
+
+    // One flipped byte in the node array fails the checksum
+    FILE* file = fopen(kSnapshot, "r+b");
+    CPPUNIT_ASSERT(file != NULL);
+    fseek(file, 200, SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, 200, SEEK_SET);
+    fputc(byte ^ 0x40, file);
+    fclose(file);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_DATA,
+        target.MapSnapshot(kSnapshot, token));
+
+    // Another format version is rebuilt rather than misread
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, index.WriteSnapshot(kSnapshot, "t"));
+    file = fopen(kSnapshot, "r+b");
+    uint32 version = RemoteTreeIndex::kSnapshotVersion + 1;
+    fseek(file, 4, SEEK_SET);
+    fwrite(&version, sizeof(version), 1, file);
+    fclose(file);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_DATA,
+        target.MapSnapshot(kSnapshot, token));
+
+    // Truncation is caught before anything is read past the end
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, index.WriteSnapshot(kSnapshot, "t"));
+    CPPUNIT_ASSERT_EQUAL(0, truncate(kSnapshot, 300));
+    CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_DATA,
+        target.MapSnapshot(kSnapshot, token));
+
+    // A rejected snapshot leaves the index as it was
+    CPPUNIT_ASSERT_EQUAL((int32)0, target.CountItems());
+    unlink(kSnapshot);
+}
+
+void SyncEngineTest::TestSyncQueueRoundTrip()
+{
+    SyncQueue queue;
+    CPPUNIT_ASSERT(queue.IsEmpty());
+
+    SyncItem item = _MakeItem(kSyncOpMove, "/Photos/2024/a.jpg",
+        "/Inbox/a.jpg");
+    item.localPath = "/boot/home/OneDrive/Photos/2024/a.jpg";
+    item.fileId = "D4648F06C91D9D3D!1234";
+    item.parentId = "D4648F06C91D9D3D!12";
+    item.eTag = "\"{5E2D1A3C-0000-4B5D-9B0A-000000000000},3\"";
+    item.localHash = "0123456789abcdef0123456789abcdef"
+        "0123456789abcdef0123456789abcdef";
+    item.remoteHash = "AAECAwQFBgcICQoLDA0ODxAREhM=";
+    item.status = kSyncStatusError;
+    item.errorMessage = "Connection reset";
+    item.retryCount = 2;
+    item.localModified = 1723700000;
+    item.remoteModified = 1723700001;
+    item.size = 5000000000LL;
+    item.isPinned = true;
+    item.priority = kSyncPriorityUser;
+    item.queuedTime = 1723700002000000LL;
+    queue.Push(SyncItem(item));
+
+    SyncItem second = _MakeItem(kSyncOpUpload, "/Photos/2024/b.jpg");
+    second.localPath = "/boot/home/OneDrive/Photos/2024/b.jpg";
+    second.remoteHash = "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709";
+    queue.Push(SyncItem(second));
+    CPPUNIT_ASSERT_EQUAL((int32)2, queue.Count());
+
+    SyncItem result;
+    CPPUNIT_ASSERT(queue.Pop(result));
+    CPPUNIT_ASSERT(result.localPath == item.localPath);
+    CPPUNIT_ASSERT(result.remotePath == item.remotePath);
+    CPPUNIT_ASSERT(result.previousPath == item.previousPath);
+    CPPUNIT_ASSERT(result.fileId == item.fileId);
+    CPPUNIT_ASSERT(result.parentId == item.parentId);
+    CPPUNIT_ASSERT(result.eTag == item.eTag);
+    CPPUNIT_ASSERT(result.localHash == item.localHash);
+    CPPUNIT_ASSERT(result.remoteHash == item.remoteHash);
+    CPPUNIT_ASSERT(result.errorMessage == item.errorMessage);
+    CPPUNIT_ASSERT_EQUAL(kSyncOpMove, result.operation);
+    CPPUNIT_ASSERT_EQUAL(kSyncStatusError, result.status);
+    CPPUNIT_ASSERT_EQUAL((int32)2, result.retryCount);
+    CPPUNIT_ASSERT(result.localModified == item.localModified);
+    CPPUNIT_ASSERT(result.remoteModified == item.remoteModified);
+    CPPUNIT_ASSERT(result.size == item.size);
+    CPPUNIT_ASSERT(result.isPinned);
+    CPPUNIT_ASSERT_EQUAL(kSyncPriorityUser, result.priority);
+    CPPUNIT_ASSERT(result.queuedTime == item.queuedTime);
+
+    // Empty fields stay empty, uppercase hex stays uppercase
+    CPPUNIT_ASSERT(queue.Pop(result));
+    CPPUNIT_ASSERT(result.remotePath == "/Photos/2024/b.jpg");
+    CPPUNIT_ASSERT(result.previousPath.IsEmpty());
+    CPPUNIT_ASSERT(result.fileId.IsEmpty());
+    CPPUNIT_ASSERT(result.localHash.IsEmpty());
+    CPPUNIT_ASSERT(result.remoteHash == second.remoteHash);
+    CPPUNIT_ASSERT(result.errorMessage.IsEmpty());
+    CPPUNIT_ASSERT(!result.isPinned);
+    CPPUNIT_ASSERT(!queue.Pop(result));
+
+    // TakeWindow hands back everything in memory, oldest first
+    queue.Push(_MakeItem(kSyncOpDelete, "/"));
+    queue.Push(_MakeItem(kSyncOpDelete, "/Inbox"));
+    std::vector<SyncItem> all;
+    queue.TakeWindow(all);
+    CPPUNIT_ASSERT(queue.IsEmpty());
+    CPPUNIT_ASSERT_EQUAL((size_t)2, all.size());
+    CPPUNIT_ASSERT(all[0].remotePath == "/");
+    CPPUNIT_ASSERT(all[1].remotePath == "/Inbox");
+}
+
+void SyncEngineTest::TestSyncQueueFootprint()
+{
+    // An initial upload: 100 folders of 1000 files with SHA-256 hashes
+    const int32 kFolders = 100;
+    const int32 kFiles = 1000;
+    SyncQueue queue;
+    size_t baseline = 0;
+    char path[128];
+
+    for (int32 folder = 0; folder < kFolders; folder++) {
+        for (int32 file = 0; file < kFiles; file++) {
+            snprintf(path, sizeof(path), "/Pictures/Camera/%d/IMG_%04d.JPG",
+                folder, file);
+            SyncItem item = _MakeItem(kSyncOpUpload, path);
+            item.localPath = "/boot/home/OneDrive";
+            item.localPath << path;
+            item.localHash.SetToFormat("%056x%08x", 0, folder * kFiles + file);
+            item.size = file;
+
+            // What the same item costs as a SyncItem in a std::queue
+            baseline += sizeof(SyncItem) + item.localPath.Length() + 1
+                + item.remotePath.Length() + 1 + item.localHash.Length() + 1;
+            queue.Push(std::move(item));
+        }
+    }
+
+    CPPUNIT_ASSERT_EQUAL(kFolders * kFiles, queue.Count());
+    size_t perItem = queue.MemoryUsage() / queue.Count();
+    CPPUNIT_ASSERT(perItem * 2 < baseline / queue.Count());
+    size_t filled = queue.MemoryUsage();
+
+    SyncItem item;
+    char expected[128];
+    for (int32 i = 0; i < kFolders * kFiles; i++) {
+        CPPUNIT_ASSERT(queue.Pop(item));
+        if (i % 9973 == 0) {
+            snprintf(expected, sizeof(expected),
+                "/Pictures/Camera/%d/IMG_%04d.JPG", i / kFiles, i % kFiles);
+            CPPUNIT_ASSERT(item.remotePath == expected);
+            CPPUNIT_ASSERT(item.size == i % kFiles);
+
+            // Popping reads the packed records in place
+            CPPUNIT_ASSERT(queue.MemoryUsage() <= filled);
+        }
+    }
+
+    // Draining the queue drops the pool
+    CPPUNIT_ASSERT(queue.IsEmpty());
+    CPPUNIT_ASSERT(queue.MemoryUsage() < 4096);
+}
+
+/**
+ * @brief Remove the files of a queue directory, return how many there were
+ */
+static int32
+ClearQueueDirectory(const char* directory, const char* prefix = "")
+{
+    int32 count = 0;
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        return 0;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.'
+            || strncmp(entry->d_name, prefix, strlen(prefix)) != 0) {
+            continue;
+        }
+        BString path(directory);
+        path << "/" << entry->d_name;
+        unlink(path.String());
+        count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/**
+ * @brief Queue and drain a backlog, checking order; return peak memory
+ */
+static size_t
+RunQueueBacklog(SyncQueue& queue, int32 count)
+{
+    char path[64];
+    size_t peak = 0;
+    for (int32 i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "/Backlog/%d/file_%d", i / 100, i);
+        SyncItem item;
+        item.remotePath = path;
+        item.localPath = path;
+        item.operation = kSyncOpUpload;
+        item.status = kSyncStatusPending;
+        item.localModified = item.remoteModified = 0;
+        item.size = i;
+        item.retryCount = 0;
+        item.isPinned = false;
+        item.priority = kSyncPriorityNormal;
+        item.queuedTime = 0;
+        queue.Push(std::move(item));
+        if (queue.MemoryUsage() > peak) {
+            peak = queue.MemoryUsage();
+        }
+    }
+
+    SyncItem item;
+    for (int32 i = 0; i < count; i++) {
+        if (!queue.Pop(item) || item.size != i) {
+            return 0;
+        }
+        if (queue.MemoryUsage() > peak) {
+            peak = queue.MemoryUsage();
+        }
+    }
+    return queue.IsEmpty() ? peak : 0;
+}
+
+void SyncEngineTest::TestSyncQueueSpill()
+{
+    const char* kDirectory = "/tmp/onedrive_queue_test";
+    ClearQueueDirectory(kDirectory);
+
+    SyncQueue queue(100);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Open(kDirectory));
+
+    // Everything past the window goes to disk and comes back in order
+    char path[64];
+    for (int32 i = 0; i < 1000; i++) {
+        snprintf(path, sizeof(path), "/Spill/file_%d", i);
+        queue.Push(_MakeItem(kSyncOpUpload, path));
+    }
+    CPPUNIT_ASSERT_EQUAL((int32)1000, queue.Count());
+    CPPUNIT_ASSERT_EQUAL((int32)900, queue.CountSpilled());
+
+    SyncItem item;
+    for (int32 i = 0; i < 1000; i++) {
+        CPPUNIT_ASSERT(queue.Pop(item));
+        snprintf(path, sizeof(path), "/Spill/file_%d", i);
+        CPPUNIT_ASSERT(item.remotePath == path);
+    }
+    CPPUNIT_ASSERT(queue.IsEmpty());
+    CPPUNIT_ASSERT(!queue.Pop(item));
+
+    // Read segments go once a save no longer needs them
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Save());
+    CPPUNIT_ASSERT_EQUAL((int32)0, ClearQueueDirectory(kDirectory, "segment."));
+
+    // Peak memory does not grow with the backlog
+    size_t small = RunQueueBacklog(queue, 2000);
+    size_t large = RunQueueBacklog(queue, 100000);
+    CPPUNIT_ASSERT(small > 0 && large > 0);
+    CPPUNIT_ASSERT(large < small + 16 * 1024);
+
+    ClearQueueDirectory(kDirectory);
+}
+
+void SyncEngineTest::TestSyncQueueRestart()
+{
+    const char* kDirectory = "/tmp/onedrive_queue_test";
+    ClearQueueDirectory(kDirectory);
+    char path[64];
+    SyncItem item;
+
+    {
+        SyncQueue queue(100);
+        CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Open(kDirectory));
+        for (int32 i = 0; i < 1000; i++) {
+            snprintf(path, sizeof(path), "/Restart/file_%d", i);
+            queue.Push(_MakeItem(kSyncOpUpload, path));
+        }
+        for (int32 i = 0; i < 250; i++) {
+            CPPUNIT_ASSERT(queue.Pop(item));
+        }
+        CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Save());
+
+        // Taken after the save: handed out again after a crash
+        for (int32 i = 0; i < 50; i++) {
+            CPPUNIT_ASSERT(queue.Pop(item));
+        }
+    }
+
+    // A spill write torn by the crash is cut off
+    DIR* dir = opendir(kDirectory);
+    CPPUNIT_ASSERT(dir != NULL);
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "segment.", 8) == 0) {
+            BString segment(kDirectory);
+            segment << "/" << entry->d_name;
+            FILE* file = fopen(segment.String(), "ab");
+            fwrite("\x40\x00\x00\x00torn", 8, 1, file);
+            fclose(file);
+        }
+    }
+    closedir(dir);
+
+    SyncQueue queue(100);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Open(kDirectory));
+    CPPUNIT_ASSERT_EQUAL((int32)750, queue.Count());
+
+    snprintf(path, sizeof(path), "/Restart/file_%d", 1000);
+    queue.Push(_MakeItem(kSyncOpUpload, path));
+    for (int32 i = 250; i <= 1000; i++) {
+        CPPUNIT_ASSERT(queue.Pop(item));
+        snprintf(path, sizeof(path), "/Restart/file_%d", i);
+        CPPUNIT_ASSERT(item.remotePath == path);
+    }
+    CPPUNIT_ASSERT(queue.IsEmpty());
+
+    ClearQueueDirectory(kDirectory);
+}
+
+void SyncEngineTest::TestSyncQueueRefillCrash()
+{
+    const char* kDirectory = "/tmp/onedrive_queue_test";
+    ClearQueueDirectory(kDirectory);
+    char path[64];
+    SyncItem item;
+
+    {
+        SyncQueue queue(100);
+        CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Open(kDirectory));
+        for (int32 i = 0; i < 1000; i++) {
+            snprintf(path, sizeof(path), "/Refill/file_%d", i);
+            queue.Push(_MakeItem(kSyncOpUpload, path));
+        }
+        CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Save());
+
+        // Drain through every refill, then crash before the next save
+        for (int32 i = 0; i < 1000; i++) {
+            CPPUNIT_ASSERT(queue.Pop(item));
+        }
+        CPPUNIT_ASSERT(queue.IsEmpty());
+    }
+
+    // The saved window still finds the spilled operations behind it
+    SyncQueue queue(100);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, queue.Open(kDirectory));
+    CPPUNIT_ASSERT_EQUAL((int32)1000, queue.Count());
+    for (int32 i = 0; i < 1000; i++) {
+        CPPUNIT_ASSERT(queue.Pop(item));
+        snprintf(path, sizeof(path), "/Refill/file_%d", i);
+        CPPUNIT_ASSERT(item.remotePath == path);
+    }
+
+    ClearQueueDirectory(kDirectory);
+}
+
+void SyncEngineTest::TestSchedulerLanes()
+{
+    const off_t kMB = 1024 * 1024;
+    SyncScheduler scheduler(1000);
+    scheduler.SetLargeShare(0.0f);
+
+    SyncItem large = _MakeItem(kSyncOpUpload, "/Images/haiku.iso");
+    large.size = 700 * kMB;
+    SyncItem small = _MakeItem(kSyncOpUpload, "/Docs/letter.txt");
+    small.size = 4096;
+    SyncItem user = _MakeItem(kSyncOpDownload, "/Docs/report.pdf");
+    user.size = 2 * kMB;
+    user.priority = kSyncPriorityUser;
+    SyncItem remove = _MakeItem(kSyncOpDelete, "/Images/old.iso");
+    remove.size = 700 * kMB;
+
+    // Deletes are cheap whatever the size; user requests go first
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneLarge, scheduler.LaneFor(large));
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneSmall, scheduler.LaneFor(small));
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneUser, scheduler.LaneFor(user));
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneSmall, scheduler.LaneFor(remove));
+
+    scheduler.Push(SyncItem(large), 0);
+    scheduler.Push(SyncItem(small), 0);
+    scheduler.Push(SyncItem(remove), 0);
+    scheduler.Push(SyncItem(user), 0);
+    CPPUNIT_ASSERT_EQUAL((int32)4, scheduler.Count());
+
+    SyncItem item;
+    CPPUNIT_ASSERT(scheduler.Pop(0, item));
+    CPPUNIT_ASSERT(item.remotePath == "/Docs/report.pdf");
+    CPPUNIT_ASSERT(scheduler.Pop(0, item));
+    CPPUNIT_ASSERT(item.remotePath == "/Docs/letter.txt");
+    CPPUNIT_ASSERT(scheduler.Pop(0, item));
+    CPPUNIT_ASSERT(item.remotePath == "/Images/old.iso");
+    CPPUNIT_ASSERT(scheduler.Pop(0, item));
+    CPPUNIT_ASSERT(item.remotePath == "/Images/haiku.iso");
+    CPPUNIT_ASSERT(!scheduler.Pop(0, item));
+    CPPUNIT_ASSERT(scheduler.IsEmpty());
+
+    SyncLaneStats stats = scheduler.LaneStats(kSyncLaneSmall);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.dispatched);
+    CPPUNIT_ASSERT(stats.dispatchedBytes == 4096);
+
+    // With a reserved share, large transfers run between small ones
+    // whenever they fell below their share of the bytes
+    SyncScheduler shared(1000);
+    shared.SetLargeShare(0.5f);
+    char path[64];
+    for (int32 i = 0; i < 10; i++) {
+        snprintf(path, sizeof(path), "/Docs/file_%d", i);
+        SyncItem document = _MakeItem(kSyncOpUpload, path);
+        document.size = kMB;
+        shared.Push(std::move(document), 0);
+    }
+    for (int32 i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "/Images/disk_%d.iso", i);
+        SyncItem image = _MakeItem(kSyncOpUpload, path);
+        image.size = 16 * kMB;
+        shared.Push(std::move(image), 0);
+    }
+
+    int32 order[12];
+    for (int32 i = 0; i < 12; i++) {
+        CPPUNIT_ASSERT(shared.Pop(0, item));
+        order[i] = shared.LaneFor(item);
+    }
+    CPPUNIT_ASSERT_EQUAL((int32)kSyncLaneSmall, order[0]);
+    CPPUNIT_ASSERT_EQUAL((int32)kSyncLaneLarge, order[1]);
+    CPPUNIT_ASSERT_EQUAL((int32)kSyncLaneSmall, order[2]);
+    for (int32 i = 3; i < 11; i++) {
+        CPPUNIT_ASSERT_EQUAL((int32)kSyncLaneSmall, order[i]);
+    }
+    CPPUNIT_ASSERT_EQUAL((int32)kSyncLaneLarge, order[11]);
+
+    stats = shared.LaneStats(kSyncLaneLarge);
+    CPPUNIT_ASSERT_EQUAL((int32)0, stats.queued);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.dispatched);
+    CPPUNIT_ASSERT(stats.dispatchedBytes == 32 * kMB);
+}
+
+void SyncEngineTest::TestSchedulerAging()
+{
+    const bigtime_t kSecond = 1000000LL;
+    SyncScheduler scheduler(1000);
+    scheduler.SetLargeShare(0.0f);
+    scheduler.SetAgingInterval(kSecond);
+
+    SyncItem large = _MakeItem(kSyncOpDownload, "/Video/talk.mkv");
+    large.size = 2000LL * 1024 * 1024;
+    scheduler.Push(std::move(large), 0);
+
+    // A steady stream of small files would starve the large lane; after
+    // waiting longer than one interval per lane of priority, it goes next
+    SyncItem item;
+    char path[64];
+    bigtime_t now = 0;
+    int32 smallBefore = 0;
+    while (true) {
+        snprintf(path, sizeof(path), "/Docs/note_%d.txt", (int)smallBefore);
+        SyncItem note = _MakeItem(kSyncOpUpload, path);
+        note.size = 512;
+        scheduler.Push(std::move(note), now);
+
+        CPPUNIT_ASSERT(scheduler.Pop(now, item));
+        if (item.remotePath == "/Video/talk.mkv") {
+            break;
+        }
+        smallBefore++;
+        now += kSecond / 4;
+        CPPUNIT_ASSERT(smallBefore < 100);
+    }
+
+    // Score of the large lane passes the small lane's weight after 1s
+    CPPUNIT_ASSERT_EQUAL((int32)5, smallBefore);
+
+    SyncLaneStats stats = scheduler.LaneStats(kSyncLaneLarge);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.dispatched);
+    CPPUNIT_ASSERT(stats.averageWait == now);
+    CPPUNIT_ASSERT(stats.maxWait == now);
+
+    stats = scheduler.LaneStats(kSyncLaneSmall);
+    CPPUNIT_ASSERT_EQUAL((int32)5, stats.dispatched);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.queued);
+    CPPUNIT_ASSERT(stats.averageWait == 0);
+    CPPUNIT_ASSERT(strcmp(SyncScheduler::LaneName(kSyncLaneLarge), "large") == 0);
+}
+
+void SyncEngineTest::TestSchedulerParentFirst()
+{
+    const bigtime_t kSecond = 1000000LL;
+    SyncScheduler scheduler(1000);
+    scheduler.SetAgingInterval(kSecond);
+
+    // Files seen before their folders, which then wait in a window long
+    // enough for the small lane to age past any weight
+    SyncItem image = _MakeItem(kSyncOpUpload, "/New/Sub/disk.iso");
+    image.size = 700LL * 1024 * 1024;
+    scheduler.Push(std::move(image), 0);
+    SyncItem note = _MakeItem(kSyncOpUpload, "/New/note.txt");
+    note.size = 512;
+    scheduler.Push(std::move(note), 0);
+    scheduler.Push(_MakeItem(kSyncOpCreateFolder, "/New/Sub"), 5 * kSecond);
+    scheduler.Push(_MakeItem(kSyncOpCreateFolder, "/New"), 5 * kSecond);
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneUser,
+        scheduler.LaneFor(_MakeItem(kSyncOpCreateFolder, "/New")));
+
+    std::vector<SyncItem> plan;
+    scheduler.TakeWindow(plan);
+    SyncPlanOptimizer optimizer;
+    optimizer.Optimize(plan);
+    scheduler.RestoreWindow(plan);
+
+    SyncItem item;
+    CPPUNIT_ASSERT(scheduler.Pop(60 * kSecond, item));
+    CPPUNIT_ASSERT(item.remotePath == "/New");
+    CPPUNIT_ASSERT(scheduler.Pop(60 * kSecond, item));
+    CPPUNIT_ASSERT(item.remotePath == "/New/Sub");
+    CPPUNIT_ASSERT(scheduler.Pop(60 * kSecond, item));
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, item.operation);
+    CPPUNIT_ASSERT(scheduler.Pop(60 * kSecond, item));
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, item.operation);
+    CPPUNIT_ASSERT(scheduler.IsEmpty());
+}
+
+void SyncEngineTest::TestSchedulerSamePathOrder()
+{
+    SyncScheduler scheduler(1000);
+    scheduler.SetLargeShare(0.0f);
+
+    // The delete alone would take the small lane and overtake the upload
+    SyncItem upload = _MakeItem(kSyncOpUpload, "/Images/disk.iso");
+    upload.size = 16LL * 1024 * 1024;
+    scheduler.Push(std::move(upload), 1);
+    SyncItem note = _MakeItem(kSyncOpUpload, "/Docs/note.txt");
+    note.size = 512;
+    scheduler.Push(std::move(note), 2);
+    SyncItem remove = _MakeItem(kSyncOpDelete, "/Images/disk.iso");
+    remove.size = 16LL * 1024 * 1024;
+    CPPUNIT_ASSERT_EQUAL(kSyncLaneSmall, scheduler.LaneFor(remove));
+    scheduler.Push(std::move(remove), 3);
+    CPPUNIT_ASSERT_EQUAL((int32)2, scheduler.LaneStats(kSyncLaneLarge).queued);
+
+    // The window comes out in queue order, and goes back pinned
+    std::vector<SyncItem> plan;
+    scheduler.TakeWindow(plan);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, plan.size());
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, plan[0].operation);
+    CPPUNIT_ASSERT(plan[0].remotePath == "/Images/disk.iso");
+    CPPUNIT_ASSERT(plan[1].remotePath == "/Docs/note.txt");
+    CPPUNIT_ASSERT_EQUAL(kSyncOpDelete, plan[2].operation);
+    scheduler.RestoreWindow(plan);
+    CPPUNIT_ASSERT_EQUAL((int32)2, scheduler.LaneStats(kSyncLaneLarge).queued);
+
+    SyncItem item;
+    CPPUNIT_ASSERT(scheduler.Pop(10, item));
+    CPPUNIT_ASSERT(item.remotePath == "/Docs/note.txt");
+    CPPUNIT_ASSERT(scheduler.Pop(10, item));
+    CPPUNIT_ASSERT_EQUAL(kSyncOpUpload, item.operation);
+    CPPUNIT_ASSERT(scheduler.Pop(10, item));
+    CPPUNIT_ASSERT_EQUAL(kSyncOpDelete, item.operation);
+    CPPUNIT_ASSERT(scheduler.IsEmpty());
+
+    // Once nothing is pending on the path, it is free to change lanes
+    scheduler.Push(_MakeItem(kSyncOpDelete, "/Images/disk.iso"), 20);
+    CPPUNIT_ASSERT_EQUAL((int32)1, scheduler.LaneStats(kSyncLaneSmall).queued);
+}
+
+/**
+ * @brief Fake stage work: track concurrency, then sleep
+ */
+static status_t
+FakeTransferStage(int32* active, int32* peak, bigtime_t delay)
+{
+    int32 running = atomic_add(active, 1) + 1;
+    int32 seen = *peak;
+    while (running > seen && atomic_test_and_set(peak, running, seen) != seen) {
+        seen = *peak;
+    }
+    snooze(delay);
+    atomic_add(active, -1);
+    return B_OK;
+}
+
+void SyncEngineTest::TestTransferPipeline()
+{
+    int32 active[kTransferStageCount] = { 0, 0, 0 };
+    int32 peak[kTransferStageCount] = { 0, 0, 0 };
+    int32 completed = 0;
+    int32 failed = 0;
+    int32 cancelled = 0;
+    bigtime_t networkDelay = 10000;
+
+    TransferPipeline pipeline(
+        [&](SyncItem& item) -> status_t {
+            return FakeTransferStage(&active[0], &peak[0], 2000);
+        },
+        [&](SyncItem& item) -> status_t {
+            if (item.remotePath == "/fail") {
+                return B_IO_ERROR;
+            }
+            return FakeTransferStage(&active[1], &peak[1], networkDelay);
+        },
+        [&](SyncItem& item) -> status_t {
+            return FakeTransferStage(&active[2], &peak[2], 500);
+        },
+        [&](SyncItem& item, status_t result) {
+            atomic_add(result == B_OK ? &completed
+                : result == B_CANCELED ? &cancelled : &failed, 1);
+        });
+    pipeline.SetConcurrency(kTransferStageDisk, 1);
+    pipeline.SetConcurrency(kTransferStageNetwork, 4);
+
+    // Nothing is taken before the workers run
+    SyncItem item = _MakeItem(kSyncOpUpload, "/early");
+    CPPUNIT_ASSERT(!pipeline.Submit(item));
+    CPPUNIT_ASSERT(item.remotePath == "/early");
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, pipeline.Start());
+
+    char path[64];
+    for (int32 i = 0; i < 40; i++) {
+        snprintf(path, sizeof(path), "/Docs/file_%d", i);
+        item = _MakeItem(kSyncOpUpload, i == 7 ? "/fail" : path);
+        CPPUNIT_ASSERT(pipeline.Submit(item));
+    }
+    pipeline.WaitIdle();
+    CPPUNIT_ASSERT_EQUAL((int32)0, pipeline.CountInFlight());
+
+    // A failed stage skips the rest; limits hold per stage
+    CPPUNIT_ASSERT_EQUAL((int32)39, completed);
+    CPPUNIT_ASSERT_EQUAL((int32)1, failed);
+    CPPUNIT_ASSERT_EQUAL((int32)1, peak[kTransferStageDisk]);
+    CPPUNIT_ASSERT(peak[kTransferStageNetwork] > 1);
+    CPPUNIT_ASSERT(peak[kTransferStageNetwork] <= 4);
+    CPPUNIT_ASSERT_EQUAL((int32)1, peak[kTransferStageFinalize]);
+
+    TransferPipelineStats stats = pipeline.Stats();
+    CPPUNIT_ASSERT_EQUAL((int32)40, stats.stages[kTransferStageDisk].processed);
+    CPPUNIT_ASSERT_EQUAL((int32)40,
+        stats.stages[kTransferStageNetwork].processed);
+    CPPUNIT_ASSERT_EQUAL((int32)39,
+        stats.stages[kTransferStageFinalize].processed);
+    for (int32 stage = 0; stage < kTransferStageCount; stage++) {
+        CPPUNIT_ASSERT(stats.stages[stage].utilization > 0.0f);
+        CPPUNIT_ASSERT(stats.stages[stage].utilization <= 1.0f);
+    }
+
+    // Fewer connections take effect while running
+    pipeline.SetConcurrency(kTransferStageNetwork, 1);
+    CPPUNIT_ASSERT_EQUAL((int32)1,
+        pipeline.Concurrency(kTransferStageNetwork));
+    peak[kTransferStageNetwork] = 0;
+    networkDelay = 50000;
+    for (int32 i = 0; i < 6; i++) {
+        snprintf(path, sizeof(path), "/Slow/file_%d", i);
+        item = _MakeItem(kSyncOpUpload, path);
+        CPPUNIT_ASSERT(pipeline.Submit(item));
+    }
+
+    // Items still queued come back as cancelled, the others finish
+    int32 handedBack = pipeline.CancelPending();
+    pipeline.WaitIdle();
+    CPPUNIT_ASSERT(handedBack > 0);
+    CPPUNIT_ASSERT_EQUAL(handedBack, cancelled);
+    CPPUNIT_ASSERT_EQUAL((int32)45, completed + cancelled);
+    CPPUNIT_ASSERT_EQUAL((int32)1, peak[kTransferStageNetwork]);
+
+    pipeline.Stop();
+    item = _MakeItem(kSyncOpUpload, "/late");
+    CPPUNIT_ASSERT(!pipeline.Submit(item));
+}
+
+/**
+ * @brief Send chunks through a shaper, counting them
+ */
+struct ThrottledTransfer {
+    BandwidthShaper* shaper;
+    int32* chunksSent;
+    int32 chunks;
+    int32 othersAtFinish;
+};
+
+static int32
+RunThrottledTransfer(void* data)
+{
+    ThrottledTransfer* transfer = static_cast<ThrottledTransfer*>(data);
+    for (int32 i = 0; i < transfer->chunks; i++) {
+        transfer->shaper->Throttle(kBandwidthUpload, 8 * 1024);
+        atomic_add(transfer->chunksSent, 1);
+    }
+    transfer->othersAtFinish = atomic_add(transfer->chunksSent, 0);
+    return 0;
+}
+
+void SyncEngineTest::TestBandwidthShaper()
+{
+    BandwidthShaper shaper;
+    bigtime_t now = system_time();
+
+    // Without a limit nothing waits
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)0,
+        shaper.Reserve(kBandwidthUpload, 1024 * 1024, now));
+
+    // 1 MB/s: each 64 KB chunk costs 62.5ms; a new limit starts without
+    // burst credit
+    shaper.SetLimit(kBandwidthUpload, 1024 * 1024);
+    now = system_time();
+    bigtime_t wait = 0;
+    for (int32 i = 0; i < 10; i++) {
+        wait = shaper.Reserve(kBandwidthUpload, 64 * 1024, now);
+    }
+    CPPUNIT_ASSERT(wait >= 562500 - 10000);
+    CPPUNIT_ASSERT(wait <= 562500);
+
+    // An idle bucket saves up to the burst credit of 100ms
+    now += 10 * 1000000LL;
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)0,
+        shaper.Reserve(kBandwidthUpload, 64 * 1024, now));
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)0,
+        shaper.Reserve(kBandwidthUpload, 64 * 1024, now));
+    wait = shaper.Reserve(kBandwidthUpload, 64 * 1024, now);
+    CPPUNIT_ASSERT(wait >= 24000 && wait <= 26000);
+
+    // Downloads have their own bucket
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)0,
+        shaper.Reserve(kBandwidthDownload, 1024 * 1024, now));
+
+    // Lifting the limit drops the debt
+    shaper.SetLimit(kBandwidthUpload, 0);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)0,
+        shaper.Reserve(kBandwidthUpload, 64 * 1024, system_time()));
+
+    // Concurrent transfers take turns: 4 x 10 x 8 KB at 1 MB/s; without
+    // burst credit the first transfer cannot run ahead
+    shaper.SetLimit(kBandwidthUpload, 1024 * 1024);
+    int32 chunksSent = 0;
+    ThrottledTransfer transfers[4];
+    thread_id threads[4];
+    bigtime_t start = system_time();
+    for (int32 i = 0; i < 4; i++) {
+        transfers[i].shaper = &shaper;
+        transfers[i].chunksSent = &chunksSent;
+        transfers[i].chunks = 10;
+        transfers[i].othersAtFinish = 0;
+        threads[i] = spawn_thread(RunThrottledTransfer, "throttled transfer",
+            B_NORMAL_PRIORITY, &transfers[i]);
+    }
+    for (int32 i = 0; i < 4; i++) {
+        resume_thread(threads[i]);
+    }
+    for (int32 i = 0; i < 4; i++) {
+        status_t exitValue;
+        wait_for_thread(threads[i], &exitValue);
+    }
+    bigtime_t elapsed = system_time() - start;
+
+    // 320 KB take about 310ms
+    CPPUNIT_ASSERT(elapsed >= 250000);
+    for (int32 i = 0; i < 4; i++) {
+        // No transfer finishes long before the others
+        CPPUNIT_ASSERT(transfers[i].othersAtFinish >= 25);
+    }
+    BandwidthStats stats = shaper.Stats(kBandwidthUpload);
+    CPPUNIT_ASSERT_EQUAL((off_t)1024 * 1024, stats.limit);
+    CPPUNIT_ASSERT(stats.throttled > 0);
+
+    // Schedules
+    std::vector<BandwidthRule> rules;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, BandwidthShaper::ParseSchedule(
+        "Mon-Fri 09:00-18:00 2M; sat,sun 10:00-12:00 up=512K; "
+        "22:00-07:00 unlimited", rules));
+    CPPUNIT_ASSERT_EQUAL((size_t)3, rules.size());
+    CPPUNIT_ASSERT_EQUAL((uint8)0x3e, rules[0].days);
+    CPPUNIT_ASSERT_EQUAL((int32)540, rules[0].start);
+    CPPUNIT_ASSERT_EQUAL((int32)1080, rules[0].end);
+    CPPUNIT_ASSERT_EQUAL((off_t)2 * 1024 * 1024,
+        rules[0].limits[kBandwidthDownload]);
+    CPPUNIT_ASSERT_EQUAL((off_t)512 * 1024, rules[1].limits[kBandwidthUpload]);
+    CPPUNIT_ASSERT_EQUAL((off_t)-1, rules[1].limits[kBandwidthDownload]);
+    CPPUNIT_ASSERT_EQUAL((off_t)0, rules[2].limits[kBandwidthUpload]);
+
+    const char* invalid[] = { "09:00-18:00", "2M", "Mon-Fry 09:00-18:00 2M",
+        "09:00-25:00 2M", "09:00-18:00 2X", "09:00-18:00 2M 10:00-11:00" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_VALUE,
+            BandwidthShaper::ParseSchedule(invalid[i], rules));
+    }
+
+    BandwidthShaper scheduled;
+    scheduled.SetLimit(kBandwidthUpload, 100 * 1024);
+    scheduled.SetLimit(kBandwidthDownload, 200 * 1024);
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, scheduled.SetSchedule(
+        "Mon-Fri 09:00-18:00 2M; sat,sun 10:00-12:00 up=512K; "
+        "22:00-07:00 unlimited"));
+    CPPUNIT_ASSERT_EQUAL((status_t)B_BAD_VALUE, scheduled.SetSchedule("bad"));
+
+    // Office hours on a Wednesday
+    CPPUNIT_ASSERT_EQUAL((off_t)2 * 1024 * 1024,
+        scheduled.LimitAt(kBandwidthUpload, 3, 10 * 60));
+    // Wednesday evening: the default limits
+    CPPUNIT_ASSERT_EQUAL((off_t)100 * 1024,
+        scheduled.LimitAt(kBandwidthUpload, 3, 19 * 60));
+    CPPUNIT_ASSERT_EQUAL((off_t)200 * 1024,
+        scheduled.LimitAt(kBandwidthDownload, 3, 19 * 60));
+    // Night, before and after midnight
+    CPPUNIT_ASSERT_EQUAL((off_t)0,
+        scheduled.LimitAt(kBandwidthUpload, 3, 23 * 60));
+    CPPUNIT_ASSERT_EQUAL((off_t)0,
+        scheduled.LimitAt(kBandwidthDownload, 4, 6 * 60 + 59));
+    // Weekend rule limits uploads only
+    CPPUNIT_ASSERT_EQUAL((off_t)512 * 1024,
+        scheduled.LimitAt(kBandwidthUpload, 6, 11 * 60));
+    CPPUNIT_ASSERT_EQUAL((off_t)200 * 1024,
+        scheduled.LimitAt(kBandwidthDownload, 6, 11 * 60));
+}
+
+void SyncEngineTest::TestPathFilter()
+{
+    PathFilter filter;
+    CPPUNIT_ASSERT(filter.IsEmpty());
+    CPPUNIT_ASSERT(!filter.Matches("Docs/report.tmp", true));
+
+    BStringList patterns;
+    patterns.Add("Thumbs.db");
+    patterns.Add("node_modules");
+    patterns.Add("*.tmp");
+    patterns.Add(" *.tar.gz ");
+    patterns.Add("~$*");
+    patterns.Add("[Bb]ackup?.zip");
+    patterns.Add("file[!0-9].txt");
+    patterns.Add("a\\*b");
+    patterns.Add("/Projects/**/build/");
+    patterns.Add("Cache/**.bak");
+    patterns.Add("");
+    filter.SetPatterns(patterns);
+
+    PathFilterStats stats = filter.Stats();
+    CPPUNIT_ASSERT_EQUAL((int32)10, stats.patterns);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.names);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.extensions);
+    CPPUNIT_ASSERT_EQUAL((int32)4, stats.globs);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.pathGlobs);
+
+    // Names and extensions
+    CPPUNIT_ASSERT(filter.Matches("Pictures/Thumbs.db", false));
+    CPPUNIT_ASSERT(filter.Matches("/Thumbs.db", false));
+    CPPUNIT_ASSERT(!filter.Matches("Pictures/Thumbs.dbx", false));
+    CPPUNIT_ASSERT(filter.Matches("Docs/report.tmp", false));
+    CPPUNIT_ASSERT(!filter.Matches("Docs/report.tmp.txt", false));
+    CPPUNIT_ASSERT(filter.Matches("archive.tar.gz", false));
+    CPPUNIT_ASSERT(!filter.Matches("archive.gz", false));
+
+    // Globs
+    CPPUNIT_ASSERT(filter.Matches("Docs/~$report.docx", false));
+    CPPUNIT_ASSERT(!filter.Matches("Docs/a~$report.docx", false));
+    CPPUNIT_ASSERT(filter.Matches("Backup1.zip", false));
+    CPPUNIT_ASSERT(filter.Matches("backupX.zip", false));
+    CPPUNIT_ASSERT(!filter.Matches("Backup12.zip", false));
+    CPPUNIT_ASSERT(filter.Matches("filea.txt", false));
+    CPPUNIT_ASSERT(!filter.Matches("file1.txt", false));
+    CPPUNIT_ASSERT(filter.Matches("a*b", false));
+    CPPUNIT_ASSERT(!filter.Matches("axb", false));
+
+    // Names above the last one match only when asked to
+    CPPUNIT_ASSERT(filter.Matches("web/node_modules/lib/index.js", true));
+    CPPUNIT_ASSERT(!filter.Matches("web/node_modules/lib/index.js", false));
+    CPPUNIT_ASSERT(!filter.Matches("web/node_modules_old/index.js", true));
+
+    // Path patterns match the path or a folder above it
+    CPPUNIT_ASSERT(filter.Matches("Projects/build", false));
+    CPPUNIT_ASSERT(filter.Matches("Projects/build/app.o", false));
+    CPPUNIT_ASSERT(filter.Matches("Projects/app/src/build/app.o", false));
+    CPPUNIT_ASSERT(!filter.Matches("Projects/builds/app.o", false));
+    CPPUNIT_ASSERT(!filter.Matches("Projects/appbuild/app.o", false));
+    CPPUNIT_ASSERT(!filter.Matches("Other/build/app.o", false));
+    CPPUNIT_ASSERT(filter.Matches("Cache/old.bak", false));
+    CPPUNIT_ASSERT(filter.Matches("Cache/2024/01/old.bak", false));
+    CPPUNIT_ASSERT(!filter.Matches("Cache/old.bak.txt", false));
+    CPPUNIT_ASSERT(!filter.Matches("Docs/Cache/old.bak", false));
+
+    // A new list replaces the old one
+    patterns.MakeEmpty();
+    patterns.Add("*.log");
+    filter.SetPatterns(patterns);
+    CPPUNIT_ASSERT(filter.Matches("server.log", false));
+    CPPUNIT_ASSERT(!filter.Matches("Docs/report.tmp", false));
+}
+
+void SyncEngineTest::TestPathFilterScaling()
+{
+    // Names, extensions, name globs and path globs in equal measure
+    const int32 kRules = 400;
+    const int32 kPaths = 1000000;
+    BStringList few;
+    BStringList many;
+    char pattern[64];
+    for (int32 i = 0; i < kRules; i++) {
+        switch (i % 4) {
+            case 0:
+                snprintf(pattern, sizeof(pattern), "config%d.ini", i);
+                break;
+            case 1:
+                snprintf(pattern, sizeof(pattern), "*.ext%d", i);
+                break;
+            case 2:
+                snprintf(pattern, sizeof(pattern), "*_draft%d.*", i);
+                break;
+            default:
+                snprintf(pattern, sizeof(pattern), "Projects/p%d/**/build", i);
+                break;
+        }
+        many.Add(pattern);
+        if (i < 4) {
+            few.Add(pattern);
+        }
+    }
+
+    PathFilter filters[2];
+    filters[0].SetPatterns(few);
+    filters[1].SetPatterns(many);
+
+    int32 matched[2];
+    char path[160];
+    for (int32 f = 0; f < 2; f++) {
+        matched[f] = 0;
+        for (int32 i = 0; i < kPaths; i++) {
+            int32 rule = i % (kRules * 2);
+            snprintf(path, sizeof(path),
+                "Projects/p%d/src/module%d/%s/file_draft%d.ext%d",
+                rule, i % 97, i % 3 == 0 ? "build" : "lib", rule, rule);
+            if (filters[f].Matches(path, true)) {
+                matched[f]++;
+            }
+        }
+    }
+
+    // Both filters work, and more rules catch more paths
+    CPPUNIT_ASSERT(matched[0] > 0);
+    CPPUNIT_ASSERT(matched[1] > matched[0]);
+    CPPUNIT_ASSERT(matched[1] < kPaths);
+
+    // Names and extensions are hashed, the globs merged into automata
+    PathFilterStats stats = filters[1].Stats();
+    CPPUNIT_ASSERT_EQUAL(kRules, stats.patterns);
+    CPPUNIT_ASSERT_EQUAL(kRules / 4, stats.names);
+    CPPUNIT_ASSERT_EQUAL(kRules / 4, stats.extensions);
+    CPPUNIT_ASSERT_EQUAL(kRules / 4, stats.globs);
+    CPPUNIT_ASSERT_EQUAL(kRules / 4, stats.pathGlobs);
+    CPPUNIT_ASSERT(stats.states <= 2 * PathFilter::kMaxStates);
+
+    // Once warm, a path costs one table step per character: matching
+    // the same paths again builds no state
+    int32 again = 0;
+    for (int32 i = 0; i < kRules * 2; i++) {
+        snprintf(path, sizeof(path),
+            "Projects/p%d/src/module%d/%s/file_draft%d.ext%d",
+            i, i % 97, i % 3 == 0 ? "build" : "lib", i, i);
+        filters[1].Matches(path, true);
+    }
+    stats = filters[1].Stats();
+    for (int32 i = 0; i < kRules * 2; i++) {
+        snprintf(path, sizeof(path),
+            "Projects/p%d/src/module%d/%s/file_draft%d.ext%d",
+            i, i % 97, i % 3 == 0 ? "build" : "lib", i, i);
+        if (filters[1].Matches(path, true)) {
+            again++;
+        }
+    }
+    CPPUNIT_ASSERT(again > 0);
+    CPPUNIT_ASSERT_EQUAL(stats.states, filters[1].Stats().states);
+}
+
+void SyncEngineTest::TestQuickXorHash()
+{
+    QuickXorHash hash;
+    CPPUNIT_ASSERT(hash.Base64() == "AAAAAAAAAAAAAAAAAAAAAAAAAAA=");
+
+    const char* kText = "The quick brown fox jumps over the lazy dog";
+    hash.Update(kText, strlen(kText));
+    CPPUNIT_ASSERT(hash.Base64() == "bMSlbysmxJL6S75XwfMcQZOpcr4=");
+
+    // The digest does not depend on how the input is split; 1000 bytes
+    // wrap the 160-bit register several times
+    uint8 data[1000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8)(i * 7 + 3);
+    }
+    const size_t kChunks[] = { 1000, 1, 7, 159, 160, 161, 333 };
+    for (size_t c = 0; c < sizeof(kChunks) / sizeof(kChunks[0]); c++) {
+        hash.Reset();
+        for (size_t offset = 0; offset < sizeof(data); offset += kChunks[c]) {
+            size_t length = sizeof(data) - offset;
+            hash.Update(data + offset, length < kChunks[c] ? length : kChunks[c]);
+        }
+        CPPUNIT_ASSERT(hash.Base64() == "dgD8j0n8sM0aPE5CUJ8tqmilX/E=");
+    }
+
+    uint8 digest[QuickXorHash::kDigestSize];
+    hash.Digest(digest);
+    CPPUNIT_ASSERT_EQUAL((uint8)0x76, digest[0]);
+    CPPUNIT_ASSERT_EQUAL((uint8)0xf1, digest[19]);
+}
+
+/**
+ * @brief Build a file item with a content hash
+ */
+static OneDriveItem
+MakeHashedItem(const char* id, const char* parentId, const char* name,
+    const char* hash, off_t size)
+{
+    OneDriveItem item = MakeRemoteItem(id, parentId, name);
+    item.quickXorHash = hash;
+    item.size = size;
+    return item;
+}
+
+void SyncEngineTest::TestRemoteTreeContent()
+{
+    const char* kSnapshot = "/tmp/onedrive_remote_tree_content_test";
+    const char* kPhoto = "bMSlbysmxJL6S75XwfMcQZOpcr4=";
+    const char* kLibrary = "dgD8j0n8sM0aPE5CUJ8tqmilX/E=";
+
+    RemoteTreeIndex index;
+    index.Apply(MakeRemoteItem("R", "", ""));
+    index.Apply(MakeRemoteItem("A", "R", "Exports", ITEM_TYPE_FOLDER));
+    index.Apply(MakeHashedItem("P", "A", "photo.jpg", kPhoto, 4000000));
+    index.Apply(MakeHashedItem("L", "R", "lib.so", kLibrary, 900000));
+    index.Apply(MakeRemoteItem("U", "R", "unhashed.txt"));
+
+    OneDriveItem item;
+    CPPUNIT_ASSERT(index.FindByContent(kPhoto, 4000000, item));
+    CPPUNIT_ASSERT(item.id == "P");
+    CPPUNIT_ASSERT(item.path == "/Exports/photo.jpg");
+    CPPUNIT_ASSERT(item.quickXorHash == kPhoto);
+
+    // Both the hash and the size have to match
+    CPPUNIT_ASSERT(!index.FindByContent(kPhoto, 4000001, item));
+    CPPUNIT_ASSERT(!index.FindByContent(kLibrary, 4000000, item));
+    CPPUNIT_ASSERT(!index.FindByContent("", 100, item));
+
+    // Duplicates: either copy will do, and one survives the other
+    index.Apply(MakeHashedItem("Q", "R", "copy.jpg", kPhoto, 4000000));
+    BList matches;
+    CPPUNIT_ASSERT_EQUAL((int32)2,
+        index.FindAllByContent(kPhoto, 4000000, matches, 8));
+    BString ids;
+    for (int32 i = 0; i < matches.CountItems(); i++) {
+        OneDriveItem* match = static_cast<OneDriveItem*>(matches.ItemAt(i));
+        ids << match->id;
+        delete match;
+    }
+    CPPUNIT_ASSERT(ids == "PQ" || ids == "QP");
+    matches.MakeEmpty();
+    CPPUNIT_ASSERT_EQUAL((int32)1,
+        index.FindAllByContent(kPhoto, 4000000, matches, 1));
+    delete static_cast<OneDriveItem*>(matches.ItemAt(0));
+    matches.MakeEmpty();
+    CPPUNIT_ASSERT_EQUAL((int32)0,
+        index.FindAllByContent(kLibrary, 4000000, matches, 8));
+    index.Apply(MakeRemoteItem("P", "A", "photo.jpg", ITEM_TYPE_FILE, true));
+    CPPUNIT_ASSERT(index.FindByContent(kPhoto, 4000000, item));
+    CPPUNIT_ASSERT(item.id == "Q");
+
+    // New content replaces the old key
+    index.Apply(MakeHashedItem("L", "R", "lib.so", kPhoto, 1000));
+    CPPUNIT_ASSERT(!index.FindByContent(kLibrary, 900000, item));
+    CPPUNIT_ASSERT(index.FindByContent(kPhoto, 1000, item));
+    CPPUNIT_ASSERT(item.id == "L");
+
+    // Hashes go with the snapshot and survive the first change after it
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, index.WriteSnapshot(kSnapshot, "t"));
+    RemoteTreeIndex mapped;
+    BString token;
+    CPPUNIT_ASSERT_EQUAL((status_t)B_OK, mapped.MapSnapshot(kSnapshot, token));
+    CPPUNIT_ASSERT(mapped.FindByContent(kPhoto, 4000000, item));
+    CPPUNIT_ASSERT(item.id == "Q");
+    mapped.Apply(MakeRemoteItem("A", "R", "Exports", ITEM_TYPE_FOLDER, true));
+    CPPUNIT_ASSERT(mapped.FindByContent(kPhoto, 1000, item));
+    CPPUNIT_ASSERT(item.id == "L");
+    unlink(kSnapshot);
+
+    // Removing a folder removes the content below it
+    index.Apply(MakeRemoteItem("B", "R", "Backup", ITEM_TYPE_FOLDER));
+    index.Apply(MakeHashedItem("Q", "B", "copy.jpg", kPhoto, 4000000));
+    index.Apply(MakeRemoteItem("B", "R", "Backup", ITEM_TYPE_FOLDER, true));
+    CPPUNIT_ASSERT(!index.FindByContent(kPhoto, 4000000, item));
+}
+
+void SyncEngineTest::TestDropJobProgress()
+{
+    DropJobTracker tracker(1000);
+    DropJobProgress progress;
+
+    int32 job = tracker.Begin();
+    CPPUNIT_ASSERT(tracker.AddItem(job, "/OneDrive/Photos", 0));
+    CPPUNIT_ASSERT(tracker.AddItem(job, "/OneDrive/Photos/a.jpg", 3000));
+    CPPUNIT_ASSERT(tracker.AddItem(job, "/OneDrive/Photos/b.jpg", 5000));
+    CPPUNIT_ASSERT(!tracker.AddItem(job + 1, "/OneDrive/c.jpg", 100));
+    CPPUNIT_ASSERT(tracker.GetProgress(job, progress));
+    CPPUNIT_ASSERT_EQUAL((int32)3, progress.totalItems);
+    CPPUNIT_ASSERT_EQUAL((off_t)8000, progress.totalBytes);
+    CPPUNIT_ASSERT(progress.enumerating);
+    CPPUNIT_ASSERT_EQUAL(job, tracker.JobOf("/OneDrive/Photos/a.jpg"));
+    CPPUNIT_ASSERT_EQUAL((int32)0, tracker.JobOf("/OneDrive/c.jpg"));
+
+    // Queued again by the same job, an item is still counted once
+    CPPUNIT_ASSERT(tracker.AddItem(job, "/OneDrive/Photos", 0));
+    CPPUNIT_ASSERT(tracker.GetProgress(job, progress));
+    CPPUNIT_ASSERT_EQUAL((int32)3, progress.totalItems);
+
+    // Items finishing before the walk ends do not finish the job
+    CPPUNIT_ASSERT(tracker.ItemDone("/OneDrive/Photos", true, 5000, progress));
+    CPPUNIT_ASSERT(!progress.finished);
+    CPPUNIT_ASSERT(!tracker.ItemDone("/OneDrive/Other", true, 9000, progress));
+
+    // Reports are throttled, except for the last one
+    CPPUNIT_ASSERT(!tracker.ItemDone("/OneDrive/Photos/a.jpg", true, 5500,
+        progress));
+    CPPUNIT_ASSERT(tracker.EnumerationDone(job, progress));
+    CPPUNIT_ASSERT(!progress.finished);
+    CPPUNIT_ASSERT(!progress.enumerating);
+    CPPUNIT_ASSERT(tracker.ItemDone("/OneDrive/Photos/b.jpg", false, 5600,
+        progress));
+    CPPUNIT_ASSERT(progress.finished);
+    CPPUNIT_ASSERT_EQUAL((int32)2, progress.completedItems);
+    CPPUNIT_ASSERT_EQUAL((int32)1, progress.failedItems);
+    CPPUNIT_ASSERT_EQUAL((off_t)3000, progress.completedBytes);
+    CPPUNIT_ASSERT(!tracker.GetProgress(job, progress));
+    CPPUNIT_ASSERT_EQUAL((int32)0, tracker.CountJobs());
+
+    // A walk that found nothing finishes at once
+    int32 empty = tracker.Begin();
+    CPPUNIT_ASSERT(empty != job);
+    CPPUNIT_ASSERT(tracker.EnumerationDone(empty, progress));
+    CPPUNIT_ASSERT(progress.finished);
+
+    // A path dropped again moves to the newer job
+    int32 first = tracker.Begin();
+    int32 second = tracker.Begin();
+    tracker.AddItem(first, "/OneDrive/d.jpg", 700);
+    tracker.AddItem(first, "/OneDrive/e.jpg", 300);
+    tracker.AddItem(second, "/OneDrive/d.jpg", 700);
+    CPPUNIT_ASSERT(tracker.GetProgress(first, progress));
+    CPPUNIT_ASSERT_EQUAL((int32)1, progress.totalItems);
+    CPPUNIT_ASSERT_EQUAL((off_t)300, progress.totalBytes);
+    CPPUNIT_ASSERT_EQUAL((int32)2, tracker.CountPendingItems());
+    tracker.EnumerationDone(second, progress);
+    CPPUNIT_ASSERT(tracker.ItemDone("/OneDrive/d.jpg", true, 0, progress));
+    CPPUNIT_ASSERT_EQUAL(second, progress.job);
+    CPPUNIT_ASSERT(progress.finished);
+    CPPUNIT_ASSERT_EQUAL((int32)1, tracker.CountJobs());
+}
+
+void SyncEngineTest::TestLocalChangeClassification()
+{
+    BString content = "hash-1";
+    int32 hashed = 0;
+    LocalChangeClassifier classifier([&](const BString& path) {
+        hashed++;
+        return content;
+    });
+
+    node_ref node;
+    node.device = 3;
+    node.node = 42;
+    node_ref unknown;
+    unknown.device = 3;
+    unknown.node = 43;
+
+    LocalFileState state;
+    state.path = "/OneDrive/song.mp3";
+    state.size = 4000;
+    state.modified = 1000;
+    state.hash = "hash-1";
+    classifier.Remember(node, state);
+
+    BString path;
+    CPPUNIT_ASSERT(classifier.PathFor(node, path));
+    CPPUNIT_ASSERT(path == "/OneDrive/song.mp3");
+    CPPUNIT_ASSERT(!classifier.PathFor(unknown, path));
+    LocalFileState synced;
+    CPPUNIT_ASSERT(classifier.StateOf(node, synced));
+    CPPUNIT_ASSERT(synced.hash == "hash-1");
+    CPPUNIT_ASSERT_EQUAL((off_t)4000, synced.size);
+    CPPUNIT_ASSERT(!classifier.StateOf(unknown, synced));
+
+    // Attribute changes never touch the content
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeAttributes,
+        classifier.ClassifyAttributes(node));
+
+    // Same size and time: nothing the drive keeps, no hashing
+    BString hash;
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeNone,
+        classifier.ClassifyStat(node, 4000, 1000, hash));
+    CPPUNIT_ASSERT_EQUAL((int32)0, hashed);
+
+    // A new size is new content, without hashing either
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyStat(node, 4100, 1000, hash));
+    CPPUNIT_ASSERT_EQUAL((int32)0, hashed);
+
+    // A touch: the hash shows the content is the same, and the new time
+    // is kept
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeMetadata,
+        classifier.ClassifyStat(node, 4000, 2000, hash));
+    CPPUNIT_ASSERT_EQUAL((int32)1, hashed);
+    CPPUNIT_ASSERT(hash == "hash-1");
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeNone,
+        classifier.ClassifyStat(node, 4000, 2000, hash));
+    CPPUNIT_ASSERT_EQUAL((int32)1, hashed);
+
+    // Rewritten at the same size
+    content = "hash-2";
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyStat(node, 4000, 3000, hash));
+    CPPUNIT_ASSERT(hash == "hash-2");
+
+    // Unreadable and unknown files are uploaded
+    content = "";
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyStat(node, 4000, 4000, hash));
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyStat(unknown, 4000, 1000, hash));
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyAttributes(unknown));
+
+    LocalChangeStats stats = classifier.Stats();
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.metadata);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.attributes);
+    CPPUNIT_ASSERT_EQUAL((int32)5, stats.content);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.unchanged);
+    CPPUNIT_ASSERT_EQUAL((int32)3, stats.hashed);
+
+    classifier.Forget(node);
+    CPPUNIT_ASSERT_EQUAL((int32)0, classifier.CountFiles());
+
+    // A file seen but never synced is uploaded on any change
+    classifier.Locate(unknown, "/OneDrive/notes.txt");
+    CPPUNIT_ASSERT(classifier.PathFor(unknown, path));
+    CPPUNIT_ASSERT(path == "/OneDrive/notes.txt");
+    CPPUNIT_ASSERT(classifier.StateOf(unknown, synced));
+    CPPUNIT_ASSERT_EQUAL((off_t)-1, synced.size);
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyAttributes(unknown));
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeContent,
+        classifier.ClassifyStat(unknown, 0, 0, hash));
+
+    // A renamed file keeps its synced state
+    classifier.Remember(node, state);
+    classifier.Locate(node, "/OneDrive/Music/song.mp3");
+    CPPUNIT_ASSERT(classifier.PathFor(node, path));
+    CPPUNIT_ASSERT(path == "/OneDrive/Music/song.mp3");
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeAttributes,
+        classifier.ClassifyAttributes(node));
+    CPPUNIT_ASSERT_EQUAL(kLocalChangeNone,
+        classifier.ClassifyStat(node, 4000, 1000, hash));
+
+    // A renamed folder takes the files below it along, and only those
+    classifier.MoveTree("/OneDrive/Music", "/OneDrive/Songs");
+    classifier.MoveTree("/OneDrive/notes", "/OneDrive/old");
+    CPPUNIT_ASSERT(classifier.PathFor(node, path));
+    CPPUNIT_ASSERT(path == "/OneDrive/Songs/song.mp3");
+    CPPUNIT_ASSERT(classifier.PathFor(unknown, path));
+    CPPUNIT_ASSERT(path == "/OneDrive/notes.txt");
+    CPPUNIT_ASSERT_EQUAL((int32)2, classifier.CountFiles());
+}
+
+/**
+ * @brief Remove the folders of the local move test
+ */
+static void
+ClearMoveTestTree(const char* base)
+{
+    const char* folders[] = { "OneDrive/Docs", "OneDrive/Archive/Docs",
+        "Elsewhere/Docs" };
+    BString path;
+    for (size_t i = 0; i < sizeof(folders) / sizeof(folders[0]); i++) {
+        path.SetToFormat("%s/%s/Sub/b.txt", base, folders[i]);
+        unlink(path.String());
+        path.SetToFormat("%s/%s/Sub", base, folders[i]);
+        rmdir(path.String());
+        path.SetToFormat("%s/%s/a.txt", base, folders[i]);
+        unlink(path.String());
+        path.SetToFormat("%s/%s", base, folders[i]);
+        rmdir(path.String());
+    }
+    path.SetToFormat("%s/OneDrive/Archive", base);
+    rmdir(path.String());
+    path.SetToFormat("%s/OneDrive", base);
+    rmdir(path.String());
+    path.SetToFormat("%s/Elsewhere", base);
+    rmdir(path.String());
+    rmdir(base);
+}
+
+/**
+ * @brief Rename a folder and build the node monitor message it causes
+ */
+static void
+MoveTestFolder(const BString& fromDirectory, const BString& toDirectory,
+    const char* name, BMessage& message)
+{
+    struct stat from;
+    struct stat to;
+    stat(fromDirectory.String(), &from);
+    stat(toDirectory.String(), &to);
+
+    BString source(fromDirectory);
+    source << "/" << name;
+    BString target(toDirectory);
+    target << "/" << name;
+    struct stat entry;
+    stat(source.String(), &entry);
+    rename(source.String(), target.String());
+
+    message.MakeEmpty();
+    message.what = B_NODE_MONITOR;
+    message.AddInt32("opcode", B_ENTRY_MOVED);
+    message.AddInt32("device", entry.st_dev);
+    message.AddInt64("from directory", from.st_ino);
+    message.AddInt64("to directory", to.st_ino);
+    message.AddInt64("node", entry.st_ino);
+    message.AddString("from name", name);
+    message.AddString("name", name);
+}
+
+void SyncEngineTest::TestLocalFolderMove()
+{
+    const char* kBase = "/tmp/onedrive_move_test";
+    ClearMoveTestTree(kBase);
+
+    BString root(kBase);
+    root << "/OneDrive";
+    BString archive(root);
+    archive << "/Archive";
+    BString elsewhere(kBase);
+    elsewhere << "/Elsewhere";
+    BString docs(root);
+    docs << "/Docs";
+    mkdir(kBase, 0755);
+    mkdir(root.String(), 0755);
+    mkdir(archive.String(), 0755);
+    mkdir(elsewhere.String(), 0755);
+    mkdir(docs.String(), 0755);
+    mkdir(BString(docs).Append("/Sub").String(), 0755);
+    FILE* file = fopen(BString(docs).Append("/a.txt").String(), "w");
+    CPPUNIT_ASSERT(file != NULL);
+    fclose(file);
+    file = fopen(BString(docs).Append("/Sub/b.txt").String(), "w");
+    CPPUNIT_ASSERT(file != NULL);
+    fclose(file);
+
+    BString rootPrefix(root);
+    rootPrefix << "/";
+    LocalMoveTranslator translator(BPath(root.String()),
+        [&](const BPath& path) {
+            return BString(path.Path()).StartsWith(rootPrefix);
+        });
+
+    // A populated folder moved within the sync folder: the one node
+    // monitor message it causes becomes one move of the folder
+    BMessage message;
+    MoveTestFolder(root, archive, "Docs", message);
+    SyncItem item;
+    CPPUNIT_ASSERT_EQUAL(kLocalMoveWithin, translator.Translate(&message, item));
+
+    std::vector<SyncItem> plan;
+    plan.push_back(item);
+    SyncPlanOptimizer optimizer;
+    optimizer.Optimize(plan);
+    CPPUNIT_ASSERT_EQUAL((size_t)1, plan.size());
+    CPPUNIT_ASSERT_EQUAL(kSyncOpMove, plan[0].operation);
+    CPPUNIT_ASSERT(plan[0].previousPath == "/Docs");
+    CPPUNIT_ASSERT(plan[0].remotePath == "/Archive/Docs");
+    CPPUNIT_ASSERT(plan[0].localPath == BString(archive).Append("/Docs"));
+
+    // Moved out, it is deleted at its old path; moved back in, uploaded
+    MoveTestFolder(archive, elsewhere, "Docs", message);
+    item = SyncItem();
+    CPPUNIT_ASSERT_EQUAL(kLocalMoveOut, translator.Translate(&message, item));
+    CPPUNIT_ASSERT(item.localPath == BString(archive).Append("/Docs"));
+
+    MoveTestFolder(elsewhere, root, "Docs", message);
+    item = SyncItem();
+    CPPUNIT_ASSERT_EQUAL(kLocalMoveIn, translator.Translate(&message, item));
+    CPPUNIT_ASSERT(item.localPath == docs);
+
+    // Not a move at all
+    message.RemoveName("from directory");
+    CPPUNIT_ASSERT_EQUAL(kLocalMoveIgnored,
+        translator.Translate(&message, item));
+
+    ClearMoveTestTree(kBase);
+}
+
+void SyncEngineTest::TestAttributeCoalescing()
+{
+    AttributeCoalescer coalescer(100, 1000);
+    AttributeBurst burst;
+
+    // Tracker writing five attributes of a file, and one of another
+    coalescer.Add("/OneDrive/a.mp3", "Audio:Artist", 0);
+    coalescer.Add("/OneDrive/a.mp3", "Audio:Album", 20);
+    coalescer.Add("/OneDrive/b.mp3", "Audio:Rating", 30);
+    coalescer.Add("/OneDrive/a.mp3", "Audio:Title", 40);
+    coalescer.Add("/OneDrive/a.mp3", "Audio:Track", 60);
+    coalescer.Add("/OneDrive/a.mp3", "Audio:Artist", 80);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)130, coalescer.NextDue());
+    CPPUNIT_ASSERT(!coalescer.TakeDue(129, burst));
+
+    // Each file comes out once, when its burst is quiet
+    CPPUNIT_ASSERT(coalescer.TakeDue(130, burst));
+    CPPUNIT_ASSERT(burst.path == "/OneDrive/b.mp3");
+    CPPUNIT_ASSERT(!coalescer.TakeDue(179, burst));
+    CPPUNIT_ASSERT(coalescer.TakeDue(180, burst));
+    CPPUNIT_ASSERT(burst.path == "/OneDrive/a.mp3");
+    CPPUNIT_ASSERT_EQUAL((int32)5, burst.changes);
+    CPPUNIT_ASSERT_EQUAL((size_t)4, burst.names.size());
+    CPPUNIT_ASSERT(coalescer.NextDue() == B_INFINITE_TIMEOUT);
+
+    // A file changed without pause is held at most the maximum delay
+    for (bigtime_t now = 1000; now < 3000; now += 50) {
+        coalescer.Add("/OneDrive/c.txt", "rating", now);
+    }
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)2000, coalescer.NextDue());
+
+    AttributeCoalescerStats stats = coalescer.Stats(3000);
+    CPPUNIT_ASSERT_EQUAL((int32)46, stats.changes);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.bursts);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.pending);
+
+    // Fingerprints tell type and value apart
+    int32 rating = 3;
+    int64 wideRating = 3;
+    uint64 ratingPrint = AttributeCoalescer::Fingerprint(B_INT32_TYPE,
+        &rating, sizeof(rating));
+    CPPUNIT_ASSERT(ratingPrint != AttributeCoalescer::Fingerprint(
+        B_INT64_TYPE, &wideRating, sizeof(wideRating)));
+    CPPUNIT_ASSERT(ratingPrint != AttributeCoalescer::Fingerprint(
+        B_RAW_TYPE, &rating, sizeof(rating)));
+    rating = 4;
+    CPPUNIT_ASSERT(ratingPrint != AttributeCoalescer::Fingerprint(
+        B_INT32_TYPE, &rating, sizeof(rating)));
+
+    // Never uploaded: everything goes
+    AttributeFingerprints current;
+    current["Audio:Artist"] = 1;
+    current["Audio:Album"] = 2;
+    current["Audio:Rating"] = ratingPrint;
+    std::vector<BString> changed;
+    std::vector<BString> removed;
+    coalescer.Diff("/OneDrive/a.mp3", current, changed, removed);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, changed.size());
+    CPPUNIT_ASSERT(removed.empty());
+
+    // After an upload only the differences count
+    coalescer.Commit("/OneDrive/a.mp3", current);
+    coalescer.Diff("/OneDrive/a.mp3", current, changed, removed);
+    CPPUNIT_ASSERT(changed.empty());
+    CPPUNIT_ASSERT(removed.empty());
+
+    current["Audio:Rating"] = 99;
+    current.erase("Audio:Album");
+    current["Audio:Year"] = 5;
+    coalescer.Diff("/OneDrive/a.mp3", current, changed, removed);
+    CPPUNIT_ASSERT_EQUAL((size_t)2, changed.size());
+    CPPUNIT_ASSERT(changed[0] == "Audio:Rating");
+    CPPUNIT_ASSERT(changed[1] == "Audio:Year");
+    CPPUNIT_ASSERT_EQUAL((size_t)1, removed.size());
+    CPPUNIT_ASSERT(removed[0] == "Audio:Album");
+
+    coalescer.Forget("/OneDrive/a.mp3");
+    coalescer.Forget("/OneDrive/c.txt");
+    coalescer.Diff("/OneDrive/a.mp3", current, changed, removed);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, changed.size());
+    CPPUNIT_ASSERT(coalescer.NextDue() == B_INFINITE_TIMEOUT);
+}
+
+void SyncEngineTest::TestAttributeWorkerOrdering()
+{
+    AttributeCoalescer coalescer(100, 1000);
+    AttributeBurst first;
+    AttributeBurst second;
+
+    coalescer.Add("/OneDrive/a.jpg", "rating", 0);
+    coalescer.Add("/OneDrive/b.jpg", "rating", 10);
+    CPPUNIT_ASSERT(coalescer.TakeDue(200, first));
+    CPPUNIT_ASSERT(first.path == "/OneDrive/a.jpg");
+
+    // Changed again while being uploaded: held until that upload is done,
+    // while other files go to other workers
+    coalescer.Add("/OneDrive/a.jpg", "tags", 200);
+    CPPUNIT_ASSERT(coalescer.TakeDue(400, second));
+    CPPUNIT_ASSERT(second.path == "/OneDrive/b.jpg");
+    CPPUNIT_ASSERT(!coalescer.TakeDue(400, second));
+    CPPUNIT_ASSERT(coalescer.NextDue() == B_INFINITE_TIMEOUT);
+
+    AttributeCoalescerStats stats = coalescer.Stats(400);
+    CPPUNIT_ASSERT_EQUAL((int32)1, stats.pending);
+    CPPUNIT_ASSERT_EQUAL((int32)2, stats.active);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)200, stats.busyTime);
+
+    coalescer.Done("/OneDrive/a.jpg", 500);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)300, coalescer.NextDue());
+    CPPUNIT_ASSERT(coalescer.TakeDue(500, first));
+    CPPUNIT_ASSERT(first.path == "/OneDrive/a.jpg");
+    CPPUNIT_ASSERT(first.names[0] == "tags");
+
+    // Drain rate counts time with work in hand only
+    coalescer.Done("/OneDrive/b.jpg", 600);
+    coalescer.Done("/OneDrive/a.jpg", 700);
+    coalescer.Done("/OneDrive/a.jpg", 800);
+    stats = coalescer.Stats(5000);
+    CPPUNIT_ASSERT_EQUAL((int32)3, stats.completed);
+    CPPUNIT_ASSERT_EQUAL((int32)0, stats.active);
+    CPPUNIT_ASSERT_EQUAL((bigtime_t)500, stats.busyTime);
+    CPPUNIT_ASSERT(stats.drainRate > 5999.0f && stats.drainRate < 6001.0f);
+}
+
+/**
+ * @brief An attribute Tracker or a media app sets
+ */
+struct StoredAttribute {
+    const char* name;
+    type_code type;
+    size_t size;
+};
+
+// One in ten files also has an icon, too large to be stored inline
+static const StoredAttribute kStoredAttributes[] = {
+    { "BEOS:TYPE", B_STRING_TYPE, 11 },
+    { "Media:Rating", B_INT32_TYPE, 4 },
+    { "Media:Comment", B_STRING_TYPE, 180 },
+    { "BEOS:ICON", 'VICN', 1800 }
+};
+static const int32 kStoredAttributeCount
+    = sizeof(kStoredAttributes) / sizeof(kStoredAttributes[0]);
+
+static void
+FillStoredAttribute(const StoredAttribute& attribute, int32 seed, void* buffer)
+{
+    uint8* bytes = static_cast<uint8*>(buffer);
+    for (size_t i = 0; i < attribute.size; i++) {
+        bytes[i] = attribute.type == B_STRING_TYPE
+            ? 'a' + (seed + i) % 26 : (uint8)(seed * 31 + i);
+    }
+    if (attribute.type == B_STRING_TYPE) {
+        bytes[attribute.size - 1] = '\0';
+    }
+}
+
+/**
+ * @brief The attributes of one file, made up from a seed
+ */
+class StoredAttributeReader : public AttributeReader {
+public:
+    StoredAttributeReader(int32 seed, bool icon)
+        : fSeed(seed), fIcon(icon), fNext(0)
+    {
+    }
+
+    virtual status_t InitCheck() const
+    {
+        return B_OK;
+    }
+
+    virtual status_t GetNextAttrName(char* name)
+    {
+        while (fNext < kStoredAttributeCount) {
+            const StoredAttribute& attribute = kStoredAttributes[fNext++];
+            if (attribute.size > AttributeBuffer::kInlineSize && !fIcon) {
+                continue;
+            }
+            strlcpy(name, attribute.name, B_ATTR_NAME_LENGTH);
+            return B_OK;
+        }
+        return B_ENTRY_NOT_FOUND;
+    }
+
+    virtual status_t GetAttrInfo(const char* name, attr_info* info)
+    {
+        const StoredAttribute* attribute = _Find(name);
+        if (attribute == NULL) {
+            return B_ENTRY_NOT_FOUND;
+        }
+        info->type = attribute->type;
+        info->size = attribute->size;
+        return B_OK;
+    }
+
+    virtual ssize_t ReadAttr(const char* name, type_code type, off_t offset,
+        void* buffer, size_t size)
+    {
+        const StoredAttribute* attribute = _Find(name);
+        if (attribute == NULL || attribute->type != type || offset != 0
+            || size < attribute->size) {
+            return B_BAD_VALUE;
+        }
+        FillStoredAttribute(*attribute, fSeed, buffer);
+        return attribute->size;
+    }
+
+private:
+    const StoredAttribute* _Find(const char* name) const
+    {
+        for (int32 i = 0; i < kStoredAttributeCount; i++) {
+            if (strcmp(kStoredAttributes[i].name, name) == 0) {
+                return &kStoredAttributes[i];
+            }
+        }
+        return NULL;
+    }
+
+    int32 fSeed;
+    bool fIcon;
+    int32 fNext;
+};
+
+void SyncEngineTest::TestAttributeReadScale()
+{
+    // 100000 files read through the manager's own loop
+    const int32 kFiles = 100000;
+    int32 opened = 0;
+    AttributeManager manager;
+    manager.SetAttributeSource([&opened](const BString& path) {
+        int32 file = opened++;
+        return new StoredAttributeReader(file % 64, file % 10 == 0);
+    });
+
+    AttributeBuffer& buffer = AttributeBuffer::ForThread();
+    int32 allocations = buffer.CountAllocations();
+    AttributeFingerprints current;
+    int32 reads = 0;
+    int32 inPlace = 0;
+
+    for (int32 file = 0; file < kFiles; file++) {
+        current.clear();
+        CPPUNIT_ASSERT_EQUAL(B_OK, manager.VisitAttributes("/OneDrive/a.jpg",
+            [&](const AttributeView& attribute) {
+                current[attribute.name] = AttributeCoalescer::Fingerprint(
+                    attribute.type, attribute.data, attribute.size);
+                if (attribute.data == buffer.Reserve(attribute.size)) {
+                    inPlace++;
+                }
+                reads++;
+            }));
+    }
+
+    // The old path allocated, copied and freed every one of these values;
+    // now the buffer grows once, for the first icon
+    CPPUNIT_ASSERT_EQUAL(kFiles, opened);
+    CPPUNIT_ASSERT_EQUAL(kFiles * 3 + kFiles / 10, reads);
+    CPPUNIT_ASSERT_EQUAL(reads, inPlace);
+    CPPUNIT_ASSERT(buffer.CountAllocations() - allocations <= 1);
+    CPPUNIT_ASSERT(buffer.Capacity() >= 1800);
+
+    // The views fingerprint what was read, not a copy of it
+    uint8 comment[180];
+    FillStoredAttribute(kStoredAttributes[2], (kFiles - 1) % 64, comment);
+    CPPUNIT_ASSERT_EQUAL((size_t)3, current.size());
+    CPPUNIT_ASSERT(current["Media:Comment"]
+        == AttributeCoalescer::Fingerprint(B_STRING_TYPE, comment, 180));
+
+    // The same loop fills messages
+    opened = 0;
+    BMessage attributes;
+    CPPUNIT_ASSERT_EQUAL(B_OK,
+        manager.ReadAttributes("/OneDrive/a.jpg", attributes));
+    CPPUNIT_ASSERT_EQUAL((int32)4, attributes.CountNames(B_ANY_TYPE));
+    int32 rating;
+    FillStoredAttribute(kStoredAttributes[1], 0, &rating);
+    CPPUNIT_ASSERT_EQUAL(rating, attributes.GetInt32("Media:Rating", 0));
+    CPPUNIT_ASSERT_EQUAL((int32)10,
+        (int32)strlen(attributes.GetString("BEOS:TYPE", "")));
+
+    // Small values stay inline; each thread keeps its own buffer
+    AttributeBuffer local;
+    void* small = local.Reserve(AttributeBuffer::kInlineSize);
+    CPPUNIT_ASSERT(small == local.Reserve(1));
+    CPPUNIT_ASSERT(small != local.Reserve(AttributeBuffer::kInlineSize + 1));
+    CPPUNIT_ASSERT_EQUAL((int32)1, local.CountAllocations());
+    CPPUNIT_ASSERT(&AttributeBuffer::ForThread()
+        == &AttributeBuffer::ForThread());
+    CPPUNIT_ASSERT(&AttributeBuffer::ForThread() != &local);
+}
+
+SyncItem SyncEngineTest::_MakeItem(SyncOperation operation,
+    const char* remotePath, const char* previousPath)
+{
+    SyncItem item;
+    item.operation = operation;
+    item.status = kSyncStatusPending;
+    item.remotePath = remotePath;
+    item.previousPath = previousPath;
+    item.localModified = 0;
+    item.remoteModified = 0;
+    item.size = 0;
+    item.retryCount = 0;
+    item.isPinned = false;
+    item.priority = kSyncPriorityNormal;
+    item.queuedTime = 0;
+    return item;
+}
+
+// Test suite factory
+CppUnit::Test* SyncEngineTestSuite()
+{
+    CppUnit::TestSuite* suite = new CppUnit::TestSuite("SyncEngineTestSuite");
+
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestCollapseSubtreeDelete", &SyncEngineTest::TestCollapseSubtreeDelete));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestCollapseSubtreeMove", &SyncEngineTest::TestCollapseSubtreeMove));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestNewTreeParentFirst", &SyncEngineTest::TestNewTreeParentFirst));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPlanKeepsPathOrder", &SyncEngineTest::TestPlanKeepsPathOrder));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestIsDescendant", &SyncEngineTest::TestIsDescendant));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPathCacheLookup", &SyncEngineTest::TestPathCacheLookup));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPathCacheInvalidation", &SyncEngineTest::TestPathCacheInvalidation));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPathCacheEviction", &SyncEngineTest::TestPathCacheEviction));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRetryOrdering", &SyncEngineTest::TestRetryOrdering));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRetryBackoff", &SyncEngineTest::TestRetryBackoff));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRetryParking", &SyncEngineTest::TestRetryParking));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestAdaptivePollInterval", &SyncEngineTest::TestAdaptivePollInterval));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestNotificationProtocol", &SyncEngineTest::TestNotificationProtocol));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestNotificationStandIn", &SyncEngineTest::TestNotificationStandIn));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestDeltaPipelineOrder", &SyncEngineTest::TestDeltaPipelineOrder));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestDeltaPipelineError", &SyncEngineTest::TestDeltaPipelineError));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteCrawler", &SyncEngineTest::TestRemoteCrawler));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteCrawlerFrontier", &SyncEngineTest::TestRemoteCrawlerFrontier));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeIndex", &SyncEngineTest::TestRemoteTreeIndex));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeIndexPlaceholders",
+        &SyncEngineTest::TestRemoteTreeIndexPlaceholders));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeIndexScale", &SyncEngineTest::TestRemoteTreeIndexScale));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeSnapshot", &SyncEngineTest::TestRemoteTreeSnapshot));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeSnapshotValidation",
+        &SyncEngineTest::TestRemoteTreeSnapshotValidation));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSyncQueueRoundTrip", &SyncEngineTest::TestSyncQueueRoundTrip));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSyncQueueFootprint", &SyncEngineTest::TestSyncQueueFootprint));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSyncQueueSpill", &SyncEngineTest::TestSyncQueueSpill));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSyncQueueRestart", &SyncEngineTest::TestSyncQueueRestart));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSyncQueueRefillCrash", &SyncEngineTest::TestSyncQueueRefillCrash));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSchedulerLanes", &SyncEngineTest::TestSchedulerLanes));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSchedulerAging", &SyncEngineTest::TestSchedulerAging));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSchedulerParentFirst", &SyncEngineTest::TestSchedulerParentFirst));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestSchedulerSamePathOrder", &SyncEngineTest::TestSchedulerSamePathOrder));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestTransferPipeline", &SyncEngineTest::TestTransferPipeline));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestBandwidthShaper", &SyncEngineTest::TestBandwidthShaper));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPathFilter", &SyncEngineTest::TestPathFilter));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestPathFilterScaling", &SyncEngineTest::TestPathFilterScaling));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestQuickXorHash", &SyncEngineTest::TestQuickXorHash));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestRemoteTreeContent", &SyncEngineTest::TestRemoteTreeContent));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestDropJobProgress", &SyncEngineTest::TestDropJobProgress));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestLocalChangeClassification",
+        &SyncEngineTest::TestLocalChangeClassification));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestLocalFolderMove", &SyncEngineTest::TestLocalFolderMove));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestAttributeCoalescing", &SyncEngineTest::TestAttributeCoalescing));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestAttributeWorkerOrdering",
+        &SyncEngineTest::TestAttributeWorkerOrdering));
+    suite->addTest(new CppUnit::TestCaller<SyncEngineTest>(
+        "TestAttributeReadScale", &SyncEngineTest::TestAttributeReadScale));
+
+    return suite;
+}
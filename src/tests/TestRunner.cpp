@@ -34,6 +34,7 @@
 extern CppUnit::Test* AuthManagerTestSuite();
 extern CppUnit::Test* OneDriveAPITestSuite();
 extern CppUnit::Test* OneDriveDaemonTestSuite();
+extern CppUnit::Test* SyncEngineTestSuite();
 extern CppUnit::Test* IntegrationTestSuite();
 #endif
 
@@ -287,6 +288,7 @@ int RunTestsCppUnit(const TestConfig& config, TestStats& stats)
         runner.addTest(AuthManagerTestSuite());
         runner.addTest(OneDriveAPITestSuite());
         runner.addTest(OneDriveDaemonTestSuite());
+        runner.addTest(SyncEngineTestSuite());
     }
     
     if (config.runAllTests || config.runIntegrationTests) {